@@ -30,6 +30,7 @@
 #include <psp-cfg.h>
 #include <psp-core.h>
 #include <psp-iom.h>
+#include <psp-trace.h>
 
 
 /** Opaque PSP CCD handle. */
@@ -79,6 +80,16 @@ int PSPEmuCcdQueryCore(PSPCCD hCcd, PPSPCORE phPspCore);
 int PSPEmuCcdQueryIoMgr(PSPCCD hCcd, PPSPIOM phIoMgr);
 
 
+/**
+ * Queries the tracer handle from the given CCD.
+ *
+ * @returns Status code.
+ * @param   hCcd                The CCD handle.
+ * @param   phTrace             Where to store the handle to the tracer on success, NULL if tracing is disabled.
+ */
+int PSPEmuCcdQueryTrace(PSPCCD hCcd, PPSPTRACE phTrace);
+
+
 /**
  * Resets the given CCD instance to the initial state right after creation, including all device states.
  *
@@ -25,6 +25,7 @@
 #include <common/types.h>
 
 #include <psp-dbg-hlp.h>
+#include <psp-flash.h>
 
 /**
  * Emulation mode.
@@ -216,6 +217,8 @@ typedef struct PSPEMUCFG
     bool                    fBinContainsHdr;
     /** Flag whether to load the PSP directory from the flash image into the boot rom service page. */
     bool                    fLoadPspDir;
+    /** Flag whether to write the flash index cache next to the flash image. */
+    bool                    fFlashIdxCacheWrite;
     /** Flag whether to enable the debug mode inside the PSP firmware disabling signature checks etc. */
     bool                    fPspDbgMode;
     /** Flag whether to intercept svc 6 in on chip bootloader and system mode. */
@@ -229,10 +232,20 @@ typedef struct PSPEMUCFG
     bool                    fBootRomSvcPageModify;
     /** Flag whether the i/O manager should log all I/O accesses to all regions. */
     bool                    fIomLogAllAccesses;
+    /** Path to dump the I/O manager access statistics to on exit, NULL to disable. */
+    const char              *pszIomStats;
+    /** Flag whether to account and report the host time spent in the emulator subsystems. */
+    bool                    fPerfReport;
+    /** Interval of the periodic host time report in seconds, 0 to only report on exit. */
+    uint32_t                cSecPerfReport;
     /** Flag whether the proxy should try to buffer certain writes to speed up data transfers. */
     bool                    fProxyWrBuffer;
     /** Flag whether to proxy certain CCP requests - requires the proxy to be enabled of course. */
     bool                    fCcpProxy;
+    /** Flag whether CCP queues only accessing the SRAM are processed asynchronously on host worker threads. */
+    bool                    fCcpAsync;
+    /** Directory of the persistent CCP RSA result cache, NULL if disabled. */
+    const char              *pszCcpRsaCache;
     /** Flag whether to do single step execution with dumping the core state after each instruction. */
     bool                    fSingleStepDumpCoreState;
     /** Debugger port to listen on, 0 means debugger is disabled. */
@@ -241,15 +254,19 @@ typedef struct PSPEMUCFG
     uint32_t                cDbgInsnStep;
     /** Address to run up to before dropping into the debugger. */
     PSPADDR                 PspAddrDbgRunUpTo;
+    /** Flag whether all configured CCDs are created and attached to the debugger instead of only the first one. */
+    bool                    fDbgAllCcds;
     /** Pointer to the read flash rom content. */
     void                    *pvFlashRom;
     /** Size of the flash ROM in bytes. */
     size_t                  cbFlashRom;
+    /** Index of the directory entries in the flash ROM. */
+    PSPFLASHIDX             hFlashIdx;
     /** Pointer to the on chip bootloader ROM content. */
     void                    *pvOnChipBl;
     /** Size of the on chip bootloader ROM in bytes. */
     size_t                  cbOnChipBl;
-    /** Pointer to the binary content if pszPathBinLoad is not NULL. */
+    /** Pointer to the binary content, either loaded from pszPathBinLoad or pointing into the flash ROM. */
     void                    *pvBinLoad;
     /** Number of bytes of the binary loaded. */
     size_t                  cbBinLoad;
@@ -268,6 +285,10 @@ typedef struct PSPEMUCFG
     PSPPADDR                PspAddrProxyTrustedOsHandover;
     /** Path to the trace log to write if enabled. */
     const char              *pszTraceLog;
+    /** Flag whether trace events include the (delta encoded) full core register context. */
+    bool                    fTraceFullCoreCtx;
+    /** Filter deciding which device accesses get logged to the trace log, NULL to use the default. */
+    const char              *pszTraceFilter;
     /** UART remtoe address. */
     const char              *pszUartRemoteAddr;
     /** Flash EM100 emulator emulator port. */
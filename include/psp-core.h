@@ -35,6 +35,10 @@ typedef PSPCORE *PPSPCORE;
 /** @todo Move into status code header. */
 /** PSPEmuCoreExecRun() returned because there was a WFI instruction. */
 #define PSPEMU_INF_CORE_INSN_WFI_REACHED (1000)
+/** PSPEmuCoreHaltWait() returned because the timeout expired without the core being woken up. */
+#define PSPEMU_INF_CORE_HALT_TIMEOUT     (1001)
+/** PSPEmuCoreHaltWait() returned because PSPEmuCoreExecStop() was called. */
+#define PSPEMU_INF_CORE_HALT_STOPPED     (1002)
 
 /** Trace hook handler. */
 typedef void (FNPSPCORETRACE)(PSPCORE hCore, PSPADDR uPspAddr, uint32_t cbInsn, void *pvUser);
@@ -69,6 +73,18 @@ typedef int (FNPSPCOREWFI)(PSPCORE hCore, PSPADDR PspAddrPc, uint32_t fFlags, bo
 /** Pointer to a WFI reached callback. */
 typedef FNPSPCOREWFI *PFNPSPCOREWFI;
 
+
+/**
+ * Core halt notification callback.
+ *
+ * @returns nothing.
+ * @param   hCore                   The PSP core handle which is about to be put to sleep.
+ * @param   pvUser                  Opaque user data passed during callback registration.
+ */
+typedef void (FNPSPCOREHALT)(PSPCORE hCore, void *pvUser);
+/** Pointer to a core halt notification callback. */
+typedef FNPSPCOREHALT *PFNPSPCOREHALT;
+
 /** Just check for a pending interrupt but don't block. */
 #define PSPEMU_CORE_WFI_CHECK                   BIT(0)
 
@@ -166,6 +182,8 @@ typedef PSPCOREPGTBLWALKSTS *PPSPCOREPGTBLWALKSTS;
 #define PSPEMU_CORE_MEM_REGION_PROT_F_READ      BIT(1)
 /** The mapped memory region has write permissions. */
 #define PSPEMU_CORE_MEM_REGION_PROT_F_WRITE     BIT(2)
+/** Writes to a region without write permissions are logged and dropped instead of stopping emulation. */
+#define PSPEMU_CORE_MEM_REGION_PROT_F_WRITE_IGNORE BIT(3)
 
 
 /** Disables any execution timeouts. */
@@ -175,6 +193,10 @@ typedef PSPCOREPGTBLWALKSTS *PPSPCOREPGTBLWALKSTS;
 /** Print CPU state after each instruction. */
 #define PSPEMU_CORE_EXEC_F_DUMP_CORE_STATE      BIT(0)
 
+/** Number of milliseconds a core halted in a WFI instruction sleeps in PSPEmuCoreHaltWait()
+ * before its run loop resumes execution. */
+#define PSPEMU_CORE_HALT_WAIT_MS                10
+
 
 /** Default dump config. */
 #define PSPEMU_CORE_STATE_DUMP_F_DEFAULT        (0)
@@ -336,6 +358,21 @@ int PSPEmuCoreMemWriteVirt(PSPCORE hCore, PSPVADDR AddrPspVWrite, const void *pv
  */
 int PSPEmuCoreMemReadVirt(PSPCORE hCore, PSPVADDR AddrPspVRead, void *pvDst, size_t cbDst);
 
+/**
+ * Queries the host memory backing the given physical PSP address directly.
+ *
+ * @returns Status code.
+ * @retval  STS_ERR_NOT_FOUND if the address is not backed by RAM (unassigned or MMIO).
+ * @param   hCore                   The PSP core handle.
+ * @param   AddrPsp                 The physical PSP address to query the backing for.
+ * @param   ppv                     Where to store the host pointer to the backing on success.
+ * @param   pcbAvail                Where to store the number of bytes accessible through the returned pointer
+ *                                  (until the end of the containing memory region) on success.
+ *
+ * @note Accessing the memory directly bypasses any tracing done in PSPEmuCoreMemWrite()/PSPEmuCoreMemRead().
+ */
+int PSPEmuCoreMemQueryBacking(PSPCORE hCore, PSPADDR AddrPsp, void **ppv, size_t *pcbAvail);
+
 /**
  * Adds a region of memory not initially backed by memory on the original PSP
  * (will be used for executing the TEE stuff located on a secure DRAM region).
@@ -442,6 +479,29 @@ int PSPEmuCoreExecRun(PSPCORE hCore, uint32_t fFlags, uint32_t cInsnExec, uint32
  */
 int PSPEmuCoreExecStop(PSPCORE hCore);
 
+/**
+ * Puts the calling thread to sleep after PSPEmuCoreExecRun() returned PSPEMU_INF_CORE_INSN_WFI_REACHED
+ * until the core gets woken up by PSPEmuCoreHaltWakeup(), PSPEmuCoreExecStop() was called or the timeout expired.
+ *
+ * @returns Status code.
+ * @retval  PSPEMU_INF_CORE_HALT_TIMEOUT if the timeout expired.
+ * @retval  PSPEMU_INF_CORE_HALT_STOPPED if execution was stopped with PSPEmuCoreExecStop().
+ * @param   hCore                   The PSP core handle.
+ * @param   msTimeout               Number of milliseconds to wait at most, 0 to only check for a pending wakeup,
+ *                                  use PSPEMU_CORE_EXEC_INDEFINITE to disable the timeout.
+ */
+int PSPEmuCoreHaltWait(PSPCORE hCore, uint32_t msTimeout);
+
+/**
+ * Wakes up the core from the halted state, can be called from any thread.
+ *
+ * @returns Status code.
+ * @param   hCore                   The PSP core handle.
+ *
+ * @note The wakeup is remembered if the core is not halted currently so it can't get lost.
+ */
+int PSPEmuCoreHaltWakeup(PSPCORE hCore);
+
 /**
  * Performs a CPU state reset.
  *
@@ -512,6 +572,16 @@ int PSPEmuCoreMmioDeregister(PSPCORE hCore, PSPADDR uPspAddrMmioStart, size_t cb
  */
 int PSPEmuCoreWfiSet(PSPCORE hCore, PFNPSPCOREWFI pfnWfiReached, void *pvUser);
 
+/**
+ * Sets the callback to call whenever the core is put to sleep in PSPEmuCoreHaltWait().
+ *
+ * @returns Status code.
+ * @param   hCore                   The PSP core handle.
+ * @param   pfnHalt                 The halt notification callback.
+ * @param   pvUser                  Opaque user data to pass to the callback.
+ */
+int PSPEmuCoreHaltNotifySet(PSPCORE hCore, PFNPSPCOREHALT pfnHalt, void *pvUser);
+
 /**
  * Dumps the emulation core state to stdout.
  *
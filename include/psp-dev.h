@@ -85,6 +85,14 @@ typedef struct PSPDEVREG
      * @param   pDev                The device instance to reset.s
      */
     int    (*pfnReset) (PPSPDEV pDev);
+
+    /**
+     * Notifies the device that the PSP core is about to be halted in a WFI instruction, optional.
+     *
+     * @returns nothing.
+     * @param   pDev                The device instance.
+     */
+    void   (*pfnHalt) (PPSPDEV pDev);
 } PSPDEVREG;
 
 
@@ -38,4 +38,13 @@
  */
 int PSPEmuDisasm(char *pchDst, size_t cch, uint32_t cInsnsDisasm, uint8_t *pbCode, size_t cbCode, PSPADDR uAddrStart, bool fThumb);
 
+/**
+ * Releases the capstone handles and the decode cache of the calling thread.
+ *
+ * @returns nothing.
+ *
+ * @note Safe to call multiple times, the state is recreated on the next PSPEmuDisasm() call.
+ */
+void PSPEmuDisasmThreadTerm(void);
+
 #endif /* __psp_disasm_h */
@@ -24,6 +24,32 @@
 
 #include <common/types.h>
 
+
+/** Opaque flash layout index handle. */
+typedef struct PSPFLASHIDXINT *PSPFLASHIDX;
+/** Pointer to a flash layout index handle. */
+typedef PSPFLASHIDX *PPSPFLASHIDX;
+
+
+/** Flag marking an entry ID as being from a BIOS directory (as opposed to a PSP directory). */
+#define PSP_FLASH_ENTRY_ID_F_BIOS                   BIT(31)
+/** Creates a PSP directory entry ID from the given type and sub program. */
+#define PSP_FLASH_ENTRY_ID_PSP_MAKE(a_uType, a_uSubProg)  ((uint32_t)(a_uType) | ((uint32_t)(a_uSubProg) << 8))
+/** Creates a BIOS directory entry ID from the given type and sub program. */
+#define PSP_FLASH_ENTRY_ID_BIOS_MAKE(a_uType, a_uSubProg) (PSP_FLASH_ENTRY_ID_PSP_MAKE(a_uType, a_uSubProg) | PSP_FLASH_ENTRY_ID_F_BIOS)
+
+/** The AMD public key entry type. */
+#define PSP_FLASH_ENTRY_TYPE_AMD_PUBLIC_KEY         0x00
+/** The off chip bootloader entry type. */
+#define PSP_FLASH_ENTRY_TYPE_BOOT_LOADER            0x01
+/** The trusted OS entry type. */
+#define PSP_FLASH_ENTRY_TYPE_TRUSTED_OS             0x02
+/** The PSP 2nd level directory entry type. */
+#define PSP_FLASH_ENTRY_TYPE_PSP_L2_DIR             0x40
+/** The BIOS 2nd level directory entry type (BIOS directory only). */
+#define PSP_FLASH_ENTRY_TYPE_BIOS_L2_DIR            0x70
+
+
 /**
  * Loads the flash from the given filename returning an appropriate memory buffer (mmap'ed for example).
  *
@@ -43,9 +69,58 @@ int PSPEmuFlashLoadFromFile(const char *pszFilename, void **ppv, size_t *pcb);
  */
 int PSPEmuFlashFree(void *pv, size_t cb);
 
+/**
+ * Creates an index of the directory entries found in the given flash image.
+ *
+ * @returns Status code.
+ * @param   phFlashIdx              Where to store the index handle on success.
+ * @param   pvFlash                 The start of the flash region.
+ * @param   cbFlash                 Size of the flash region.
+ * @param   pszFlashPath            Path of the flash image the index is cached next to, NULL to disable the cache.
+ * @param   fCacheWrite             Flag whether to write the cache if there is none matching the image yet.
+ *
+ * @note The on disk cache is keyed by the device, inode, size and modification time of the flash image file
+ *       so a modified image never uses a stale index. The cache is never written on read-only file systems.
+ *       Failing to read or write the cache is not fatal, the directories are scanned instead.
+ */
+int PSPEmuFlashIdxCreate(PPSPFLASHIDX phFlashIdx, const void *pvFlash, size_t cbFlash, const char *pszFlashPath,
+                         bool fCacheWrite);
+
+/**
+ * Destroys the given flash index.
+ *
+ * @returns nothing.
+ * @param   hFlashIdx               The flash index handle.
+ */
+void PSPEmuFlashIdxDestroy(PSPFLASHIDX hFlashIdx);
+
+/**
+ * Queries the location of the given entry in the flash image.
+ *
+ * @returns Status code, STS_ERR_NOT_FOUND if the flash doesn't contain the entry.
+ * @param   hFlashIdx               The flash index handle.
+ * @param   idEntry                 The entry ID to look for, see PSP_FLASH_ENTRY_ID_PSP_MAKE() and PSP_FLASH_ENTRY_ID_BIOS_MAKE().
+ * @param   poffEntry               Where to store the offset of the entry from the start of the flash on success.
+ * @param   pcbEntry                Where to store the size of the entry on success.
+ *
+ * @note Entries from 2nd level directories take precedence over the same entries in the 1st level directory.
+ */
+int PSPEmuFlashIdxQueryEntry(PSPFLASHIDX hFlashIdx, uint32_t idEntry, size_t *poffEntry, size_t *pcbEntry);
+
+/**
+ * Queries the location of the 1st level PSP directory in the flash image.
+ *
+ * @returns Status code, STS_ERR_NOT_FOUND if the flash doesn't contain a PSP directory.
+ * @param   hFlashIdx               The flash index handle.
+ * @param   poffDir                 Where to store the offset of the directory from the start of the flash on success.
+ */
+int PSPEmuFlashIdxQueryPspDir(PSPFLASHIDX hFlashIdx, size_t *poffDir);
+
 /**
  * Reads the given entry from the flash region parsing the directories etc.
  *
+ * @note This creates a temporary index for every call, use the PSPEmuFlashIdx* API when reading multiple entries.
+ *
  * @returns Status code.
  * @param   enmEntryId              The entry ID to read.
  * @param   pvFlash                 The start of the flash region.
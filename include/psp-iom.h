@@ -43,6 +43,90 @@ typedef struct PSPIOMTPINT *PSPIOMTP;
 typedef PSPIOMTP *PPSPIOMTP;
 
 
+/**
+ * Address space a vectored access operation works on.
+ */
+typedef enum PSPIOMADDRSPACE
+{
+    /** Invalid address space, do not use. */
+    PSPIOMADDRSPACE_INVALID = 0,
+    /** PSP physical address space (including the MMIO, SMN and x86 windows). */
+    PSPIOMADDRSPACE_PSP,
+    /** SMN address space. */
+    PSPIOMADDRSPACE_SMN,
+    /** x86 physical address space. */
+    PSPIOMADDRSPACE_X86,
+    /** 32bit hack. */
+    PSPIOMADDRSPACE_32BIT_HACK = 0x7fffffff
+} PSPIOMADDRSPACE;
+
+
+/**
+ * A single operation of a vectored access.
+ */
+typedef struct PSPIOMACCESSOP
+{
+    /** The address space to access. */
+    PSPIOMADDRSPACE         enmAddrSpace;
+    /** Operation flags, see PSP_IOM_ACCESS_OP_F_XXX. */
+    uint32_t                fFlags;
+    /** The address to access. */
+    uint64_t                u64Addr;
+    /** Access width in bytes (1, 2, 4 or 8). */
+    size_t                  cbAccess;
+    /** The value to write or the value read on return. */
+    uint64_t                u64Val;
+} PSPIOMACCESSOP;
+/** Pointer to a vectored access operation. */
+typedef PSPIOMACCESSOP *PPSPIOMACCESSOP;
+/** Pointer to a const vectored access operation. */
+typedef const PSPIOMACCESSOP *PCPSPIOMACCESSOP;
+
+/** The operation is a write, read otherwise. */
+#define PSP_IOM_ACCESS_OP_F_WRITE       BIT(0)
+
+
+/**
+ * Access statistics of a single region.
+ */
+typedef struct PSPIOMSTATS
+{
+    /** Number of reads. */
+    uint64_t                cReads;
+    /** Number of writes. */
+    uint64_t                cWrites;
+    /** Number of bytes read. */
+    uint64_t                cbRead;
+    /** Number of bytes written. */
+    uint64_t                cbWritten;
+    /** Host nanoseconds spent in the read handlers. */
+    uint64_t                cNsRead;
+    /** Host nanoseconds spent in the write handlers. */
+    uint64_t                cNsWrite;
+} PSPIOMSTATS;
+/** Pointer to region access statistics. */
+typedef PSPIOMSTATS *PPSPIOMSTATS;
+/** Pointer to const region access statistics. */
+typedef const PSPIOMSTATS *PCPSPIOMSTATS;
+
+
+/**
+ * Region statistics enumeration callback.
+ *
+ * @returns Status code, enumeration stops on the first failure which is passed on to the caller.
+ * @param   enmAddrSpace            The address space the region is in.
+ * @param   u64AddrStart            Start address of the region.
+ * @param   cbRegion                Size of the region, 0 for the accesses to unassigned regions of the address space.
+ * @param   pszDesc                 The region description.
+ * @param   pStats                  The access statistics of the region.
+ * @param   pvUser                  Opaque user data passed to PSPEmuIoMgrStatsEnum().
+ */
+typedef int (FNPSPIOMSTATSENUM)(PSPIOMADDRSPACE enmAddrSpace, uint64_t u64AddrStart, size_t cbRegion, const char *pszDesc,
+                                PCPSPIOMSTATS pStats, void *pvUser);
+/** Region statistics enumeration callback pointer. */
+typedef FNPSPIOMSTATSENUM *PFNPSPIOMSTATSENUM;
+
+
 /**
  * SMN read handler.
  *
@@ -289,6 +373,29 @@ int PSPEmuIoMgrDestroy(PSPIOM hIoMgr);
  */
 int PSPEmuIoMgrTraceAllAccessesSet(PSPIOM hIoMgr, bool fEnable);
 
+/**
+ * Notifies the I/O manager that the trace filter of the default tracer was changed, regions mapped directly
+ * into the core are switched back to the callbacks while a filter is set and mapped directly again afterwards.
+ *
+ * @returns Status code.
+ * @param   hIoMgr                  The I/O manager handle.
+ *
+ * @note Must be called on the thread executing the core the I/O manager belongs to.
+ */
+int PSPEmuIoMgrTraceFilterChanged(PSPIOM hIoMgr);
+
+
+/**
+ * Wakes up the PSP core attached to the I/O manager if it is halted in a WFI instruction,
+ * for devices completing work asynchronously.
+ *
+ * @returns Status code.
+ * @param   hIoMgr                  The I/O manager handle.
+ *
+ * @note Can be called from any thread.
+ */
+int PSPEmuIoMgrCoreWakeup(PSPIOM hIoMgr);
+
 
 /**
  * Sets callbacks for intercepting accesses to unassigned MMIO regions.
@@ -397,6 +504,38 @@ int PSPEmuIoMgrSmnRegister(PSPIOM hIoMgr, SMNADDR SmnAddrStart, size_t cbSmn,
                            const char *pszDesc, PPSPIOMREGIONHANDLE phSmn);
 
 
+/**
+ * Registers a plain RAM region in the SMN address space, the memory is allocated and owned by the I/O manager
+ * and gets mapped directly into the core whenever an SMN mapping slot covers it.
+ *
+ * @returns Status code.
+ * @param   hIoMgr                  The I/O manager handle.
+ * @param   SmnAddrStart            The SMN start address of the region to register.
+ * @param   cbSmn                   Size of the SMN region in bytes.
+ * @param   fProt                   Protection flags, see PSPEMU_CORE_MEM_REGION_PROT_F_XXX.
+ * @param   pszDesc                 Description for this region which must be valid for the lifetime of this region, optional.
+ * @param   ppvRam                  Where to store the pointer to the zeroed memory backing the region on success.
+ * @param   phSmn                   Where to store the handle to the SMN region on success.
+ */
+int PSPEmuIoMgrSmnRamRegister(PSPIOM hIoMgr, SMNADDR SmnAddrStart, size_t cbSmn, uint32_t fProt,
+                              const char *pszDesc, void **ppvRam, PPSPIOMREGIONHANDLE phSmn);
+
+
+/**
+ * Sets the host memory backing the given SMN region, allowing the I/O manager to map the region directly
+ * into the core whenever an SMN mapping slot covers it instead of going through the callbacks.
+ *
+ * @returns Status code.
+ * @param   hSmn                    The SMN region handle.
+ * @param   pvBacking               The host memory backing the complete region, NULL to remove the backing.
+ * @param   fProt                   Protection flags of the direct mapping, see PSPEMU_CORE_MEM_REGION_PROT_F_XXX.
+ *
+ * @note Accesses not going through a mapping slot (debugger, DMA) still use the callbacks, as do all accesses
+ *       while the region is traced. Accesses through a direct mapping are not accounted in the statistics.
+ */
+int PSPEmuIoMgrSmnRegionBackingSet(PSPIOMREGIONHANDLE hSmn, void *pvBacking, uint32_t fProt);
+
+
 /**
  * Registers a new MMIO access tracing handler.
  *
@@ -543,6 +682,20 @@ int PSPEmuIoMgrPspAddrRead(PSPIOM hIoMgr, PSPADDR PspAddr, void *pvDst, size_t c
 int PSPEmuIoMgrPspAddrWrite(PSPIOM hIoMgr, PSPADDR PspAddr, const void *pvSrc, size_t cbWrite);
 
 
+/**
+ * Queries the host memory backing the given PSP physical address if it is plain memory
+ * not covered by any MMIO, SMN or x86 region.
+ *
+ * @returns Status code.
+ * @retval  STS_ERR_NOT_FOUND if the address is not backed by memory which can be accessed directly.
+ * @param   hIoMgr                  The I/O manager handle.
+ * @param   PspAddr                 The PSP physical address to query.
+ * @param   ppv                     Where to store the host pointer on success.
+ * @param   pcbAvail                Where to store the number of bytes accessible through the pointer on success.
+ */
+int PSPEmuIoMgrPspAddrQueryBacking(PSPIOM hIoMgr, PSPADDR PspAddr, void **ppv, size_t *pcbAvail);
+
+
 /**
  * Reads from the given x86 physical address, honoring MMIO access handlers.
  *
@@ -567,6 +720,20 @@ int PSPEmuIoMgrX86AddrRead(PSPIOM hIoMgr, X86PADDR PhysX86Addr, void *pvDst, siz
 int PSPEmuIoMgrX86AddrWrite(PSPIOM hIoMgr, X86PADDR PhysX86Addr, const void *pvSrc, size_t cbWrite);
 
 
+/**
+ * Executes the given array of accesses in order, honoring all access handlers like the single access APIs.
+ *
+ * @returns Status code, processing stops at the first failing operation.
+ * @param   hIoMgr                  The I/O manager handle.
+ * @param   paOps                   The operations to execute, read values are returned in the u64Val members.
+ * @param   cOps                    Number of operations in the array.
+ *
+ * @note The region an access resolves to is reused for following accesses as long as they stay inside of it,
+ *       so batching accesses to the same device saves the lookups.
+ */
+int PSPEmuIoMgrAccessV(PSPIOM hIoMgr, PPSPIOMACCESSOP paOps, uint32_t cOps);
+
+
 /**
  * Dumps the state of the given x86 mapping slots to the trace log.
  *
@@ -589,5 +756,47 @@ int PSPEmuIoMgrX86MapSlotDump(PSPIOM hIoMgr, uint32_t idxSlotStart, uint32_t idx
 int PSPEmuIoMgrSmnMapSlotDump(PSPIOM hIoMgr, uint32_t idxSlotStart, uint32_t idxSlotEnd);
 
 
+/**
+ * Enables or disables gathering the access statistics, disabled by default.
+ *
+ * @returns Status code.
+ * @param   hIoMgr                  The I/O manager handle.
+ * @param   fEnable                 Flag whether to gather the access statistics.
+ *
+ * @note Disabling keeps the statistics gathered so far, use PSPEmuIoMgrStatsReset() to clear them.
+ */
+int PSPEmuIoMgrStatsEnable(PSPIOM hIoMgr, bool fEnable);
+
+
+/**
+ * Enumerates the access statistics of all regions, including the unassigned accesses of each address space.
+ *
+ * @returns Status code.
+ * @param   hIoMgr                  The I/O manager handle.
+ * @param   pfnEnum                 The callback to call for each region.
+ * @param   pvUser                  Opaque user data to pass to the callback.
+ */
+int PSPEmuIoMgrStatsEnum(PSPIOM hIoMgr, PFNPSPIOMSTATSENUM pfnEnum, void *pvUser);
+
+
+/**
+ * Resets the access statistics of all regions.
+ *
+ * @returns Status code.
+ * @param   hIoMgr                  The I/O manager handle.
+ */
+int PSPEmuIoMgrStatsReset(PSPIOM hIoMgr);
+
+
+/**
+ * Dumps the access statistics of all accessed regions to the given file as JSON.
+ *
+ * @returns Status code.
+ * @param   hIoMgr                  The I/O manager handle.
+ * @param   pszFilename             The file to write.
+ */
+int PSPEmuIoMgrStatsDumpToFile(PSPIOM hIoMgr, const char *pszFilename);
+
+
 #endif /* __psp_iom_h */
 
@@ -0,0 +1,91 @@
+/** @file
+ * PSP Emulator - Host time accounting of the emulator subsystems.
+ */
+
+/*
+ * Copyright (C) 2020 Alexander Eichner <alexander.eichner@campus.tu-berlin.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef __psp_perf_h
+#define __psp_perf_h
+
+#include <common/types.h>
+
+
+/**
+ * Emulator subsystem host time gets accounted to.
+ */
+typedef enum PSPPERFSUBSYS
+{
+    /** Invalid subsystem - do not use. */
+    PSPPERFSUBSYS_INVALID = 0,
+    /** Everything not accounted to any of the other subsystems (runloop, debugger, etc.). */
+    PSPPERFSUBSYS_OTHER,
+    /** Executing guest code in unicorn. */
+    PSPPERFSUBSYS_CORE_EXEC,
+    /** The MMU fault path mapping in pages. */
+    PSPPERFSUBSYS_MMU,
+    /** The I/O manager dispatching accesses. */
+    PSPPERFSUBSYS_IOM,
+    /** The device handlers. */
+    PSPPERFSUBSYS_DEV,
+    /** SVC/SMC emulation and injection. */
+    PSPPERFSUBSYS_SVC,
+    /** Creating and writing trace events. */
+    PSPPERFSUBSYS_TRACE,
+    /** Forwarding requests to the real hardware through the proxy. */
+    PSPPERFSUBSYS_PROXY,
+    /** Last valid subsystem. */
+    PSPPERFSUBSYS_LAST = PSPPERFSUBSYS_PROXY,
+    /** 32bit hack. */
+    PSPPERFSUBSYS_32BIT_HACK = 0x7fffffff
+} PSPPERFSUBSYS;
+
+
+/**
+ * Enables host time accounting for the calling thread.
+ *
+ * @returns Status code.
+ * @param   cSecReportInterval      Interval in seconds a report of the last interval is printed, 0 to only report on exit.
+ */
+int PSPEmuPerfInit(uint32_t cSecReportInterval);
+
+/**
+ * Prints the report for the whole runtime and disables accounting for the calling thread.
+ *
+ * @returns nothing.
+ */
+void PSPEmuPerfTerm(void);
+
+/**
+ * Starts accounting host time to the given subsystem, nests with the subsystem being currently active.
+ *
+ * @returns nothing.
+ * @param   enmSubsys               The subsystem being entered.
+ *
+ * @note Time is accounted exclusively, i.e. time spent in a nested subsystem is not accounted to the outer one.
+ *       This is a no-op unless PSPEmuPerfInit() was called on the calling thread.
+ */
+void PSPEmuPerfEnter(PSPPERFSUBSYS enmSubsys);
+
+/**
+ * Stops accounting host time to the subsystem entered last, resuming the outer one.
+ *
+ * @returns nothing.
+ */
+void PSPEmuPerfLeave(void);
+
+#endif /* __psp_perf_h */
@@ -159,10 +159,13 @@ int PSPEmuTraceCreateForFile(PPSPTRACE phTrace, uint32_t fFlags, PSPCORE hPspCor
 void PSPEmuTraceDestroy(PSPTRACE hTrace);
 
 /**
- * Sets the default tracer (used when NULL is given in the actual tracing methods).
+ * Sets the default tracer (used when NULL is given in the actual tracing methods) of the calling thread.
  *
  * @returns Status code.
- * @param   hTrace                  The new default tracer.
+ * @param   hTrace                  The new default tracer, NULL to disable tracing for the calling thread.
+ *
+ * @note Threads start without a default tracer, a tracer must not be destroyed while another thread
+ *       still uses it as its default.
  */
 int PSPEmuTraceSetDefault(PSPTRACE hTrace);
 
@@ -179,6 +182,58 @@ int PSPEmuTraceSetDefault(PSPTRACE hTrace);
  */
 int PSPEmuTraceEvtEnable(PSPTRACE hTrace, PSPTRACEEVTORIGIN *paEvtOrigins, PSPTRACEEVTSEVERITY *paEvtSeverities, uint32_t cEvts);
 
+/**
+ * Sets the filter deciding which device accesses get logged.
+ *
+ * The filter consists of clauses separated by ';' of which at least one has to match (OR),
+ * each clause consists of whitespace separated terms which all have to match (AND):
+ *     dev=<name>[*]            Device identifier, a trailing '*' matches by prefix.
+ *     origin=<o>[,<o>...]      Access origin, one of mmio, smn, x86, x86-mmio or x86-mem.
+ *     addr=<first>[-<last>]    Accessed address range (inclusive).
+ *     pc=<first>[-<last>]      PC range of the instruction causing the access (inclusive).
+ *     rw=r|w|rw                Access direction.
+ *     val=<val>[/<mask>]       Accessed value after applying the mask.
+ *     rate=<n>                 Log at most n matching events per second.
+ *
+ * @returns Status code, STS_ERR_INVALID_PARAMETER if the filter could not be parsed.
+ * @param   hTrace                  The trace handle, NULL means default.
+ * @param   pszFilter               The filter expression, NULL or empty to remove the filter.
+ */
+int PSPEmuTraceFilterSet(PSPTRACE hTrace, const char *pszFilter);
+
+/**
+ * Returns the generation of the active filter, changes whenever a new filter is set.
+ *
+ * @returns Filter generation, 0 if no filter is active.
+ * @param   hTrace                  The trace handle, NULL means default.
+ */
+uint32_t PSPEmuTraceFilterGetGen(PSPTRACE hTrace);
+
+/**
+ * Evaluates the access independent predicates of the active filter for the given device.
+ *
+ * @returns Bitmap of filter clauses which can match accesses to the device, 0 if none,
+ *          stays valid as long as the filter generation doesn't change.
+ * @param   hTrace                  The trace handle, NULL means default.
+ * @param   enmOrigin               The origin of accesses to the device.
+ * @param   pszDevId                The device identifier.
+ */
+uint64_t PSPEmuTraceFilterQueryDev(PSPTRACE hTrace, PSPTRACEEVTORIGIN enmOrigin, const char *pszDevId);
+
+/**
+ * Evaluates the access dependent predicates of the given filter clauses.
+ *
+ * @returns Flag whether the access should be logged.
+ * @param   hTrace                  The trace handle, NULL means default.
+ * @param   bmClauses               The clauses to check as returned by PSPEmuTraceFilterQueryDev().
+ * @param   u64Addr                 The accessed address.
+ * @param   fWrite                  Flag whether this is a write access.
+ * @param   pvVal                   The value being accessed.
+ * @param   cbVal                   Size of the access in bytes.
+ */
+bool PSPEmuTraceFilterCheck(PSPTRACE hTrace, uint64_t bmClauses, uint64_t u64Addr, bool fWrite,
+                            const void *pvVal, size_t cbVal);
+
 /**
  * Adds the given string to the trace.
  *
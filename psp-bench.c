@@ -0,0 +1,1017 @@
+/** @file
+ * PSP Emulator - Micro benchmarks for the core, I/O manager and CCP emulation.
+ */
+
+/*
+ * Copyright (C) 2020 Alexander Eichner <alexander.eichner@campus.tu-berlin.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/** @page pg_bench   PSPEmuBench - Micro benchmarks
+ *
+ * Every workload is a small hand assembled ARM program executed through PSPEmuCoreExecRun() on a freshly
+ * created core with 256KiB of SRAM at address 0, just like the emulator runs the firmware. The program gets
+ * a pointer to its parameter block in r0, loops the requested number of times and finishes with a wfi
+ * instruction which makes PSPEmuCoreExecRun() return.
+ *
+ * The number of executed instructions is derived from the loop structure of the workload code, the iteration
+ * count and the number of device reads the I/O manager accounted for the run, so nothing needs to be instrumented
+ * in the core itself. Every workload consists of setup code, an outer loop running once per iteration with at most
+ * one nested loop polling a device register (one read per round) and a final wfi instruction.
+ * Workloads exercising a device check its result afterwards, so a broken device makes the workload fail.
+ * Every workload prints a single line JSON object with the same set of keys to stdout:
+ *
+ *     {"workload":"alu","iterations":50000000,"seconds":0.512345,"insns":300000004,"mips":585.54,
+ *      "iom_ops":0,"iom_ops_per_sec":0.00,"ccp_bytes":0,"ccp_mb_per_sec":0.00}
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <zlib.h>
+
+#include <common/cdefs.h>
+#include <common/status.h>
+#include <psp/ccp.h>
+
+#include <psp-core.h>
+#include <psp-iom.h>
+#include <psp-devs.h>
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+
+/** Size of the SRAM the workloads run in. */
+#define PSP_BENCH_SRAM_SZ                   _256K
+/** Address the workload code is loaded to. */
+#define PSP_BENCH_CODE_ADDR                 0x00000100
+/** Address of the CCP request descriptor. */
+#define PSP_BENCH_CCP_REQ_ADDR              0x00001000
+/** Address of the CCP AES key. */
+#define PSP_BENCH_CCP_KEY_ADDR              0x00001100
+/** Address of the CCP source buffer. */
+#define PSP_BENCH_CCP_SRC_ADDR              0x00008000
+/** Address of the CCP destination buffer. */
+#define PSP_BENCH_CCP_DST_ADDR              0x00010000
+/** Size of the data processed by a single CCP request. */
+#define PSP_BENCH_CCP_DATA_SZ               (16 * _1K)
+/** Address of the L1 page table for the MMU workload (must be 16KiB aligned). */
+#define PSP_BENCH_PGTBL_ADDR                0x00020000
+/** Initial stack pointer. */
+#define PSP_BENCH_STACK_ADDR                0x0003e000
+/** Address of the parameter block passed in r0. */
+#define PSP_BENCH_PARAM_ADDR                0x0003f000
+/** Maximum number of parameters in the parameter block (the first one is always the iteration count). */
+#define PSP_BENCH_PARAM_MAX                 8
+
+/** Address of the benchmark MMIO device. */
+#define PSP_BENCH_MMIO_ADDR                 0x03ff0000
+/** Size of the benchmark MMIO device. */
+#define PSP_BENCH_MMIO_SZ                   _4K
+/** Status register offset, bit 0 is set on every PSP_BENCH_MMIO_POLL_CNT'th read. */
+#define PSP_BENCH_MMIO_REG_STATUS           0x0
+/** Acknowledge register offset. */
+#define PSP_BENCH_MMIO_REG_ACK              0x4
+/** Number of status register reads until the ready bit gets set. */
+#define PSP_BENCH_MMIO_POLL_CNT             4
+
+/** SMN address of the RAM region read back by the SMN RAM workload (must be 1MiB aligned). */
+#define PSP_BENCH_SMN_RAM_ADDR              0x5a000000
+/** Size of the SMN RAM region. */
+#define PSP_BENCH_SMN_RAM_SZ                _4K
+/** Value stored in the first word of the SMN RAM region. */
+#define PSP_BENCH_SMN_RAM_PATTERN           0x5a5aa5a5
+/** Address of the SMN mapping slot control register programming slot 0 and 1. */
+#define PSP_BENCH_SMN_CTRL_ADDR             0x03220000
+/** Address of the SMN mapping slot 0 window. */
+#define PSP_BENCH_SMN_SLOT0_ADDR            0x01000000
+
+/** Section descriptor mapping the first 1MiB of physical memory, full access. */
+#define PSP_BENCH_PGTBL_SECTION_0           0x00000c02
+/** Virtual address aliasing physical address 0 through the second L1 entry in the MMU workload. */
+#define PSP_BENCH_MMU_ALIAS_ADDR            0x00100000
+
+/*
+ * CCP request fields, the layout follows the CCPv5 command descriptor in the Linux kernel
+ * (dword0: soc:1, ioc:1, rsvd:1, init:1, eom:1, function:15, engine:4 and memory types: type:2, lsb_ctx_id:8).
+ */
+/** Creates the first request dword for a single request message. */
+#define PSP_BENCH_CCP_DW0(a_Engine, a_Func) (((a_Engine) << 20) | ((a_Func) << 5) | BIT(4) /*EOM*/ | BIT(3) /*INIT*/ | BIT(0) /*SOC*/)
+/** Creates the SHA engine function field. */
+#define PSP_BENCH_CCP_SHA_FUNC(a_Type)      ((a_Type) << 10)
+/** Creates the AES engine function field. */
+#define PSP_BENCH_CCP_AES_FUNC(a_Type, a_Mode, a_fEncrypt) (((a_Type) << 13) | ((a_Mode) << 8) | ((a_fEncrypt) << 7))
+/** Creates a memory type field. */
+#define PSP_BENCH_CCP_MEM_TYPE(a_Type, a_LsbCtxId) ((a_Type) | ((a_LsbCtxId) << 2))
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+
+/**
+ * Benchmark instance data for a single workload run.
+ */
+typedef struct PSPBENCH
+{
+    /** The PSP core handle. */
+    PSPCORE                         hCore;
+    /** The I/O manager handle. */
+    PSPIOM                          hIoMgr;
+    /** The CCP device instance. */
+    PPSPDEV                         pDevCcp;
+    /** The benchmark MMIO region handle. */
+    PSPIOMREGIONHANDLE              hMmio;
+    /** The SMN RAM region handle, NULL if not registered. */
+    PSPIOMREGIONHANDLE              hSmnRam;
+    /** The SRAM backing. */
+    void                            *pvSram;
+    /** Config passed to the devices. */
+    PSPEMUCFG                       Cfg;
+    /** Number of status register reads of the benchmark MMIO device. */
+    uint32_t                        cMmioStatusReads;
+    /** Number of SVC calls handled. */
+    uint64_t                        cSvcCalls;
+    /** Number of bytes processed by the CCP for each iteration. */
+    size_t                          cbCcpPerIter;
+    /** The parameter block passed to the workload. */
+    uint32_t                        au32Params[PSP_BENCH_PARAM_MAX];
+} PSPBENCH;
+/** Pointer to the benchmark instance data. */
+typedef PSPBENCH *PPSPBENCH;
+
+
+/**
+ * Workload prepare callback.
+ *
+ * @returns Status code.
+ * @param   pThis                   The benchmark instance data.
+ * @param   cIters                  Number of iterations the workload runs.
+ *
+ * @note The iteration count is already set in the parameter block, the callback sets up the rest of the
+ *       parameters and any memory content required.
+ */
+typedef int (FNPSPBENCHPREPARE)(PPSPBENCH pThis, uint32_t cIters);
+/** Workload prepare callback pointer. */
+typedef FNPSPBENCHPREPARE *PFNPSPBENCHPREPARE;
+
+
+/**
+ * Workload result check callback.
+ *
+ * @returns Status code, failure if the workload didn't produce the expected result.
+ * @param   pThis                   The benchmark instance data.
+ * @param   cIters                  Number of iterations the workload ran.
+ */
+typedef int (FNPSPBENCHCHECK)(PPSPBENCH pThis, uint32_t cIters);
+/** Workload result check callback pointer. */
+typedef FNPSPBENCHCHECK *PFNPSPBENCHCHECK;
+
+
+/**
+ * A single workload.
+ */
+typedef struct PSPBENCHWORKLOAD
+{
+    /** Workload name. */
+    const char                      *pszName;
+    /** Description. */
+    const char                      *pszDesc;
+    /** The instruction words of the workload. */
+    const uint32_t                  *pau32Code;
+    /** Number of instruction words. */
+    uint32_t                        cInsnsCode;
+    /** Default number of iterations. */
+    uint32_t                        cItersDefault;
+    /** Prepare callback, optional. */
+    PFNPSPBENCHPREPARE              pfnPrepare;
+    /** Result check callback, optional. */
+    PFNPSPBENCHCHECK                pfnCheck;
+} PSPBENCHWORKLOAD;
+/** Pointer to a const workload. */
+typedef const PSPBENCHWORKLOAD *PCPSPBENCHWORKLOAD;
+
+
+/**
+ * Instruction counts derived from the loop structure of a workload.
+ */
+typedef struct PSPBENCHINSNS
+{
+    /** Number of instructions executed once (setup and the final wfi). */
+    uint32_t                        cInsnsFixed;
+    /** Number of instructions executed for each iteration, excluding the poll loop. */
+    uint32_t                        cInsnsPerIter;
+    /** Number of instructions executed for each round of the poll loop (one device read each). */
+    uint32_t                        cInsnsPerPoll;
+} PSPBENCHINSNS;
+/** Pointer to the instruction counts of a workload. */
+typedef PSPBENCHINSNS *PPSPBENCHINSNS;
+
+
+/**
+ * I/O manager statistics summary.
+ */
+typedef struct PSPBENCHIOMSTATS
+{
+    /** Number of reads. */
+    uint64_t                        cReads;
+    /** Number of writes. */
+    uint64_t                        cWrites;
+} PSPBENCHIOMSTATS;
+/** Pointer to the I/O manager statistics summary. */
+typedef PSPBENCHIOMSTATS *PPSPBENCHIOMSTATS;
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+
+/**
+ * Tight ALU loop.
+ */
+static const uint32_t g_au32CodeAlu[] =
+{
+    0xe5901000, /*     ldr  r1, [r0]              */
+    0xe3a02000, /*     mov  r2, #0                */
+    0xe3a03001, /*     mov  r3, #1                */
+    0xe0822003, /* 1:  add  r2, r2, r3            */
+    0xe0233082, /*     eor  r3, r3, r2, lsl #1    */
+    0xe1824003, /*     orr  r4, r2, r3            */
+    0xe00451a2, /*     and  r5, r4, r2, lsr #3    */
+    0xe2511001, /*     subs r1, r1, #1            */
+    0x1afffff9, /*     bne  1b                    */
+    0xe320f003  /*     wfi                        */
+};
+
+/**
+ * Polls the status register of the benchmark device until it is ready and acknowledges it.
+ */
+static const uint32_t g_au32CodeMmio[] =
+{
+    0xe5901000, /*     ldr  r1, [r0]              */
+    0xe5902004, /*     ldr  r2, [r0, #4]          */
+    0xe5923000, /* 1:  ldr  r3, [r2]              */
+    0xe3130001, /*     tst  r3, #1                */
+    0x0afffffc, /*     beq  1b                    */
+    0xe5823004, /*     str  r3, [r2, #4]          */
+    0xe2511001, /*     subs r1, r1, #1            */
+    0x1afffff9, /*     bne  1b                    */
+    0xe320f003  /*     wfi                        */
+};
+
+/**
+ * SVC storm, every SVC is handled by the injected handler.
+ */
+static const uint32_t g_au32CodeSvc[] =
+{
+    0xe5901000, /*     ldr  r1, [r0]              */
+    0xef000042, /* 1:  svc  #0x42                 */
+    0xe2511001, /*     subs r1, r1, #1            */
+    0x1afffffc, /*     bne  1b                    */
+    0xe320f003  /*     wfi                        */
+};
+
+/**
+ * Enables the MMU and rewrites a page table entry before every access through it,
+ * which flushes all mappings and causes a page table walk for the code and data pages.
+ */
+static const uint32_t g_au32CodeMmu[] =
+{
+    0xe5901000, /*     ldr  r1, [r0]              */
+    0xe5902004, /*     ldr  r2, [r0, #4]          */
+    0xee022f10, /*     mcr  p15, 0, r2, c2, c0, 0 ; TTBR0 */
+    0xe3e03000, /*     mvn  r3, #0                */
+    0xee033f10, /*     mcr  p15, 0, r3, c3, c0, 0 ; DACR  */
+    0xee113f10, /*     mrc  p15, 0, r3, c1, c0, 0 ; SCTLR */
+    0xe3833001, /*     orr  r3, r3, #1            */
+    0xee013f10, /*     mcr  p15, 0, r3, c1, c0, 0 ; SCTLR */
+    0xe5902008, /*     ldr  r2, [r0, #8]          */
+    0xe590300c, /*     ldr  r3, [r0, #12]         */
+    0xe5904010, /*     ldr  r4, [r0, #16]         */
+    0xe5823000, /* 1:  str  r3, [r2]              */
+    0xe5945000, /*     ldr  r5, [r4]              */
+    0xe2511001, /*     subs r1, r1, #1            */
+    0x1afffffb, /*     bne  1b                    */
+    0xe320f003  /*     wfi                        */
+};
+
+/**
+ * Submits the request descriptor to the CCP queue and polls the control register until the queue halts.
+ */
+static const uint32_t g_au32CodeCcp[] =
+{
+    0xe5901000, /*     ldr  r1, [r0]              */
+    0xe5902004, /*     ldr  r2, [r0, #4]          ; Control register */
+    0xe5903008, /*     ldr  r3, [r0, #8]          ; Tail register */
+    0xe590400c, /*     ldr  r4, [r0, #12]         ; Head register */
+    0xe5905010, /*     ldr  r5, [r0, #16]         ; First request */
+    0xe5906014, /*     ldr  r6, [r0, #20]         ; End of the requests */
+    0xe5907018, /*     ldr  r7, [r0, #24]         ; Run bit */
+    0xe590801c, /*     ldr  r8, [r0, #28]         ; Halt bit */
+    0xe5835000, /* 1:  str  r5, [r3]              */
+    0xe5846000, /*     str  r6, [r4]              */
+    0xe5827000, /*     str  r7, [r2]              */
+    0xe5929000, /* 2:  ldr  r9, [r2]              */
+    0xe1190008, /*     tst  r9, r8                */
+    0x0afffffc, /*     beq  2b                    */
+    0xe2511001, /*     subs r1, r1, #1            */
+    0x1afffff7, /*     bne  1b                    */
+    0xe320f003  /*     wfi                        */
+};
+
+/**
+ * Maps SMN slot 0 onto the SMN RAM region and sums up the first word read through the slot window.
+ */
+static const uint32_t g_au32CodeSmnRam[] =
+{
+    0xe5901000, /*     ldr  r1, [r0]              */
+    0xe5902004, /*     ldr  r2, [r0, #4]          ; Slot control register */
+    0xe5903008, /*     ldr  r3, [r0, #8]          ; Slot base */
+    0xe5823000, /*     str  r3, [r2]              */
+    0xe590200c, /*     ldr  r2, [r0, #12]         ; Slot window */
+    0xe3a04000, /*     mov  r4, #0                */
+    0xe5925000, /* 1:  ldr  r5, [r2]              */
+    0xe0844005, /*     add  r4, r4, r5            */
+    0xe2511001, /*     subs r1, r1, #1            */
+    0x1afffffb, /*     bne  1b                    */
+    0xe5804010, /*     str  r4, [r0, #16]         ; Result */
+    0xe320f003  /*     wfi                        */
+};
+
+
+static int pspBenchPrepareMmio(PPSPBENCH pThis, uint32_t cIters);
+static int pspBenchPrepareMmu(PPSPBENCH pThis, uint32_t cIters);
+static int pspBenchPrepareCcpSha256(PPSPBENCH pThis, uint32_t cIters);
+static int pspBenchPrepareCcpAes128(PPSPBENCH pThis, uint32_t cIters);
+static int pspBenchPrepareCcpZlib(PPSPBENCH pThis, uint32_t cIters);
+static int pspBenchPrepareSmnRam(PPSPBENCH pThis, uint32_t cIters);
+static int pspBenchCcpCheck(PPSPBENCH pThis, uint32_t cIters);
+static int pspBenchSmnRamCheck(PPSPBENCH pThis, uint32_t cIters);
+
+/**
+ * The available workloads.
+ */
+static const PSPBENCHWORKLOAD g_aWorkloads[] =
+{
+    { "alu",        "Tight ALU loop",                                g_au32CodeAlu,    ELEMENTS(g_au32CodeAlu),    50000000, NULL,                     NULL                },
+    { "mmio",       "MMIO status register polling",                  g_au32CodeMmio,   ELEMENTS(g_au32CodeMmio),    1000000, pspBenchPrepareMmio,      NULL                },
+    { "svc",        "SVC storm handled by an injected handler",      g_au32CodeSvc,    ELEMENTS(g_au32CodeSvc),      200000, NULL,                     NULL                },
+    { "mmu",        "Page table churn with the MMU enabled",         g_au32CodeMmu,    ELEMENTS(g_au32CodeMmu),       20000, pspBenchPrepareMmu,       NULL                },
+    { "ccp-sha256", "CCP SHA256 of 16KiB",                           g_au32CodeCcp,    ELEMENTS(g_au32CodeCcp),        5000, pspBenchPrepareCcpSha256, pspBenchCcpCheck    },
+    { "ccp-aes128", "CCP AES128-ECB encryption of 16KiB",            g_au32CodeCcp,    ELEMENTS(g_au32CodeCcp),        5000, pspBenchPrepareCcpAes128, pspBenchCcpCheck    },
+    { "ccp-zlib",   "CCP zlib decompression to 16KiB",               g_au32CodeCcp,    ELEMENTS(g_au32CodeCcp),        5000, pspBenchPrepareCcpZlib,   pspBenchCcpCheck    },
+    { "smn-ram",    "SMN RAM read back through a mapping slot",      g_au32CodeSmnRam, ELEMENTS(g_au32CodeSmnRam), 10000000, pspBenchPrepareSmnRam,    pspBenchSmnRamCheck }
+};
+
+
+/**
+ * Available options for PSPEmuBench.
+ */
+static struct option g_aOptions[] =
+{
+    {"workload",   required_argument, 0, 'w'},
+    {"iterations", required_argument, 0, 'i'},
+    {"list",       no_argument,       0, 'l'},
+
+    {"help",       no_argument,       0, 'H'},
+    {0, 0, 0, 0}
+};
+
+
+/**
+ * Returns the current host timestamp.
+ *
+ * @returns Nanosecond timestamp.
+ */
+static inline uint64_t pspBenchTsNs(void)
+{
+    struct timespec Tp;
+    clock_gettime(CLOCK_MONOTONIC, &Tp);
+    return (uint64_t)Tp.tv_sec * 1000000000ULL + Tp.tv_nsec;
+}
+
+
+/**
+ * @copydoc FNPSPIOMMMIOREAD
+ */
+static void pspBenchMmioRead(PSPADDR offMmio, size_t cbRead, void *pvVal, void *pvUser)
+{
+    PPSPBENCH pThis = (PPSPBENCH)pvUser;
+
+    memset(pvVal, 0, cbRead);
+    if (   offMmio == PSP_BENCH_MMIO_REG_STATUS
+        && cbRead == sizeof(uint32_t))
+        *(uint32_t *)pvVal = (++pThis->cMmioStatusReads % PSP_BENCH_MMIO_POLL_CNT) == 0 ? 1 : 0;
+}
+
+
+/**
+ * @copydoc FNPSPIOMMMIOWRITE
+ */
+static void pspBenchMmioWrite(PSPADDR offMmio, size_t cbWrite, const void *pvVal, void *pvUser)
+{
+    /* Acknowledging has no effect. */
+    (void)offMmio;
+    (void)cbWrite;
+    (void)pvVal;
+    (void)pvUser;
+}
+
+
+/**
+ * @copydoc FNPSPCORESVMCHANDLER
+ */
+static bool pspBenchSvcHandler(PSPCORE hCore, uint32_t idxCall, uint32_t fFlags, void *pvUser)
+{
+    PPSPBENCH pThis = (PPSPBENCH)pvUser;
+
+    (void)hCore;
+    (void)idxCall;
+    (void)fFlags;
+    pThis->cSvcCalls++;
+    return true;
+}
+
+
+/**
+ * SVC injection record handling every SVC call.
+ */
+static const PSPCORESVMCREG g_SvcReg =
+{
+    /** GlobalSvmc */
+    {
+        /** pszName */
+        "Bench",
+        /** pfnSvmcHnd */
+        pspBenchSvcHandler,
+        /** fFlags */
+        PSPEMU_CORE_SVMC_F_BEFORE
+    },
+    /** cSvmcDescs */
+    0,
+    /** paSvmcDescs */
+    NULL
+};
+
+
+/**
+ * Returns the index of the target of the given instruction if it is a backward branch (without link).
+ *
+ * @returns Index of the branch target or UINT32_MAX if the instruction is no backward branch.
+ * @param   pau32Code               The workload code.
+ * @param   idxInsn                 Index of the instruction to check.
+ */
+static uint32_t pspBenchInsnBranchBackTarget(const uint32_t *pau32Code, uint32_t idxInsn)
+{
+    uint32_t u32Insn = pau32Code[idxInsn];
+
+    /* B<cond> <label>, the target is relative to the instruction address + 8 in units of instructions. */
+    if (   (u32Insn & 0xf0000000) != 0xf0000000
+        && (u32Insn & 0x0f000000) == 0x0a000000)
+    {
+        int32_t offInsns = (int32_t)(u32Insn << 8) >> 8;
+        int64_t idxTarget = (int64_t)idxInsn + 2 + offInsns;
+
+        if (   idxTarget >= 0
+            && idxTarget <= idxInsn)
+            return (uint32_t)idxTarget;
+    }
+
+    return UINT32_MAX;
+}
+
+
+/**
+ * Derives the instruction counts from the loop structure of the given workload.
+ *
+ * @returns Status code.
+ * @param   pWorkload               The workload.
+ * @param   pInsns                  Where to store the instruction counts on success.
+ */
+static int pspBenchWorkloadInsnsDerive(PCPSPBENCHWORKLOAD pWorkload, PPSPBENCHINSNS pInsns)
+{
+    const uint32_t *pau32Code = pWorkload->pau32Code;
+    uint32_t idxLoopBranch = UINT32_MAX;
+    uint32_t idxLoop = UINT32_MAX;
+    uint32_t idxPollBranch = UINT32_MAX;
+    uint32_t idxPoll = UINT32_MAX;
+
+    /* The last backward branch closes the outer loop. */
+    for (uint32_t i = pWorkload->cInsnsCode; i > 0 && idxLoopBranch == UINT32_MAX; i--)
+    {
+        idxLoop = pspBenchInsnBranchBackTarget(pau32Code, i - 1);
+        if (idxLoop != UINT32_MAX)
+            idxLoopBranch = i - 1;
+    }
+    if (idxLoopBranch == UINT32_MAX)
+        return STS_ERR_INVALID_PARAMETER;
+
+    /* At most one poll loop nested in the outer loop. */
+    for (uint32_t i = idxLoop; i < idxLoopBranch; i++)
+    {
+        uint32_t idxTarget = pspBenchInsnBranchBackTarget(pau32Code, i);
+        if (idxTarget != UINT32_MAX)
+        {
+            if (   idxPollBranch != UINT32_MAX
+                || idxTarget < idxLoop)
+                return STS_ERR_INVALID_PARAMETER;
+
+            idxPollBranch = i;
+            idxPoll       = idxTarget;
+        }
+    }
+
+    pInsns->cInsnsFixed   = idxLoop + (pWorkload->cInsnsCode - idxLoopBranch - 1);
+    pInsns->cInsnsPerPoll = idxPollBranch != UINT32_MAX ? idxPollBranch - idxPoll + 1 : 0;
+    pInsns->cInsnsPerIter = idxLoopBranch - idxLoop + 1 - pInsns->cInsnsPerPoll;
+    return STS_INF_SUCCESS;
+}
+
+
+/**
+ * @copydoc FNPSPIOMSTATSENUM
+ */
+static int pspBenchIomStatsSum(PSPIOMADDRSPACE enmAddrSpace, uint64_t u64AddrStart, size_t cbRegion, const char *pszDesc,
+                               PCPSPIOMSTATS pStats, void *pvUser)
+{
+    PPSPBENCHIOMSTATS pSum = (PPSPBENCHIOMSTATS)pvUser;
+
+    (void)enmAddrSpace;
+    (void)u64AddrStart;
+    (void)cbRegion;
+    (void)pszDesc;
+    pSum->cReads  += pStats->cReads;
+    pSum->cWrites += pStats->cWrites;
+    return STS_INF_SUCCESS;
+}
+
+
+static int pspBenchPrepareMmio(PPSPBENCH pThis, uint32_t cIters)
+{
+    (void)cIters;
+    pThis->au32Params[1] = PSP_BENCH_MMIO_ADDR;
+    return STS_INF_SUCCESS;
+}
+
+
+static int pspBenchPrepareMmu(PPSPBENCH pThis, uint32_t cIters)
+{
+    /* Identity map the first 1MiB and alias it at 1MiB. */
+    uint32_t au32PgTbl[2] = { PSP_BENCH_PGTBL_SECTION_0, PSP_BENCH_PGTBL_SECTION_0 };
+
+    (void)cIters;
+    pThis->au32Params[1] = PSP_BENCH_PGTBL_ADDR;
+    pThis->au32Params[2] = PSP_BENCH_PGTBL_ADDR + sizeof(uint32_t);
+    pThis->au32Params[3] = PSP_BENCH_PGTBL_SECTION_0;
+    pThis->au32Params[4] = PSP_BENCH_MMU_ALIAS_ADDR;
+    return PSPEmuCoreMemWrite(pThis->hCore, PSP_BENCH_PGTBL_ADDR, &au32PgTbl[0], sizeof(au32PgTbl));
+}
+
+
+/**
+ * Writes the given CCP request and sets up the CCP workload parameters.
+ *
+ * @returns Status code.
+ * @param   pThis                   The benchmark instance data.
+ * @param   pReq                    The request to submit in every iteration.
+ * @param   pvSrc                   The source data.
+ * @param   cbSrc                   Size of the source data in bytes.
+ * @param   cbPerIter               Number of bytes processed by the request.
+ */
+static int pspBenchCcpSetup(PPSPBENCH pThis, PCCCP5REQ pReq, const void *pvSrc, size_t cbSrc, size_t cbPerIter)
+{
+    PSPADDR PspAddrQueue = CCP_V5_MMIO_ADDRESS + CCP_V5_Q_OFFSET;
+
+    pThis->au32Params[1] = PspAddrQueue + CCP_V5_Q_REG_CTRL;
+    pThis->au32Params[2] = PspAddrQueue + CCP_V5_Q_REG_TAIL;
+    pThis->au32Params[3] = PspAddrQueue + CCP_V5_Q_REG_HEAD;
+    pThis->au32Params[4] = PSP_BENCH_CCP_REQ_ADDR;
+    pThis->au32Params[5] = PSP_BENCH_CCP_REQ_ADDR + sizeof(*pReq);
+    pThis->au32Params[6] = CCP_V5_Q_REG_CTRL_RUN;
+    pThis->au32Params[7] = CCP_V5_Q_REG_CTRL_HALT;
+    pThis->cbCcpPerIter  = cbPerIter;
+
+    int rc = PSPEmuCoreMemWrite(pThis->hCore, PSP_BENCH_CCP_REQ_ADDR, pReq, sizeof(*pReq));
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuCoreMemWrite(pThis->hCore, PSP_BENCH_CCP_SRC_ADDR, pvSrc, cbSrc);
+    return rc;
+}
+
+
+/**
+ * Fills the given buffer with compressible but not entirely trivial data.
+ *
+ * @returns nothing.
+ * @param   pb                      The buffer to fill.
+ * @param   cb                      Size of the buffer in bytes.
+ */
+static void pspBenchDataFill(uint8_t *pb, size_t cb)
+{
+    for (size_t i = 0; i < cb; i++)
+        pb[i] = (uint8_t)((i % 61) + (i / 509));
+}
+
+
+static int pspBenchPrepareCcpSha256(PPSPBENCH pThis, uint32_t cIters)
+{
+    uint8_t abData[PSP_BENCH_CCP_DATA_SZ];
+    CCP5REQ Req;
+
+    (void)cIters;
+    pspBenchDataFill(&abData[0], sizeof(abData));
+    memset(&Req, 0, sizeof(Req));
+    Req.u32Dw0               = PSP_BENCH_CCP_DW0(CCP_V5_ENGINE_SHA, PSP_BENCH_CCP_SHA_FUNC(CCP_V5_ENGINE_SHA_TYPE_256));
+    Req.cbSrc                = sizeof(abData);
+    Req.u32AddrSrcLow        = PSP_BENCH_CCP_SRC_ADDR;
+    Req.u16SrcMemType        = PSP_BENCH_CCP_MEM_TYPE(CCP_V5_MEM_TYPE_LOCAL, 0 /*LsbCtxId*/);
+    Req.Op.Sha.u32ShaBitsLow = sizeof(abData) * 8;
+    return pspBenchCcpSetup(pThis, &Req, &abData[0], sizeof(abData), sizeof(abData));
+}
+
+
+static int pspBenchPrepareCcpAes128(PPSPBENCH pThis, uint32_t cIters)
+{
+    static const uint8_t s_abKey[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                                         0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+    uint8_t abData[PSP_BENCH_CCP_DATA_SZ];
+    CCP5REQ Req;
+
+    (void)cIters;
+    pspBenchDataFill(&abData[0], sizeof(abData));
+    memset(&Req, 0, sizeof(Req));
+    Req.u32Dw0                  = PSP_BENCH_CCP_DW0(CCP_V5_ENGINE_AES,
+                                                    PSP_BENCH_CCP_AES_FUNC(CCP_V5_ENGINE_AES_TYPE_128, CCP_V5_ENGINE_AES_MODE_ECB,
+                                                                           1 /*fEncrypt*/));
+    Req.cbSrc                   = sizeof(abData);
+    Req.u32AddrSrcLow           = PSP_BENCH_CCP_SRC_ADDR;
+    Req.u16SrcMemType           = PSP_BENCH_CCP_MEM_TYPE(CCP_V5_MEM_TYPE_LOCAL, 0 /*LsbCtxId*/);
+    Req.Op.NonSha.u32AddrDstLow = PSP_BENCH_CCP_DST_ADDR;
+    Req.Op.NonSha.u16DstMemType = PSP_BENCH_CCP_MEM_TYPE(CCP_V5_MEM_TYPE_LOCAL, 0 /*LsbCtxId*/);
+    Req.u32AddrKeyLow           = PSP_BENCH_CCP_KEY_ADDR;
+    Req.u16KeyMemType           = PSP_BENCH_CCP_MEM_TYPE(CCP_V5_MEM_TYPE_LOCAL, 0 /*LsbCtxId*/);
+
+    int rc = PSPEmuCoreMemWrite(pThis->hCore, PSP_BENCH_CCP_KEY_ADDR, &s_abKey[0], sizeof(s_abKey));
+    if (STS_SUCCESS(rc))
+        rc = pspBenchCcpSetup(pThis, &Req, &abData[0], sizeof(abData), sizeof(abData));
+    return rc;
+}
+
+
+static int pspBenchPrepareCcpZlib(PPSPBENCH pThis, uint32_t cIters)
+{
+    uint8_t abData[PSP_BENCH_CCP_DATA_SZ];
+    uint8_t abComp[PSP_BENCH_CCP_DST_ADDR - PSP_BENCH_CCP_SRC_ADDR];
+    uLongf cbComp = sizeof(abComp);
+    CCP5REQ Req;
+
+    (void)cIters;
+    pspBenchDataFill(&abData[0], sizeof(abData));
+    if (compress2(&abComp[0], &cbComp, &abData[0], sizeof(abData), Z_BEST_COMPRESSION) != Z_OK)
+        return STS_ERR_BUFFER_OVERFLOW;
+
+    memset(&Req, 0, sizeof(Req));
+    Req.u32Dw0                  = PSP_BENCH_CCP_DW0(CCP_V5_ENGINE_ZLIB_DECOMP, 0 /*uFunc*/);
+    Req.cbSrc                   = cbComp;
+    Req.u32AddrSrcLow           = PSP_BENCH_CCP_SRC_ADDR;
+    Req.u16SrcMemType           = PSP_BENCH_CCP_MEM_TYPE(CCP_V5_MEM_TYPE_LOCAL, 0 /*LsbCtxId*/);
+    Req.Op.NonSha.u32AddrDstLow = PSP_BENCH_CCP_DST_ADDR;
+    Req.Op.NonSha.u16DstMemType = PSP_BENCH_CCP_MEM_TYPE(CCP_V5_MEM_TYPE_LOCAL, 0 /*LsbCtxId*/);
+    return pspBenchCcpSetup(pThis, &Req, &abComp[0], cbComp, sizeof(abData));
+}
+
+
+static int pspBenchPrepareSmnRam(PPSPBENCH pThis, uint32_t cIters)
+{
+    void *pvRam = NULL;
+
+    (void)cIters;
+    pThis->au32Params[1] = PSP_BENCH_SMN_CTRL_ADDR;
+    pThis->au32Params[2] = PSP_BENCH_SMN_RAM_ADDR >> 20;
+    pThis->au32Params[3] = PSP_BENCH_SMN_SLOT0_ADDR;
+    pThis->au32Params[4] = 0;
+
+    int rc = PSPEmuIoMgrSmnRamRegister(pThis->hIoMgr, PSP_BENCH_SMN_RAM_ADDR, PSP_BENCH_SMN_RAM_SZ,
+                                       PSPEMU_CORE_MEM_REGION_PROT_F_READ | PSPEMU_CORE_MEM_REGION_PROT_F_WRITE,
+                                       "BenchSmnRam", &pvRam, &pThis->hSmnRam);
+    if (STS_SUCCESS(rc))
+        *(uint32_t *)pvRam = PSP_BENCH_SMN_RAM_PATTERN;
+    return rc;
+}
+
+
+/**
+ * @copydoc FNPSPBENCHCHECK
+ *
+ * @note Checks that all requests submitted to the CCP succeeded.
+ */
+static int pspBenchCcpCheck(PPSPBENCH pThis, uint32_t cIters)
+{
+    uint32_t u32Sts = 0;
+
+    (void)cIters;
+    int rc = PSPEmuIoMgrPspAddrRead(pThis->hIoMgr, CCP_V5_MMIO_ADDRESS + CCP_V5_Q_OFFSET + CCP_V5_Q_REG_STATUS,
+                                    &u32Sts, sizeof(u32Sts));
+    if (   STS_SUCCESS(rc)
+        && u32Sts != CCP_V5_Q_REG_STATUS_SUCCESS)
+        rc = STS_ERR_GENERAL_ERROR;
+
+    return rc;
+}
+
+
+/**
+ * @copydoc FNPSPBENCHCHECK
+ *
+ * @note Checks that the workload read the pattern in every iteration and that reading the slot window
+ *       through the I/O manager returns it as well.
+ */
+static int pspBenchSmnRamCheck(PPSPBENCH pThis, uint32_t cIters)
+{
+    uint32_t u32Sum = 0;
+    uint32_t u32Val = 0;
+
+    int rc = PSPEmuCoreMemRead(pThis->hCore, PSP_BENCH_PARAM_ADDR + 4 * sizeof(uint32_t), &u32Sum, sizeof(u32Sum));
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuIoMgrPspAddrRead(pThis->hIoMgr, PSP_BENCH_SMN_SLOT0_ADDR, &u32Val, sizeof(u32Val));
+    if (   STS_SUCCESS(rc)
+        && (   u32Sum != cIters * PSP_BENCH_SMN_RAM_PATTERN
+            || u32Val != PSP_BENCH_SMN_RAM_PATTERN))
+        rc = STS_ERR_GENERAL_ERROR;
+
+    return rc;
+}
+
+
+/**
+ * Destroys the emulation environment of a workload.
+ *
+ * @returns nothing.
+ * @param   pThis                   The benchmark instance data.
+ */
+static void pspBenchEnvDestroy(PPSPBENCH pThis)
+{
+    if (pThis->pDevCcp)
+        PSPEmuDevDestroy(pThis->pDevCcp);
+    if (pThis->hSmnRam)
+        PSPEmuIoMgrDeregister(pThis->hSmnRam);
+    if (pThis->hIoMgr)
+        PSPEmuIoMgrDestroy(pThis->hIoMgr);
+    if (pThis->hCore)
+        PSPEmuCoreDestroy(pThis->hCore);
+    if (pThis->pvSram)
+        free(pThis->pvSram);
+    memset(pThis, 0, sizeof(*pThis));
+}
+
+
+/**
+ * Creates a fresh emulation environment for a workload.
+ *
+ * @returns Status code.
+ * @param   pThis                   The benchmark instance data.
+ */
+static int pspBenchEnvCreate(PPSPBENCH pThis)
+{
+    memset(pThis, 0, sizeof(*pThis));
+
+    /* The CCP gets the default config, i.e. synchronous processing on the emulation thread without any proxy. */
+    pThis->pvSram = calloc(1, PSP_BENCH_SRAM_SZ);
+    if (!pThis->pvSram)
+        return STS_ERR_NO_MEMORY;
+
+    int rc = PSPEmuCoreCreate(&pThis->hCore);
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuCoreMemRegionAdd(pThis->hCore, 0x0, PSP_BENCH_SRAM_SZ,
+                                    PSPEMU_CORE_MEM_REGION_PROT_F_EXEC | PSPEMU_CORE_MEM_REGION_PROT_F_READ | PSPEMU_CORE_MEM_REGION_PROT_F_WRITE,
+                                    pThis->pvSram);
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuIoMgrCreate(&pThis->hIoMgr, pThis->hCore);
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuIoMgrStatsEnable(pThis->hIoMgr, true /*fEnable*/);
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuIoMgrMmioRegister(pThis->hIoMgr, PSP_BENCH_MMIO_ADDR, PSP_BENCH_MMIO_SZ,
+                                     pspBenchMmioRead, pspBenchMmioWrite, pThis,
+                                     "Bench", &pThis->hMmio);
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuDevCreate(pThis->hIoMgr, &g_DevRegCcpV5, &pThis->Cfg, &pThis->pDevCcp);
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuCoreSvcInjectSet(pThis->hCore, &g_SvcReg, pThis);
+    if (STS_FAILURE(rc))
+        pspBenchEnvDestroy(pThis);
+
+    return rc;
+}
+
+
+/**
+ * Runs a single workload and prints the results.
+ *
+ * @returns Status code.
+ * @param   pWorkload               The workload to run.
+ * @param   cIters                  Number of iterations, 0 for the workload default.
+ */
+static int pspBenchWorkloadRun(PCPSPBENCHWORKLOAD pWorkload, uint32_t cIters)
+{
+    PSPBENCH This;
+    PPSPBENCH pThis = &This;
+    PSPBENCHINSNS Insns;
+
+    if (!cIters)
+        cIters = pWorkload->cItersDefault;
+
+    int rc = pspBenchWorkloadInsnsDerive(pWorkload, &Insns);
+    if (STS_FAILURE(rc))
+    {
+        fprintf(stderr, "%s: The loop structure of the workload code is not supported\n", pWorkload->pszName);
+        return rc;
+    }
+
+    rc = pspBenchEnvCreate(pThis);
+    if (STS_FAILURE(rc))
+    {
+        fprintf(stderr, "%s: Creating the emulation environment failed with %d\n", pWorkload->pszName, rc);
+        return rc;
+    }
+
+    pThis->au32Params[0] = cIters;
+    if (pWorkload->pfnPrepare)
+        rc = pWorkload->pfnPrepare(pThis, cIters);
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuCoreMemWrite(pThis->hCore, PSP_BENCH_CODE_ADDR, pWorkload->pau32Code,
+                                pWorkload->cInsnsCode * sizeof(uint32_t));
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuCoreMemWrite(pThis->hCore, PSP_BENCH_PARAM_ADDR, &pThis->au32Params[0], sizeof(pThis->au32Params));
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuCoreSetReg(pThis->hCore, PSPCOREREG_R0, PSP_BENCH_PARAM_ADDR);
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuCoreSetReg(pThis->hCore, PSPCOREREG_SP, PSP_BENCH_STACK_ADDR);
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuCoreExecSetStartAddr(pThis->hCore, PSP_BENCH_CODE_ADDR);
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuIoMgrStatsReset(pThis->hIoMgr);
+    if (STS_FAILURE(rc))
+    {
+        fprintf(stderr, "%s: Preparing the workload failed with %d\n", pWorkload->pszName, rc);
+        pspBenchEnvDestroy(pThis);
+        return rc;
+    }
+
+    uint64_t tsStartNs = pspBenchTsNs();
+    rc = PSPEmuCoreExecRun(pThis->hCore, PSPEMU_CORE_EXEC_F_DEFAULT, 0, PSPEMU_CORE_EXEC_INDEFINITE);
+    uint64_t cNsElapsed = pspBenchTsNs() - tsStartNs;
+
+    /* The workloads finish with a wfi instruction, anything else means something went wrong. */
+    if (rc == PSPEMU_INF_CORE_INSN_WFI_REACHED)
+        rc = STS_INF_SUCCESS;
+    else if (STS_SUCCESS(rc))
+        rc = STS_ERR_GENERAL_ERROR;
+
+    /* Query the statistics first as checking the result might cause further accesses. */
+    PSPBENCHIOMSTATS IomStats = { 0, 0 };
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuIoMgrStatsEnum(pThis->hIoMgr, pspBenchIomStatsSum, &IomStats);
+    if (   STS_SUCCESS(rc)
+        && pWorkload->pfnCheck)
+        rc = pWorkload->pfnCheck(pThis, cIters);
+
+    if (STS_SUCCESS(rc))
+    {
+        double   dSecs     = (double)cNsElapsed / 1000000000.0;
+        uint64_t cIomOps   = IomStats.cReads + IomStats.cWrites;
+        uint64_t cbCcp     = (uint64_t)cIters * pThis->cbCcpPerIter;
+        uint64_t cInsns    =   Insns.cInsnsFixed
+                             + (uint64_t)cIters * Insns.cInsnsPerIter
+                             + IomStats.cReads  * Insns.cInsnsPerPoll;
+
+        if (dSecs <= 0.0)
+            dSecs = 1.0 / 1000000000.0;
+
+        printf("{\"workload\":\"%s\",\"iterations\":%u,\"seconds\":%.6f,\"insns\":%llu,\"mips\":%.2f,"
+               "\"iom_ops\":%llu,\"iom_ops_per_sec\":%.2f,\"ccp_bytes\":%llu,\"ccp_mb_per_sec\":%.2f}\n",
+               pWorkload->pszName, cIters, dSecs, (unsigned long long)cInsns, (double)cInsns / dSecs / 1000000.0,
+               (unsigned long long)cIomOps, (double)cIomOps / dSecs,
+               (unsigned long long)cbCcp, (double)cbCcp / dSecs / (double)_1M);
+        fflush(stdout);
+    }
+    else
+        fprintf(stderr, "%s: Running the workload failed with %d\n", pWorkload->pszName, rc);
+
+    pspBenchEnvDestroy(pThis);
+    return rc;
+}
+
+
+/**
+ * Returns the workload with the given name.
+ *
+ * @returns Pointer to the workload or NULL if not found.
+ * @param   pszName                 The workload name.
+ * @param   cchName                 Length of the name.
+ */
+static PCPSPBENCHWORKLOAD pspBenchWorkloadFind(const char *pszName, size_t cchName)
+{
+    for (uint32_t i = 0; i < ELEMENTS(g_aWorkloads); i++)
+    {
+        if (   strlen(g_aWorkloads[i].pszName) == cchName
+            && !strncmp(g_aWorkloads[i].pszName, pszName, cchName))
+            return &g_aWorkloads[i];
+    }
+
+    return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *pszWorkloads = NULL;
+    uint32_t cIters = 0;
+    int ch = 0;
+    int idxOption = 0;
+
+    while ((ch = getopt_long (argc, argv, "hw:i:l", &g_aOptions[0], &idxOption)) != -1)
+    {
+        switch (ch)
+        {
+            case 'h':
+            case 'H':
+                printf("%s: PSP emulator micro benchmarks\n"
+                       "    --workload <name>[,<name>...] Workloads to run, default is all of them\n"
+                       "    --iterations <count>          Number of iterations overriding the workload default\n"
+                       "    --list                        Lists the available workloads\n",
+                       argv[0]);
+                return 0;
+            case 'w':
+                pszWorkloads = optarg;
+                break;
+            case 'i':
+                cIters = strtoul(optarg, NULL, 0);
+                break;
+            case 'l':
+                for (uint32_t i = 0; i < ELEMENTS(g_aWorkloads); i++)
+                    printf("%-12s %s (%u iterations)\n", g_aWorkloads[i].pszName, g_aWorkloads[i].pszDesc,
+                           g_aWorkloads[i].cItersDefault);
+                return 0;
+            default:
+                fprintf(stderr, "Unrecognised option: -%c\n", optopt);
+                return 1;
+        }
+    }
+
+    int rc = STS_INF_SUCCESS;
+    if (pszWorkloads)
+    {
+        const char *pszCur = pszWorkloads;
+        while (*pszCur)
+        {
+            const char *pszSep = strchr(pszCur, ',');
+            size_t cchName = pszSep ? (size_t)(pszSep - pszCur) : strlen(pszCur);
+            PCPSPBENCHWORKLOAD pWorkload = pspBenchWorkloadFind(pszCur, cchName);
+            if (!pWorkload)
+            {
+                fprintf(stderr, "Unknown workload: %.*s\n", (int)cchName, pszCur);
+                return 1;
+            }
+
+            int rc2 = pspBenchWorkloadRun(pWorkload, cIters);
+            if (STS_FAILURE(rc2))
+                rc = rc2;
+
+            pszCur += cchName;
+            if (*pszCur == ',')
+                pszCur++;
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < ELEMENTS(g_aWorkloads); i++)
+        {
+            int rc2 = pspBenchWorkloadRun(&g_aWorkloads[i], cIters);
+            if (STS_FAILURE(rc2))
+                rc = rc2;
+        }
+    }
+
+    return STS_SUCCESS(rc) ? 0 : 1;
+}
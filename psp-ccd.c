@@ -20,6 +20,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 #include <stddef.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -428,6 +429,29 @@ static int pspEmuCcdDevicesReset(PPSPCCDINT pThis)
 }
 
 
+/**
+ * Core halt notification callback, forwards the notification to all devices.
+ *
+ * @returns nothing.
+ * @param   hCore                   The PSP core handle which is about to be put to sleep.
+ * @param   pvUser                  Opaque user data, the CCD instance.
+ */
+static void pspEmuCcdCoreHalt(PSPCORE hCore, void *pvUser)
+{
+    PPSPCCDINT pThis = (PPSPCCDINT)pvUser;
+
+    (void)hCore;
+
+    PPSPDEV pDev = pThis->pDevsHead;
+    while (pDev)
+    {
+        if (pDev->pReg->pfnHalt)
+            pDev->pReg->pfnHalt(pDev);
+        pDev = pDev->pNext;
+    }
+}
+
+
 /**
  * Create temporary memory regions given on the command line.
  *
@@ -566,9 +590,17 @@ static int pspEmuCcdMemoryInit(PPSPCCDINT pThis, PCPSPEMUCFG pCfg)
 
             if (pCfg->fLoadPspDir)
             {
-                printf("Loading PSP 1st level directory from flash image into boot ROM service page\n");
-                uint8_t *pbFlashRom = (uint8_t *)pCfg->pvFlashRom;
-                memcpy(&Brsp.Fields.abFfsDir[0], &pbFlashRom[0x77000], sizeof(Brsp.Fields.abFfsDir)); /** @todo */
+                size_t offPspDir = 0;
+                if (   !PSPEmuFlashIdxQueryPspDir(pCfg->hFlashIdx, &offPspDir)
+                    && offPspDir + sizeof(Brsp.Fields.abFfsDir) <= pCfg->cbFlashRom)
+                {
+                    uint8_t *pbFlashRom = (uint8_t *)pCfg->pvFlashRom;
+
+                    printf("Loading PSP 1st level directory at %#zx from flash image into boot ROM service page\n", offPspDir);
+                    memcpy(&Brsp.Fields.abFfsDir[0], &pbFlashRom[offPspDir], sizeof(Brsp.Fields.abFfsDir));
+                }
+                else
+                    printf("The flash image doesn't contain a PSP 1st level directory, not loading it into the boot ROM service page\n");
             }
 
             Brsp.Fields.idPhysDie      = (uint8_t)pThis->idCcd;
@@ -698,7 +730,8 @@ static int pspEmuCcdExecEnvInit(PPSPCCDINT pThis, PCPSPEMUCFG pCfg)
  * @param   pThis                   The CCD instance to initialize the debugger for.
  * @param   pCfg                    The global config.
  *
- * @todo Tracing for multiple CCDs is not working right now.
+ * @note Every CCD gets its own tracer and log file if there is more than one, the tracer is made the default
+ *       of the thread executing the CCD in PSPEmuCcdRun() (or by the debugger).
  */
 static int pspEmuCcdTraceInit(PPSPCCDINT pThis, PCPSPEMUCFG pCfg)
 {
@@ -706,10 +739,29 @@ static int pspEmuCcdTraceInit(PPSPCCDINT pThis, PCPSPEMUCFG pCfg)
 
     if (pCfg->pszTraceLog)
     {
-        rc = PSPEmuTraceCreateForFile(&pThis->hTrace, PSPEMU_TRACE_F_DEFAULT, pThis->hPspCore,
-                                      0, pCfg->pszTraceLog);
+        char szPath[PATH_MAX];
+        const char *pszPath = pCfg->pszTraceLog;
+        uint32_t fTraceFlags = PSPEMU_TRACE_F_DEFAULT;
+        if (pCfg->fTraceFullCoreCtx)
+            fTraceFlags |= PSPEMU_TRACE_F_FULL_CORE_CTX;
+
+        if (pCfg->cSockets * pCfg->cCcdsPerSocket > 1)
+        {
+            snprintf(&szPath[0], sizeof(szPath), "%s.%u.%u", pCfg->pszTraceLog, pThis->idSocket, pThis->idCcd);
+            pszPath = &szPath[0];
+        }
+
+        rc = PSPEmuTraceCreateForFile(&pThis->hTrace, fTraceFlags, pThis->hPspCore,
+                                      0, pszPath);
         if (!rc)
             rc = PSPEmuTraceSetDefault(pThis->hTrace);
+        if (   !rc
+            && pCfg->pszTraceFilter)
+        {
+            rc = PSPEmuTraceFilterSet(pThis->hTrace, pCfg->pszTraceFilter);
+            if (rc)
+                printf("Parsing the trace filter \"%s\" failed with %d\n", pCfg->pszTraceFilter, rc);
+        }
     }
 
     if (pCfg->pszCovTrace)
@@ -787,6 +839,9 @@ int PSPEmuCcdCreate(PPSPCCD phCcd, uint32_t idSocket, uint32_t idCcd, PCPSPEMUCF
             if (!rc)
             {
                 rc = PSPEmuIoMgrTraceAllAccessesSet(pThis->hIoMgr, pCfg->fIomLogAllAccesses);
+                if (   !rc
+                    && pCfg->pszIomStats)
+                    rc = PSPEmuIoMgrStatsEnable(pThis->hIoMgr, true /*fEnable*/);
                 if (!rc)
                 {
                     /* Create all the devices. */
@@ -794,6 +849,8 @@ int PSPEmuCcdCreate(PPSPCCD phCcd, uint32_t idSocket, uint32_t idCcd, PCPSPEMUCF
                         rc = pspEmuCcdDevicesInstantiate(pThis, pCfg->papszDevs, pCfg);
                     else
                         rc = pspEmuCcdDevicesInstantiateDefault(pThis, pCfg);
+                    if (!rc)
+                        rc = PSPEmuCoreHaltNotifySet(pThis->hPspCore, pspEmuCcdCoreHalt, pThis);
                     if (!rc)
                     {
                         /* Initialize the memory content for the PSP. */
@@ -859,6 +916,23 @@ void PSPEmuCcdDestroy(PSPCCD hCcd)
         pThis->hSvc = NULL;
     }
 
+    if (pThis->pCfg->pszIomStats)
+    {
+        char szPath[PATH_MAX];
+        const char *pszPath = pThis->pCfg->pszIomStats;
+
+        /* Every CCD gets its own file if there is more than one. */
+        if (pThis->pCfg->cSockets * pThis->pCfg->cCcdsPerSocket > 1)
+        {
+            snprintf(&szPath[0], sizeof(szPath), "%s.%u.%u", pThis->pCfg->pszIomStats, pThis->idSocket, pThis->idCcd);
+            pszPath = &szPath[0];
+        }
+
+        int rc = PSPEmuIoMgrStatsDumpToFile(pThis->hIoMgr, pszPath);
+        if (rc)
+            printf("Dumping the I/O statistics to %s failed with %d\n", pszPath, rc);
+    }
+
     pspEmuCcdDevicesDestroy(pThis);
 
     /* Destroy the I/O manager and then the emulation core and last this structure. */
@@ -888,6 +962,15 @@ int PSPEmuCcdQueryIoMgr(PSPCCD hCcd, PPSPIOM phIoMgr)
 }
 
 
+int PSPEmuCcdQueryTrace(PSPCCD hCcd, PPSPTRACE phTrace)
+{
+    PPSPCCDINT pThis = hCcd;
+
+    *phTrace = pThis->hTrace;
+    return 0;
+}
+
+
 int PSPEmuCcdReset(PSPCCD hCcd)
 {
     PPSPCCDINT pThis = hCcd;
@@ -908,11 +991,32 @@ int PSPEmuCcdRun(PSPCCD hCcd)
 {
     PPSPCCDINT pThis = hCcd;
 
-    int rc = PSPEmuCoreExecRun(pThis->hPspCore,
+    int rc = PSPEmuTraceSetDefault(pThis->hTrace);
+    for (;;)
+    {
+        rc = PSPEmuCoreExecRun(pThis->hPspCore,
                                  pThis->pCfg->fSingleStepDumpCoreState
                                ? PSPEMU_CORE_EXEC_F_DUMP_CORE_STATE
                                : PSPEMU_CORE_EXEC_F_DEFAULT,
                                0, PSPEMU_CORE_EXEC_INDEFINITE);
+        if (rc != PSPEMU_INF_CORE_INSN_WFI_REACHED)
+            break;
+
+        /*
+         * Sleep instead of spinning on the WFI. There is no interrupt controller and no timer deadline
+         * which could wake the core up yet, so resume after a short while to let the firmware re-check
+         * its conditions (a WFI is allowed to complete spuriously).
+         */
+        rc = PSPEmuCoreHaltWait(pThis->hPspCore, PSPEMU_CORE_HALT_WAIT_MS);
+        if (rc == PSPEMU_INF_CORE_HALT_STOPPED)
+        {
+            rc = STS_INF_SUCCESS;
+            break;
+        }
+        else if (STS_FAILURE(rc))
+            break;
+    }
+
     PSPEmuCoreStateDump(pThis->hPspCore, PSPEMU_CORE_STATE_DUMP_F_DEFAULT, 0 /*cInsns*/);
     return rc;
 }
@@ -20,6 +20,9 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 #include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
 
 #include <unicorn/unicorn.h>
 
@@ -29,12 +32,16 @@
 
 #include <psp-core.h>
 #include <psp-disasm.h>
+#include <psp-perf.h>
 #include <psp-trace.h>
 
 /** Page size used in the PSP firmware. */
 #define PSP_PAGE_SIZE         _4K
 #define PSP_PAGE_L1_IDX_SHIFT 20
 
+/** Number of SVC return addresses which can have an after hook registered (must be a power of two). */
+#define PSP_CORE_SVC_RET_HOOKS  64
+
 /**
  * A datum read/written.
  */
@@ -249,6 +256,26 @@ typedef PSPCOREPGTBLTRACK *PPSPCOREPGTBLTRACK;
 typedef const PSPCOREPGTBLTRACK *PCPSPCOREPGTBLTRACK;
 
 
+/**
+ * SVC return address hook.
+ */
+typedef struct PSPCORESVCRET
+{
+    /** The PSP core this hook belongs to. */
+    struct PSPCOREINT       *pCore;
+    /** The return address the hook is registered for (without the thumb bit), 0 if the entry is free. */
+    PSPADDR                 PspAddrRet;
+    /** The unicorn hook handle. */
+    uc_hook                 hUcHook;
+    /** Flag whether an SVC returning to this address is outstanding. */
+    bool                    fPending;
+    /** The SVC number of the outstanding call. */
+    uint32_t                idxSvc;
+} PSPCORESVCRET;
+/** Pointer to a SVC return address hook. */
+typedef PSPCORESVCRET *PPSPCORESVCRET;
+
+
 /**
  * A single PSP core executing.
  */
@@ -284,6 +311,16 @@ typedef struct PSPCOREINT
     PFNPSPCOREWFI           pfnWfiReached;
     /** Opaque user data to pass to the WFI reached callback. */
     void                    *pvWfiUser;
+    /** The halt notification callback if set. */
+    PFNPSPCOREHALT          pfnHalt;
+    /** Opaque user data to pass to the halt notification callback. */
+    void                    *pvHaltUser;
+    /** Mutex protecting the halt state. */
+    pthread_mutex_t         HaltMtx;
+    /** Condition variable a halted core waits on. */
+    pthread_cond_t          HaltCond;
+    /** Flag whether a wakeup is pending for the halted core, protected by HaltMtx. */
+    bool                    fHaltWakeup;
 
     /** The SVC injection registartion record set, NULL if no overrides exist. */
     PCPSPCORESVMCREG        pSvcReg;
@@ -291,8 +328,8 @@ typedef struct PSPCOREINT
     void                    *pvSvcUser;
     /** The currently syscall number being executed. */
     uint32_t                idxSvc;
-    /** The hook for the after SVC breakpoint. */
-    uc_hook                 hUcHookSvcAfter;
+    /** Hash table of return addresses with a persistent after SVC hook, indexed by the address. */
+    PSPCORESVCRET           aSvcRet[PSP_CORE_SVC_RET_HOOKS];
 
     /** The SMC injection registartion record set, NULL if no overrides exist. */
     PCPSPCORESVMCREG        pSmcReg;
@@ -673,7 +710,9 @@ static uint64_t pspEmuCoreMmioRead(struct uc_struct* pUcEngine, void *pvUser, ui
     PSPDATUM ValRead;
     uint64_t uValRet = 0;
 
+    PSPEmuPerfEnter(PSPPERFSUBSYS_IOM);
     pRegion->u.Mmio.pfnRead(pRegion->pPspCore, (PSPADDR)uAddr, cb, &ValRead, pRegion->u.Mmio.pvUser);
+    PSPEmuPerfLeave();
     switch (cb)
     {
         case 1:
@@ -730,7 +769,9 @@ static void pspEmuCoreMmioWrite(struct uc_struct* pUcEngine, void *pvUser, uint6
             /** @todo assert() */
             uc_emu_stop(pUcEngine);
     }
+    PSPEmuPerfEnter(PSPPERFSUBSYS_IOM);
     pRegion->u.Mmio.pfnWrite(pRegion->pPspCore, (PSPADDR)uAddr, cb, &ValWrite, pRegion->u.Mmio.pvUser);
+    PSPEmuPerfLeave();
 }
 
 
@@ -1115,18 +1156,22 @@ static void pspEmuCoreCpsrChangeWrapper(struct uc_struct *pUcEngine, uint64_t uA
             pThis->fIrq = fIrq;
             pThis->fFiq = fFirq;
         }
+    }
 
-        if (pThis->fIrq || pThis->fFiq)
-        {
-            PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_CORE, "Injecting IRQ!\n");
-            if (pThis->enmExcpPending != PSPCOREEXCP_NONE)
-                printf("OVERWRITING another exception which should not happen!\n");
-            if (fFirq && !(u32Val & BIT(6)))
-                pThis->enmExcpPending = PSPCOREEXCP_FIQ;
-            else if (fIrq && !(u32Val & BIT(7)))
-                pThis->enmExcpPending = PSPCOREEXCP_IRQ;
-            uc_emu_stop(pUcEngine);
-        }
+    /*
+     * Deliver a pending interrupt the moment the source gets unmasked, the exception is
+     * injected by the runloop once unicorn stopped after the current instruction.
+     * Another pending exception takes precedence, the interrupt stays pending in that case.
+     */
+    bool fFiqDeliver = pThis->fFiq && !(u32Val & BIT(6));
+    bool fIrqDeliver = pThis->fIrq && !(u32Val & BIT(7));
+    if (   (fFiqDeliver || fIrqDeliver)
+        && pThis->enmExcpPending == PSPCOREEXCP_NONE)
+    {
+        PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_CORE, "Injecting %s!\n",
+                                fFiqDeliver ? "FIQ" : "IRQ");
+        pThis->enmExcpPending = fFiqDeliver ? PSPCOREEXCP_FIQ : PSPCOREEXCP_IRQ;
+        uc_emu_stop(pUcEngine);
     }
 }
 
@@ -1211,8 +1256,9 @@ static int pspEmuCoreSvcBefore(PPSPCOREINT pThis, PSPADDR PspAddrPc, bool fThumb
  *
  * @returns Status code.
  * @param   pThis               The PSP emulation code instance.
+ * @param   idxSvc              The SVC number which was executed.
  */
-static int pspEmuCoreSvcAfter(PPSPCOREINT pThis)
+static int pspEmuCoreSvcAfter(PPSPCOREINT pThis, uint32_t idxSvc)
 {
     int rc = 0;
 
@@ -1221,15 +1267,15 @@ static int pspEmuCoreSvcAfter(PPSPCOREINT pThis)
         /* Any global handlers?. */
         if (   pThis->pSvcReg->GlobalSvmc.pfnSvmcHnd
             && pThis->pSvcReg->GlobalSvmc.fFlags & PSPEMU_CORE_SVMC_F_AFTER)
-            pThis->pSvcReg->GlobalSvmc.pfnSvmcHnd(pThis, pThis->idxSvc, PSPEMU_CORE_SVMC_F_AFTER, pThis->pvSvcUser);
+            pThis->pSvcReg->GlobalSvmc.pfnSvmcHnd(pThis, idxSvc, PSPEMU_CORE_SVMC_F_AFTER, pThis->pvSvcUser);
 
         /* Any per SVC handler set?. */
-        if (pThis->idxSvc < pThis->pSvcReg->cSvmcDescs)
+        if (idxSvc < pThis->pSvcReg->cSvmcDescs)
         {
-            PCPSPCORESVMCDESC pSvcDesc = &pThis->pSvcReg->paSvmcDescs[pThis->idxSvc];
+            PCPSPCORESVMCDESC pSvcDesc = &pThis->pSvcReg->paSvmcDescs[idxSvc];
             if (   pSvcDesc->pfnSvmcHnd
                 && pSvcDesc->fFlags & PSPEMU_CORE_SVMC_F_AFTER)
-                pSvcDesc->pfnSvmcHnd(pThis, pThis->idxSvc, PSPEMU_CORE_SVMC_F_AFTER, pThis->pvSvcUser);
+                pSvcDesc->pfnSvmcHnd(pThis, idxSvc, PSPEMU_CORE_SVMC_F_AFTER, pThis->pvSvcUser);
         }
     }
 
@@ -1237,6 +1283,34 @@ static int pspEmuCoreSvcAfter(PPSPCOREINT pThis)
 }
 
 
+/**
+ * Returns whether any after handler is registered for the given SVC.
+ *
+ * @returns Flag whether an after handler exists.
+ * @param   pThis               The PSP emulation code instance.
+ * @param   idxSvc              The SVC number to check.
+ */
+static bool pspEmuCoreSvcAfterIsRequired(PPSPCOREINT pThis, uint32_t idxSvc)
+{
+    if (!pThis->pSvcReg)
+        return false;
+
+    if (   pThis->pSvcReg->GlobalSvmc.pfnSvmcHnd
+        && pThis->pSvcReg->GlobalSvmc.fFlags & PSPEMU_CORE_SVMC_F_AFTER)
+        return true;
+
+    if (idxSvc < pThis->pSvcReg->cSvmcDescs)
+    {
+        PCPSPCORESVMCDESC pSvcDesc = &pThis->pSvcReg->paSvmcDescs[idxSvc];
+        if (   pSvcDesc->pfnSvmcHnd
+            && pSvcDesc->fFlags & PSPEMU_CORE_SVMC_F_AFTER)
+            return true;
+    }
+
+    return false;
+}
+
+
 /**
  * Execute any injected SMC handlers before possibly passing control to the monitor code.
  *
@@ -1344,7 +1418,7 @@ static int pspEmuCoreSmcAfter(PPSPCOREINT pThis)
 
 
 /**
- * The after SVC trace hook called by unicorn.
+ * The after SVC hook called by unicorn when the code reaches a return address of a SVC.
  *
  * @returns nothing.
  * @param   pUcEngine               The unicorn engine pointer.
@@ -1354,14 +1428,62 @@ static int pspEmuCoreSmcAfter(PPSPCOREINT pThis)
  */
 static void pspEmuCoreSvcAfterHook(uc_engine *pUcEngine, uint64_t uAddr, uint32_t cbInsn, void *pvUser)
 {
-    PPSPCOREINT pThis = (PPSPCOREINT)pvUser;
+    PPSPCORESVCRET pSvcRet = (PPSPCORESVCRET)pvUser;
 
-    pspEmuCoreSvcAfter(pThis); /* Handle all after hooks. */
+    /* The hook stays registered, so this might be reached without a SVC being outstanding. */
+    if (pSvcRet->fPending)
+    {
+        pSvcRet->fPending = false;
 
-    /* Delete the temporary unicorn hook. */
-    uc_err rcUc = uc_hook_del(pThis->pUcEngine, pThis->hUcHookSvcAfter);
-    /** @todo assert(rcUc == UC_ERR_OK) */
-    pThis->hUcHookSvcAfter = 0;
+        PSPEmuPerfEnter(PSPPERFSUBSYS_SVC);
+        pspEmuCoreSvcAfter(pSvcRet->pCore, pSvcRet->idxSvc); /* Handle all after hooks. */
+        PSPEmuPerfLeave();
+    }
+}
+
+
+/**
+ * Arms the after SVC hook for the given return address, registering a new persistent unicorn hook
+ * the first time a SVC returns to the address.
+ *
+ * @returns Status code.
+ * @param   pThis               The PSP emulation code instance.
+ * @param   PspAddrRet          The address the SVC returns to.
+ * @param   idxSvc              The SVC number being executed.
+ *
+ * @note If the table is full the after handlers are not called for the return address.
+ */
+static int pspEmuCoreSvcAfterArm(PPSPCOREINT pThis, PSPADDR PspAddrRet, uint32_t idxSvc)
+{
+    uint32_t idxHash = (PspAddrRet >> 1) & (PSP_CORE_SVC_RET_HOOKS - 1);
+
+    for (uint32_t i = 0; i < PSP_CORE_SVC_RET_HOOKS; i++)
+    {
+        PPSPCORESVCRET pSvcRet = &pThis->aSvcRet[(idxHash + i) & (PSP_CORE_SVC_RET_HOOKS - 1)];
+
+        if (pSvcRet->PspAddrRet == PspAddrRet)
+        {
+            pSvcRet->fPending = true;
+            pSvcRet->idxSvc   = idxSvc;
+            return STS_INF_SUCCESS;
+        }
+        else if (!pSvcRet->PspAddrRet)
+        {
+            uc_err rcUc = uc_hook_add(pThis->pUcEngine, &pSvcRet->hUcHook, UC_HOOK_CODE,
+                                      (void *)(uintptr_t)pspEmuCoreSvcAfterHook, pSvcRet,
+                                      PspAddrRet, PspAddrRet);
+            if (rcUc != UC_ERR_OK)
+                return pspEmuCoreErrConvertFromUcErr(rcUc);
+
+            pSvcRet->pCore      = pThis;
+            pSvcRet->PspAddrRet = PspAddrRet;
+            pSvcRet->fPending   = true;
+            pSvcRet->idxSvc     = idxSvc;
+            return STS_INF_SUCCESS;
+        }
+    }
+
+    return STS_INF_SUCCESS;
 }
 
 
@@ -1379,7 +1501,7 @@ static bool pspEmuCoreInsnIsWfi(PPSPCOREINT pThis, PSPADDR PspAddrPc, bool fThum
     {
         uint16_t u16Insn = 0;
         uc_err rcUc = uc_mem_read(pThis->pUcEngine, PspAddrPc - 2, &u16Insn, sizeof(u16Insn));
-        if (   rcUc = UC_ERR_OK
+        if (   rcUc == UC_ERR_OK
             && u16Insn == 0xbf30)
             return true;
     }
@@ -1387,7 +1509,7 @@ static bool pspEmuCoreInsnIsWfi(PPSPCOREINT pThis, PSPADDR PspAddrPc, bool fThum
     {
         uint32_t u32Insn = 0;
         uc_err rcUc = uc_mem_read(pThis->pUcEngine, PspAddrPc - 4, &u32Insn, sizeof(u32Insn));
-        if (   rcUc = UC_ERR_OK
+        if (   rcUc == UC_ERR_OK
             && (u32Insn & 0x0fffffff) == 0x0320f003)
             return true;
     }
@@ -1396,64 +1518,6 @@ static bool pspEmuCoreInsnIsWfi(PPSPCOREINT pThis, PSPADDR PspAddrPc, bool fThum
 }
 
 
-/**
- * Single steps through the instructions until the pending interrupt source is enabled.
- *
- * @returns Status code.
- * @param   pThis               The PSP emulation core instance.
- * @param   fFirq               Flag whether an FIRQ is pending.
- * @param   fIrq                Flag whether an IRQ is pending.
- *
- * @note This is a very limited version of our runloop which expects that there is nothing fancy going
- *       on between exiting the WFI instruction and enabling the interrupts on the core.
- */
-static int pspEmuCoreExecSingleStepUntilIrqEnabled(PPSPCOREINT pThis, bool fFirq, bool fIrq)
-{
-    int rc = 0;
-
-    while (   !rc
-           && !pThis->fExecStop)
-    {
-        uc_err rcUc = uc_emu_start(pThis->pUcEngine, pThis->PspAddrExecNext, 0xffffffff, 0, 1);
-        if (rcUc == UC_ERR_OK)
-        {
-            /* Query CPSR and check whether interrupts are enabled for a pending source. */
-            PSPADDR PspAddrPc = 0;
-            uint32_t uCpsrOld = 0;
-            size_t   ucCpuMode = 0;
-
-            uc_err rcUc = uc_reg_read(pThis->pUcEngine, UC_ARM_REG_CPSR, &uCpsrOld);
-            if (rcUc == UC_ERR_OK)
-                rcUc = uc_reg_read(pThis->pUcEngine, UC_ARM_REG_PC, &PspAddrPc);
-            if (rcUc == UC_ERR_OK)
-                rcUc = uc_query(pThis->pUcEngine, UC_QUERY_MODE, &ucCpuMode);
-            if (rcUc == UC_ERR_OK)
-            {
-                if (   (   fFirq
-                        && !(uCpsrOld & (1 << 6)))
-                    || (   fIrq
-                        && !(uCpsrOld & (1 << 7))))
-                    break;
-            }
-            else
-                rc = pspEmuCoreErrConvertFromUcErr(rcUc);
-
-            /*
-             * Unicorn doesn't use the CPSR Thumb state bit but switches to the instruction set
-             * based on bit 0 of the address (like for a blx instruction for instance).
-             */
-            bool fThumb = ucCpuMode == UC_MODE_THUMB ? true : false;
-            PspAddrPc |= fThumb ? 1 : 0;
-            pThis->PspAddrExecNext = PspAddrPc;
-        }
-        else
-            rc = pspEmuCoreErrConvertFromUcErr(rcUc);
-    }
-
-    return rc;
-}
-
-
 /**
  * Finds the region assigned to the given address or NULL if there is nothing assigned.
  *
@@ -2352,6 +2416,40 @@ static int pspEmuCoreMmuSetupTeardown(PPSPCOREINT pThis)
 }
 
 
+/**
+ * Returns whether writes to the given address hit a RAM region dropping writes without write permissions.
+ *
+ * @returns Flag whether the write should be dropped.
+ * @param   pThis                   The PSP core instance.
+ * @param   uAddr                   The address being written to, virtual if the MMU is enabled.
+ */
+static bool pspEmuCoreMemRegionIsWriteIgnored(PPSPCOREINT pThis, uint64_t uAddr)
+{
+    PCPSPCOREMEMREGION pMemRegion = NULL;
+
+    if (pspEmuCoreCpIsSctrlMmuEnabled(pThis))
+    {
+        PPSPCOREMMUMAP pMmuMap = pThis->pMmuMappingsHead;
+        while (   pMmuMap
+               && pMmuMap->PspAddrVStart <= uAddr)
+        {
+            if (uAddr < pMmuMap->PspAddrVStart + pMmuMap->cbRegion)
+            {
+                pMemRegion = pMmuMap->pMemRegion;
+                break;
+            }
+            pMmuMap = pMmuMap->pNext;
+        }
+    }
+    else
+        pMemRegion = pspEmuCoreMemRegionFindByAddr(pThis, (PSPADDR)uAddr, NULL /*ppPrevRegion*/);
+
+    return    pMemRegion
+           && !pMemRegion->fMmio
+           && (pMemRegion->u.Ram.fProt & PSPEMU_CORE_MEM_REGION_PROT_F_WRITE_IGNORE);
+}
+
+
 /**
  * Callback for invalid memory accesses so the MMU can map in regions lazily.
  *
@@ -2373,10 +2471,22 @@ static bool pspEmuCoreMemMemInvAccess(uc_engine *pUcEngine, uc_mem_type enmMemTy
     printf("pspEmuCoreMemMemInvAccess: enmMemType=%#x uAddr=%#llx cbAcc=%u i64Val=%#llx\n",
            enmMemType, uAddr, cbAcc, i64Val);
 #endif
+    /* Reporting the write as handled makes unicorn drop it as the region is mapped read only. */
+    if (   enmMemType == UC_MEM_WRITE_PROT
+        && pspEmuCoreMemRegionIsWriteIgnored(pThis, uAddr))
+    {
+        PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_WARNING, PSPTRACEEVTORIGIN_CORE,
+                                "Write to read only memory at %#llx cbAcc=%u i64Val=%#llx -> IGNORED",
+                                uAddr, cbAcc, i64Val);
+        return true;
+    }
+
     if (pspEmuCoreCpIsSctrlMmuEnabled(pThis))
     {
         bool fHandled;
+        PSPEmuPerfEnter(PSPPERFSUBSYS_MMU);
         int rc = pspEmuCoreMmuMap(pThis, uAddr, &fHandled);
+        PSPEmuPerfLeave();
         if (   !rc
             && fHandled)
             return true;
@@ -2472,14 +2582,23 @@ static int pspEmuCoreExcpHandle(PPSPCOREINT pThis, PSPADDR PspAddrPc, bool fThum
     {
         /* Handle any SVC injections before passing control to any supervisor code. */
         bool fSwitchToSvc = true;
+        PSPEmuPerfEnter(PSPPERFSUBSYS_SVC);
         rc = pspEmuCoreSvcBefore(pThis, PspAddrPc, fThumb, &fSwitchToSvc);
+        PSPEmuPerfLeave();
         if (STS_SUCCESS(rc))
         {
-            if (fSwitchToSvc) /** @todo Set temporary breakpoint to call SVC injection handlers afterwards. */
+            if (fSwitchToSvc)
+            {
                 rc = pspEmuCoreExcpInject(pThis, PSPCOREMODE_SVC, 0x2, PspAddrPc, false /*fUseMVBar*/);
+                if (   STS_SUCCESS(rc)
+                    && pspEmuCoreSvcAfterIsRequired(pThis, pThis->idxSvc))
+                    rc = pspEmuCoreSvcAfterArm(pThis, PspAddrPc, pThis->idxSvc);
+            }
             else
             {
-                pspEmuCoreSvcAfter(pThis);
+                PSPEmuPerfEnter(PSPPERFSUBSYS_SVC);
+                pspEmuCoreSvcAfter(pThis, pThis->idxSvc);
+                PSPEmuPerfLeave();
 
                 /* Return to the caller. */
                 PspAddrPc |= fThumb ? 1 : 0;
@@ -2491,14 +2610,18 @@ static int pspEmuCoreExcpHandle(PPSPCOREINT pThis, PSPADDR PspAddrPc, bool fThum
     {
         /* Handle any SMC injections before passing control to any monitor code. */
         bool fSwitchToSmc = true;
+        PSPEmuPerfEnter(PSPPERFSUBSYS_SVC);
         rc = pspEmuCoreSmcBefore(pThis, PspAddrPc, fThumb, &fSwitchToSmc);
+        PSPEmuPerfLeave();
         if (STS_SUCCESS(rc))
         {
             if (fSwitchToSmc) /** @todo Set temporary breakpoint to call SVC injection handlers afterwards. */
                 rc = pspEmuCoreExcpInject(pThis, PSPCOREMODE_MON, 0x2, PspAddrPc, true /*fUseMVBar*/);
             else
             {
+                PSPEmuPerfEnter(PSPPERFSUBSYS_SVC);
                 pspEmuCoreSmcAfter(pThis);
+                PSPEmuPerfLeave();
 
                 /* Return to the caller. */
                 PspAddrPc |= fThumb ? 1 : 0;
@@ -2509,8 +2632,15 @@ static int pspEmuCoreExcpHandle(PPSPCOREINT pThis, PSPADDR PspAddrPc, bool fThum
     else if (pThis->enmExcpPending == PSPCOREEXCP_IRQ)
     {
         PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_CORE, "IRQ exception");
+        pThis->fIrq = false;
         rc = pspEmuCoreExcpInject(pThis, PSPCOREMODE_IRQ, 0x6, PspAddrPc + 4, false /*fUseMVBar*/);
     }
+    else if (pThis->enmExcpPending == PSPCOREEXCP_FIQ)
+    {
+        PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_CORE, "FIQ exception");
+        pThis->fFiq = false;
+        rc = pspEmuCoreExcpInject(pThis, PSPCOREMODE_FIQ, 0x7, PspAddrPc + 4, false /*fUseMVBar*/);
+    }
 
     pThis->enmExcpPending = PSPCOREEXCP_NONE;
     return rc;
@@ -2530,50 +2660,34 @@ static int pspEmuCoreExcpHandle(PPSPCOREINT pThis, PSPADDR PspAddrPc, bool fThum
 static int pspEmuCoreIrqFiqCheck(PPSPCOREINT pThis, PSPADDR PspAddrPc, bool fThumb, bool fIrq, bool fFirq)
 {
     int rc = STS_INF_SUCCESS;
-    uint32_t uCpsrOld = 0;
-    uc_err rcUc = uc_reg_read(pThis->pUcEngine, UC_ARM_REG_CPSR, &uCpsrOld);
+    uint32_t uCpsr = 0;
+    uc_err rcUc = uc_reg_read(pThis->pUcEngine, UC_ARM_REG_CPSR, &uCpsr);
     if (rcUc == UC_ERR_OK)
     {
-        /*
-         * If we have an interrupt and the corresponding source is masked
-         * we have to single step through the code to find out when it gets enabled.
-         */
-        if (   (   fFirq
-                && (uCpsrOld & (1 << 6)))
-            || (   fIrq
-                && (uCpsrOld & (1 << 7))))
-        {
-            PspAddrPc |= fThumb ? 1 : 0;
-            pThis->PspAddrExecNext = PspAddrPc;
-
-            rc = pspEmuCoreExecSingleStepUntilIrqEnabled(pThis, fFirq, fIrq);
-            if (!rc)
-            {
-                size_t ucCpuMode = 0;
-
-                /* Query new PC and new mode value. */
-                rcUc = uc_reg_read(pThis->pUcEngine, UC_ARM_REG_PC, &PspAddrPc);
-                if (rcUc == UC_ERR_OK)
-                    rcUc = uc_query(pThis->pUcEngine, UC_QUERY_MODE, &ucCpuMode);
+        pThis->fIrq = fIrq;
+        pThis->fFiq = fFirq;
 
-                fThumb = ucCpuMode == UC_MODE_THUMB ? true : false;
-                if (rcUc != UC_ERR_OK)
-                    rc = pspEmuCoreErrConvertFromUcErr(rcUc);
-            }
+        /* Continue with the appropriate exception handler if the source is not masked. */
+        if (   fFirq
+            && !(uCpsr & BIT(6)))
+        {
+            pThis->fFiq = false;
+            rc = pspEmuCoreExcpInject(pThis, PSPCOREMODE_FIQ, 0x7, PspAddrPc + 4, false /*fUseMVBar*/);
         }
-
-        if (!rc)
+        else if (   fIrq
+                 && !(uCpsr & BIT(7)))
         {
-            /* Continue with the appropriate exception handler. */
-            if (fFirq)
-                rc = pspEmuCoreExcpInject(pThis, PSPCOREMODE_FIQ, 0x7, PspAddrPc, false /*fUseMVBar*/);
-            else if (fIrq)
-                rc = pspEmuCoreExcpInject(pThis, PSPCOREMODE_IRQ, 0x6, PspAddrPc + 4, false /*fUseMVBar*/);
-            else
-            {
-                PspAddrPc |= fThumb ? 1 : 0;
-                pThis->PspAddrExecNext = PspAddrPc;
-            }
+            pThis->fIrq = false;
+            rc = pspEmuCoreExcpInject(pThis, PSPCOREMODE_IRQ, 0x6, PspAddrPc + 4, false /*fUseMVBar*/);
+        }
+        else
+        {
+            /*
+             * The pending sources are masked (or there is nothing pending), continue executing and
+             * let the CPSR write hook deliver the interrupt as soon as the code unmasks the source.
+             */
+            PspAddrPc |= fThumb ? 1 : 0;
+            pThis->PspAddrExecNext = PspAddrPc;
         }
     }
     else
@@ -2589,6 +2703,38 @@ const char *PSPEmuCoreModeToStr(PSPCOREMODE enmCoreMode)
 }
 
 
+/**
+ * Initializes the halt state synchronization primitives.
+ *
+ * @returns Status code.
+ * @param   pThis               The PSP emulation core instance.
+ */
+static int pspEmuCoreHaltInit(PPSPCOREINT pThis)
+{
+    pthread_condattr_t CondAttr;
+
+    int rcPsx = pthread_mutex_init(&pThis->HaltMtx, NULL);
+    if (!rcPsx)
+    {
+        /* The wait deadline is calculated from the monotonic clock so host time adjustments don't affect us. */
+        rcPsx = pthread_condattr_init(&CondAttr);
+        if (!rcPsx)
+        {
+            rcPsx = pthread_condattr_setclock(&CondAttr, CLOCK_MONOTONIC);
+            if (!rcPsx)
+                rcPsx = pthread_cond_init(&pThis->HaltCond, &CondAttr);
+            pthread_condattr_destroy(&CondAttr);
+            if (!rcPsx)
+                return STS_INF_SUCCESS;
+        }
+
+        pthread_mutex_destroy(&pThis->HaltMtx);
+    }
+
+    return STS_ERR_GENERAL_ERROR;
+}
+
+
 int PSPEmuCoreCreate(PPSPCORE phCore)
 {
     int rc = 0;
@@ -2605,7 +2751,6 @@ int PSPEmuCoreCreate(PPSPCORE phCore)
         pThis->fExecStop             = false;
         pThis->enmCoreMode           = PSPCOREMODE_SVC;
         pThis->enmExcpPending        = PSPCOREEXCP_NONE;
-        pThis->hUcHookSvcAfter       = 0;
         pThis->hUcHookCpWrite        = 0;
         pThis->hUcHookCpRead         = 0;
         pThis->fMmuChanged           = false;
@@ -2614,12 +2759,14 @@ int PSPEmuCoreCreate(PPSPCORE phCore)
         pThis->pMmuMappingsHead      = NULL;
         pThis->pMmuPgTblTrackingHead = NULL;
         pThis->Cp15.u32RegScr        = 0;
+        pThis->fHaltWakeup           = false;
         memset(&pThis->Cp15.aBankedRegs[0], 0, sizeof(pThis->Cp15.aBankedRegs));
 
         /* Initialize unicorn engine in ARM mode. */
         err = uc_open(UC_ARCH_ARM, UC_MODE_ARM | UC_MODE_ARM_NO_MMU, &pThis->pUcEngine);
         if (!err)
         {
+            rc = pspEmuCoreHaltInit(pThis);
             if (!rc)
             {
                 err = uc_hook_add(pThis->pUcEngine, &pThis->pUcHookIntr, UC_HOOK_INTR, (void *)(uintptr_t)pspEmuCoreExcpWrapper, pThis, 1, 0);
@@ -2648,6 +2795,9 @@ int PSPEmuCoreCreate(PPSPCORE phCore)
                         pThis->pUcCtxReset = NULL;
                     }
                 }
+
+                pthread_cond_destroy(&pThis->HaltCond);
+                pthread_mutex_destroy(&pThis->HaltMtx);
             }
 
             uc_close(pThis->pUcEngine);
@@ -2670,6 +2820,9 @@ void PSPEmuCoreDestroy(PSPCORE hCore)
 {
     PPSPCOREINT pThis = hCore;
 
+    /* The core is destroyed on the thread which executed it, release the disassembler state used for dumping it. */
+    PSPEmuDisasmThreadTerm();
+
     /* Unmap all memory regions. */
     PPSPCOREMEMREGION pMemCur = pThis->pMemRegionsHead;
     while (pMemCur)
@@ -2694,7 +2847,18 @@ void PSPEmuCoreDestroy(PSPCORE hCore)
         free(pFree);
     }
 
+    for (uint32_t i = 0; i < ELEMENTS(pThis->aSvcRet); i++)
+    {
+        if (pThis->aSvcRet[i].PspAddrRet)
+        {
+            uc_err rcUc = uc_hook_del(pThis->pUcEngine, pThis->aSvcRet[i].hUcHook);
+            /** @todo assert(rcUc == UC_ERR_OK) */
+        }
+    }
+
     pThis->pMemRegionsHead = NULL;
+    pthread_cond_destroy(&pThis->HaltCond);
+    pthread_mutex_destroy(&pThis->HaltMtx);
     uc_free(pThis->pUcCtxReset);
     uc_close(pThis->pUcEngine);
     free(pThis);
@@ -2770,7 +2934,7 @@ int PSPEmuCoreMemRead(PSPCORE hCore, PSPADDR AddrPspRead, void *pvDst, size_t cb
             else
             {
                 /** @todo Handle ourselves. */
-                uc_err rcUc = uc_mem_read(pThis->pUcEngine, AddrPspRead, pbDst, cbDst);
+                uc_err rcUc = uc_mem_read(pThis->pUcEngine, AddrPspRead, pbDst, cbThisRead);
                 if (rcUc != UC_ERR_OK)
                     rc = pspEmuCoreErrConvertFromUcErr(rcUc);
             }
@@ -2786,6 +2950,24 @@ int PSPEmuCoreMemRead(PSPCORE hCore, PSPADDR AddrPspRead, void *pvDst, size_t cb
     return rc;
 }
 
+int PSPEmuCoreMemQueryBacking(PSPCORE hCore, PSPADDR AddrPsp, void **ppv, size_t *pcbAvail)
+{
+    PPSPCOREINT pThis = hCore;
+
+    PPSPCOREMEMREGION pRegion = pspEmuCoreMemRegionFindByAddr(pThis, AddrPsp, NULL /*ppPrev*/);
+    if (   pRegion
+        && !pRegion->fMmio)
+    {
+        PSPADDR offStart = AddrPsp - pRegion->PspAddrStart;
+
+        *ppv      = (uint8_t *)pRegion->u.Ram.pvBacking + offStart;
+        *pcbAvail = pRegion->cbRegion - offStart;
+        return STS_INF_SUCCESS;
+    }
+
+    return STS_ERR_NOT_FOUND;
+}
+
 int PSPEmuCoreMemWriteVirt(PSPCORE hCore, PSPVADDR AddrPspVWrite, const void *pvData, size_t cbData)
 {
     PPSPCOREINT pThis = hCore;
@@ -2805,7 +2987,7 @@ int PSPEmuCoreMemWriteVirt(PSPCORE hCore, PSPVADDR AddrPspVWrite, const void *pv
             if (STS_SUCCESS(rc))
             {
                 cbThisWrite = MIN(cbThisWrite, cbData);
-                rc = PSPEmuCoreMemRead(hCore, PspPAddr, pbSrc, cbThisWrite);
+                rc = PSPEmuCoreMemWrite(hCore, PspPAddr, pbSrc, cbThisWrite);
 
                 pbSrc         += cbThisWrite;
                 cbData        -= cbThisWrite;
@@ -3008,7 +3190,9 @@ int PSPEmuCoreExecRun(PSPCORE hCore, uint32_t fFlags, uint32_t cInsnExec, uint32
     while (!rc && cInsnExec && msExec && !pThis->fExecStop)
     {
         uint64_t usUcExec = msExec == PSPEMU_CORE_EXEC_INDEFINITE ? 0 : (uint64_t)msExec * 1000;
+        PSPEmuPerfEnter(PSPPERFSUBSYS_CORE_EXEC);
         uc_err rcUc = uc_emu_start(pThis->pUcEngine, pThis->PspAddrExecNext, 0xffffffff, usUcExec, fSingleStep ? 1 : cInsnExec);
+        PSPEmuPerfLeave();
         if (rcUc == UC_ERR_OK)
         {
             cInsnExec--; /* Executed at least one instruction. */
@@ -3042,34 +3226,40 @@ int PSPEmuCoreExecRun(PSPCORE hCore, uint32_t fFlags, uint32_t cInsnExec, uint32
                         pThis->fMmuChanged = false;
                     }
                 }
-                else if (pspEmuCoreInsnIsWfi(pThis, uPc, fThumb))
-                {
-                    if (pThis->pfnWfiReached)
-                    {
-                        bool fIrq = false;
-                        bool fFirq = false;
-                        rc = pThis->pfnWfiReached(pThis, uPc, 0 /*fFlags*/, &fIrq, &fFirq, pThis->pvWfiUser);
-                        if (   STS_SUCCESS(rc)
-                            && (   fIrq
-                                || fFirq))
-                            rc = pspEmuCoreIrqFiqCheck(pThis, uPc, fThumb, fIrq, fFirq);
-                        else if (STS_FAILURE(rc)) /* Break out of execution loop. */
-                            break;
-                    }
-                    else
-                    {
-                        rc = PSPEMU_INF_CORE_INSN_WFI_REACHED;
-                        break;
-                    }
-                }
                 else if (fCont)
                 {
                     /*
                      * Unicorn doesn't use the CPSR Thumb state bit but switches to the instruction set
                      * based on bit 0 of the address (like for a blx instruction for instance).
                      */
-                    uPc |= fThumb ? 1 : 0;
-                    pThis->PspAddrExecNext = (PSPADDR)uPc;
+                    pThis->PspAddrExecNext = (PSPADDR)(uPc | (fThumb ? 1 : 0));
+
+                    /*
+                     * Unicorn halts emulation on a WFI without telling us through any hook, so only check
+                     * for it if the slice ended without any other known reason.
+                     */
+                    if (   !pThis->fExecStop
+                        && pspEmuCoreInsnIsWfi(pThis, uPc, fThumb))
+                    {
+                        if (pThis->pfnWfiReached)
+                        {
+                            bool fIrq = false;
+                            bool fFirq = false;
+                            rc = pThis->pfnWfiReached(pThis, uPc, 0 /*fFlags*/, &fIrq, &fFirq, pThis->pvWfiUser);
+                            if (   STS_SUCCESS(rc)
+                                && (   fIrq
+                                    || fFirq))
+                                rc = pspEmuCoreIrqFiqCheck(pThis, uPc, fThumb, fIrq, fFirq);
+                            else if (STS_FAILURE(rc)) /* Break out of execution loop. */
+                                break;
+                        }
+                        else
+                        {
+                            /* Let the caller put the core to sleep, execution resumes after the WFI. */
+                            rc = PSPEMU_INF_CORE_INSN_WFI_REACHED;
+                            break;
+                        }
+                    }
                 }
             }
             else
@@ -3121,9 +3311,72 @@ int PSPEmuCoreExecStop(PSPCORE hCore)
 
     pThis->fExecStop = true;
     int rcUc = uc_emu_stop(pThis->pUcEngine);
+
+    /* Kick the core out of the halted state as well. */
+    pthread_mutex_lock(&pThis->HaltMtx);
+    pthread_cond_broadcast(&pThis->HaltCond);
+    pthread_mutex_unlock(&pThis->HaltMtx);
     return pspEmuCoreErrConvertFromUcErr(rcUc);
 }
 
+int PSPEmuCoreHaltWait(PSPCORE hCore, uint32_t msTimeout)
+{
+    PPSPCOREINT pThis = hCore;
+    int rc = STS_INF_SUCCESS;
+
+    if (pThis->pfnHalt)
+        pThis->pfnHalt(pThis, pThis->pvHaltUser);
+
+    struct timespec TpDeadline;
+    clock_gettime(CLOCK_MONOTONIC, &TpDeadline);
+    if (msTimeout != PSPEMU_CORE_EXEC_INDEFINITE)
+    {
+        TpDeadline.tv_sec  += msTimeout / 1000;
+        TpDeadline.tv_nsec += (msTimeout % 1000) * 1000000;
+        if (TpDeadline.tv_nsec >= 1000000000)
+        {
+            TpDeadline.tv_sec++;
+            TpDeadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_mutex_lock(&pThis->HaltMtx);
+    while (   !pThis->fHaltWakeup
+           && !pThis->fExecStop)
+    {
+        int rcPsx = 0;
+
+        if (msTimeout == PSPEMU_CORE_EXEC_INDEFINITE)
+            rcPsx = pthread_cond_wait(&pThis->HaltCond, &pThis->HaltMtx);
+        else
+            rcPsx = pthread_cond_timedwait(&pThis->HaltCond, &pThis->HaltMtx, &TpDeadline);
+
+        if (rcPsx == ETIMEDOUT)
+        {
+            rc = PSPEMU_INF_CORE_HALT_TIMEOUT;
+            break;
+        }
+    }
+    if (   !pThis->fHaltWakeup
+        && pThis->fExecStop)
+        rc = PSPEMU_INF_CORE_HALT_STOPPED;
+    pThis->fHaltWakeup = false;
+    pthread_mutex_unlock(&pThis->HaltMtx);
+
+    return rc;
+}
+
+int PSPEmuCoreHaltWakeup(PSPCORE hCore)
+{
+    PPSPCOREINT pThis = hCore;
+
+    pthread_mutex_lock(&pThis->HaltMtx);
+    pThis->fHaltWakeup = true;
+    pthread_cond_broadcast(&pThis->HaltCond);
+    pthread_mutex_unlock(&pThis->HaltMtx);
+    return STS_INF_SUCCESS;
+}
+
 int PSPEmuCoreExecReset(PSPCORE hCore)
 {
     PPSPCOREINT pThis = hCore;
@@ -3300,6 +3553,23 @@ int PSPEmuCoreWfiSet(PSPCORE hCore, PFNPSPCOREWFI pfnWfiReached, void *pvUser)
     return rc;
 }
 
+int PSPEmuCoreHaltNotifySet(PSPCORE hCore, PFNPSPCOREHALT pfnHalt, void *pvUser)
+{
+    PPSPCOREINT pThis = hCore;
+    int rc = 0;
+
+    /* Only allow one callback for now. */
+    if (!pThis->pfnHalt)
+    {
+        pThis->pfnHalt    = pfnHalt;
+        pThis->pvHaltUser = pvUser;
+    }
+    else
+        rc = -1;
+
+    return rc;
+}
+
 void PSPEmuCoreStateDump(PSPCORE hCore, uint32_t fFlags, uint32_t cInsns)
 {
     PPSPCOREINT pThis = hCore;
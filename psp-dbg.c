@@ -31,6 +31,8 @@
 #include <netdb.h>
 
 #include <poll.h>
+#include <pthread.h>
+#include <time.h>
 #include <sys/ioctl.h>
 
 #include <libgdbstub.h>
@@ -44,10 +46,42 @@
 #include <psp-trace.h>
 
 
+/** Number of milliseconds an unselected CCD executes before its worker checks whether it should stop. */
+#define PSP_DBG_CCD_WORKER_SLICE_MS 100
+
+
 /** Pointer to the debugger instance data. */
 typedef struct PSPDBGINT *PPSPDBGINT;
 
 
+/**
+ * Host thread executing an unselected CCD.
+ */
+typedef struct PSPDBGCCDWORKER
+{
+    /** The CCD handle. */
+    PSPCCD                  hCcd;
+    /** The PSP core of the CCD. */
+    PSPCORE                 hPspCore;
+    /** The tracer of the CCD, NULL if tracing is disabled. */
+    PSPTRACE                hTrace;
+    /** The worker thread handle. */
+    pthread_t               hThrd;
+    /** Flag whether the worker thread was started. */
+    bool                    fActive;
+    /** Flag whether the worker thread should stop, accessed atomically. */
+    bool                    fStop;
+    /** Mutex protecting fExited. */
+    pthread_mutex_t         Mtx;
+    /** Condition signalled when the worker thread stopped executing code. */
+    pthread_cond_t          CondExited;
+    /** Flag whether the worker thread stopped executing code. */
+    bool                    fExited;
+} PSPDBGCCDWORKER;
+/** Pointer to a CCD worker. */
+typedef PSPDBGCCDWORKER *PPSPDBGCCDWORKER;
+
+
 /**
  * A coverage tracer instance.
  */
@@ -132,6 +166,10 @@ typedef struct PSPDBGINT
     uint32_t                cCcds;
     /** Currently selected CCD. */
     uint32_t                idxCcd;
+    /** Flag whether the unselected CCDs keep running while the selected one is stopped (non-stop mode). */
+    bool                    fNonStop;
+    /** Array of worker threads executing the unselected CCDs, indexed like the CCD array. */
+    PPSPDBGCCDWORKER        paCcdWorkers;
     /** Array of CCDs assigned to this debugger - variable in syize. */
     PSPCCD                  ahCcds[1];
 } PSPDBGINT;
@@ -239,6 +277,192 @@ static PSPCCD pspEmuDbgGetCcdFromSelectedCcd(PPSPDBGINT pThis)
 }
 
 
+/**
+ * Returns the I/O manager handle from the currently selected CCD.
+ *
+ * @returns Handle to the I/O manager.
+ * @param   pThis                   The PSP debugger instance.
+ */
+static PSPIOM pspEmuDbgGetIoMgrFromSelectedCcd(PPSPDBGINT pThis)
+{
+    PSPIOM hIoMgr = NULL;
+
+    int rc = PSPEmuCcdQueryIoMgr(pThis->ahCcds[pThis->idxCcd], &hIoMgr);
+    /** @todo assert(rc) */
+    return hIoMgr;
+}
+
+
+/**
+ * Transfers memory between the debugger and the selected CCD using the virtual address space of the core.
+ *
+ * @returns Status code.
+ * @param   pThis                   The PSP debugger instance.
+ * @param   PspVAddr                The virtual address to start the transfer at.
+ * @param   pvBuf                   The buffer to read into or write from.
+ * @param   cbXfer                  Number of bytes to transfer.
+ * @param   fWrite                  Flag whether to write to the guest memory.
+ *
+ * @note RAM is accessed directly through the backing buffers a page at a time, everything else
+ *       goes through the I/O manager instead of unicorn.
+ */
+static int pspEmuDbgMemXfer(PPSPDBGINT pThis, PSPVADDR PspVAddr, void *pvBuf, size_t cbXfer, bool fWrite)
+{
+    PSPCORE hPspCore = pspEmuDbgGetPspCoreFromSelectedCcd(pThis);
+    PSPIOM hIoMgr = pspEmuDbgGetIoMgrFromSelectedCcd(pThis);
+    uint8_t *pbBuf = (uint8_t *)pvBuf;
+    int rc = STS_INF_SUCCESS;
+
+    while (   cbXfer
+           && STS_SUCCESS(rc))
+    {
+        size_t cbThisXfer = MIN(cbXfer, _4K - (PspVAddr & (_4K - 1)));
+        PSPPADDR PspPAddr = 0;
+
+        rc = PSPEmuCoreQueryPAddrFromVAddr(hPspCore, PspVAddr, &PspPAddr, NULL /*penmPgTblWalk*/);
+        if (STS_SUCCESS(rc))
+        {
+            void *pvBacking = NULL;
+            size_t cbAvail = 0;
+
+            rc = PSPEmuIoMgrPspAddrQueryBacking(hIoMgr, PspPAddr, &pvBacking, &cbAvail);
+            if (STS_SUCCESS(rc))
+            {
+                cbThisXfer = MIN(cbThisXfer, cbAvail);
+                if (fWrite)
+                    memcpy(pvBacking, pbBuf, cbThisXfer);
+                else
+                    memcpy(pbBuf, pvBacking, cbThisXfer);
+            }
+            else if (fWrite)
+                rc = PSPEmuIoMgrPspAddrWrite(hIoMgr, PspPAddr, pbBuf, cbThisXfer);
+            else
+                rc = PSPEmuIoMgrPspAddrRead(hIoMgr, PspPAddr, pbBuf, cbThisXfer);
+        }
+
+        PspVAddr += cbThisXfer;
+        pbBuf    += cbThisXfer;
+        cbXfer   -= cbThisXfer;
+    }
+
+    return rc;
+}
+
+
+/**
+ * Worker thread executing an unselected CCD.
+ *
+ * @returns Opaque return value.
+ * @param   pvUser                  The CCD worker.
+ */
+static void *pspEmuDbgCcdWorker(void *pvUser)
+{
+    PPSPDBGCCDWORKER pWorker = (PPSPDBGCCDWORKER)pvUser;
+    int rc = PSPEmuTraceSetDefault(pWorker->hTrace);
+
+    while (   STS_SUCCESS(rc)
+           && !__atomic_load_n(&pWorker->fStop, __ATOMIC_ACQUIRE))
+    {
+        rc = PSPEmuCoreExecRun(pWorker->hPspCore, PSPEMU_CORE_EXEC_F_DEFAULT, 0, PSP_DBG_CCD_WORKER_SLICE_MS);
+        if (rc == PSPEMU_INF_CORE_INSN_WFI_REACHED)
+        {
+            rc = PSPEmuCoreHaltWait(pWorker->hPspCore, PSPEMU_CORE_HALT_WAIT_MS);
+            if (   rc == PSPEMU_INF_CORE_HALT_TIMEOUT
+                || rc == PSPEMU_INF_CORE_HALT_STOPPED)
+                rc = STS_INF_SUCCESS;
+        }
+    }
+
+    if (STS_FAILURE(rc))
+    {
+        printf("Unselected CCD stopped executing with %d\n", rc);
+        PSPEmuCoreStateDump(pWorker->hPspCore, PSPEMU_CORE_STATE_DUMP_F_DEFAULT, 0 /*cInsns*/);
+    }
+
+    pthread_mutex_lock(&pWorker->Mtx);
+    pWorker->fExited = true;
+    pthread_cond_signal(&pWorker->CondExited);
+    pthread_mutex_unlock(&pWorker->Mtx);
+    return NULL;
+}
+
+
+/**
+ * Starts or stops the worker threads for the unselected CCDs.
+ *
+ * @returns nothing.
+ * @param   pThis                   The PSP debugger instance.
+ * @param   fRun                    Flag whether the unselected CCDs should execute, the selected CCD
+ *                                  is always executed by the debugger runloop.
+ */
+static void pspEmuDbgCcdWorkersSync(PPSPDBGINT pThis, bool fRun)
+{
+    for (uint32_t i = 0; i < pThis->cCcds; i++)
+    {
+        PPSPDBGCCDWORKER pWorker = &pThis->paCcdWorkers[i];
+        bool fRunThis = fRun && i != pThis->idxCcd;
+
+        if (   fRunThis
+            && !pWorker->fActive)
+        {
+            pWorker->fStop   = false;
+            pWorker->fExited = false;
+            int rcPsx = pthread_create(&pWorker->hThrd, NULL, pspEmuDbgCcdWorker, pWorker);
+            if (!rcPsx)
+                pWorker->fActive = true;
+            else
+                printf("Starting the worker for CCD %u failed with %d\n", i, rcPsx);
+        }
+        else if (   !fRunThis
+                 && pWorker->fActive)
+        {
+            /*
+             * The core resets the stop request when it enters the runloop, so kick it again
+             * if the worker didn't exit within the halt wait period.
+             */
+            __atomic_store_n(&pWorker->fStop, true, __ATOMIC_RELEASE);
+            pthread_mutex_lock(&pWorker->Mtx);
+            while (!pWorker->fExited)
+            {
+                struct timespec TsDeadline;
+
+                PSPEmuCoreExecStop(pWorker->hPspCore);
+                clock_gettime(CLOCK_REALTIME, &TsDeadline);
+                TsDeadline.tv_nsec += PSPEMU_CORE_HALT_WAIT_MS * 1000000L;
+                if (TsDeadline.tv_nsec >= 1000000000L)
+                {
+                    TsDeadline.tv_sec++;
+                    TsDeadline.tv_nsec -= 1000000000L;
+                }
+                pthread_cond_timedwait(&pWorker->CondExited, &pWorker->Mtx, &TsDeadline);
+            }
+            pthread_mutex_unlock(&pWorker->Mtx);
+
+            pthread_join(pWorker->hThrd, NULL);
+            pWorker->fActive = false;
+        }
+    }
+}
+
+
+/**
+ * Frees the worker array of the given debugger instance, the workers must be stopped.
+ *
+ * @returns nothing.
+ * @param   pThis                   The PSP debugger instance.
+ */
+static void pspEmuDbgCcdWorkersFree(PPSPDBGINT pThis)
+{
+    for (uint32_t i = 0; i < pThis->cCcds; i++)
+    {
+        pthread_cond_destroy(&pThis->paCcdWorkers[i].CondExited);
+        pthread_mutex_destroy(&pThis->paCcdWorkers[i].Mtx);
+    }
+
+    free(pThis->paCcdWorkers);
+}
+
+
 /**
  * Creates a new trace point and links it into the list.
  *
@@ -936,6 +1160,184 @@ static int gdbStubCmdTraceMarker(GDBSTUBCTX hGdbStubCtx, PCGDBSTUBOUTHLP pHlp, c
 }
 
 
+/**
+ * @copydoc{GDBSTUBCMD,pfnCmd}
+ */
+static int gdbStubCmdTraceFilter(GDBSTUBCTX hGdbStubCtx, PCGDBSTUBOUTHLP pHlp, const char *pszArgs, void *pvUser)
+{
+    PPSPDBGINT pThis = (PPSPDBGINT)pvUser;
+    PSPCCD  hCcd = pspEmuDbgGetCcdFromSelectedCcd(pThis);
+    PSPIOM hIoMgr = NULL;
+
+    int rc = PSPEmuCcdQueryIoMgr(hCcd, &hIoMgr);
+    if (rc)
+        return pspEmuDbgErrConvertToGdbStubErr(rc);
+
+    rc = PSPEmuTraceFilterSet(NULL, pszArgs);
+    if (STS_SUCCESS(rc))
+        rc = PSPEmuIoMgrTraceFilterChanged(hIoMgr); /* Directly mapped regions must go through the filter now. */
+    if (STS_FAILURE(rc))
+        pHlp->pfnPrintf(pHlp, "Setting the trace filter failed with %d\n", rc);
+    else if (pszArgs && *pszArgs != '\0')
+        pHlp->pfnPrintf(pHlp, "Trace filter set\n");
+    else
+        pHlp->pfnPrintf(pHlp, "Trace filter removed\n");
+    return GDBSTUB_INF_SUCCESS;
+}
+
+
+/**
+ * A single region entry collected for the iostats command.
+ */
+typedef struct PSPDBGIOSTATSENTRY
+{
+    /** The address space the region is in. */
+    PSPIOMADDRSPACE             enmAddrSpace;
+    /** Start address of the region. */
+    uint64_t                    u64AddrStart;
+    /** Size of the region, 0 for unassigned accesses. */
+    size_t                      cbRegion;
+    /** The region description. */
+    const char                  *pszDesc;
+    /** Copy of the access statistics. */
+    PSPIOMSTATS                 Stats;
+} PSPDBGIOSTATSENTRY;
+/** Pointer to a collected region entry. */
+typedef PSPDBGIOSTATSENTRY *PPSPDBGIOSTATSENTRY;
+/** Pointer to a const collected region entry. */
+typedef const PSPDBGIOSTATSENTRY *PCPSPDBGIOSTATSENTRY;
+
+
+/**
+ * State for collecting the region statistics.
+ */
+typedef struct PSPDBGIOSTATSCOLLECT
+{
+    /** Number of entries collected. */
+    uint32_t                    cEntries;
+    /** Maximum number of entries the array can hold. */
+    uint32_t                    cEntriesMax;
+    /** Array of collected entries. */
+    PPSPDBGIOSTATSENTRY         paEntries;
+} PSPDBGIOSTATSCOLLECT;
+/** Pointer to the region statistics collection state. */
+typedef PSPDBGIOSTATSCOLLECT *PPSPDBGIOSTATSCOLLECT;
+
+
+/**
+ * @copydoc{FNPSPIOMSTATSENUM}
+ */
+static int pspEmuDbgIoStatsCollect(PSPIOMADDRSPACE enmAddrSpace, uint64_t u64AddrStart, size_t cbRegion, const char *pszDesc,
+                                   PCPSPIOMSTATS pStats, void *pvUser)
+{
+    PPSPDBGIOSTATSCOLLECT pCollect = (PPSPDBGIOSTATSCOLLECT)pvUser;
+
+    if (   !pStats->cReads
+        && !pStats->cWrites)
+        return STS_INF_SUCCESS;
+
+    if (pCollect->cEntries == pCollect->cEntriesMax)
+    {
+        uint32_t cEntriesMaxNew = pCollect->cEntriesMax ? pCollect->cEntriesMax * 2 : 32;
+        PPSPDBGIOSTATSENTRY paEntriesNew = (PPSPDBGIOSTATSENTRY)realloc(pCollect->paEntries,
+                                                                        cEntriesMaxNew * sizeof(*paEntriesNew));
+        if (!paEntriesNew)
+            return STS_ERR_NO_MEMORY;
+
+        pCollect->paEntries   = paEntriesNew;
+        pCollect->cEntriesMax = cEntriesMaxNew;
+    }
+
+    PPSPDBGIOSTATSENTRY pEntry = &pCollect->paEntries[pCollect->cEntries++];
+    pEntry->enmAddrSpace = enmAddrSpace;
+    pEntry->u64AddrStart = u64AddrStart;
+    pEntry->cbRegion     = cbRegion;
+    pEntry->pszDesc      = pszDesc;
+    pEntry->Stats        = *pStats;
+    return STS_INF_SUCCESS;
+}
+
+
+/**
+ * Sorts the collected region entries by the host time spent in the handlers, most expensive first.
+ */
+static int pspEmuDbgIoStatsCmp(const void *pv1, const void *pv2)
+{
+    PCPSPDBGIOSTATSENTRY pEntry1 = (PCPSPDBGIOSTATSENTRY)pv1;
+    PCPSPDBGIOSTATSENTRY pEntry2 = (PCPSPDBGIOSTATSENTRY)pv2;
+    uint64_t cNs1 = pEntry1->Stats.cNsRead + pEntry1->Stats.cNsWrite;
+    uint64_t cNs2 = pEntry2->Stats.cNsRead + pEntry2->Stats.cNsWrite;
+
+    return cNs1 < cNs2 ? 1 : cNs1 > cNs2 ? -1 : 0;
+}
+
+
+/**
+ * @copydoc{GDBSTUBCMD,pfnCmd}
+ */
+static int gdbStubCmdIoStats(GDBSTUBCTX hGdbStubCtx, PCGDBSTUBOUTHLP pHlp, const char *pszArgs, void *pvUser)
+{
+    PPSPDBGINT pThis = (PPSPDBGINT)pvUser;
+    PSPCCD  hCcd = pspEmuDbgGetCcdFromSelectedCcd(pThis);
+    PSPIOM hIoMgr = NULL;
+
+    int rc = PSPEmuCcdQueryIoMgr(hCcd, &hIoMgr);
+    if (rc)
+        return pspEmuDbgErrConvertToGdbStubErr(rc);
+
+    if (   pszArgs
+        && !strcmp(pszArgs, "reset"))
+    {
+        PSPEmuIoMgrStatsReset(hIoMgr);
+        return GDBSTUB_INF_SUCCESS;
+    }
+    else if (   pszArgs
+             && (   !strcmp(pszArgs, "on")
+                 || !strcmp(pszArgs, "off")))
+    {
+        PSPEmuIoMgrStatsEnable(hIoMgr, !strcmp(pszArgs, "on"));
+        return GDBSTUB_INF_SUCCESS;
+    }
+    else if (   pszArgs
+             && *pszArgs != '\0')
+    {
+        pHlp->pfnPrintf(pHlp, "Invalid argument \"%s\", only \"on\", \"off\" and \"reset\" are supported\n", pszArgs);
+        return GDBSTUB_INF_SUCCESS;
+    }
+
+    PSPDBGIOSTATSCOLLECT Collect = { 0, 0, NULL };
+    rc = PSPEmuIoMgrStatsEnum(hIoMgr, pspEmuDbgIoStatsCollect, &Collect);
+    if (STS_SUCCESS(rc))
+    {
+        qsort(Collect.paEntries, Collect.cEntries, sizeof(*Collect.paEntries), pspEmuDbgIoStatsCmp);
+
+        pHlp->pfnPrintf(pHlp, "Space Address            Size       Reads        Writes       Bytes read   Bytes written ns read        ns write       Description\n");
+        for (uint32_t i = 0; i < Collect.cEntries; i++)
+        {
+            PCPSPDBGIOSTATSENTRY pEntry = &Collect.paEntries[i];
+            pHlp->pfnPrintf(pHlp, "%-5s 0x%016llx %#-10zx %-12llu %-12llu %-12llu %-13llu %-14llu %-14llu %s\n",
+                              pEntry->enmAddrSpace == PSPIOMADDRSPACE_PSP
+                            ? "MMIO"
+                            : pEntry->enmAddrSpace == PSPIOMADDRSPACE_SMN
+                            ? "SMN"
+                            : "X86",
+                            (unsigned long long)pEntry->u64AddrStart, pEntry->cbRegion,
+                            (unsigned long long)pEntry->Stats.cReads, (unsigned long long)pEntry->Stats.cWrites,
+                            (unsigned long long)pEntry->Stats.cbRead, (unsigned long long)pEntry->Stats.cbWritten,
+                            (unsigned long long)pEntry->Stats.cNsRead, (unsigned long long)pEntry->Stats.cNsWrite,
+                            pEntry->pszDesc);
+        }
+    }
+    else
+        pHlp->pfnPrintf(pHlp, "Collecting the I/O statistics failed with %d\n", rc);
+
+    if (Collect.paEntries)
+        free(Collect.paEntries);
+
+    return GDBSTUB_INF_SUCCESS;
+}
+
+
 /**
  * @copydoc{GDBSTUBCMD,pfnCmd}
  */
@@ -1064,6 +1466,73 @@ static int gdbStubCmdSingleStep(GDBSTUBCTX hGdbStubCtx, PCGDBSTUBOUTHLP pHlp, co
 }
 
 
+/**
+ * @copydoc{GDBSTUBCMD,pfnCmd}
+ */
+static int gdbStubCmdCcd(GDBSTUBCTX hGdbStubCtx, PCGDBSTUBOUTHLP pHlp, const char *pszArgs, void *pvUser)
+{
+    PPSPDBGINT pThis = (PPSPDBGINT)pvUser;
+
+    if (   pszArgs
+        && *pszArgs != '\0')
+    {
+        char *pszEnd = NULL;
+        uint32_t idxCcd = strtoul(pszArgs, &pszEnd, 10);
+        if (   pszEnd != pszArgs
+            && *pszEnd == '\0'
+            && idxCcd < pThis->cCcds)
+        {
+            /* Take over the CCD from its worker, the previously selected one gets its own worker if required. */
+            pThis->idxCcd = idxCcd;
+            pspEmuDbgCcdWorkersSync(pThis, pThis->fNonStop);
+            PSPEmuTraceSetDefault(pThis->paCcdWorkers[idxCcd].hTrace);
+            pHlp->pfnPrintf(pHlp, "Selected CCD %u\n", idxCcd);
+        }
+        else
+            pHlp->pfnPrintf(pHlp, "Argument must be a CCD index below %u, given: %s\n", pThis->cCcds, pszArgs);
+    }
+    else
+    {
+        pHlp->pfnPrintf(pHlp, "Current CCD: %u\n", pThis->idxCcd);
+        for (uint32_t i = 0; i < pThis->cCcds; i++)
+            pHlp->pfnPrintf(pHlp, "%c %u: %s\n", i == pThis->idxCcd ? '*' : ' ', i,
+                              i == pThis->idxCcd
+                            ? "selected"
+                            : pThis->paCcdWorkers[i].fActive
+                            ? "running"
+                            : "stopped");
+    }
+
+    return GDBSTUB_INF_SUCCESS;
+}
+
+
+/**
+ * @copydoc{GDBSTUBCMD,pfnCmd}
+ */
+static int gdbStubCmdCcdMode(GDBSTUBCTX hGdbStubCtx, PCGDBSTUBOUTHLP pHlp, const char *pszArgs, void *pvUser)
+{
+    PPSPDBGINT pThis = (PPSPDBGINT)pvUser;
+
+    if (pszArgs)
+    {
+        if (!strcmp(pszArgs, "allstop"))
+            pThis->fNonStop = false;
+        else if (!strcmp(pszArgs, "nonstop"))
+            pThis->fNonStop = true;
+        else
+            pHlp->pfnPrintf(pHlp, "Argument must be either \"allstop\" or \"nonstop\", given: %s\n", pszArgs);
+
+        /* The selected CCD is stopped when executing commands. */
+        pspEmuDbgCcdWorkersSync(pThis, pThis->fNonStop);
+    }
+    else
+        pHlp->pfnPrintf(pHlp, "%s\n", pThis->fNonStop ? "nonstop" : "allstop");
+
+    return GDBSTUB_INF_SUCCESS;
+}
+
+
 /**
  * @copydoc{GDBSTUBCMD,pfnCmd}
  */
@@ -1108,11 +1577,15 @@ static const GDBSTUBCMD g_aGdbCmds[] =
     { "covtracedel",  "Delete a coverage tracer, arguments: <id>",                                                       gdbStubCmdCovTraceDel          },
     { "va2pa",        "Resolves the given virtual address to a physical one",                                            gdbStubCmdQueryPAddrFromVAddr  },
     { "tracemarker",  "Dumps the marker given as a string to the trace log",                                             gdbStubCmdTraceMarker          },
+    { "tracefilter",  "Sets the trace filter for device accesses (see --trace-filter), no arguments removes it",         gdbStubCmdTraceFilter          },
     { "corestate",    "Dumps the core state to the trace log",                                                           gdbStubCmdDumpCoreState        },
     { "x86mapslot",   "Dumps the x86 mapslot info to the trace log, arguments: <idx start> <idx end>",                   gdbStubCmdDumpX86MapSlotState  },
     { "smnmapslot",   "Dumps the SMN mapslot info to the trace log, arguments: <idx start> <idx end>",                   gdbStubCmdDumpSmnMapSlotState  },
+    { "iostats",      "Shows the per region I/O access statistics sorted by host time, arguments: [on|off|reset]",       gdbStubCmdIoStats              },
     { "singlestep",   "Single steps through the code dumping the core state after each instruction, arguments: on|off",  gdbStubCmdSingleStep           },
     { "insnstepcnt",  "Sets the instruction step count for one debug runloop round, US AT OWN RISK!",                    gdbStubCmdInsnStepCnt          },
+    { "ccd",          "Shows the current CCD and lists all or selects the one to debug, arguments: [idx]",              gdbStubCmdCcd                  },
+    { "ccdmode",      "Sets whether unselected CCDs stop with the selected one, arguments: allstop|nonstop",             gdbStubCmdCcdMode              },
     { NULL,           NULL,                                                                                              NULL                           }
 };
 
@@ -1201,6 +1674,8 @@ static int pspDbgGdbStubIfTgtStep(GDBSTUBCTX hGdbStubCtx, void *pvUser)
     pThis->fSingleStep = true;
     int rc = PSPEmuCoreExecRun(hPspCore, pThis->fCoreExecRun, 1, PSPEMU_CORE_EXEC_INDEFINITE);
     pThis->fSingleStep = false;
+    if (rc == PSPEMU_INF_CORE_INSN_WFI_REACHED) /* Stepping over a WFI completes it. */
+        rc = 0;
     return pspEmuDbgErrConvertToGdbStubErr(rc);
 }
 
@@ -1223,9 +1698,8 @@ static int pspDbgGdbStubIfTgtCont(GDBSTUBCTX hGdbStubCtx, void *pvUser)
 static int pspDbgGdbStubIfTgtMemRead(GDBSTUBCTX hGdbStubCtx, void *pvUser, GDBTGTMEMADDR GdbTgtMemAddr, void *pvDst, size_t cbRead)
 {
     PPSPDBGINT pThis = (PPSPDBGINT)pvUser;
-    PSPCORE hPspCore = pspEmuDbgGetPspCoreFromSelectedCcd(pThis);
 
-    int rc = PSPEmuCoreMemReadVirt(hPspCore, (PSPVADDR)GdbTgtMemAddr, pvDst, cbRead);
+    int rc = pspEmuDbgMemXfer(pThis, (PSPVADDR)GdbTgtMemAddr, pvDst, cbRead, false /*fWrite*/);
     return pspEmuDbgErrConvertToGdbStubErr(rc);
 }
 
@@ -1236,9 +1710,8 @@ static int pspDbgGdbStubIfTgtMemRead(GDBSTUBCTX hGdbStubCtx, void *pvUser, GDBTG
 static int pspDbgGdbStubIfTgtMemWrite(GDBSTUBCTX hGdbStubCtx, void *pvUser, GDBTGTMEMADDR GdbTgtMemAddr, const void *pvSrc, size_t cbWrite)
 {
     PPSPDBGINT pThis = (PPSPDBGINT)pvUser;
-    PSPCORE hPspCore = pspEmuDbgGetPspCoreFromSelectedCcd(pThis);
 
-    int rc = PSPEmuCoreMemWriteVirt(hPspCore, (PSPVADDR)GdbTgtMemAddr, pvSrc, cbWrite);
+    int rc = pspEmuDbgMemXfer(pThis, (PSPVADDR)GdbTgtMemAddr, (void *)pvSrc, cbWrite, true /*fWrite*/);
     return pspEmuDbgErrConvertToGdbStubErr(rc);
 }
 
@@ -1253,8 +1726,20 @@ static int pspDbgGdbStubIfTgtRegsRead(GDBSTUBCTX hGdbStubCtx, void *pvUser, uint
 
     int rc = 0;
     uint32_t *pau32RegVals = (uint32_t *)pvDst;
-    for (uint32_t i = 0; i < cRegs && !rc; i++)
-        rc = PSPEmuCoreQueryReg(hPspCore, (PSPCOREREG)(paRegs[i] + 1), &pau32RegVals[i]);
+    PSPCOREREG aenmRegs[PSPCOREREG_LAST];
+
+    if (cRegs <= ELEMENTS(aenmRegs))
+    {
+        /* Query everything at once, GDB usually asks for the whole register set. */
+        for (uint32_t i = 0; i < cRegs; i++)
+            aenmRegs[i] = (PSPCOREREG)(paRegs[i] + 1);
+        rc = PSPEmuCoreQueryRegBatch(hPspCore, &aenmRegs[0], cRegs, pau32RegVals);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < cRegs && !rc; i++)
+            rc = PSPEmuCoreQueryReg(hPspCore, (PSPCOREREG)(paRegs[i] + 1), &pau32RegVals[i]);
+    }
 
     return pspEmuDbgErrConvertToGdbStubErr(rc);
 }
@@ -1608,6 +2093,14 @@ static int pspEmuDbgRunloopCoreRunning(PPSPDBGINT pThis)
          *      through the code when the debugger is enabled.
          */
         rc = PSPEmuCoreExecRun(hPspCore, pThis->fCoreExecRun, pThis->cInsnsStep != 0 ? pThis->cInsnsStep : 1, PSPEMU_CORE_EXEC_INDEFINITE);
+        if (rc == PSPEMU_INF_CORE_INSN_WFI_REACHED)
+        {
+            /* Sleep for a bit instead of spinning on the WFI, GDB is polled afterwards so it can still interrupt us. */
+            rc = PSPEmuCoreHaltWait(hPspCore, PSPEMU_CORE_HALT_WAIT_MS);
+            if (   rc == PSPEMU_INF_CORE_HALT_TIMEOUT
+                || rc == PSPEMU_INF_CORE_HALT_STOPPED)
+                rc = 0;
+        }
         if (!rc)
         {
             int rcPsx = poll(&PollFd, 1, 0);
@@ -1648,8 +2141,34 @@ int PSPEmuDbgCreate(PPSPDBG phDbg, uint16_t uPort, uint32_t cInsnsStep, PSPADDR
         pThis->idxCcd           = 0;
         pThis->idCovNext        = 0;
         pThis->PspAddrRunUpTo   = PspAddrRunUpTo;
-        for (uint32_t i = 0; i < cCcds; i++)
+        pThis->fNonStop         = false;
+        pThis->paCcdWorkers     = (PPSPDBGCCDWORKER)calloc(cCcds, sizeof(*pThis->paCcdWorkers));
+        if (!pThis->paCcdWorkers)
+        {
+            free(pThis);
+            return -1;
+        }
+
+        for (uint32_t i = 0; i < cCcds && !rc; i++)
+        {
             pThis->ahCcds[i] = pahCcds[i];
+            pThis->paCcdWorkers[i].hCcd = pahCcds[i];
+            rc = PSPEmuCcdQueryCore(pahCcds[i], &pThis->paCcdWorkers[i].hPspCore);
+            if (!rc)
+                rc = PSPEmuCcdQueryTrace(pahCcds[i], &pThis->paCcdWorkers[i].hTrace);
+        }
+        if (rc)
+        {
+            free(pThis->paCcdWorkers);
+            free(pThis);
+            return rc;
+        }
+
+        for (uint32_t i = 0; i < cCcds; i++)
+        {
+            pthread_mutex_init(&pThis->paCcdWorkers[i].Mtx, NULL);
+            pthread_cond_init(&pThis->paCcdWorkers[i].CondExited, NULL);
+        }
 
         int rcGdbStub = GDBStubCtxCreate(&pThis->hGdbStubCtx, &g_PspDbgGdbStubIoIf, &g_PspDbgGdbStubIf, pThis);
         if (rcGdbStub == GDBSTUB_INF_SUCCESS)
@@ -1685,6 +2204,7 @@ int PSPEmuDbgCreate(PPSPDBG phDbg, uint16_t uPort, uint32_t cInsnsStep, PSPADDR
         else
             rc = pspEmuDbgErrConvertFromGdbStubErr(rcGdbStub);
 
+        pspEmuDbgCcdWorkersFree(pThis);
         free(pThis);
     }
     else
@@ -1698,6 +2218,8 @@ int PSPEmuDbgDestroy(PSPDBG hDbg)
 {
     PPSPDBGINT pThis = hDbg;
 
+    pspEmuDbgCcdWorkersSync(pThis, false /*fRun*/);
+    pspEmuDbgCcdWorkersFree(pThis);
     if (pThis->hDbgHlp)
         PSPEmuDbgHlpRelease(pThis->hDbgHlp);
     if (pThis->iFdGdbCon != 0)
@@ -1714,6 +2236,9 @@ int PSPEmuDbgRunloop(PSPDBG hDbg)
     int rc = 0;
     PPSPDBGINT pThis = hDbg;
 
+    /* The selected CCD is executed by this thread, so trace to its tracer by default. */
+    PSPEmuTraceSetDefault(pThis->paCcdWorkers[pThis->idxCcd].hTrace);
+
     /* We are supposed to be running up to a specified point insert a single shot trace point
      * and a excercise the running runloop until the trace point is hit.
      */
@@ -1726,7 +2251,17 @@ int PSPEmuDbgRunloop(PSPDBG hDbg)
         PSPEmuCoreTraceRegister(hPspCore, pThis->PspAddrRunUpTo, pThis->PspAddrRunUpTo,
                                 PSPEMU_CORE_TRACE_F_EXEC, pspDbgTpBpHit, pTp);
         pThis->fCoreRunning = true;
+        pspEmuDbgCcdWorkersSync(pThis, true /*fRun*/);
         rc = PSPEmuCoreExecRun(hPspCore, pThis->fCoreExecRun, 0, PSPEMU_CORE_EXEC_INDEFINITE);
+        while (rc == PSPEMU_INF_CORE_INSN_WFI_REACHED)
+        {
+            rc = PSPEmuCoreHaltWait(hPspCore, PSPEMU_CORE_HALT_WAIT_MS);
+            if (rc == PSPEMU_INF_CORE_HALT_STOPPED)
+                rc = 0;
+            else if (   !rc
+                     || rc == PSPEMU_INF_CORE_HALT_TIMEOUT)
+                rc = PSPEmuCoreExecRun(hPspCore, pThis->fCoreExecRun, 0, PSPEMU_CORE_EXEC_INDEFINITE);
+        }
         pThis->fCoreRunning = false;
     }
 
@@ -1737,6 +2272,9 @@ int PSPEmuDbgRunloop(PSPDBG hDbg)
                && pThis->iFdGdbCon == 0)
             rc = pspEmuDbgWaitForGdbConnection(pThis);
 
+        /* The unselected CCDs stop with the selected one unless in non-stop mode. */
+        pspEmuDbgCcdWorkersSync(pThis, pThis->fCoreRunning || pThis->fNonStop);
+
         if (!pThis->fCoreRunning)
             rc = pspEmuDbgRunloopCoreNotRunning(pThis);
         else
@@ -23,14 +23,35 @@
 /** @page pg_dev_ccp_v5   CCPv5 - Cryptographic Co-Processor version 5
  *
  * @todo Write something here.
+ *
+ * @section sec_dev_ccp_v5_async    Asynchronous request processing
+ *
+ * By default requests are processed synchronously on the emulation thread when the guest polls the
+ * control register after starting a queue (see pspDevCcpMmioQueueRegRead() for the reason why it isn't
+ * done in the write handler). When enabled in the config every queue gets a host worker thread instead
+ * which processes the descriptors in the background while the PSP core continues executing. The control,
+ * tail, status and interrupt status registers are only updated by the worker once the request results
+ * were written and the guest polling the control register synchronizes with the worker through
+ * acquire/release semantics so it will always see the complete results once the halt bit is set.
+ *
+ * Neither the I/O manager nor the PSP core are thread safe, so the worker must not call into them while
+ * the emulation thread executes guest code. A batch is only handed to the worker if the descriptors and
+ * all local memory the requests reference live in the directly backed SRAM, which is looked up on the
+ * emulation thread when the queue is started (see pspDevCcpQueueAsyncCheck()). The worker then accesses
+ * the SRAM through the host mapping only and doesn't create trace events. Anything else, like requests
+ * accessing MMIO or going through the CCP proxy, is processed synchronously on the emulation thread.
+ * The queue mutex is held while a batch gets processed, so both never run at the same time.
  */
 
 
 /*********************************************************************************************************************************
 *   Header Files                                                                                                                 *
 *********************************************************************************************************************************/
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include <openssl/bn.h>
 #include <openssl/evp.h>
@@ -40,6 +61,12 @@
 # if OPENSSL_VERSION_NUMBER < 0x10100000 // = OpenSSL 1.1.0
 #  define EVP_MD_CTX_new EVP_MD_CTX_create
 #  define EVP_MD_CTX_free EVP_MD_CTX_destroy
+#  define EVP_CIPHER_CTX_iv(a_pCtx) ((a_pCtx)->iv)
+# endif
+/* EVP_CIPHER_CTX_get_updated_iv() only exists since OpenSSL 3.0 which deprecated EVP_CIPHER_CTX_iv(). */
+# if OPENSSL_VERSION_NUMBER < 0x30000000 // = OpenSSL 3.0.0
+#  define EVP_CIPHER_CTX_get_updated_iv(a_pCtx, a_pvBuf, a_cbBuf) \
+    (memcpy((a_pvBuf), EVP_CIPHER_CTX_iv(a_pCtx), (a_cbBuf)) != NULL)
 # endif
 
 #include <zlib.h>
@@ -50,12 +77,83 @@
 # endif
 
 #include <common/cdefs.h>
+#include <common/status.h>
 #include <psp/ccp.h>
 
 #include <psp-devs.h>
 #include <psp-trace.h>
 
 
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+
+#ifndef CCP_V5_Q_REG_INT_ENABLE
+/** Queue interrupt enable register offset. */
+# define CCP_V5_Q_REG_INT_ENABLE                0x0c
+#endif
+#ifndef CCP_V5_Q_REG_INT_STATUS
+/** Queue interrupt status register offset (write 1 to clear). */
+# define CCP_V5_Q_REG_INT_STATUS                0x10
+#endif
+/** Interrupt status: The queue completed all requests successfully. */
+#define CCP_V5_Q_REG_INT_F_COMPLETION           BIT(0)
+/** Interrupt status: A request failed. */
+#define CCP_V5_Q_REG_INT_F_ERROR                BIT(1)
+/** Interrupt status: The queue stopped (halted). */
+#define CCP_V5_Q_REG_INT_F_QUEUE_STOPPED        BIT(2)
+/** Interrupt status: The queue is empty. */
+#define CCP_V5_Q_REG_INT_F_QUEUE_EMPTY          BIT(3)
+
+/*
+ * The XTS-AES and DES3 function fields share the layout of the AES function field
+ * (size/unit size, encrypt, mode, type) according to the Linux kernel.
+ */
+#ifndef CCP_V5_ENGINE_XTS_UNIT_SZ_GET
+# define CCP_V5_ENGINE_XTS_UNIT_SZ_GET(a_Func)  CCP_V5_ENGINE_AES_SZ_GET(a_Func)
+# define CCP_V5_ENGINE_XTS_ENCRYPT_GET(a_Func)  CCP_V5_ENGINE_AES_ENCRYPT_GET(a_Func)
+/** XTS data unit sizes. */
+# define CCP_V5_ENGINE_XTS_UNIT_SZ_16           0
+# define CCP_V5_ENGINE_XTS_UNIT_SZ_512          1
+# define CCP_V5_ENGINE_XTS_UNIT_SZ_1024         2
+# define CCP_V5_ENGINE_XTS_UNIT_SZ_2048         3
+# define CCP_V5_ENGINE_XTS_UNIT_SZ_4096         4
+#endif
+#ifndef CCP_V5_ENGINE_DES3_MODE_GET
+# define CCP_V5_ENGINE_DES3_ENCRYPT_GET(a_Func) CCP_V5_ENGINE_AES_ENCRYPT_GET(a_Func)
+# define CCP_V5_ENGINE_DES3_MODE_GET(a_Func)    CCP_V5_ENGINE_AES_MODE_GET(a_Func)
+# define CCP_V5_ENGINE_DES3_TYPE_GET(a_Func)    CCP_V5_ENGINE_AES_TYPE_GET(a_Func)
+/** DES3 modes. */
+# define CCP_V5_ENGINE_DES3_MODE_ECB            0
+# define CCP_V5_ENGINE_DES3_MODE_CBC            1
+# define CCP_V5_ENGINE_DES3_MODE_CFB            2
+/** DES3 type (the only one there is). */
+# define CCP_V5_ENGINE_DES3_TYPE_168            1
+#endif
+#ifndef CCP_V5_ENGINE_ECC_FUNC_GET
+/** Returns the ECC function from the function field (size:10, type:2, mode:3 in the Linux kernel). */
+# define CCP_V5_ENGINE_ECC_FUNC_GET(a_Func)     (((a_Func) >> 12) & 0x7)
+/** ECC functions. */
+# define CCP_V5_ENGINE_ECC_FUNC_MMUL_384BIT     0
+# define CCP_V5_ENGINE_ECC_FUNC_MADD_384BIT     1
+# define CCP_V5_ENGINE_ECC_FUNC_MINV_384BIT     2
+# define CCP_V5_ENGINE_ECC_FUNC_PADD_384BIT     3
+# define CCP_V5_ENGINE_ECC_FUNC_PMUL_384BIT     4
+# define CCP_V5_ENGINE_ECC_FUNC_PDBL_384BIT     5
+#endif
+
+/** Size of a single ECC operand in bytes. */
+#define CCP_V5_ECC_OPERAND_SZ                   64
+/** Maximum number of ECC operands for a request (point addition). */
+#define CCP_V5_ECC_OPERAND_CNT_MAX              7
+/** Maximum modulus size supported by the ECC engine in bytes (384bit). */
+#define CCP_V5_ECC_MODULUS_SZ_MAX               48
+/** Offset of the ECC result status in the output. */
+#define CCP_V5_ECC_RESULT_OFF                   60
+/** ECC result status: Success. */
+#define CCP_V5_ECC_RESULT_F_SUCCESS             BIT(0)
+
+
 /*********************************************************************************************************************************
 *   Structures and Typedefs                                                                                                      *
 *********************************************************************************************************************************/
@@ -79,6 +177,28 @@ typedef struct CCPQUEUE
     uint32_t                        u32RegReqHead;
     /** Request status register. */
     uint32_t                        u32RegSts;
+    /** Interrupt enable register. */
+    uint32_t                        u32RegIntEn;
+    /** Interrupt status register. */
+    uint32_t                        u32RegIntSts;
+    /** The owning CCP device instance. */
+    struct PSPDEVCCP                *pCcp;
+    /** Flag whether the queue is processed by a worker thread. */
+    bool                            fWorker;
+    /** Flag whether the worker was kicked to process requests, protected by Mtx. */
+    bool                            fKick;
+    /** Flag whether the worker should terminate, protected by Mtx. */
+    bool                            fShutdown;
+    /** Host mapping of the SRAM the kicked batch is restricted to, protected by Mtx. */
+    void                            *pvSramKick;
+    /** Size of the SRAM the kicked batch is restricted to, protected by Mtx. */
+    size_t                          cbSramKick;
+    /** The worker thread handle. */
+    pthread_t                       hThrdWorker;
+    /** Mutex protecting the worker state, held while a batch of requests gets processed. */
+    pthread_mutex_t                 Mtx;
+    /** Condition variable to kick the worker. */
+    pthread_cond_t                  CondKick;
 } CCPQUEUE;
 /** Pointer to a single CCP queue. */
 typedef CCPQUEUE *PCCPQUEUE;
@@ -131,12 +251,22 @@ typedef struct PSPDEVCCP
      * so the code will only every process one SHA operation at a time.
      */
     EVP_MD_CTX                      *pOsslShaCtx;
-    /** The openssl AES context currently in use, same note as above applies. */
+    /** The openssl AES/DES3 context currently in use, same note as above applies. */
     EVP_CIPHER_CTX                  *pOsslAesCtx;
+    /** The cipher the context was initialized with. */
+    const EVP_CIPHER                *pOsslEvpCipherCtx;
+    /** Flag whether the context was initialized for encryption. */
+    bool                            fEncryptCtx;
+    /** The key the context was initialized with (openssl format). */
+    uint8_t                         abKeyCtx[EVP_MAX_KEY_LENGTH];
     /** The zlib decompression state. */
     z_stream                        Zlib;
-    /** Size of the last transfer in bytes (written to local PSP memory). */
+    /** Size of the last transfer in bytes (written to local PSP memory), updated atomically by the queue worker. */
     size_t                          cbWrittenLast;
+    /** The SRAM accessed directly by the queue worker while processing a batch, NULL on the emulation thread. */
+    uint8_t                         *pbSram;
+    /** Size of the SRAM accessed directly by the queue worker. */
+    size_t                          cbSram;
 } PSPDEVCCP;
 /** Pointer to the device instance data. */
 typedef PSPDEVCCP *PPSPDEVCCP;
@@ -168,11 +298,66 @@ typedef struct CCPXFERCTX
 typedef CCPXFERCTX *PCCPXFERCTX;
 
 
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+
+/** Flag whether the current thread is a queue worker. */
+static __thread bool g_fCcpWorkerThread = false;
+
+
 /*********************************************************************************************************************************
 *   Internal Functions                                                                                                           *
 *********************************************************************************************************************************/
 
 
+/**
+ * Adds a string to the default tracer, the queue workers print warnings and errors to the console instead
+ * because creating a trace event queries the state of the PSP core running on the emulation thread.
+ *
+ * @returns Status code.
+ * @param   hTrace                  The trace handle, NULL means default.
+ * @param   enmSeverity             The severity of the event.
+ * @param   enmEvtOrigin            The origin of the event.
+ * @param   pszFmt                  The format string to log.
+ * @param   ...                     Arguments for the format string.
+ */
+static int pspDevCcpTraceEvtAddStr(PSPTRACE hTrace, PSPTRACEEVTSEVERITY enmSeverity, PSPTRACEEVTORIGIN enmEvtOrigin,
+                                   const char *pszFmt, ...)
+{
+    int rc = 0;
+    va_list hArgs;
+
+    va_start(hArgs, pszFmt);
+    if (!g_fCcpWorkerThread)
+        rc = PSPEmuTraceEvtAddStringV(hTrace, enmSeverity, enmEvtOrigin, pszFmt, hArgs);
+    else if (enmSeverity >= PSPTRACEEVTSEVERITY_WARNING)
+    {
+        printf("CCP: ");
+        vprintf(pszFmt, hArgs);
+        printf("\n");
+    }
+    va_end(hArgs);
+
+    return rc;
+}
+
+
+/**
+ * Checks whether the given range lies completely within the SRAM of the given size.
+ *
+ * @returns Flag whether the range is inside the SRAM.
+ * @param   cbSram              Size of the SRAM starting at address 0.
+ * @param   CcpAddr             Start address of the range.
+ * @param   cb                  Size of the range in bytes.
+ */
+static inline bool pspDevCcpSramRangeIsValid(size_t cbSram, CCPADDR CcpAddr, size_t cb)
+{
+    return    CcpAddr < cbSram
+           && cb <= cbSram - CcpAddr;
+}
+
+
 /**
  * Transfer data from system memory to a local buffer.
  *
@@ -266,7 +451,19 @@ static int pspDevCcpXferMemLsbWrite(PPSPDEVCCP pThis, CCPADDR CcpAddr, const voi
  */
 static int pspDevCcpXferMemLocalRead(PPSPDEVCCP pThis, CCPADDR CcpAddr, void *pvDst, size_t cbRead)
 {
-    return PSPEmuIoMgrPspAddrRead(pThis->pDev->hIoMgr, (uint32_t)CcpAddr, pvDst, cbRead);
+    if (!pThis->pbSram)
+        return PSPEmuIoMgrPspAddrRead(pThis->pDev->hIoMgr, (uint32_t)CcpAddr, pvDst, cbRead);
+
+    /* Running on the queue worker, restricted to the SRAM. */
+    if (!pspDevCcpSramRangeIsValid(pThis->cbSram, CcpAddr, cbRead))
+    {
+        printf("CCP: Read outside of the SRAM from the queue worker CcpAddr=%#llx cbRead=%zu\n",
+               (unsigned long long)CcpAddr, cbRead);
+        return -1;
+    }
+
+    memcpy(pvDst, pThis->pbSram + CcpAddr, cbRead);
+    return 0;
 }
 
 
@@ -281,9 +478,21 @@ static int pspDevCcpXferMemLocalRead(PPSPDEVCCP pThis, CCPADDR CcpAddr, void *pv
  */
 static int pspDevCcpXferMemLocalWrite(PPSPDEVCCP pThis, CCPADDR CcpAddr, const void *pvSrc, size_t cbWrite)
 {
-    int rc = PSPEmuIoMgrPspAddrWrite(pThis->pDev->hIoMgr, (uint32_t)CcpAddr, pvSrc, cbWrite);
+    int rc = 0;
+
+    if (!pThis->pbSram)
+        rc = PSPEmuIoMgrPspAddrWrite(pThis->pDev->hIoMgr, (uint32_t)CcpAddr, pvSrc, cbWrite);
+    else if (pspDevCcpSramRangeIsValid(pThis->cbSram, CcpAddr, cbWrite))
+        memcpy(pThis->pbSram + CcpAddr, pvSrc, cbWrite);
+    else
+    {
+        printf("CCP: Write outside of the SRAM from the queue worker CcpAddr=%#llx cbWrite=%zu\n",
+               (unsigned long long)CcpAddr, cbWrite);
+        rc = -1;
+    }
+
     if (!rc)
-        pThis->cbWrittenLast += cbWrite;
+        __atomic_add_fetch(&pThis->cbWrittenLast, cbWrite, __ATOMIC_RELEASE);
 
     return rc;
 }
@@ -303,7 +512,7 @@ static int pspDevCcpXferMemLocalWrite(PPSPDEVCCP pThis, CCPADDR CcpAddr, const v
 static int pspDevCcpXferCtxInit(PCCPXFERCTX pCtx, PPSPDEVCCP pThis, PCCCP5REQ pReq, bool fSha, size_t cbWrite,
                                 bool fWriteRev)
 {
-    pThis->cbWrittenLast = 0;
+    __atomic_store_n(&pThis->cbWrittenLast, 0, __ATOMIC_RELEASE);
 
     pCtx->pThis      = pThis;
     pCtx->CcpAddrSrc = CCP_ADDR_CREATE_FROM_HI_LO(pReq->u16AddrSrcHigh, pReq->u32AddrSrcLow);
@@ -451,6 +660,117 @@ static int pspDevCcpXferCtxWrite(PCCPXFERCTX pCtx, const void *pvSrc, size_t cbW
 }
 
 
+/**
+ * Queries the host memory backing the given local PSP address.
+ *
+ * @returns Status code.
+ * @param   pThis               The CCP device instance data.
+ * @param   CcpAddr             The local PSP address to query.
+ * @param   ppv                 Where to store the host pointer on success.
+ * @param   pcbAvail            Where to store the number of bytes accessible through the pointer on success.
+ */
+static int pspDevCcpLocalQueryBacking(PPSPDEVCCP pThis, CCPADDR CcpAddr, void **ppv, size_t *pcbAvail)
+{
+    if (!pThis->pbSram)
+        return PSPEmuIoMgrPspAddrQueryBacking(pThis->pDev->hIoMgr, (PSPADDR)CcpAddr, ppv, pcbAvail);
+
+    if (CcpAddr >= pThis->cbSram)
+        return STS_ERR_NOT_FOUND;
+
+    *ppv      = pThis->pbSram + CcpAddr;
+    *pcbAvail = pThis->cbSram - CcpAddr;
+    return STS_INF_SUCCESS;
+}
+
+
+/**
+ * Queries a host pointer to access the current source of the given transfer context directly.
+ *
+ * @returns Flag whether the source can be accessed directly.
+ * @param   pCtx                The transfer context to use.
+ * @param   ppvSrc              Where to store the host pointer on success.
+ * @param   pcbSrc              Where to store the number of bytes which can be read directly on success.
+ */
+static bool pspDevCcpXferCtxQuerySrcDirect(PCCPXFERCTX pCtx, const void **ppvSrc, size_t *pcbSrc)
+{
+    if (   pCtx->pfnRead == pspDevCcpXferMemLocalRead
+        && pCtx->cbReadLeft)
+    {
+        void *pv = NULL;
+        size_t cbAvail = 0;
+        int rc = pspDevCcpLocalQueryBacking(pCtx->pThis, pCtx->CcpAddrSrc, &pv, &cbAvail);
+        if (   STS_SUCCESS(rc)
+            && cbAvail)
+        {
+            *ppvSrc = pv;
+            *pcbSrc = MIN(cbAvail, pCtx->cbReadLeft);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ * Advances the source of the given transfer context after data was read directly.
+ *
+ * @returns nothing.
+ * @param   pCtx                The transfer context to use.
+ * @param   cbRead              Number of bytes read directly.
+ */
+static void pspDevCcpXferCtxSrcAdvance(PCCPXFERCTX pCtx, size_t cbRead)
+{
+    pCtx->cbReadLeft -= cbRead;
+    pCtx->CcpAddrSrc += cbRead;
+}
+
+
+/**
+ * Queries a host pointer to access the current destination of the given transfer context directly.
+ *
+ * @returns Flag whether the destination can be accessed directly.
+ * @param   pCtx                The transfer context to use.
+ * @param   ppvDst              Where to store the host pointer on success.
+ * @param   pcbDst              Where to store the number of bytes which can be written directly on success.
+ */
+static bool pspDevCcpXferCtxQueryDstDirect(PCCPXFERCTX pCtx, void **ppvDst, size_t *pcbDst)
+{
+    if (   pCtx->pfnWrite == pspDevCcpXferMemLocalWrite
+        && !pCtx->fWriteRev
+        && pCtx->cbWriteLeft)
+    {
+        void *pv = NULL;
+        size_t cbAvail = 0;
+        int rc = pspDevCcpLocalQueryBacking(pCtx->pThis, pCtx->CcpAddrDst, &pv, &cbAvail);
+        if (   STS_SUCCESS(rc)
+            && cbAvail)
+        {
+            *ppvDst = pv;
+            *pcbDst = MIN(cbAvail, pCtx->cbWriteLeft);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ * Advances the destination of the given transfer context after data was written directly.
+ *
+ * @returns nothing.
+ * @param   pCtx                The transfer context to use.
+ * @param   cbWritten           Number of bytes written directly.
+ */
+static void pspDevCcpXferCtxDstAdvance(PCCPXFERCTX pCtx, size_t cbWritten)
+{
+    pCtx->cbWriteLeft          -= cbWritten;
+    pCtx->CcpAddrDst           += cbWritten;
+    __atomic_add_fetch(&pCtx->pThis->cbWrittenLast, cbWritten, __ATOMIC_RELEASE);
+}
+
+
 /**
  * Reverses the data in the given buffer.
  *
@@ -528,6 +848,29 @@ static int pspDevCcpCopyFromLsb(PPSPDEVCCP pThis, CCPADDR CcpAddrLsb, size_t cb,
 }
 
 
+/**
+ * Copies data from the supplied buffer into an LSB.
+ *
+ * @returns Status code.
+ * @param   pThis               The CCP device instance data.
+ * @param   CcpAddrLsb          CCP LSB address to copy to.
+ * @param   cb                  Amount of bytes to copy.
+ * @param   pv                  The data to copy.
+ */
+static int pspDevCcpCopyToLsb(PPSPDEVCCP pThis, CCPADDR CcpAddrLsb, size_t cb, const void *pv)
+{
+    int rc = 0;
+
+    if (   CcpAddrLsb < sizeof(pThis->Lsb)
+        && CcpAddrLsb + cb <= sizeof(pThis->Lsb))
+        memcpy(&pThis->Lsb.u.abLsb[CcpAddrLsb], pv, cb);
+    else
+        rc = -1;
+
+    return rc;
+}
+
+
 /**
  * Returns the string representation of the given CCP request engine field.
  *
@@ -777,7 +1120,7 @@ static void pspDevCcpDumpReq(PCCCP5REQ pReq, PSPADDR PspAddrReq)
                                                                 pReq->u32Dw0, pszEngine);
 
     if (uEngine != CCP_V5_ENGINE_SHA)
-        PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_CCP,
+        pspDevCcpTraceEvtAddStr(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_CCP,
                                 "CCP Request 0x%08x:\n"
                                 "    %s\n"
                                 "    cbSrc:              %u\n"
@@ -798,7 +1141,7 @@ static void pspDevCcpDumpReq(PCCCP5REQ pReq, PSPADDR PspAddrReq)
                                 CCP_V5_MEM_LSB_FIXED_GET(pReq->Op.NonSha.u16DstMemType),
                                 pReq->u32AddrKeyLow, pReq->u16AddrKeyHigh, pReq->u16KeyMemType);
     else
-        PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_CCP,
+        pspDevCcpTraceEvtAddStr(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_CCP,
                                 "CCP Request 0x%08x:\n"
                                 "    %s\n"
                                 "    cbSrc:              %u\n"
@@ -862,7 +1205,7 @@ static int pspDevCcpReqPassthruProcess(PPSPDEVCCP pThis, PCCCP5REQ pReq, uint32_
     }
     else
     {
-        PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_CCP,
+        pspDevCcpTraceEvtAddStr(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_CCP,
                                 "CCP: PASSTHRU ERROR uBitwise=%u, uByteSwap=%u and uReflect=%u not implemented yet!\n",
                                 uBitwise, uByteSwap, uReflect);
         rc = -1;
@@ -963,7 +1306,7 @@ static int pspDevCcpReqShaProcess(PPSPDEVCCP pThis, PCCCP5REQ pReq, uint32_t uFu
     }
     else
     {
-        PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_CCP,
+        pspDevCcpTraceEvtAddStr(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_CCP,
                                 "CCP: SHA ERROR uShaType=%u fInit=%u fEom=%u u32ShaBitsHigh=%u u32ShaBitsLow=%u not implemented yet!\n",
                                 uShaType, fInit, fEom, pReq->Op.Sha.u32ShaBitsHigh, pReq->Op.Sha.u32ShaBitsLow);
         rc = -1;
@@ -1018,18 +1361,18 @@ static int pspDevCcpReqAesPassthrough(PPSPDEVCCP pThis, PCCCP5REQ pReq, bool fUs
                 rc = pspDevCcpXferCtxWrite(&XferCtx, &abDst[0], pReq->cbSrc, NULL);
             else
             {
-                PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_CCP,
+                pspDevCcpTraceEvtAddStr(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_CCP,
                                         "CCP: CCP returned status %#x!\n", u32CcpSts & 0x3f);
                 rc = -1;
             }
         }
         else
-            PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_FATAL_ERROR, PSPTRACEEVTORIGIN_CCP,
+            pspDevCcpTraceEvtAddStr(NULL, PSPTRACEEVTSEVERITY_FATAL_ERROR, PSPTRACEEVTORIGIN_CCP,
                                     "CCP: AES passthrough operation failed with %d!\n", rc);
     }
     else
     {
-        PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_FATAL_ERROR, PSPTRACEEVTORIGIN_CCP,
+        pspDevCcpTraceEvtAddStr(NULL, PSPTRACEEVTSEVERITY_FATAL_ERROR, PSPTRACEEVTORIGIN_CCP,
                                 "CCP: AES passthrough with too much data %u!\n", pReq->cbSrc);
         rc = -1;
     }
@@ -1039,190 +1382,95 @@ static int pspDevCcpReqAesPassthrough(PPSPDEVCCP pThis, PCCCP5REQ pReq, bool fUs
 
 
 /**
- * Processes a AES request.
+ * Checks whether the two given buffers overlap partially.
  *
- * @returns Status code.
- * @param   pThis               The CCP device instance data.
- * @param   pReq                The request to process.
- * @param   uFunc               The engine specific function.
- * @param   fInit               Flag whether to initialize the context state.
- * @param   fEom                Flag whether this request marks the end ofthe message.
+ * @returns Flag whether the buffers overlap without being identical.
+ * @param   pv1                 The first buffer.
+ * @param   pv2                 The second buffer.
+ * @param   cb                  Size of both buffers in bytes.
  */
-static int pspDevCcpReqAesProcess(PPSPDEVCCP pThis, PCCCP5REQ pReq, uint32_t uFunc,
-                                  bool fInit, bool fEom)
+static bool pspDevCcpBufsOverlapPartially(const void *pv1, const void *pv2, size_t cb)
 {
-    int     rc       = 0;
-    uint8_t uSz      = CCP_V5_ENGINE_AES_SZ_GET(uFunc);
-    uint8_t fEncrypt = CCP_V5_ENGINE_AES_ENCRYPT_GET(uFunc);
-    uint8_t uMode    = CCP_V5_ENGINE_AES_MODE_GET(uFunc);
-    uint8_t uAesType = CCP_V5_ENGINE_AES_TYPE_GET(uFunc);
-
-    /* If the request uses a protected LSB and CCP passthrough is available we use the real CCP. */
-    if (   CCP_V5_MEM_TYPE_GET(pReq->u16KeyMemType) == CCP_V5_MEM_TYPE_SB
-        && CCP_ADDR_CREATE_FROM_HI_LO(pReq->u16AddrKeyHigh, pReq->u32AddrKeyLow) < 0xa0
-        && pThis->pDev->pCfg->pCcpProxyIf)
-        return pspDevCcpReqAesPassthrough(pThis, pReq, uMode == CCP_V5_ENGINE_AES_MODE_CBC ? true : false /*fUseIv*/);
+    uintptr_t uPtr1 = (uintptr_t)pv1;
+    uintptr_t uPtr2 = (uintptr_t)pv2;
 
-    if (   uSz == 0
-        && (   uMode == CCP_V5_ENGINE_AES_MODE_ECB
-            || uMode == CCP_V5_ENGINE_AES_MODE_CBC)
-        && (   uAesType == CCP_V5_ENGINE_AES_TYPE_256
-            || uAesType == CCP_V5_ENGINE_AES_TYPE_128))
-    {
-        const EVP_CIPHER *pOsslEvpAes = NULL;
-        size_t cbLeft = pReq->cbSrc;
-        size_t cbKey = 0;
-        bool fUseIv = false;
-        CCPXFERCTX XferCtx;
+    return    uPtr1 != uPtr2
+           && uPtr1 < uPtr2 + cb
+           && uPtr2 < uPtr1 + cb;
+}
 
-        if (uAesType == CCP_V5_ENGINE_AES_TYPE_256)
-        {
-            cbKey = 256 / 8;
 
-            if (uMode == CCP_V5_ENGINE_AES_MODE_ECB)
-                pOsslEvpAes = EVP_aes_256_ecb();
-            else if (uMode == CCP_V5_ENGINE_AES_MODE_CBC)
-            {
-                pOsslEvpAes = EVP_aes_256_cbc();
-                fUseIv = true;
-            }
-            else
-            {
-                PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_FATAL_ERROR, PSPTRACEEVTORIGIN_CCP, "CCP: Internal AES error");
-                rc = -1;
-            }
+/**
+ * Runs the given amount of data from the transfer context through the given cipher context.
+ *
+ * @returns Status code.
+ * @param   pXferCtx            The transfer context to use.
+ * @param   pOsslCipherCtx      The initialized openssl cipher context.
+ * @param   cbProcess           Number of bytes to process.
+ * @param   fSingleCall         Flag whether the data must be passed to the cipher in a single call
+ *                              (XTS data units), cbProcess must not exceed 4KiB in that case.
+ *
+ * @note Whenever the source and destination are plain PSP memory the data is processed in place
+ *       in as large chunks as possible which lets openssl use its accelerated multi block code paths
+ *       (AES-NI etc.), the bounce buffers are only used when going through the I/O manager is required.
+ */
+static int pspDevCcpCipherXfer(PCCPXFERCTX pXferCtx, EVP_CIPHER_CTX *pOsslCipherCtx, size_t cbProcess,
+                               bool fSingleCall)
+{
+    int rc = 0;
+    size_t cbBlock = EVP_CIPHER_CTX_block_size(pOsslCipherCtx);
 
-        }
-        else if (uAesType == CCP_V5_ENGINE_AES_TYPE_128)
+    while (   !rc
+           && cbProcess)
+    {
+        const void *pvSrc = NULL;
+        void *pvDst = NULL;
+        size_t cbSrc = 0;
+        size_t cbDst = 0;
+        size_t cbThisProc = 0;
+        int cbOut = 0;
+
+        if (   pspDevCcpXferCtxQuerySrcDirect(pXferCtx, &pvSrc, &cbSrc)
+            && pspDevCcpXferCtxQueryDstDirect(pXferCtx, &pvDst, &cbDst))
         {
-            cbKey = 128 / 8;
+            cbThisProc = MIN(MIN(cbSrc, cbDst), MIN(cbProcess, (size_t)INT32_MAX));
+            /* Whole blocks only so the cipher never produces more output than it was fed with. */
+            cbThisProc -= cbThisProc % cbBlock;
+            if (   (   fSingleCall
+                    && cbThisProc != cbProcess)
+                || pspDevCcpBufsOverlapPartially(pvSrc, pvDst, cbThisProc))
+                cbThisProc = 0;
+        }
 
-            if (uMode == CCP_V5_ENGINE_AES_MODE_ECB)
-                pOsslEvpAes = EVP_aes_128_ecb();
-            else if (uMode == CCP_V5_ENGINE_AES_MODE_CBC)
+        if (cbThisProc)
+        {
+            if (EVP_CipherUpdate(pOsslCipherCtx, (uint8_t *)pvDst, &cbOut, (const uint8_t *)pvSrc, (int)cbThisProc) == 1)
             {
-                pOsslEvpAes = EVP_aes_128_cbc();
-                fUseIv = true;
+                pspDevCcpXferCtxSrcAdvance(pXferCtx, cbThisProc);
+                pspDevCcpXferCtxDstAdvance(pXferCtx, cbOut);
             }
             else
-            {
-                PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_FATAL_ERROR, PSPTRACEEVTORIGIN_CCP, "CCP: Internal AES error");
                 rc = -1;
-            }
         }
         else
         {
-            PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_FATAL_ERROR, PSPTRACEEVTORIGIN_CCP, "CCP: Internal AES error");
-            rc = -1;
-        }
+            uint8_t abDataIn[_4K];
+            uint8_t abDataOut[_4K + EVP_MAX_BLOCK_LENGTH];
 
-        if (!rc)
-            rc = pspDevCcpXferCtxInit(&XferCtx, pThis, pReq, false /*fSha*/, pReq->cbSrc /**@todo Correct? */,
-                                      false /*fWriteRev*/);
-        if (!rc)
-        {
-            uint8_t abKey[256 / 8];
-            uint8_t abIv[128 / 8];
-            rc = pspDevCcpKeyCopyFromReq(pThis, pReq, cbKey, &abKey[0]);
-            if (!rc) /* The key is given in reverse order (Linux kernel mentions big endian). */
-                pspDevCcpReverseBuf(&abKey[0], cbKey);
-            if (!rc && fUseIv)
-            {
-                /*
-                 * The IV is always given in the LSB which ID is given in the source memory type.
-                 * And we need to reverse the IV as well.
-                 */
-                uint8_t uLsbCtxId = CCP_V5_MEM_LSB_CTX_ID_GET(pReq->u16SrcMemType);
-                CCPADDR CcpAddrIv = uLsbCtxId * sizeof(pThis->Lsb.u.aSlots[0].abData);
-
-                rc = pspDevCcpCopyFromLsb(pThis, CcpAddrIv, sizeof(abIv), &abIv[0]);
-                pspDevCcpReverseBuf(&abIv[0], sizeof(abIv));
-            }
+            cbThisProc = MIN(cbProcess, sizeof(abDataIn));
+            rc = pspDevCcpXferCtxRead(pXferCtx, &abDataIn[0], cbThisProc, NULL);
             if (!rc)
             {
-                pThis->pOsslAesCtx = EVP_CIPHER_CTX_new();
-                if (!pThis->pOsslAesCtx)
-                    rc = -1;
-                else if (fEncrypt)
-                {
-                    if (EVP_EncryptInit_ex(pThis->pOsslAesCtx, pOsslEvpAes, NULL, &abKey[0],
-                                           fUseIv ? &abIv[0] : NULL) != 1)
-                        rc = -1;
-                }
-                else
-                {
-                    if (EVP_DecryptInit_ex(pThis->pOsslAesCtx, pOsslEvpAes, NULL, &abKey[0],
-                                           fUseIv ? &abIv[0] : NULL) != 1)
-                        rc = -1;
-                }
-
-                if (EVP_CIPHER_CTX_set_padding(pThis->pOsslAesCtx, 0) != 1)
+                if (EVP_CipherUpdate(pOsslCipherCtx, &abDataOut[0], &cbOut, &abDataIn[0], (int)cbThisProc) != 1)
                     rc = -1;
             }
 
-            while (   !rc
-                   && cbLeft)
-            {
-                uint8_t abDataIn[512];
-                uint8_t abDataOut[512];
-                size_t cbThisProc = MIN(cbLeft, sizeof(abDataIn));
-                int cbOut = 0;
-
-                rc = pspDevCcpXferCtxRead(&XferCtx, &abDataIn[0], cbThisProc, NULL);
-                if (!rc)
-                {
-                    if (fEncrypt)
-                    {
-                        if (EVP_EncryptUpdate(pThis->pOsslAesCtx, &abDataOut[0], &cbOut, &abDataIn[0], cbThisProc) != 1)
-                            rc = -1;
-                    }
-                    else
-                    {
-                        if (EVP_DecryptUpdate(pThis->pOsslAesCtx, &abDataOut[0], &cbOut, &abDataIn[0], cbThisProc) != 1)
-                            rc = -1;
-                    }
-                }
-
-                if (   !rc
-                    && cbOut)
-                    rc = pspDevCcpXferCtxWrite(&XferCtx, &abDataOut[0], cbOut, NULL);
-
-                cbLeft -= cbThisProc;
-            }
-
             if (   !rc
-                && fEom)
-            {
-                /* Finalize state. */
-                uint8_t abDataOut[512];
-                int cbOut = 0;
-
-                if (fEncrypt)
-                {
-                    if (EVP_EncryptFinal_ex(pThis->pOsslAesCtx, &abDataOut[0], &cbOut) != 1)
-                        rc = -1;
-                }
-                else
-                {
-                    if (EVP_DecryptFinal_ex(pThis->pOsslAesCtx, &abDataOut[0], &cbOut) != 1)
-                        rc = -1;
-                }
-
-                if (   !rc
-                    && cbOut)
-                    rc = pspDevCcpXferCtxWrite(&XferCtx, &abDataOut[0], cbOut, NULL);
-
-                EVP_CIPHER_CTX_free(pThis->pOsslAesCtx);
-                pThis->pOsslAesCtx = NULL;
-            }
+                && cbOut)
+                rc = pspDevCcpXferCtxWrite(pXferCtx, &abDataOut[0], cbOut, NULL);
         }
-    }
-    else
-    {
-        PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_CCP,
-                                "CCP: AES ERROR uAesType=%u uMode=%u fEncrypt=%u uSz=%u not implemented yet!\n",
-                                uAesType, uMode, fEncrypt, uSz);
-        rc = -1;
+
+        cbProcess -= cbThisProc;
     }
 
     return rc;
@@ -1230,87 +1478,885 @@ static int pspDevCcpReqAesProcess(PPSPDEVCCP pThis, PCCCP5REQ pReq, uint32_t uFu
 
 
 /**
- * Processes a ZLIB decompression request.
+ * Frees the shared cipher context and wipes the key it was initialized with.
+ *
+ * @returns nothing.
+ * @param   pThis               The CCP device instance data.
+ */
+static void pspDevCcpCipherCtxFree(PPSPDEVCCP pThis)
+{
+    if (pThis->pOsslAesCtx)
+        EVP_CIPHER_CTX_free(pThis->pOsslAesCtx);
+
+    pThis->pOsslAesCtx       = NULL;
+    pThis->pOsslEvpCipherCtx = NULL;
+    memset(&pThis->abKeyCtx[0], 0, sizeof(pThis->abKeyCtx));
+}
+
+
+/**
+ * Processes a symmetric block cipher request (AES and DES3) using the shared cipher context.
+ *
+ * The context of a multi-part message is only reused if the cipher, direction and key match
+ * what it was initialized with. Like the real hardware the IV is taken from the LSB for every
+ * part and the updated IV gets written back afterwards so the guest can continue from there.
  *
  * @returns Status code.
  * @param   pThis               The CCP device instance data.
  * @param   pReq                The request to process.
- * @param   uFunc               The engine specific function.
+ * @param   pOsslEvpCipher      The openssl cipher to use.
+ * @param   pbKey               The key in openssl format.
+ * @param   pbIv                The IV in openssl format, NULL if the mode doesn't use one.
+ * @param   CcpAddrIv           The LSB address the IV was read from, ignored if pbIv is NULL.
+ * @param   fEncrypt            Flag whether to encrypt or decrypt.
  * @param   fInit               Flag whether to initialize the context state.
  * @param   fEom                Flag whether this request marks the end ofthe message.
  */
-static int pspDevCcpReqZlibProcess(PPSPDEVCCP pThis, PCCCP5REQ pReq, uint32_t uFunc,
-                                   bool fInit, bool fEom)
+static int pspDevCcpReqCipherProcess(PPSPDEVCCP pThis, PCCCP5REQ pReq, const EVP_CIPHER *pOsslEvpCipher,
+                                     const uint8_t *pbKey, const uint8_t *pbIv, CCPADDR CcpAddrIv,
+                                     bool fEncrypt, bool fInit, bool fEom)
 {
-    (void)uFunc; /* Ignored */
+    size_t cbKey = EVP_CIPHER_key_length(pOsslEvpCipher);
+    size_t cbIv  = EVP_CIPHER_iv_length(pOsslEvpCipher);
+    if (   cbKey > sizeof(pThis->abKeyCtx)
+        || cbIv > EVP_MAX_IV_LENGTH)
+        return -1;
 
     CCPXFERCTX XferCtx;
-    int rc = pspDevCcpXferCtxInit(&XferCtx, pThis, pReq, false /*fSha*/, UINT32_MAX,
+    int rc = pspDevCcpXferCtxInit(&XferCtx, pThis, pReq, false /*fSha*/, pReq->cbSrc /**@todo Correct? */,
                                   false /*fWriteRev*/);
     if (!rc)
     {
-        size_t cbReadLeft = pReq->cbSrc;
-
-        if (fInit)
+        /* Keep the context of a multi-part message around unless the guest starts a new one or changes parameters. */
+        if (   fInit
+            || !pThis->pOsslAesCtx
+            || pThis->pOsslEvpCipherCtx != pOsslEvpCipher
+            || pThis->fEncryptCtx != fEncrypt
+            || memcmp(&pThis->abKeyCtx[0], pbKey, cbKey))
         {
-            memset(&pThis->Zlib, 0, sizeof(pThis->Zlib));
-            int rcZlib = inflateInit2(&pThis->Zlib, Z_DEF_WBITS);
-            if (rcZlib < 0)
+            pspDevCcpCipherCtxFree(pThis);
+
+            pThis->pOsslAesCtx = EVP_CIPHER_CTX_new();
+            if (!pThis->pOsslAesCtx)
                 rc = -1;
+            else if (   EVP_CipherInit_ex(pThis->pOsslAesCtx, pOsslEvpCipher, NULL, pbKey, pbIv, fEncrypt ? 1 : 0) != 1
+                     || EVP_CIPHER_CTX_set_padding(pThis->pOsslAesCtx, 0) != 1)
+                rc = -1;
+            else
+            {
+                pThis->pOsslEvpCipherCtx = pOsslEvpCipher;
+                pThis->fEncryptCtx       = fEncrypt;
+                memcpy(&pThis->abKeyCtx[0], pbKey, cbKey);
+            }
         }
+        else if (   pbIv
+                 && EVP_CipherInit_ex(pThis->pOsslAesCtx, NULL, NULL, NULL, pbIv, -1) != 1) /* Continue from the IV in the LSB. */
+            rc = -1;
 
-        uint8_t abDecomp[_4K];
-        uint32_t offDecomp = 0;
-        memset(&abDecomp[0], 0, sizeof(abDecomp));
+        if (!rc)
+            rc = pspDevCcpCipherXfer(&XferCtx, pThis->pOsslAesCtx, pReq->cbSrc, false /*fSingleCall*/);
 
-        while (   !rc
-               && cbReadLeft)
+        if (   !rc
+            && pbIv
+            && cbIv)
         {
-            uint8_t abData[_4K];
-            size_t cbThisRead = MIN(cbReadLeft, sizeof(abData));
+            /* Write the updated IV back to the LSB in reverse order. */
+            uint8_t abIv[EVP_MAX_IV_LENGTH];
 
-            rc = pspDevCcpXferCtxRead(&XferCtx, &abData[0], cbThisRead, NULL);
-            if (!rc)
+            if (EVP_CIPHER_CTX_get_updated_iv(pThis->pOsslAesCtx, &abIv[0], cbIv) == 1)
             {
-                pThis->Zlib.avail_in = cbThisRead;
-                pThis->Zlib.next_in  = &abData[0];
+                pspDevCcpReverseBuf(&abIv[0], cbIv);
+                rc = pspDevCcpCopyToLsb(pThis, CcpAddrIv, cbIv, &abIv[0]);
+            }
+            else
+                rc = -1;
+        }
+
+        if (   !rc
+            && fEom)
+        {
+            /* Finalize state. */
+            uint8_t abDataOut[EVP_MAX_BLOCK_LENGTH];
+            int cbOut = 0;
+
+            if (EVP_CipherFinal_ex(pThis->pOsslAesCtx, &abDataOut[0], &cbOut) != 1)
+                rc = -1;
+
+            if (   !rc
+                && cbOut)
+                rc = pspDevCcpXferCtxWrite(&XferCtx, &abDataOut[0], cbOut, NULL);
+        }
+
+        if (   fEom
+            || rc)
+            pspDevCcpCipherCtxFree(pThis);
+    }
+
+    return rc;
+}
+
+
+/**
+ * Returns the openssl cipher for the given AES type and mode.
+ *
+ * @returns Openssl cipher or NULL if not supported.
+ * @param   uAesType            The AES type from the function field.
+ * @param   uMode               The AES mode from the function field.
+ * @param   pcbKey              Where to store the key size in bytes.
+ * @param   pfUseIv             Where to store the flag whether the mode uses an IV.
+ */
+static const EVP_CIPHER *pspDevCcpAesCipherGet(uint8_t uAesType, uint8_t uMode, size_t *pcbKey, bool *pfUseIv)
+{
+    static const struct
+    {
+        /** The ECB cipher getter. */
+        const EVP_CIPHER *(*pfnEcb)(void);
+        /** The CBC cipher getter. */
+        const EVP_CIPHER *(*pfnCbc)(void);
+        /** The OFB cipher getter. */
+        const EVP_CIPHER *(*pfnOfb)(void);
+        /** The CFB cipher getter. */
+        const EVP_CIPHER *(*pfnCfb)(void);
+        /** The CTR cipher getter. */
+        const EVP_CIPHER *(*pfnCtr)(void);
+        /** Key size in bytes. */
+        size_t            cbKey;
+    } s_aCiphers[] =
+    {
+        { EVP_aes_128_ecb, EVP_aes_128_cbc, EVP_aes_128_ofb, EVP_aes_128_cfb128, EVP_aes_128_ctr, 128 / 8 }, /* CCP_V5_ENGINE_AES_TYPE_128 */
+        { EVP_aes_192_ecb, EVP_aes_192_cbc, EVP_aes_192_ofb, EVP_aes_192_cfb128, EVP_aes_192_ctr, 192 / 8 }, /* CCP_V5_ENGINE_AES_TYPE_192 */
+        { EVP_aes_256_ecb, EVP_aes_256_cbc, EVP_aes_256_ofb, EVP_aes_256_cfb128, EVP_aes_256_ctr, 256 / 8 }  /* CCP_V5_ENGINE_AES_TYPE_256 */
+    };
+    unsigned idxCipher;
+
+    switch (uAesType)
+    {
+        case CCP_V5_ENGINE_AES_TYPE_128:
+            idxCipher = 0;
+            break;
+        case CCP_V5_ENGINE_AES_TYPE_192:
+            idxCipher = 1;
+            break;
+        case CCP_V5_ENGINE_AES_TYPE_256:
+            idxCipher = 2;
+            break;
+        default:
+            return NULL;
+    }
+
+    *pcbKey  = s_aCiphers[idxCipher].cbKey;
+    *pfUseIv = true;
+    switch (uMode)
+    {
+        case CCP_V5_ENGINE_AES_MODE_ECB:
+            *pfUseIv = false;
+            return s_aCiphers[idxCipher].pfnEcb();
+        case CCP_V5_ENGINE_AES_MODE_CBC:
+            return s_aCiphers[idxCipher].pfnCbc();
+        case CCP_V5_ENGINE_AES_MODE_OFB:
+            return s_aCiphers[idxCipher].pfnOfb();
+        case CCP_V5_ENGINE_AES_MODE_CFB:
+            return s_aCiphers[idxCipher].pfnCfb();
+        case CCP_V5_ENGINE_AES_MODE_CTR:
+            return s_aCiphers[idxCipher].pfnCtr();
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Processes a AES request.
+ *
+ * @returns Status code.
+ * @param   pThis               The CCP device instance data.
+ * @param   pReq                The request to process.
+ * @param   uFunc               The engine specific function.
+ * @param   fInit               Flag whether to initialize the context state.
+ * @param   fEom                Flag whether this request marks the end ofthe message.
+ */
+static int pspDevCcpReqAesProcess(PPSPDEVCCP pThis, PCCCP5REQ pReq, uint32_t uFunc,
+                                  bool fInit, bool fEom)
+{
+    int     rc       = 0;
+    uint8_t uSz      = CCP_V5_ENGINE_AES_SZ_GET(uFunc);
+    uint8_t fEncrypt = CCP_V5_ENGINE_AES_ENCRYPT_GET(uFunc);
+    uint8_t uMode    = CCP_V5_ENGINE_AES_MODE_GET(uFunc);
+    uint8_t uAesType = CCP_V5_ENGINE_AES_TYPE_GET(uFunc);
+
+    /* If the request uses a protected LSB and CCP passthrough is available we use the real CCP. */
+    if (   CCP_V5_MEM_TYPE_GET(pReq->u16KeyMemType) == CCP_V5_MEM_TYPE_SB
+        && CCP_ADDR_CREATE_FROM_HI_LO(pReq->u16AddrKeyHigh, pReq->u32AddrKeyLow) < 0xa0
+        && pThis->pDev->pCfg->pCcpProxyIf)
+        return pspDevCcpReqAesPassthrough(pThis, pReq, uMode == CCP_V5_ENGINE_AES_MODE_CBC ? true : false /*fUseIv*/);
+
+    size_t cbKey = 0;
+    bool fUseIv = false;
+    const EVP_CIPHER *pOsslEvpAes = pspDevCcpAesCipherGet(uAesType, uMode, &cbKey, &fUseIv);
+
+    /*
+     * The size field gives the feedback/counter width in bits minus one for the stream modes
+     * (the Linux kernel always uses the full block), only that and 0 are supported.
+     */
+    if (   pOsslEvpAes
+        && (   uSz == 0
+            || (   uSz == 128 - 1
+                && uMode != CCP_V5_ENGINE_AES_MODE_ECB
+                && uMode != CCP_V5_ENGINE_AES_MODE_CBC)))
+    {
+        uint8_t abKey[256 / 8];
+        uint8_t abIv[128 / 8];
+        /* The IV (or initial counter block for CTR) is always given in the LSB which ID is given in the source memory type. */
+        uint8_t uLsbCtxId = CCP_V5_MEM_LSB_CTX_ID_GET(pReq->u16SrcMemType);
+        CCPADDR CcpAddrIv = uLsbCtxId * sizeof(pThis->Lsb.u.aSlots[0].abData);
+
+        rc = pspDevCcpKeyCopyFromReq(pThis, pReq, cbKey, &abKey[0]);
+        if (!rc) /* The key is given in reverse order (Linux kernel mentions big endian). */
+            pspDevCcpReverseBuf(&abKey[0], cbKey);
+        if (!rc && fUseIv)
+        {
+            /* We need to reverse the IV as well. */
+            rc = pspDevCcpCopyFromLsb(pThis, CcpAddrIv, sizeof(abIv), &abIv[0]);
+            pspDevCcpReverseBuf(&abIv[0], sizeof(abIv));
+        }
+        if (!rc)
+            rc = pspDevCcpReqCipherProcess(pThis, pReq, pOsslEvpAes, &abKey[0], fUseIv ? &abIv[0] : NULL,
+                                           CcpAddrIv, fEncrypt ? true : false, fInit, fEom);
+    }
+    else
+    {
+        pspDevCcpTraceEvtAddStr(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_CCP,
+                                "CCP: AES ERROR uAesType=%u uMode=%u fEncrypt=%u uSz=%u not implemented yet!\n",
+                                uAesType, uMode, fEncrypt, uSz);
+        rc = -1;
+    }
+
+    return rc;
+}
+
+
+/**
+ * Processes a XTS-AES-128 request.
+ *
+ * @returns Status code.
+ * @param   pThis               The CCP device instance data.
+ * @param   pReq                The request to process.
+ * @param   uFunc               The engine specific function.
+ * @param   fInit               Flag whether to initialize the context state.
+ * @param   fEom                Flag whether this request marks the end ofthe message.
+ */
+static int pspDevCcpReqXtsAes128Process(PPSPDEVCCP pThis, PCCCP5REQ pReq, uint32_t uFunc,
+                                        bool fInit, bool fEom)
+{
+    int     rc        = 0;
+    uint8_t uUnitSz   = CCP_V5_ENGINE_XTS_UNIT_SZ_GET(uFunc);
+    uint8_t fEncrypt  = CCP_V5_ENGINE_XTS_ENCRYPT_GET(uFunc);
+    size_t  cbUnit    = 0;
+
+    (void)fInit; /* Every data unit is independent. */
+    (void)fEom;
+
+    switch (uUnitSz)
+    {
+        case CCP_V5_ENGINE_XTS_UNIT_SZ_16:
+            cbUnit = 16;
+            break;
+        case CCP_V5_ENGINE_XTS_UNIT_SZ_512:
+            cbUnit = 512;
+            break;
+        case CCP_V5_ENGINE_XTS_UNIT_SZ_1024:
+            cbUnit = _1K;
+            break;
+        case CCP_V5_ENGINE_XTS_UNIT_SZ_2048:
+            cbUnit = 2 * _1K;
+            break;
+        case CCP_V5_ENGINE_XTS_UNIT_SZ_4096:
+            cbUnit = _4K;
+            break;
+    }
+
+    if (   cbUnit
+        && !(pReq->cbSrc % cbUnit))
+    {
+        uint8_t abKeyCcp[2 * 128 / 8];
+        uint8_t abKey[2 * 128 / 8];
+        uint8_t abTweak[128 / 8];
+
+        /*
+         * Following the Linux kernel the LSB holds the tweak key in the lower and the data key in the upper half
+         * and the whole 256bit is stored in big endian format. Openssl wants the data key followed by the tweak key.
+         * The tweak lives unswapped in the LSB given in the source memory type.
+         */
+        rc = pspDevCcpKeyCopyFromReq(pThis, pReq, sizeof(abKeyCcp), &abKeyCcp[0]);
+        if (!rc)
+        {
+            pspDevCcpReverseBuf(&abKeyCcp[0], sizeof(abKeyCcp));
+            memcpy(&abKey[0], &abKeyCcp[128 / 8], 128 / 8);
+            memcpy(&abKey[128 / 8], &abKeyCcp[0], 128 / 8);
+
+            uint8_t uLsbCtxId = CCP_V5_MEM_LSB_CTX_ID_GET(pReq->u16SrcMemType);
+            CCPADDR CcpAddrIv = uLsbCtxId * sizeof(pThis->Lsb.u.aSlots[0].abData);
+            rc = pspDevCcpCopyFromLsb(pThis, CcpAddrIv, sizeof(abTweak), &abTweak[0]);
+        }
+
+        if (!rc)
+        {
+            CCPXFERCTX XferCtx;
+            EVP_CIPHER_CTX *pOsslXtsCtx = NULL;
+
+            rc = pspDevCcpXferCtxInit(&XferCtx, pThis, pReq, false /*fSha*/, pReq->cbSrc,
+                                      false /*fWriteRev*/);
+            if (!rc)
+            {
+                pOsslXtsCtx = EVP_CIPHER_CTX_new();
+                if (   !pOsslXtsCtx
+                    || EVP_CipherInit_ex(pOsslXtsCtx, EVP_aes_128_xts(), NULL, &abKey[0], NULL, fEncrypt ? 1 : 0) != 1)
+                    rc = -1;
+            }
+
+            size_t cbLeft = pReq->cbSrc;
+            while (   !rc
+                   && cbLeft)
+            {
+                /* Each data unit is processed with its own tweak which is incremented as a 128bit little endian number. */
+                if (EVP_CipherInit_ex(pOsslXtsCtx, NULL, NULL, NULL, &abTweak[0], -1) != 1)
+                    rc = -1;
+                else
+                    rc = pspDevCcpCipherXfer(&XferCtx, pOsslXtsCtx, cbUnit, true /*fSingleCall*/);
+
+                for (unsigned i = 0; i < sizeof(abTweak) && !++abTweak[i]; i++)
+                    ; /* carry */
+
+                cbLeft -= cbUnit;
+            }
+
+            if (pOsslXtsCtx)
+                EVP_CIPHER_CTX_free(pOsslXtsCtx);
+        }
+
+        memset(&abKeyCcp[0], 0, sizeof(abKeyCcp));
+        memset(&abKey[0], 0, sizeof(abKey));
+    }
+    else
+    {
+        pspDevCcpTraceEvtAddStr(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_CCP,
+                                "CCP: XTS-AES-128 ERROR uUnitSz=%u fEncrypt=%u cbSrc=%u not implemented yet!\n",
+                                uUnitSz, fEncrypt, pReq->cbSrc);
+        rc = -1;
+    }
+
+    return rc;
+}
+
+
+/**
+ * Processes a DES3 request.
+ *
+ * @returns Status code.
+ * @param   pThis               The CCP device instance data.
+ * @param   pReq                The request to process.
+ * @param   uFunc               The engine specific function.
+ * @param   fInit               Flag whether to initialize the context state.
+ * @param   fEom                Flag whether this request marks the end ofthe message.
+ */
+static int pspDevCcpReqDes3Process(PPSPDEVCCP pThis, PCCCP5REQ pReq, uint32_t uFunc,
+                                   bool fInit, bool fEom)
+{
+    int     rc        = 0;
+    uint8_t fEncrypt  = CCP_V5_ENGINE_DES3_ENCRYPT_GET(uFunc);
+    uint8_t uMode     = CCP_V5_ENGINE_DES3_MODE_GET(uFunc);
+    uint8_t uDes3Type = CCP_V5_ENGINE_DES3_TYPE_GET(uFunc);
+    const EVP_CIPHER *pOsslEvpDes3 = NULL;
+
+    if (uDes3Type == CCP_V5_ENGINE_DES3_TYPE_168)
+    {
+        if (uMode == CCP_V5_ENGINE_DES3_MODE_ECB)
+            pOsslEvpDes3 = EVP_des_ede3_ecb();
+        else if (uMode == CCP_V5_ENGINE_DES3_MODE_CBC)
+            pOsslEvpDes3 = EVP_des_ede3_cbc();
+        else if (uMode == CCP_V5_ENGINE_DES3_MODE_CFB)
+            pOsslEvpDes3 = EVP_des_ede3_cfb64();
+    }
+
+    if (pOsslEvpDes3)
+    {
+        uint8_t abKeyCcp[3 * 64 / 8];
+        uint8_t abKey[3 * 64 / 8];
+        uint8_t abIv[64 / 8];
+        /* Same as for AES the IV is given in reverse order in the LSB given in the source memory type. */
+        uint8_t uLsbCtxId = CCP_V5_MEM_LSB_CTX_ID_GET(pReq->u16SrcMemType);
+        CCPADDR CcpAddrIv = uLsbCtxId * sizeof(pThis->Lsb.u.aSlots[0].abData);
+
+        /*
+         * The key is stored in big endian format with the three single keys in reverse order,
+         * after reversing the whole key we end up with K3 || K2 || K1.
+         */
+        rc = pspDevCcpKeyCopyFromReq(pThis, pReq, sizeof(abKeyCcp), &abKeyCcp[0]);
+        if (!rc)
+        {
+            pspDevCcpReverseBuf(&abKeyCcp[0], sizeof(abKeyCcp));
+            for (unsigned i = 0; i < 3; i++)
+                memcpy(&abKey[i * 8], &abKeyCcp[(2 - i) * 8], 8);
+        }
+        if (   !rc
+            && uMode != CCP_V5_ENGINE_DES3_MODE_ECB)
+        {
+            rc = pspDevCcpCopyFromLsb(pThis, CcpAddrIv, sizeof(abIv), &abIv[0]);
+            pspDevCcpReverseBuf(&abIv[0], sizeof(abIv));
+        }
+        if (!rc)
+            rc = pspDevCcpReqCipherProcess(pThis, pReq, pOsslEvpDes3, &abKey[0],
+                                           uMode != CCP_V5_ENGINE_DES3_MODE_ECB ? &abIv[0] : NULL, CcpAddrIv,
+                                           fEncrypt ? true : false, fInit, fEom);
+
+        memset(&abKeyCcp[0], 0, sizeof(abKeyCcp));
+        memset(&abKey[0], 0, sizeof(abKey));
+    }
+    else
+    {
+        pspDevCcpTraceEvtAddStr(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_CCP,
+                                "CCP: DES3 ERROR uDes3Type=%u uMode=%u fEncrypt=%u not implemented yet!\n",
+                                uDes3Type, uMode, fEncrypt);
+        rc = -1;
+    }
+
+    return rc;
+}
+
+
+/**
+ * Computes the resulting point of an addition or doubling from the given slope.
+ *
+ * @returns Status code.
+ * @param   pMod                The prime modulus of the curve.
+ * @param   pLambda             The slope.
+ * @param   pX1                 X coordinate of the first point.
+ * @param   pY1                 Y coordinate of the first point.
+ * @param   pX2                 X coordinate of the second point.
+ * @param   pXR                 Where to store the X coordinate of the result, may alias the inputs.
+ * @param   pYR                 Where to store the Y coordinate of the result, may alias the inputs.
+ * @param   pBnCtx              The bignum context to use.
+ */
+static int pspDevCcpEccPointFromLambda(const BIGNUM *pMod, const BIGNUM *pLambda, const BIGNUM *pX1, const BIGNUM *pY1,
+                                       const BIGNUM *pX2, BIGNUM *pXR, BIGNUM *pYR, BN_CTX *pBnCtx)
+{
+    int rc = -1;
+
+    BN_CTX_start(pBnCtx);
+    BIGNUM *pXNew = BN_CTX_get(pBnCtx);
+    BIGNUM *pTmp  = BN_CTX_get(pBnCtx);
+
+    /* x3 = lambda^2 - x1 - x2, y3 = lambda * (x1 - x3) - y1 */
+    if (   pTmp
+        && BN_mod_sqr(pXNew, pLambda, pMod, pBnCtx)
+        && BN_mod_sub(pXNew, pXNew, pX1, pMod, pBnCtx)
+        && BN_mod_sub(pXNew, pXNew, pX2, pMod, pBnCtx)
+        && BN_mod_sub(pTmp, pX1, pXNew, pMod, pBnCtx)
+        && BN_mod_mul(pTmp, pLambda, pTmp, pMod, pBnCtx)
+        && BN_mod_sub(pYR, pTmp, pY1, pMod, pBnCtx)
+        && BN_copy(pXR, pXNew))
+        rc = 0;
+
+    BN_CTX_end(pBnCtx);
+    return rc;
+}
+
+
+/**
+ * Doubles the given affine point on the curve y^2 = x^3 + ax + b.
+ *
+ * @returns Status code, failure if the result is the point at infinity.
+ * @param   pMod                The prime modulus of the curve.
+ * @param   pA                  The a parameter of the curve.
+ * @param   pX                  X coordinate of the point.
+ * @param   pY                  Y coordinate of the point.
+ * @param   pXR                 Where to store the X coordinate of the result, may alias the inputs.
+ * @param   pYR                 Where to store the Y coordinate of the result, may alias the inputs.
+ * @param   pBnCtx              The bignum context to use.
+ */
+static int pspDevCcpEccPointDbl(const BIGNUM *pMod, const BIGNUM *pA, const BIGNUM *pX, const BIGNUM *pY,
+                                BIGNUM *pXR, BIGNUM *pYR, BN_CTX *pBnCtx)
+{
+    int rc = -1;
+
+    BN_CTX_start(pBnCtx);
+    BIGNUM *pLambda = BN_CTX_get(pBnCtx);
+    BIGNUM *pTmp    = BN_CTX_get(pBnCtx);
+
+    /* lambda = (3x^2 + a) / 2y */
+    if (   pTmp
+        && !BN_is_zero(pY)
+        && BN_mod_sqr(pLambda, pX, pMod, pBnCtx)
+        && BN_mul_word(pLambda, 3)
+        && BN_mod_add(pLambda, pLambda, pA, pMod, pBnCtx)
+        && BN_mod_lshift1(pTmp, pY, pMod, pBnCtx)
+        && BN_mod_inverse(pTmp, pTmp, pMod, pBnCtx)
+        && BN_mod_mul(pLambda, pLambda, pTmp, pMod, pBnCtx))
+        rc = pspDevCcpEccPointFromLambda(pMod, pLambda, pX, pY, pX, pXR, pYR, pBnCtx);
+
+    BN_CTX_end(pBnCtx);
+    return rc;
+}
+
+
+/**
+ * Adds the two given affine points.
+ *
+ * @returns Status code, failure if the result is the point at infinity.
+ * @param   pMod                The prime modulus of the curve.
+ * @param   pA                  The a parameter of the curve, NULL if unknown (adding a point to itself fails then).
+ * @param   pX1                 X coordinate of the first point.
+ * @param   pY1                 Y coordinate of the first point.
+ * @param   pX2                 X coordinate of the second point.
+ * @param   pY2                 Y coordinate of the second point.
+ * @param   pXR                 Where to store the X coordinate of the result, may alias the inputs.
+ * @param   pYR                 Where to store the Y coordinate of the result, may alias the inputs.
+ * @param   pBnCtx              The bignum context to use.
+ */
+static int pspDevCcpEccPointAdd(const BIGNUM *pMod, const BIGNUM *pA, const BIGNUM *pX1, const BIGNUM *pY1,
+                                const BIGNUM *pX2, const BIGNUM *pY2, BIGNUM *pXR, BIGNUM *pYR, BN_CTX *pBnCtx)
+{
+    int rc = -1;
+
+    if (!BN_cmp(pX1, pX2))
+    {
+        if (   pA
+            && !BN_cmp(pY1, pY2))
+            rc = pspDevCcpEccPointDbl(pMod, pA, pX1, pY1, pXR, pYR, pBnCtx);
+        return rc;
+    }
+
+    BN_CTX_start(pBnCtx);
+    BIGNUM *pLambda = BN_CTX_get(pBnCtx);
+    BIGNUM *pTmp    = BN_CTX_get(pBnCtx);
+
+    /* lambda = (y2 - y1) / (x2 - x1) */
+    if (   pTmp
+        && BN_mod_sub(pLambda, pY2, pY1, pMod, pBnCtx)
+        && BN_mod_sub(pTmp, pX2, pX1, pMod, pBnCtx)
+        && BN_mod_inverse(pTmp, pTmp, pMod, pBnCtx)
+        && BN_mod_mul(pLambda, pLambda, pTmp, pMod, pBnCtx))
+        rc = pspDevCcpEccPointFromLambda(pMod, pLambda, pX1, pY1, pX2, pXR, pYR, pBnCtx);
+
+    BN_CTX_end(pBnCtx);
+    return rc;
+}
+
+
+/**
+ * Multiplies the given affine point with the given scalar.
+ *
+ * @returns Status code, failure if the result is the point at infinity.
+ * @param   pMod                The prime modulus of the curve.
+ * @param   pA                  The a parameter of the curve.
+ * @param   pK                  The scalar.
+ * @param   pX                  X coordinate of the point.
+ * @param   pY                  Y coordinate of the point.
+ * @param   pXR                 Where to store the X coordinate of the result.
+ * @param   pYR                 Where to store the Y coordinate of the result.
+ * @param   pBnCtx              The bignum context to use.
+ */
+static int pspDevCcpEccPointMul(const BIGNUM *pMod, const BIGNUM *pA, const BIGNUM *pK, const BIGNUM *pX,
+                                const BIGNUM *pY, BIGNUM *pXR, BIGNUM *pYR, BN_CTX *pBnCtx)
+{
+    int rc = 0;
+    bool fInf = true;
+
+    BN_CTX_start(pBnCtx);
+    BIGNUM *pXAcc = BN_CTX_get(pBnCtx);
+    BIGNUM *pYAcc = BN_CTX_get(pBnCtx);
+    if (!pYAcc)
+        rc = -1;
+
+    /* Simple double and add, there is no need to be constant time here. */
+    for (int i = BN_num_bits(pK) - 1; i >= 0 && !rc; i--)
+    {
+        if (!fInf)
+            rc = pspDevCcpEccPointDbl(pMod, pA, pXAcc, pYAcc, pXAcc, pYAcc, pBnCtx);
+
+        if (   !rc
+            && BN_is_bit_set(pK, i))
+        {
+            if (fInf)
+            {
+                if (   BN_copy(pXAcc, pX)
+                    && BN_copy(pYAcc, pY))
+                    fInf = false;
+                else
+                    rc = -1;
+            }
+            else
+                rc = pspDevCcpEccPointAdd(pMod, pA, pXAcc, pYAcc, pX, pY, pXAcc, pYAcc, pBnCtx);
+        }
+    }
+
+    if (   !rc
+        && (   fInf
+            || !BN_copy(pXR, pXAcc)
+            || !BN_copy(pYR, pYAcc)))
+        rc = -1;
+
+    BN_CTX_end(pBnCtx);
+    return rc;
+}
+
+
+/**
+ * Processes an ECC request.
+ *
+ * @returns Status code.
+ * @param   pThis               The CCP device instance data.
+ * @param   pReq                The request to process.
+ * @param   uFunc               The engine specific function.
+ * @param   fInit               Flag whether to initialize the context state.
+ * @param   fEom                Flag whether this request marks the end ofthe message.
+ *
+ * @note The source buffer layout follows the Linux kernel, every operand is a 64 byte little endian number
+ *       starting with the modulus. Points are in affine coordinates, so the Z coordinates are ignored.
+ *       A failed computation (no inverse, point at infinity) is reported through the result status word
+ *       in the output like the hardware does and not as a request error.
+ */
+static int pspDevCcpReqEccProcess(PPSPDEVCCP pThis, PCCCP5REQ pReq, uint32_t uFunc,
+                                  bool fInit, bool fEom)
+{
+    int      rc        = 0;
+    uint8_t  uEccFunc  = CCP_V5_ENGINE_ECC_FUNC_GET(uFunc);
+    unsigned cOperands = 0;
+    size_t   cbResult  = CCP_V5_ECC_OPERAND_SZ;
+
+    (void)fInit;
+    (void)fEom;
+
+    switch (uEccFunc)
+    {
+        case CCP_V5_ENGINE_ECC_FUNC_MMUL_384BIT:
+        case CCP_V5_ENGINE_ECC_FUNC_MADD_384BIT:
+            cOperands = 3; /* Modulus, operand 1 and 2. */
+            break;
+        case CCP_V5_ENGINE_ECC_FUNC_MINV_384BIT:
+            cOperands = 2; /* Modulus, operand. */
+            break;
+        case CCP_V5_ENGINE_ECC_FUNC_PADD_384BIT:
+            cOperands = 7; /* Modulus, P (x, y, z), Q (x, y, z). */
+            cbResult  = 2 * CCP_V5_ECC_OPERAND_SZ;
+            break;
+        case CCP_V5_ENGINE_ECC_FUNC_PMUL_384BIT:
+            cOperands = 6; /* Modulus, P (x, y, z), curve parameter a, scalar. */
+            cbResult  = 2 * CCP_V5_ECC_OPERAND_SZ;
+            break;
+        case CCP_V5_ENGINE_ECC_FUNC_PDBL_384BIT:
+            cOperands = 5; /* Modulus, P (x, y, z), curve parameter a. */
+            cbResult  = 2 * CCP_V5_ECC_OPERAND_SZ;
+            break;
+    }
+
+    if (   cOperands
+        && pReq->cbSrc >= cOperands * CCP_V5_ECC_OPERAND_SZ)
+    {
+        uint8_t abSrc[CCP_V5_ECC_OPERAND_CNT_MAX * CCP_V5_ECC_OPERAND_SZ];
+        uint8_t abResult[2 * CCP_V5_ECC_OPERAND_SZ];
+        CCPXFERCTX XferCtx;
+
+        rc = pspDevCcpXferCtxInit(&XferCtx, pThis, pReq, false /*fSha*/, cbResult,
+                                  false /*fWriteRev*/);
+        if (!rc)
+            rc = pspDevCcpXferCtxRead(&XferCtx, &abSrc[0], cOperands * CCP_V5_ECC_OPERAND_SZ, NULL);
+        if (!rc)
+        {
+            BIGNUM *apOps[CCP_V5_ECC_OPERAND_CNT_MAX] = { NULL };
+            BIGNUM *pXR = BN_new();
+            BIGNUM *pYR = BN_new();
+            BN_CTX *pBnCtx = BN_CTX_new();
+            bool fOk = pXR && pYR && pBnCtx;
+            int rcEcc = -1;
+
+            for (unsigned i = 0; i < cOperands && fOk; i++)
+            {
+                apOps[i] = BN_lebin2bn(&abSrc[i * CCP_V5_ECC_OPERAND_SZ], CCP_V5_ECC_OPERAND_SZ, NULL);
+                if (!apOps[i])
+                    fOk = false;
+            }
+
+            if (   fOk
+                && !BN_is_zero(apOps[0])
+                && BN_num_bytes(apOps[0]) <= CCP_V5_ECC_MODULUS_SZ_MAX)
+            {
+                switch (uEccFunc)
+                {
+                    case CCP_V5_ENGINE_ECC_FUNC_MMUL_384BIT:
+                        rcEcc = BN_mod_mul(pXR, apOps[1], apOps[2], apOps[0], pBnCtx) ? 0 : -1;
+                        break;
+                    case CCP_V5_ENGINE_ECC_FUNC_MADD_384BIT:
+                        rcEcc = BN_mod_add(pXR, apOps[1], apOps[2], apOps[0], pBnCtx) ? 0 : -1;
+                        break;
+                    case CCP_V5_ENGINE_ECC_FUNC_MINV_384BIT:
+                        rcEcc = BN_mod_inverse(pXR, apOps[1], apOps[0], pBnCtx) ? 0 : -1;
+                        break;
+                    case CCP_V5_ENGINE_ECC_FUNC_PADD_384BIT:
+                        rcEcc = pspDevCcpEccPointAdd(apOps[0], NULL /*pA*/, apOps[1], apOps[2], apOps[4], apOps[5],
+                                                     pXR, pYR, pBnCtx);
+                        break;
+                    case CCP_V5_ENGINE_ECC_FUNC_PMUL_384BIT:
+                        rcEcc = pspDevCcpEccPointMul(apOps[0], apOps[4], apOps[5], apOps[1], apOps[2],
+                                                     pXR, pYR, pBnCtx);
+                        break;
+                    case CCP_V5_ENGINE_ECC_FUNC_PDBL_384BIT:
+                        rcEcc = pspDevCcpEccPointDbl(apOps[0], apOps[4], apOps[1], apOps[2], pXR, pYR, pBnCtx);
+                        break;
+                }
+            }
+            else if (!fOk)
+                rc = -1;
 
-                while (   pThis->Zlib.avail_in
-                       && !rc)
+            if (!rc)
+            {
+                /* The result status lives in the unused upper part of the (first) result operand. */
+                memset(&abResult[0], 0, sizeof(abResult));
+                if (!rcEcc)
+                {
+                    if (   BN_bn2lebinpad(pXR, &abResult[0], CCP_V5_ECC_OPERAND_SZ) == CCP_V5_ECC_OPERAND_SZ
+                        && (   cbResult == CCP_V5_ECC_OPERAND_SZ
+                            || BN_bn2lebinpad(pYR, &abResult[CCP_V5_ECC_OPERAND_SZ], CCP_V5_ECC_OPERAND_SZ) == CCP_V5_ECC_OPERAND_SZ))
+                        abResult[CCP_V5_ECC_RESULT_OFF] = CCP_V5_ECC_RESULT_F_SUCCESS;
+                    else
+                        memset(&abResult[0], 0, sizeof(abResult));
+                }
+
+                rc = pspDevCcpXferCtxWrite(&XferCtx, &abResult[0], cbResult, NULL);
+            }
+
+            for (unsigned i = 0; i < ELEMENTS(apOps); i++)
+                if (apOps[i])
+                    BN_clear_free(apOps[i]);
+            if (pXR)
+                BN_clear_free(pXR);
+            if (pYR)
+                BN_clear_free(pYR);
+            if (pBnCtx)
+                BN_CTX_free(pBnCtx);
+        }
+    }
+    else
+    {
+        pspDevCcpTraceEvtAddStr(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_CCP,
+                                "CCP: ECC ERROR uEccFunc=%u cbSrc=%u not implemented yet!\n",
+                                uEccFunc, pReq->cbSrc);
+        rc = -1;
+    }
+
+    return rc;
+}
+
+
+/**
+ * Processes a ZLIB decompression request.
+ *
+ * @returns Status code.
+ * @param   pThis               The CCP device instance data.
+ * @param   pReq                The request to process.
+ * @param   uFunc               The engine specific function.
+ * @param   fInit               Flag whether to initialize the context state.
+ * @param   fEom                Flag whether this request marks the end ofthe message.
+ */
+static int pspDevCcpReqZlibProcess(PPSPDEVCCP pThis, PCCCP5REQ pReq, uint32_t uFunc,
+                                   bool fInit, bool fEom)
+{
+    (void)uFunc; /* Ignored */
+
+    CCPXFERCTX XferCtx;
+    int rc = pspDevCcpXferCtxInit(&XferCtx, pThis, pReq, false /*fSha*/, UINT32_MAX,
+                                  false /*fWriteRev*/);
+    if (!rc)
+    {
+        size_t cbReadLeft = pReq->cbSrc;
+        int rcZlib = Z_OK;
+
+        if (fInit)
+        {
+            memset(&pThis->Zlib, 0, sizeof(pThis->Zlib));
+            rcZlib = inflateInit2(&pThis->Zlib, Z_DEF_WBITS);
+            if (rcZlib < 0)
+                rc = -1;
+        }
+
+        /*
+         * Input and output go directly from/to the backing memory if the source/destination is plain PSP memory,
+         * the bounce buffers are only used when going through the I/O manager is required.
+         */
+        uint8_t abDecomp[_4K];
+        uint8_t abData[_4K];
+
+        while (   !rc
+               && cbReadLeft
+               && rcZlib != Z_STREAM_END)
+        {
+            const void *pvSrc = NULL;
+            size_t cbThisRead = 0;
+
+            if (pspDevCcpXferCtxQuerySrcDirect(&XferCtx, &pvSrc, &cbThisRead))
+            {
+                cbThisRead = MIN(cbThisRead, UINT32_MAX); /* avail_in is only 32bit. */
+                pspDevCcpXferCtxSrcAdvance(&XferCtx, cbThisRead);
+            }
+            else
+            {
+                cbThisRead = MIN(cbReadLeft, sizeof(abData));
+                rc = pspDevCcpXferCtxRead(&XferCtx, &abData[0], cbThisRead, NULL);
+                pvSrc = &abData[0];
+            }
+
+            if (!rc)
+            {
+                pThis->Zlib.avail_in = cbThisRead;
+                pThis->Zlib.next_in  = (Bytef *)pvSrc;
+
+                /* Inflate until the input is consumed and there is no pending output anymore. */
+                do
                 {
-                    size_t cbDecompLeft = sizeof(abDecomp) - offDecomp;
+                    void *pvDst = NULL;
+                    size_t cbDst = 0;
+                    bool fDirect = pspDevCcpXferCtxQueryDstDirect(&XferCtx, &pvDst, &cbDst);
+                    if (!fDirect)
+                    {
+                        pvDst = &abDecomp[0];
+                        cbDst = sizeof(abDecomp);
+                    }
+                    else
+                        cbDst = MIN(cbDst, UINT32_MAX);
 
-                    pThis->Zlib.next_out  = (Bytef *)&abDecomp[offDecomp];
-                    pThis->Zlib.avail_out = cbDecompLeft;
+                    pThis->Zlib.next_out  = (Bytef *)pvDst;
+                    pThis->Zlib.avail_out = cbDst;
 
-                    int rcZlib = inflate(&pThis->Zlib, Z_NO_FLUSH);
-                    if (pThis->Zlib.avail_out < cbDecompLeft)
+                    rcZlib = inflate(&pThis->Zlib, Z_NO_FLUSH);
+                    size_t cbOut = cbDst - pThis->Zlib.avail_out;
+                    if (cbOut)
                     {
-                        offDecomp += cbDecompLeft - pThis->Zlib.avail_out;
-                        /* Write the chunk if the decompression buffer is full. */
-                        if (offDecomp == sizeof(abDecomp))
-                        {
-                            rc = pspDevCcpXferCtxWrite(&XferCtx, &abDecomp[0], sizeof(abDecomp), NULL);
-                            offDecomp = 0; /* Off to the next round. */
-                        }
+                        if (fDirect)
+                            pspDevCcpXferCtxDstAdvance(&XferCtx, cbOut);
+                        else
+                            rc = pspDevCcpXferCtxWrite(&XferCtx, &abDecomp[0], cbOut, NULL);
                     }
-                    if (   !rc
-                        && rcZlib == Z_STREAM_END)
+
+                    if (rcZlib == Z_BUF_ERROR) /* No progress possible, need more input. */
                         break;
-                }
+                    else if (rcZlib < 0)
+                    {
+                        pspDevCcpTraceEvtAddStr(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_CCP,
+                                                "CCP: ZLIB inflate() failed with %d\n", rcZlib);
+                        rc = -1;
+                    }
+                } while (   !rc
+                         && rcZlib != Z_STREAM_END
+                         && (   pThis->Zlib.avail_in
+                             || !pThis->Zlib.avail_out));
             }
 
             cbReadLeft -= cbThisRead;
         }
 
-        /* Write the last chunk. */
-        if (   !rc
-            && offDecomp)
-            rc = pspDevCcpXferCtxWrite(&XferCtx, &abDecomp[0], offDecomp, NULL);
-
         if (fEom)
         {
-            int rcZlib = inflateEnd(&pThis->Zlib);
+            rcZlib = inflateEnd(&pThis->Zlib);
             if (   rcZlib < 0
                 && !rc)
                 rc = -1;
@@ -1321,6 +2367,120 @@ static int pspDevCcpReqZlibProcess(PPSPDEVCCP pThis, PCCCP5REQ pReq, uint32_t uF
 }
 
 
+/**
+ * Computes the RSA result cache key for the given request content.
+ *
+ * @returns Status code.
+ * @param   pbExp               The exponent buffer as given in the key.
+ * @param   cbExp               Size of the exponent buffer in bytes.
+ * @param   pbSrc               The source buffer (modulus followed by the message).
+ * @param   cbSrc               Size of the source buffer in bytes.
+ * @param   pszKey              Where to store the key as a hex string.
+ * @param   cbKey               Size of the key buffer in bytes (at least 2 * SHA256 digest size + 1).
+ */
+static int pspDevCcpRsaCacheKeyCompute(const uint8_t *pbExp, size_t cbExp, const uint8_t *pbSrc, size_t cbSrc,
+                                       char *pszKey, size_t cbKey)
+{
+    int rc = 0;
+    EVP_MD_CTX *pOsslShaCtx = EVP_MD_CTX_new();
+    if (pOsslShaCtx)
+    {
+        uint8_t abDigest[32];
+        uint32_t cbExpLe = (uint32_t)cbExp;
+
+        /* The exponent size is part of the key so different key sizes never collide. */
+        if (   EVP_DigestInit_ex(pOsslShaCtx, EVP_sha256(), NULL) == 1
+            && EVP_DigestUpdate(pOsslShaCtx, &cbExpLe, sizeof(cbExpLe)) == 1
+            && EVP_DigestUpdate(pOsslShaCtx, pbExp, cbExp) == 1
+            && EVP_DigestUpdate(pOsslShaCtx, pbSrc, cbSrc) == 1
+            && EVP_DigestFinal_ex(pOsslShaCtx, &abDigest[0], NULL) == 1
+            && cbKey >= 2 * sizeof(abDigest) + 1)
+        {
+            for (unsigned i = 0; i < sizeof(abDigest); i++)
+                snprintf(&pszKey[i * 2], cbKey - i * 2, "%02x", abDigest[i]);
+        }
+        else
+            rc = -1;
+
+        EVP_MD_CTX_free(pOsslShaCtx);
+    }
+    else
+        rc = -1;
+
+    return rc;
+}
+
+
+/**
+ * Tries to get the RSA result for the given key from the on disk cache.
+ *
+ * @returns Status code, STS_ERR_NOT_FOUND if there is no cache entry.
+ * @param   pThis               The CCP device instance data.
+ * @param   pszKey              The cache key.
+ * @param   pbResult            Where to store the result.
+ * @param   cbResult            Expected size of the result in bytes.
+ */
+static int pspDevCcpRsaCacheLookup(PPSPDEVCCP pThis, const char *pszKey, uint8_t *pbResult, size_t cbResult)
+{
+    int rc = STS_ERR_NOT_FOUND;
+    char szPath[4096];
+
+    snprintf(&szPath[0], sizeof(szPath), "%s/%s", pThis->pDev->pCfg->pszCcpRsaCache, pszKey);
+    FILE *pFile = fopen(&szPath[0], "rb");
+    if (pFile)
+    {
+        uint8_t bEof;
+
+        /* The entry must have exactly the expected size, anything else is considered corrupted. */
+        if (   fread(pbResult, cbResult, 1, pFile) == 1
+            && fread(&bEof, 1, 1, pFile) == 0)
+            rc = STS_INF_SUCCESS;
+
+        fclose(pFile);
+    }
+
+    return rc;
+}
+
+
+/**
+ * Stores the given RSA result in the on disk cache.
+ *
+ * @returns nothing.
+ * @param   pThis               The CCP device instance data.
+ * @param   pszKey              The cache key.
+ * @param   pbResult            The result to store.
+ * @param   cbResult            Size of the result in bytes.
+ *
+ * @note The entry is written to a temporary file first and renamed afterwards so concurrent emulator
+ *       instances sharing the cache never see partially written entries. Failing to store is not fatal.
+ */
+static void pspDevCcpRsaCacheStore(PPSPDEVCCP pThis, const char *pszKey, const uint8_t *pbResult, size_t cbResult)
+{
+    char szPath[4096];
+    char szPathTmp[4096];
+
+    snprintf(&szPath[0], sizeof(szPath), "%s/%s", pThis->pDev->pCfg->pszCcpRsaCache, pszKey);
+    snprintf(&szPathTmp[0], sizeof(szPathTmp), "%s.%d.%p.tmp", &szPath[0], (int)getpid(), pThis);
+
+    FILE *pFile = fopen(&szPathTmp[0], "wb");
+    if (pFile)
+    {
+        bool fOk = fwrite(pbResult, cbResult, 1, pFile) == 1;
+        if (fclose(pFile))
+            fOk = false;
+
+        if (   !fOk
+            || rename(&szPathTmp[0], &szPath[0]))
+        {
+            remove(&szPathTmp[0]);
+            pspDevCcpTraceEvtAddStr(NULL, PSPTRACEEVTSEVERITY_WARNING, PSPTRACEEVTORIGIN_CCP,
+                                    "CCP: Failed to store RSA result cache entry %s\n", &szPath[0]);
+        }
+    }
+}
+
+
 /**
  * Processes a RSA request.
  *
@@ -1347,7 +2507,35 @@ static int pspDevCcpReqRsaProcess(PPSPDEVCCP pThis, PCCCP5REQ pReq, uint32_t uFu
     {
         /* The key contains the exponent as a 2048bit or 4096bit integer. */
         uint8_t abExp[512];
+        CCPXFERCTX XferCtx;
+        /*
+         * The source buffer contains the modulus as a 2048bit integer in little endian format
+         * followed by the message the process (why the modulus is not part of the key buffer
+         * remains a mystery).
+         */
+        uint8_t abData[1024];
+        uint8_t abResult[512];
+        char szCacheKey[2 * 32 + 1];
+        bool fCacheKeyValid = false;
+
         rc = pspDevCcpKeyCopyFromReq(pThis, pReq, uSz, &abExp[0]);
+        if (!rc)
+            rc = pspDevCcpXferCtxInit(&XferCtx, pThis, pReq, false /*fSha*/, uSz,
+                                      false /*fWriteRev*/);
+        if (!rc)
+            rc = pspDevCcpXferCtxRead(&XferCtx, &abData[0], pReq->cbSrc, NULL);
+
+        /* The result depends only on the exponent, modulus and message so it can be served from the cache. */
+        if (   !rc
+            && pThis->pDev->pCfg->pszCcpRsaCache)
+        {
+            fCacheKeyValid = !pspDevCcpRsaCacheKeyCompute(&abExp[0], uSz / 2, &abData[0], pReq->cbSrc,
+                                                          &szCacheKey[0], sizeof(szCacheKey));
+            if (   fCacheKeyValid
+                && STS_SUCCESS(pspDevCcpRsaCacheLookup(pThis, &szCacheKey[0], &abResult[0], uSz)))
+                return pspDevCcpXferCtxWrite(&XferCtx, &abResult[0], uSz, NULL);
+        }
+
         if (!rc)
         {
             bool fFreeBignums = true;
@@ -1355,50 +2543,34 @@ static int pspDevCcpReqRsaProcess(PPSPDEVCCP pThis, PCCCP5REQ pReq, uint32_t uFu
             RSA *pRsaPubKey = RSA_new();
             if (pExp && pRsaPubKey)
             {
-                CCPXFERCTX XferCtx;
-                rc = pspDevCcpXferCtxInit(&XferCtx, pThis, pReq, false /*fSha*/, uSz,
-                                          false /*fWriteRev*/);
-                if (!rc)
+                BIGNUM *pMod = BN_lebin2bn(&abData[0], pReq->cbSrc / 2, NULL);
+                if (pMod)
                 {
-                    /*
-                     * The source buffer contains the modulus as a 2048bit integer in little endian format
-                     * followed by the message the process (why the modulus is not part of the key buffer
-                     * remains a mystery).
-                     */
-                    uint8_t abData[1024];
-
-                    rc = pspDevCcpXferCtxRead(&XferCtx, &abData[0], pReq->cbSrc, NULL);
-                    if (!rc)
+                    RSA_set0_key(pRsaPubKey, pMod, pExp, NULL);
+
+                    /* The RSA public key structure has taken over the memory and freeing it will free the exponent and modulus as well. */
+                    fFreeBignums = false;
+
+                    /* Need to convert to little endian format. */
+                    pspDevCcpReverseBuf(&abData[uSz], pReq->cbSrc / 2);
+                    size_t cbEnc = RSA_public_encrypt(pReq->cbSrc / 2, &abData[uSz], &abResult[0], pRsaPubKey, RSA_NO_PADDING);
+                    if (cbEnc == uSz)
                     {
-                        BIGNUM *pMod = BN_lebin2bn(&abData[0], pReq->cbSrc / 2, NULL);
-                        if (pMod)
-                        {
-                            uint8_t abResult[512];
-
-                            RSA_set0_key(pRsaPubKey, pMod, pExp, NULL);
-
-                            /* The RSA public key structure has taken over the memory and freeing it will free the exponent and modulus as well. */
-                            fFreeBignums = false;
-
-                            /* Need to convert to little endian format. */
-                            pspDevCcpReverseBuf(&abData[uSz], pReq->cbSrc / 2);
-                            size_t cbEnc = RSA_public_encrypt(pReq->cbSrc / 2, &abData[uSz], &abResult[0], pRsaPubKey, RSA_NO_PADDING);
-                            if (cbEnc == uSz)
-                            {
-                                /* Need to swap endianess of result buffer as well. */
-                                pspDevCcpReverseBuf(&abResult[0], uSz);
-                                rc = pspDevCcpXferCtxWrite(&XferCtx, &abResult[0], uSz, NULL);
-                            }
-                            else
-                                rc = -1;
-
-                            if (fFreeBignums)
-                                BN_clear_free(pMod);
-                        }
-                        else
-                            rc = -1;
+                        /* Need to swap endianess of result buffer as well. */
+                        pspDevCcpReverseBuf(&abResult[0], uSz);
+                        rc = pspDevCcpXferCtxWrite(&XferCtx, &abResult[0], uSz, NULL);
+                        if (   !rc
+                            && fCacheKeyValid)
+                            pspDevCcpRsaCacheStore(pThis, &szCacheKey[0], &abResult[0], uSz);
                     }
+                    else
+                        rc = -1;
+
+                    if (fFreeBignums)
+                        BN_clear_free(pMod);
                 }
+                else
+                    rc = -1;
             }
             else
                 rc = -1;
@@ -1411,7 +2583,7 @@ static int pspDevCcpReqRsaProcess(PPSPDEVCCP pThis, PCCCP5REQ pReq, uint32_t uFu
     }
     else
     {
-        PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_CCP,
+        pspDevCcpTraceEvtAddStr(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_CCP,
                                 "CCP: RSA ERROR uMode=%u uSz=%u not implemented yet!\n",
                                 uMode, uSz);
         rc = -1;
@@ -1464,10 +2636,20 @@ static int pspDevCcpReqProcess(PPSPDEVCCP pThis, PCCCP5REQ pReq)
             break;
         }
         case CCP_V5_ENGINE_XTS_AES128:
+        {
+            rc = pspDevCcpReqXtsAes128Process(pThis, pReq, uFunction, fInit, fEom);
+            break;
+        }
         case CCP_V5_ENGINE_DES3:
+        {
+            rc = pspDevCcpReqDes3Process(pThis, pReq, uFunction, fInit, fEom);
+            break;
+        }
         case CCP_V5_ENGINE_ECC:
-            /** @todo */
+        {
+            rc = pspDevCcpReqEccProcess(pThis, pReq, uFunction, fInit, fEom);
             break;
+        }
         default:
             rc = -1;
     }
@@ -1476,6 +2658,221 @@ static int pspDevCcpReqProcess(PPSPDEVCCP pThis, PCCCP5REQ pReq)
 }
 
 
+/**
+ * Processes all requests between the tail and head pointer of the given queue and
+ * sets the halt bit afterwards.
+ *
+ * @returns nothing.
+ * @param   pThis               The CCP device instance data.
+ * @param   pQueue              The queue to process.
+ *
+ * @note Might get called from the queue worker thread, the register updates are published with
+ *       release semantics so the guest sees the results of the requests once it sees the halt bit.
+ */
+static void pspDevCcpQueueProcess(PPSPDEVCCP pThis, PCCPQUEUE pQueue)
+{
+    uint32_t u32ReqTail = __atomic_load_n(&pQueue->u32RegReqTail, __ATOMIC_ACQUIRE);
+    uint32_t u32ReqHead = __atomic_load_n(&pQueue->u32RegReqHead, __ATOMIC_ACQUIRE);
+    uint32_t fIntSts = CCP_V5_Q_REG_INT_F_QUEUE_STOPPED | CCP_V5_Q_REG_INT_F_QUEUE_EMPTY;
+
+    while (u32ReqTail < u32ReqHead)
+    {
+        CCP5REQ Req;
+
+        int rc = pspDevCcpXferMemLocalRead(pThis, u32ReqTail, &Req, sizeof(Req));
+        if (!rc)
+        {
+            pspDevCcpDumpReq(&Req, u32ReqTail);
+            rc = pspDevCcpReqProcess(pThis, &Req);
+            if (!rc)
+                __atomic_store_n(&pQueue->u32RegSts, CCP_V5_Q_REG_STATUS_SUCCESS, __ATOMIC_RELAXED);
+            else
+            {
+                __atomic_store_n(&pQueue->u32RegSts, CCP_V5_Q_REG_STATUS_ERROR, __ATOMIC_RELAXED);
+                fIntSts |= CCP_V5_Q_REG_INT_F_ERROR;
+            }
+        }
+        else
+        {
+            printf("CCP: Failed to read request from 0x%08x with rc=%d\n", u32ReqTail, rc);
+            __atomic_store_n(&pQueue->u32RegSts, CCP_V5_Q_REG_STATUS_ERROR, __ATOMIC_RELAXED); /* Signal error. */
+            fIntSts |= CCP_V5_Q_REG_INT_F_ERROR;
+            fIntSts &= ~CCP_V5_Q_REG_INT_F_QUEUE_EMPTY;
+            break;
+        }
+
+        u32ReqTail += sizeof(Req);
+    }
+
+    if (!(fIntSts & CCP_V5_Q_REG_INT_F_ERROR))
+        fIntSts |= CCP_V5_Q_REG_INT_F_COMPLETION;
+
+    /* Set halt bit again, this must come last. */
+    __atomic_store_n(&pQueue->u32RegReqTail, u32ReqTail, __ATOMIC_RELAXED);
+    __atomic_or_fetch(&pQueue->u32RegIntSts, fIntSts, __ATOMIC_RELAXED);
+    __atomic_or_fetch(&pQueue->u32RegCtrl, CCP_V5_Q_REG_CTRL_HALT, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Checks whether all requests of the given queue only access the directly backed SRAM, so they can be
+ * processed by the worker without calling into the I/O manager or the PSP core.
+ *
+ * @returns Flag whether the queue can be processed by the worker.
+ * @param   pThis               The CCP device instance data.
+ * @param   pQueue              The queue to check.
+ * @param   ppvSram             Where to store the host mapping of the SRAM on success.
+ * @param   pcbSram             Where to store the size of the SRAM on success.
+ *
+ * @note Must be called on the emulation thread. The sizes of the destination and key depend on the engine,
+ *       so only their start is checked here, accesses running past the end of the SRAM fail the request.
+ */
+static bool pspDevCcpQueueAsyncCheck(PPSPDEVCCP pThis, PCCPQUEUE pQueue, void **ppvSram, size_t *pcbSram)
+{
+    void *pvSram = NULL;
+    size_t cbSram = 0;
+
+    /* The proxy is used by the emulation thread as well. */
+    if (pThis->pDev->pCfg->pCcpProxyIf)
+        return false;
+
+    /* The SRAM always starts at address 0. */
+    int rc = PSPEmuIoMgrPspAddrQueryBacking(pThis->pDev->hIoMgr, 0 /*PspAddr*/, &pvSram, &cbSram);
+    if (   STS_FAILURE(rc)
+        || !cbSram)
+        return false;
+
+    uint32_t u32ReqTail = __atomic_load_n(&pQueue->u32RegReqTail, __ATOMIC_ACQUIRE);
+    uint32_t u32ReqHead = __atomic_load_n(&pQueue->u32RegReqHead, __ATOMIC_ACQUIRE);
+    while (u32ReqTail < u32ReqHead)
+    {
+        CCP5REQ Req;
+
+        if (!pspDevCcpSramRangeIsValid(cbSram, u32ReqTail, sizeof(Req)))
+            return false;
+
+        memcpy(&Req, (uint8_t *)pvSram + u32ReqTail, sizeof(Req));
+        if (   CCP_V5_MEM_TYPE_GET(Req.u16SrcMemType) == CCP_V5_MEM_TYPE_LOCAL
+            && !pspDevCcpSramRangeIsValid(cbSram, CCP_ADDR_CREATE_FROM_HI_LO(Req.u16AddrSrcHigh, Req.u32AddrSrcLow), Req.cbSrc))
+            return false;
+        if (   CCP_V5_ENGINE_GET(Req.u32Dw0) != CCP_V5_ENGINE_SHA
+            && CCP_V5_MEM_TYPE_GET(Req.Op.NonSha.u16DstMemType) == CCP_V5_MEM_TYPE_LOCAL
+            && !pspDevCcpSramRangeIsValid(cbSram, CCP_ADDR_CREATE_FROM_HI_LO(Req.Op.NonSha.u16AddrDstHigh, Req.Op.NonSha.u32AddrDstLow), 1))
+            return false;
+        if (   CCP_V5_MEM_TYPE_GET(Req.u16KeyMemType) == CCP_V5_MEM_TYPE_LOCAL
+            && !pspDevCcpSramRangeIsValid(cbSram, CCP_ADDR_CREATE_FROM_HI_LO(Req.u16AddrKeyHigh, Req.u32AddrKeyLow), 1))
+            return false;
+
+        u32ReqTail += sizeof(Req);
+    }
+
+    *ppvSram = pvSram;
+    *pcbSram = cbSram;
+    return true;
+}
+
+
+/**
+ * Queue worker thread.
+ *
+ * @returns Opaque return value.
+ * @param   pvUser              The queue this worker processes.
+ */
+static void *pspDevCcpQueueWorker(void *pvUser)
+{
+    PCCPQUEUE pQueue = (PCCPQUEUE)pvUser;
+    PPSPDEVCCP pThis = pQueue->pCcp;
+
+    g_fCcpWorkerThread = true;
+
+    pthread_mutex_lock(&pQueue->Mtx);
+    for (;;)
+    {
+        while (   !pQueue->fKick
+               && !pQueue->fShutdown)
+            pthread_cond_wait(&pQueue->CondKick, &pQueue->Mtx);
+
+        if (pQueue->fShutdown)
+            break;
+
+        /* The lock stays held so the emulation thread can't process the queue synchronously at the same time. */
+        pQueue->fKick  = false;
+        pThis->pbSram  = (uint8_t *)pQueue->pvSramKick;
+        pThis->cbSram  = pQueue->cbSramKick;
+        pspDevCcpQueueProcess(pThis, pQueue);
+        pThis->pbSram  = NULL;
+        pThis->cbSram  = 0;
+
+        /* The firmware might wait for the completion in a WFI. */
+        PSPEmuIoMgrCoreWakeup(pThis->pDev->hIoMgr);
+    }
+    pthread_mutex_unlock(&pQueue->Mtx);
+
+    return NULL;
+}
+
+
+/**
+ * Creates the worker thread for the given queue.
+ *
+ * @returns Status code.
+ * @param   pThis               The CCP device instance data.
+ * @param   pQueue              The queue to create the worker for.
+ */
+static int pspDevCcpQueueWorkerCreate(PPSPDEVCCP pThis, PCCPQUEUE pQueue)
+{
+    pQueue->pCcp       = pThis;
+    pQueue->fKick      = false;
+    pQueue->fShutdown  = false;
+    pQueue->pvSramKick = NULL;
+    pQueue->cbSramKick = 0;
+
+    int rcPsx = pthread_mutex_init(&pQueue->Mtx, NULL);
+    if (!rcPsx)
+    {
+        rcPsx = pthread_cond_init(&pQueue->CondKick, NULL);
+        if (!rcPsx)
+        {
+            rcPsx = pthread_create(&pQueue->hThrdWorker, NULL, pspDevCcpQueueWorker, pQueue);
+            if (!rcPsx)
+            {
+                pQueue->fWorker = true;
+                return 0;
+            }
+
+            pthread_cond_destroy(&pQueue->CondKick);
+        }
+
+        pthread_mutex_destroy(&pQueue->Mtx);
+    }
+
+    return -1;
+}
+
+
+/**
+ * Terminates the worker thread of the given queue, waiting for the batch currently being processed.
+ *
+ * @returns nothing.
+ * @param   pQueue              The queue to destroy the worker for.
+ */
+static void pspDevCcpQueueWorkerDestroy(PCCPQUEUE pQueue)
+{
+    if (!pQueue->fWorker)
+        return;
+
+    pthread_mutex_lock(&pQueue->Mtx);
+    pQueue->fShutdown = true;
+    pthread_cond_signal(&pQueue->CondKick);
+    pthread_mutex_unlock(&pQueue->Mtx);
+
+    pthread_join(pQueue->hThrdWorker, NULL);
+    pthread_cond_destroy(&pQueue->CondKick);
+    pthread_mutex_destroy(&pQueue->Mtx);
+    pQueue->fWorker = false;
+}
+
+
 /**
  * Handles register read from a specific queue.
  *
@@ -1490,6 +2887,7 @@ static void pspDevCcpMmioQueueRegRead(PPSPDEVCCP pThis, PCCPQUEUE pQueue, uint32
     switch (offRegQ)
     {
         case CCP_V5_Q_REG_CTRL:
+        {
             /*
              * This used to be in the write handler where it would make probably more sense
              * but this caused a fatal stack overwrite during the last CCP request of the on chip bootloader
@@ -1520,53 +2918,56 @@ static void pspDevCcpMmioQueueRegRead(PPSPDEVCCP pThis, PCCPQUEUE pQueue, uint32
              * the on chip bootloader survive and successfully call into the off chip bootloader. So the obvious fix with our synchronous
              * CCP implementation is to defer the request until the bootloader polls the control register to wait for the CCP to halt again.
              * Thanks AMD!
+             *
+             * The worker thread doesn't change this as it would finish the copy long before the ARM core has left the
+             * dangerous zone, so it gets kicked here as well and the guest keeps running while polling for the halt bit.
+             * Batches the worker can't process on its own are processed right here while holding the worker lock.
              */
-            if (pQueue->u32RegCtrl & CCP_V5_Q_REG_CTRL_RUN) /* Running bit set? Process requests. */
+            uint32_t u32RegCtrl = __atomic_load_n(&pQueue->u32RegCtrl, __ATOMIC_ACQUIRE);
+            if (u32RegCtrl & CCP_V5_Q_REG_CTRL_RUN) /* Running bit set? Process requests. */
             {
                 /* Clear halt and running bit. */
-                pQueue->u32RegCtrl &= ~(CCP_V5_Q_REG_CTRL_RUN | CCP_V5_Q_REG_CTRL_HALT);
-
-                uint32_t u32ReqTail = pQueue->u32RegReqTail;
-                uint32_t u32ReqHead = pQueue->u32RegReqHead;
+                __atomic_and_fetch(&pQueue->u32RegCtrl, ~(CCP_V5_Q_REG_CTRL_RUN | CCP_V5_Q_REG_CTRL_HALT), __ATOMIC_RELAXED);
 
-                while (u32ReqTail < u32ReqHead)
+                if (pQueue->fWorker)
                 {
-                    CCP5REQ Req;
+                    void *pvSram = NULL;
+                    size_t cbSram = 0;
+                    bool fAsync = pspDevCcpQueueAsyncCheck(pThis, pQueue, &pvSram, &cbSram);
 
-                    int rc = PSPEmuIoMgrPspAddrRead(pThis->pDev->hIoMgr, u32ReqTail, &Req, sizeof(Req));
-                    if (!rc)
+                    pthread_mutex_lock(&pQueue->Mtx);
+                    if (fAsync)
                     {
-                        pspDevCcpDumpReq(&Req, u32ReqTail);
-                        rc = pspDevCcpReqProcess(pThis, &Req);
-                        if (!rc)
-                            pQueue->u32RegSts = CCP_V5_Q_REG_STATUS_SUCCESS;
-                        else
-                            pQueue->u32RegSts = CCP_V5_Q_REG_STATUS_ERROR;
+                        pQueue->pvSramKick = pvSram;
+                        pQueue->cbSramKick = cbSram;
+                        pQueue->fKick      = true;
+                        pthread_cond_signal(&pQueue->CondKick);
                     }
                     else
-                    {
-                        printf("CCP: Failed to read request from 0x%08x with rc=%d\n", u32ReqTail, rc);
-                        pQueue->u32RegSts = CCP_V5_Q_REG_STATUS_ERROR; /* Signal error. */
-                        break;
-                    }
-
-                    u32ReqTail += sizeof(Req);
+                        pspDevCcpQueueProcess(pThis, pQueue);
+                    pthread_mutex_unlock(&pQueue->Mtx);
                 }
-
-                /* Set halt bit again. */
-                pQueue->u32RegReqTail = u32ReqTail;
-                pQueue->u32RegCtrl |= CCP_V5_Q_REG_CTRL_HALT;
+                else
+                    pspDevCcpQueueProcess(pThis, pQueue);
             }
-            *pu32Dst = pQueue->u32RegCtrl;
+            /* Pairs with the release in pspDevCcpQueueProcess() so the request results are visible once halted. */
+            *pu32Dst = __atomic_load_n(&pQueue->u32RegCtrl, __ATOMIC_ACQUIRE);
             break;
+        }
         case CCP_V5_Q_REG_HEAD:
-            *pu32Dst = pQueue->u32RegReqHead;
+            *pu32Dst = __atomic_load_n(&pQueue->u32RegReqHead, __ATOMIC_RELAXED);
             break;
         case CCP_V5_Q_REG_TAIL:
-            *pu32Dst = pQueue->u32RegReqTail;
+            *pu32Dst = __atomic_load_n(&pQueue->u32RegReqTail, __ATOMIC_ACQUIRE);
             break;
         case CCP_V5_Q_REG_STATUS:
-            *pu32Dst = pQueue->u32RegSts;
+            *pu32Dst = __atomic_load_n(&pQueue->u32RegSts, __ATOMIC_ACQUIRE);
+            break;
+        case CCP_V5_Q_REG_INT_ENABLE:
+            *pu32Dst = pQueue->u32RegIntEn;
+            break;
+        case CCP_V5_Q_REG_INT_STATUS:
+            *pu32Dst = __atomic_load_n(&pQueue->u32RegIntSts, __ATOMIC_ACQUIRE);
             break;
     }
 }
@@ -1586,16 +2987,22 @@ static void pspDevCcpMmioQueueRegWrite(PPSPDEVCCP pThis, PCCPQUEUE pQueue, uint3
     switch (offRegQ)
     {
         case CCP_V5_Q_REG_CTRL:
-            pQueue->u32RegCtrl = u32Val;
+            __atomic_store_n(&pQueue->u32RegCtrl, u32Val, __ATOMIC_RELEASE);
             break;
         case CCP_V5_Q_REG_HEAD:
-            pQueue->u32RegReqHead = u32Val;
+            __atomic_store_n(&pQueue->u32RegReqHead, u32Val, __ATOMIC_RELEASE);
             break;
         case CCP_V5_Q_REG_TAIL:
-            pQueue->u32RegReqTail = u32Val;
+            __atomic_store_n(&pQueue->u32RegReqTail, u32Val, __ATOMIC_RELEASE);
             break;
         case CCP_V5_Q_REG_STATUS:
-            pQueue->u32RegSts = u32Val;
+            __atomic_store_n(&pQueue->u32RegSts, u32Val, __ATOMIC_RELEASE);
+            break;
+        case CCP_V5_Q_REG_INT_ENABLE:
+            pQueue->u32RegIntEn = u32Val;
+            break;
+        case CCP_V5_Q_REG_INT_STATUS:
+            __atomic_and_fetch(&pQueue->u32RegIntSts, ~u32Val, __ATOMIC_RELEASE);
             break;
     }
 }
@@ -1672,7 +3079,7 @@ static void pspDevCcpMmioRead2(PSPADDR offMmio, size_t cbRead, void *pvDst, void
     switch (offMmio)
     {
         case 0x28: /* Contains the transfer size of the last oepration? (Zen2 uses it to read the decompressed size). */
-            *(uint32_t *)pvDst = pThis->cbWrittenLast;
+            *(uint32_t *)pvDst = __atomic_load_n(&pThis->cbWrittenLast, __ATOMIC_ACQUIRE);
             break;
         case 0x38:
             *(uint32_t *)pvDst = 0x1; /* Zen1 on chip BL waits for bit 0 to become 1. */
@@ -1690,7 +3097,11 @@ static int pspDevCcpInit(PPSPDEV pDev)
     pThis->pDev             = pDev;
     pThis->Queue.u32RegCtrl = CCP_V5_Q_REG_CTRL_HALT; /* Halt bit set. */
     pThis->Queue.u32RegSts  = CCP_V5_Q_REG_STATUS_SUCCESS;
+    pThis->Queue.pCcp       = pThis;
+    pThis->Queue.fWorker    = false;
     pThis->pOsslShaCtx      = NULL;
+    pThis->pbSram           = NULL;
+    pThis->cbSram           = 0;
 
     /* Register MMIO ranges. */
     int rc = PSPEmuIoMgrMmioRegister(pDev->hIoMgr, CCP_V5_MMIO_ADDRESS, CCP_V5_Q_OFFSET + CCP_V5_Q_SIZE,
@@ -1703,13 +3114,19 @@ static int pspDevCcpInit(PPSPDEV pDev)
         rc = PSPEmuIoMgrMmioRegister(pDev->hIoMgr, CCP_V5_MMIO_ADDRESS_2, CCP_V5_MMIO_SIZE_2,
                                      pspDevCcpMmioRead2, NULL, pThis,
                                      "CCPv5 + 0x6000", &pThis->hMmio2);
+    if (   !rc
+        && pDev->pCfg->fCcpAsync)
+        rc = pspDevCcpQueueWorkerCreate(pThis, &pThis->Queue);
     return rc;
 }
 
 
 static void pspDevCcpDestruct(PPSPDEV pDev)
 {
-    /* Nothing to do so far. */
+    PPSPDEVCCP pThis = (PPSPDEVCCP)&pDev->abInstance[0];
+
+    pspDevCcpQueueWorkerDestroy(&pThis->Queue);
+    pspDevCcpCipherCtxFree(pThis);
 }
 
 
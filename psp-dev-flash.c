@@ -24,15 +24,17 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <time.h>
 
-#include <poll.h>
-#include <sys/ioctl.h>
-
 #include <pthread.h>
 
 #include <common/cdefs.h>
@@ -58,22 +60,88 @@ typedef struct REQHDR
 
 #define REQHDR_MAGIC 0xebadc0de
 
+/** Read command. */
+#define REQHDR_CMD_READ     0
+/** Write command. */
+#define REQHDR_CMD_WRITE    1
+
+/** Maximum number of clients connected at the same time. */
+#define EM100_CON_MAX       8
+/** Maximum number of events to retrieve with one epoll_wait() call. */
+#define EM100_EVT_MAX       (EM100_CON_MAX + 2)
+
+
+/**
+ * EM100 connection state.
+ */
+typedef enum EM100CONSTATE
+{
+    /** Invalid state, connection slot is free. */
+    EM100CONSTATE_INVALID = 0,
+    /** Receiving the request header. */
+    EM100CONSTATE_RECV_HDR,
+    /** Receiving the data for a write request. */
+    EM100CONSTATE_RECV_DATA,
+    /** Sending the response and optional read data. */
+    EM100CONSTATE_SEND,
+    /** 32bit hack. */
+    EM100CONSTATE_32BIT_HACK = 0x7fffffff
+} EM100CONSTATE;
+
+
+/**
+ * A single EM100 client connection.
+ */
+typedef struct EM100CON
+{
+    /** Current connection state. */
+    EM100CONSTATE           enmState;
+    /** The socket of the connection. */
+    int                     iFdCon;
+    /** Flag whether the socket is waiting for EPOLLOUT instead of EPOLLIN. */
+    bool                    fWaitSend;
+    /** Flag whether the current request is invalid and the write data is discarded. */
+    bool                    fDiscard;
+    /** The request currently being processed. */
+    REQHDR                  Req;
+    /** Number of bytes of the request header received so far. */
+    size_t                  cbHdrRecv;
+    /** Number of bytes of the write data received so far. */
+    size_t                  cbDataRecv;
+    /** The response status. */
+    int32_t                 rcResp;
+    /** Number of bytes of the response (status and payload) sent so far. */
+    size_t                  cbRespSent;
+} EM100CON;
+/** Pointer to a EM100 client connection. */
+typedef EM100CON *PEM100CON;
+
 
 /**
  * EM100 emulation state.
  */
 typedef struct EM100EMU
 {
-    /** Flag whether it should be running. */
-    bool                    fRunning;
+    /** Number of flash devices referencing this state. */
+    uint32_t                cRefs;
     /** The port to listen on. */
     uint16_t                uPort;
     /** The thread which handles the network I/O. */
     pthread_t               hThrdIo;
+    /** The epoll instance. */
+    int                     iFdEpoll;
+    /** The listening socket. */
+    int                     iFdListening;
+    /** Event file descriptor used to tell the I/O thread to terminate. */
+    int                     iFdEvtTerm;
     /** Flash image pointer. */
     void                    *pvFlash;
     /** Size of the flash. */
     size_t                  cbFlash;
+    /** Lock protecting the flash image against concurrent accesses from the network and the emulation. */
+    pthread_mutex_t         MtxFlash;
+    /** The client connections. */
+    EM100CON                aCons[EM100_CON_MAX];
 } EM100EMU;
 /** Pointer to the EM100 emulation state. */
 typedef EM100EMU *PEM100EMU;
@@ -122,84 +190,324 @@ static uint64_t pspDevFlashGetTimeNs(void)
 }
 
 
+/** The EM100 network emulation state shared by all flash devices (the flash image is shared as well). */
+static PEM100EMU g_pEm100 = NULL;
+/** Protects g_pEm100 during creation and destruction. */
+static pthread_mutex_t g_MtxEm100 = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * Locks the flash image for access.
+ *
+ * @returns nothing.
+ * @param   pThis                   The EM100 network emulation state.
+ */
+static inline void pspEm100FlashLock(PEM100EMU pThis)
+{
+    pthread_mutex_lock(&pThis->MtxFlash);
+}
+
+
+/**
+ * Unlocks the flash image.
+ *
+ * @returns nothing.
+ * @param   pThis                   The EM100 network emulation state.
+ */
+static inline void pspEm100FlashUnlock(PEM100EMU pThis)
+{
+    pthread_mutex_unlock(&pThis->MtxFlash);
+}
+
+
+/**
+ * Closes the given connection and frees the slot.
+ *
+ * @returns nothing.
+ * @param   pThis                   The EM100 network emulation state.
+ * @param   pCon                    The connection to close.
+ */
+static void pspEm100ConClose(PEM100EMU pThis, PEM100CON pCon)
+{
+    epoll_ctl(pThis->iFdEpoll, EPOLL_CTL_DEL, pCon->iFdCon, NULL);
+    close(pCon->iFdCon);
+    pCon->iFdCon   = -1;
+    pCon->enmState = EM100CONSTATE_INVALID;
+}
+
+
 /**
- * I/O loop for a single connection.
+ * Switches the events the connection waits for between receiving and sending.
  *
  * @returns Status code.
  * @param   pThis                   The EM100 network emulation state.
- * @param   iFdCon                  File descriptor of the socket.
+ * @param   pCon                    The connection.
+ * @param   fWaitSend               Flag whether to wait for the socket becoming writable.
  */
-static int pspEm100ConIoLoop(PEM100EMU pThis, int iFdCon)
+static int pspEm100ConWaitSet(PEM100EMU pThis, PEM100CON pCon, bool fWaitSend)
 {
-    int rc = 0;
-    void *pvScratch = NULL;
-    size_t cbScratch = 0;
+    if (pCon->fWaitSend == fWaitSend)
+        return 0;
 
-    do
+    struct epoll_event Evt;
+    Evt.events   = fWaitSend ? EPOLLOUT : EPOLLIN;
+    Evt.data.ptr = pCon;
+    int rcPsx = epoll_ctl(pThis->iFdEpoll, EPOLL_CTL_MOD, pCon->iFdCon, &Evt);
+    if (rcPsx)
+        return -1;
+
+    pCon->fWaitSend = fWaitSend;
+    return 0;
+}
+
+
+/**
+ * Checks the received request header and sets up the connection state for processing it.
+ *
+ * @returns Status code, failure if the connection should be dropped.
+ * @param   pThis                   The EM100 network emulation state.
+ * @param   pCon                    The connection.
+ */
+static int pspEm100ConReqStart(PEM100EMU pThis, PEM100CON pCon)
+{
+    if (pCon->Req.u32Magic != REQHDR_MAGIC)
+        return -1;
+
+    bool fValid = (uint64_t)pCon->Req.u32AddrStart + pCon->Req.cbXfer <= pThis->cbFlash;
+    pCon->rcResp     = fValid ? 0 : -1;
+    pCon->cbDataRecv = 0;
+    pCon->cbRespSent = 0;
+
+    if (pCon->Req.u32Cmd == REQHDR_CMD_WRITE)
+    {
+        /* There is no data to receive for an empty write, respond right away. */
+        pCon->fDiscard = !fValid;
+        pCon->enmState = pCon->Req.cbXfer ? EM100CONSTATE_RECV_DATA : EM100CONSTATE_SEND;
+    }
+    else if (pCon->Req.u32Cmd == REQHDR_CMD_READ)
+        pCon->enmState = EM100CONSTATE_SEND;
+    else
+        return -1;
+
+    return 0;
+}
+
+
+/**
+ * Receives as much as possible without blocking for the current request.
+ *
+ * @returns Status code, failure if the connection should be dropped.
+ * @param   pThis                   The EM100 network emulation state.
+ * @param   pCon                    The connection.
+ * @param   pfWouldBlock            Where to store whether no more data is available right now.
+ */
+static int pspEm100ConRecv(PEM100EMU pThis, PEM100CON pCon, bool *pfWouldBlock)
+{
+    ssize_t cbRecv;
+
+    if (pCon->enmState == EM100CONSTATE_RECV_HDR)
+        cbRecv = recv(pCon->iFdCon, (uint8_t *)&pCon->Req + pCon->cbHdrRecv, sizeof(pCon->Req) - pCon->cbHdrRecv, MSG_DONTWAIT);
+    else if (!pCon->fDiscard)
+    {
+        /* Write data goes straight into the flash image. */
+        pspEm100FlashLock(pThis);
+        cbRecv = recv(pCon->iFdCon, (uint8_t *)pThis->pvFlash + pCon->Req.u32AddrStart + pCon->cbDataRecv,
+                      pCon->Req.cbXfer - pCon->cbDataRecv, MSG_DONTWAIT);
+        pspEm100FlashUnlock(pThis);
+    }
+    else
+    {
+        uint8_t abDiscard[_4K];
+        cbRecv = recv(pCon->iFdCon, &abDiscard[0], MIN(sizeof(abDiscard), pCon->Req.cbXfer - pCon->cbDataRecv), MSG_DONTWAIT);
+    }
+
+    if (cbRecv == -1)
     {
-        /* Receive the header first. */
-        REQHDR Req;
-        ssize_t cbRecv = recv(iFdCon, &Req, sizeof(Req), 0);
-        if (   cbRecv == sizeof(Req)
-            && Req.u32Magic == REQHDR_MAGIC)
+        if (   errno == EAGAIN
+            || errno == EWOULDBLOCK
+            || errno == EINTR)
         {
-            if (cbScratch < Req.cbXfer)
-            {
-                void *pvNew = realloc(pvScratch, Req.cbXfer);
-                if (pvNew)
-                {
-                    pvScratch = pvNew;
-                    cbScratch = Req.cbXfer;
-                }
-            }
+            *pfWouldBlock = errno != EINTR;
+            return 0;
+        }
 
-            if (cbScratch >= Req.cbXfer)
-            {
-                int rcReq = 0;
+        return -1;
+    }
+    else if (!cbRecv) /* Connection closed. */
+        return -1;
 
-                if (Req.u32Cmd == 1)
-                {
-                    /* Receive the data to write. */
-                    cbRecv = recv(iFdCon, pvScratch, Req.cbXfer, 0);
-                    if (cbRecv == Req.cbXfer)
-                        memcpy((uint8_t *)pThis->pvFlash + Req.u32AddrStart, pvScratch, Req.cbXfer);
-                    else
-                        rc = -1;
-                }
-                else
-                    memcpy(pvScratch, (uint8_t *)pThis->pvFlash + Req.u32AddrStart, Req.cbXfer);
+    *pfWouldBlock = false;
+    if (pCon->enmState == EM100CONSTATE_RECV_HDR)
+    {
+        pCon->cbHdrRecv += cbRecv;
+        if (pCon->cbHdrRecv == sizeof(pCon->Req))
+        {
+            pCon->cbHdrRecv = 0;
+            return pspEm100ConReqStart(pThis, pCon);
+        }
+    }
+    else
+    {
+        pCon->cbDataRecv += cbRecv;
+        if (pCon->cbDataRecv == pCon->Req.cbXfer)
+            pCon->enmState = EM100CONSTATE_SEND;
+    }
 
-                /* Send response and optional data. */
-                int32_t rcResp = 0;
-                ssize_t cbSend = send(iFdCon, &rcResp, sizeof(rcResp), 0);
-                if (cbSend == sizeof(rcResp))
-                {
-                    if (   Req.u32Cmd == 0
-                        && rcResp == 0)
-                    {
-                        /* Send payload on successful read. */
-                        cbSend = send(iFdCon, pvScratch, Req.cbXfer, 0);
-                        if (cbSend != Req.cbXfer)
-                            rc = -1;
-                    }
-                }
-                else
-                    rc = -1;
-            }
-            else
-                rc = -1;
+    return 0;
+}
+
+
+/**
+ * Sends as much of the response as possible without blocking, read data is sent straight from the flash image.
+ *
+ * @returns Status code, failure if the connection should be dropped.
+ * @param   pThis                   The EM100 network emulation state.
+ * @param   pCon                    The connection.
+ * @param   pfWouldBlock            Where to store whether the socket can't take more data right now.
+ */
+static int pspEm100ConSend(PEM100EMU pThis, PEM100CON pCon, bool *pfWouldBlock)
+{
+    size_t cbPayload = (   pCon->Req.u32Cmd == REQHDR_CMD_READ
+                        && !pCon->rcResp)
+                     ? pCon->Req.cbXfer
+                     : 0;
+    size_t cbResp = sizeof(pCon->rcResp) + cbPayload;
+    struct iovec aIoVec[2];
+    unsigned cIoVec = 0;
+
+    if (pCon->cbRespSent < sizeof(pCon->rcResp))
+    {
+        aIoVec[cIoVec].iov_base = (uint8_t *)&pCon->rcResp + pCon->cbRespSent;
+        aIoVec[cIoVec].iov_len  = sizeof(pCon->rcResp) - pCon->cbRespSent;
+        cIoVec++;
+    }
+    if (cbPayload)
+    {
+        size_t offPayload = pCon->cbRespSent > sizeof(pCon->rcResp) ? pCon->cbRespSent - sizeof(pCon->rcResp) : 0;
+        aIoVec[cIoVec].iov_base = (uint8_t *)pThis->pvFlash + pCon->Req.u32AddrStart + offPayload;
+        aIoVec[cIoVec].iov_len  = cbPayload - offPayload;
+        cIoVec++;
+    }
+
+    /* Don't get killed by SIGPIPE when the client went away in the middle of the response. */
+    struct msghdr Msg;
+    memset(&Msg, 0, sizeof(Msg));
+    Msg.msg_iov    = &aIoVec[0];
+    Msg.msg_iovlen = cIoVec;
+
+    pspEm100FlashLock(pThis);
+    ssize_t cbSent = sendmsg(pCon->iFdCon, &Msg, MSG_NOSIGNAL);
+    pspEm100FlashUnlock(pThis);
+
+    if (cbSent == -1)
+    {
+        if (   errno == EAGAIN
+            || errno == EWOULDBLOCK
+            || errno == EINTR)
+        {
+            *pfWouldBlock = errno != EINTR;
+            return 0;
         }
+
+        return -1;
+    }
+
+    *pfWouldBlock = false;
+    pCon->cbRespSent += cbSent;
+    if (pCon->cbRespSent == cbResp)
+        pCon->enmState = EM100CONSTATE_RECV_HDR;
+
+    return 0;
+}
+
+
+/**
+ * Processes the given connection until it would block, handling any number of pipelined requests.
+ *
+ * @returns Status code, failure if the connection should be dropped.
+ * @param   pThis                   The EM100 network emulation state.
+ * @param   pCon                    The connection.
+ */
+static int pspEm100ConProcess(PEM100EMU pThis, PEM100CON pCon)
+{
+    int rc = 0;
+    bool fWouldBlock = false;
+
+    while (   !rc
+           && !fWouldBlock)
+    {
+        if (pCon->enmState == EM100CONSTATE_SEND)
+            rc = pspEm100ConSend(pThis, pCon, &fWouldBlock);
         else
-            rc = -1;
-    } while (!rc);
+            rc = pspEm100ConRecv(pThis, pCon, &fWouldBlock);
+    }
+
+    if (!rc)
+        rc = pspEm100ConWaitSet(pThis, pCon, pCon->enmState == EM100CONSTATE_SEND);
 
-    if (pvScratch)
-        free(pvScratch);
-    close(iFdCon);
     return rc;
 }
 
 
+/**
+ * Accepts a new client connection.
+ *
+ * @returns nothing.
+ * @param   pThis                   The EM100 network emulation state.
+ */
+static void pspEm100ConAccept(PEM100EMU pThis)
+{
+    int iFdCon = accept(pThis->iFdListening, (struct sockaddr *)NULL, NULL);
+    if (iFdCon == -1)
+        return;
+
+    int fFlags = fcntl(iFdCon, F_GETFL);
+    if (   fFlags == -1
+        || fcntl(iFdCon, F_SETFL, fFlags | O_NONBLOCK) == -1)
+    {
+        close(iFdCon);
+        return;
+    }
+
+    PEM100CON pCon = NULL;
+    for (uint32_t i = 0; i < ELEMENTS(pThis->aCons); i++)
+    {
+        if (pThis->aCons[i].enmState == EM100CONSTATE_INVALID)
+        {
+            pCon = &pThis->aCons[i];
+            break;
+        }
+    }
+
+    if (pCon)
+    {
+        int fNoDelay = 1;
+        setsockopt(iFdCon, IPPROTO_TCP, TCP_NODELAY, &fNoDelay, sizeof(fNoDelay));
+
+        memset(pCon, 0, sizeof(*pCon));
+        pCon->iFdCon   = iFdCon;
+        pCon->enmState = EM100CONSTATE_RECV_HDR;
+
+        struct epoll_event Evt;
+        Evt.events   = EPOLLIN;
+        Evt.data.ptr = pCon;
+        int rcPsx = epoll_ctl(pThis->iFdEpoll, EPOLL_CTL_ADD, iFdCon, &Evt);
+        if (!rcPsx)
+        {
+            printf("EM100: Client connected\n");
+            return;
+        }
+
+        pCon->enmState = EM100CONSTATE_INVALID;
+        pCon->iFdCon   = -1;
+    }
+    else
+        printf("EM100: Too many clients connected, dropping new connection\n");
+
+    close(iFdCon);
+}
+
+
 /**
  * The EM100 network emulation thread worker.
  *
@@ -208,52 +516,41 @@ static int pspEm100ConIoLoop(PEM100EMU pThis, int iFdCon)
  */
 static void *pspEm100IoThread(void *pvUser)
 {
-    int rc = 0;
     PEM100EMU pThis = (PEM100EMU)pvUser;
+    bool fRunning = true;
 
-    while (   pThis->fRunning
-           && !rc)
+    while (fRunning)
     {
-        int iFdListening = socket(AF_INET, SOCK_STREAM, 0);
-        if (iFdListening > -1)
+        struct epoll_event aEvts[EM100_EVT_MAX];
+        int cEvts = epoll_wait(pThis->iFdEpoll, &aEvts[0], ELEMENTS(aEvts), -1);
+        if (cEvts == -1)
+        {
+            if (errno == EINTR)
+                continue;
+
+            printf("EM100: Waiting for events failed with errno=%d, stopping network emulation\n", errno);
+            break;
+        }
+
+        for (int i = 0; i < cEvts; i++)
         {
-            struct sockaddr_in SockAddr;
-
-            memset(&SockAddr, 0, sizeof(SockAddr));
-            SockAddr.sin_family      = AF_INET;
-            SockAddr.sin_addr.s_addr = htonl(INADDR_ANY);
-            SockAddr.sin_port        = htons(pThis->uPort);
-            int rcPsx = bind(iFdListening, (struct sockaddr *)&SockAddr, sizeof(SockAddr));
-            if (!rcPsx)
+            if (aEvts[i].data.ptr == &pThis->iFdEvtTerm)
+                fRunning = false;
+            else if (aEvts[i].data.ptr == &pThis->iFdListening)
+                pspEm100ConAccept(pThis);
+            else
             {
-                printf("EM100: Waiting for incoming connection...\n");
-                rcPsx = listen(iFdListening, 1);
-                if (!rcPsx)
+                PEM100CON pCon = (PEM100CON)aEvts[i].data.ptr;
+
+                /* Let the receive/send path find out about errors and hangups. */
+                int rc = pspEm100ConProcess(pThis, pCon);
+                if (rc)
                 {
-                    int iFdCon = accept(iFdListening, (struct sockaddr *)NULL, NULL);
-                    if (iFdCon == -1)
-                        rc = -1;
-                    else
-                    {
-                        printf("EM100: Connected, entering I/O loop\n");
-                        rc = pspEm100ConIoLoop(pThis, iFdCon);
-                        if (rc < 0)
-                        {
-                            printf("EM100: Network I/O loop failed\n");
-                            rc = -1;
-                        }
-                    }
+                    printf("EM100: Client disconnected\n");
+                    pspEm100ConClose(pThis, pCon);
                 }
-                else
-                    rc = -1;
             }
-            else
-                rc = -1;
-
-            close(iFdListening);
         }
-        else
-            break;
     }
 
     return NULL;
@@ -261,31 +558,156 @@ static void *pspEm100IoThread(void *pvUser)
 
 
 /**
- * Create a EM100 network emulation state.
+ * Registers the given file descriptor for input events with the epoll instance.
+ *
+ * @returns Status code.
+ * @param   pThis                   The EM100 network emulation state.
+ * @param   iFd                     The file descriptor to register.
+ */
+static int pspEm100EpollAdd(PEM100EMU pThis, int iFd)
+{
+    struct epoll_event Evt;
+    Evt.events   = EPOLLIN;
+    Evt.data.ptr = iFd == pThis->iFdEvtTerm ? (void *)&pThis->iFdEvtTerm : (void *)&pThis->iFdListening;
+    return epoll_ctl(pThis->iFdEpoll, EPOLL_CTL_ADD, iFd, &Evt) ? -1 : 0;
+}
+
+
+/**
+ * Sets up the listening socket and the epoll instance.
+ *
+ * @returns Status code.
+ * @param   pThis                   The EM100 network emulation state.
+ */
+static int pspEm100NetInit(PEM100EMU pThis)
+{
+    pThis->iFdEpoll = epoll_create1(EPOLL_CLOEXEC);
+    if (pThis->iFdEpoll == -1)
+        return -1;
+
+    pThis->iFdEvtTerm = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (pThis->iFdEvtTerm == -1)
+        return -1;
+
+    pThis->iFdListening = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (pThis->iFdListening == -1)
+        return -1;
+
+    struct sockaddr_in SockAddr;
+    int fReuse = 1;
+
+    setsockopt(pThis->iFdListening, SOL_SOCKET, SO_REUSEADDR, &fReuse, sizeof(fReuse));
+    memset(&SockAddr, 0, sizeof(SockAddr));
+    SockAddr.sin_family      = AF_INET;
+    SockAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    SockAddr.sin_port        = htons(pThis->uPort);
+    int rcPsx = bind(pThis->iFdListening, (struct sockaddr *)&SockAddr, sizeof(SockAddr));
+    if (!rcPsx)
+        rcPsx = listen(pThis->iFdListening, EM100_CON_MAX);
+    if (rcPsx)
+    {
+        printf("EM100: Failed to listen on port %u (errno=%d)\n", pThis->uPort, errno);
+        return -1;
+    }
+
+    int rc = pspEm100EpollAdd(pThis, pThis->iFdEvtTerm);
+    if (!rc)
+        rc = pspEm100EpollAdd(pThis, pThis->iFdListening);
+    if (!rc)
+        printf("EM100: Listening for connections on port %u\n", pThis->uPort);
+
+    return rc;
+}
+
+
+/**
+ * Closes all file descriptors of the EM100 network emulation state.
+ *
+ * @returns nothing.
+ * @param   pThis                   The EM100 network emulation state.
+ */
+static void pspEm100NetTerm(PEM100EMU pThis)
+{
+    for (uint32_t i = 0; i < ELEMENTS(pThis->aCons); i++)
+    {
+        if (pThis->aCons[i].enmState != EM100CONSTATE_INVALID)
+            pspEm100ConClose(pThis, &pThis->aCons[i]);
+    }
+
+    if (pThis->iFdListening != -1)
+        close(pThis->iFdListening);
+    if (pThis->iFdEvtTerm != -1)
+        close(pThis->iFdEvtTerm);
+    if (pThis->iFdEpoll != -1)
+        close(pThis->iFdEpoll);
+}
+
+
+/**
+ * Create a EM100 network emulation state or retains the existing one if the flash image is the same.
  *
  * @returns Status code.
  * @param   ppEm100                 Where to store the pointer to the EM100 state on success.
  * @param   uPort                   The network port to listen on.
  * @param   pvFlash                 The flash image pointer.
  * @param   cbFlash                 Size of the flash image in bytes.
+ *
+ * @note All CCDs share the same flash image, so there is only one server and one lock for all of them.
  */
 static int pspEm100EmuCreate(PEM100EMU *ppEm100, uint16_t uPort, void *pvFlash, size_t cbFlash)
 {
     int rc = 0;
+
+    pthread_mutex_lock(&g_MtxEm100);
+    if (g_pEm100)
+    {
+        if (   g_pEm100->pvFlash == pvFlash
+            && g_pEm100->uPort == uPort)
+        {
+            g_pEm100->cRefs++;
+            *ppEm100 = g_pEm100;
+        }
+        else
+            rc = -1;
+
+        pthread_mutex_unlock(&g_MtxEm100);
+        return rc;
+    }
+
     PEM100EMU pThis = calloc(1, sizeof(*pThis));
     if (pThis)
     {
-        pThis->fRunning = true;
-        pThis->uPort    = uPort;
-        pThis->pvFlash  = pvFlash;
-        pThis->cbFlash  = cbFlash;
-
-        /* Spin up the network I/O thread. */
-        int rcThrd = pthread_create(&pThis->hThrdIo, NULL, pspEm100IoThread, pThis);
-        if (!rcThrd)
+        pThis->cRefs        = 1;
+        pThis->uPort        = uPort;
+        pThis->pvFlash      = pvFlash;
+        pThis->cbFlash      = cbFlash;
+        pThis->iFdEpoll     = -1;
+        pThis->iFdListening = -1;
+        pThis->iFdEvtTerm   = -1;
+        for (uint32_t i = 0; i < ELEMENTS(pThis->aCons); i++)
+            pThis->aCons[i].iFdCon = -1;
+
+        int rcPsx = pthread_mutex_init(&pThis->MtxFlash, NULL);
+        if (!rcPsx)
         {
-            *ppEm100 = pThis;
-            return 0;
+            rc = pspEm100NetInit(pThis);
+            if (!rc)
+            {
+                /* Spin up the network I/O thread. */
+                int rcThrd = pthread_create(&pThis->hThrdIo, NULL, pspEm100IoThread, pThis);
+                if (!rcThrd)
+                {
+                    g_pEm100 = pThis;
+                    *ppEm100 = pThis;
+                    pthread_mutex_unlock(&g_MtxEm100);
+                    return 0;
+                }
+                else
+                    rc = -1;
+            }
+
+            pspEm100NetTerm(pThis);
+            pthread_mutex_destroy(&pThis->MtxFlash);
         }
         else
             rc = -1;
@@ -295,21 +717,44 @@ static int pspEm100EmuCreate(PEM100EMU *ppEm100, uint16_t uPort, void *pvFlash,
     else
         rc = -1;
 
+    pthread_mutex_unlock(&g_MtxEm100);
     return rc;
 }
 
 
 /**
- * Destroys the given EM100 network emulation state.
+ * Releases the given EM100 network emulation state, destroying it when the last reference is gone.
  *
  * @returns nothing.
  * @param   pEm100                  The emulation state to destroy.
  */
 static void pspEm100EmuDestroy(PEM100EMU pEm100)
 {
-    pEm100->fRunning = false;
-    /** @todo Poke thread. */
+    pthread_mutex_lock(&g_MtxEm100);
+    if (--pEm100->cRefs)
+    {
+        pthread_mutex_unlock(&g_MtxEm100);
+        return;
+    }
+    g_pEm100 = NULL;
+    pthread_mutex_unlock(&g_MtxEm100);
+
+    /*
+     * Poke the thread and wait for it to terminate, the thread must be gone before the state is freed
+     * so cancel it if it can't be poked (epoll_wait() is a cancellation point).
+     */
+    uint64_t u64Evt = 1;
+    ssize_t cbWritten;
+    do
+        cbWritten = write(pEm100->iFdEvtTerm, &u64Evt, sizeof(u64Evt));
+    while (   cbWritten == -1
+           && errno == EINTR);
+    if (cbWritten != sizeof(u64Evt))
+        pthread_cancel(pEm100->hThrdIo);
     pthread_join(pEm100->hThrdIo, NULL);
+
+    pspEm100NetTerm(pEm100);
+    pthread_mutex_destroy(&pEm100->MtxFlash);
     free(pEm100);
 }
 
@@ -318,10 +763,17 @@ static void pspDevFlashRead(SMNADDR offSmn, size_t cbRead, void *pvDst, void *pv
 {
     PPSPDEVFLASH pThis = (PPSPDEVFLASH)pvUser;
 
-    if (offSmn + cbRead <= pThis->pDev->pCfg->cbFlashRom)
-        memcpy(pvDst, (uint8_t *)pThis->pDev->pCfg->pvFlashRom + offSmn, cbRead);
-    else
+    if (offSmn + cbRead > pThis->pDev->pCfg->cbFlashRom)
+    {
         printf("%s: ATTEMPTED out of bounds read from offSmn=%#x cbRead=%zu -> IGNORED\n", __FUNCTION__, offSmn, cbRead);
+        return;
+    }
+
+    /* The flash image can be rewritten over the network at any time. */
+    if (pThis->pEm100)
+        pspEm100FlashLock(pThis->pEm100);
+
+    memcpy(pvDst, (uint8_t *)pThis->pDev->pCfg->pvFlashRom + offSmn, cbRead);
 
     /* Log the access if enabled. */
     if (pThis->pSpiFlashTrace)
@@ -356,6 +808,9 @@ static void pspDevFlashRead(SMNADDR offSmn, size_t cbRead, void *pvDst, void *pv
         }
         fflush(pThis->pSpiFlashTrace);
     }
+
+    if (pThis->pEm100)
+        pspEm100FlashUnlock(pThis->pEm100);
 }
 
 
@@ -366,7 +821,11 @@ static void pspDevFlashWrite(SMNADDR offSmn, size_t cbWrite, const void *pvVal,
     if (pThis->pEm100)
     {
         if (offSmn + cbWrite <= pThis->pDev->pCfg->cbFlashRom)
+        {
+            pspEm100FlashLock(pThis->pEm100);
             memcpy((uint8_t *)pThis->pDev->pCfg->pvFlashRom + offSmn, pvVal, cbWrite);
+            pspEm100FlashUnlock(pThis->pEm100);
+        }
         else
             printf("%s: ATTEMPTED out of bounds write from offSmn=%#x cbWrite=%zu -> IGNORED\n", __FUNCTION__, offSmn, cbWrite);
     }
@@ -430,6 +889,18 @@ static int pspDevFlashInit(PPSPDEV pDev)
             rc = -1;
     }
 
+    /*
+     * Let the core read the flash directly when nothing needs to see the individual accesses,
+     * the SPI flash window is read only (writes in EM100 mode and the trace need the callbacks).
+     * Stray writes get dropped like the write callback does instead of stopping emulation.
+     */
+    if (   !rc
+        && !pThis->pEm100
+        && !pThis->pSpiFlashTrace)
+        rc = PSPEmuIoMgrSmnRegionBackingSet(pThis->hSmn, pDev->pCfg->pvFlashRom,
+                                              PSPEMU_CORE_MEM_REGION_PROT_F_EXEC | PSPEMU_CORE_MEM_REGION_PROT_F_READ
+                                            | PSPEMU_CORE_MEM_REGION_PROT_F_WRITE_IGNORE);
+
     return rc;
 }
 
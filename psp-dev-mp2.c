@@ -37,58 +37,26 @@ typedef struct PSPDEVMP2
     PSPIOMREGIONHANDLE          hSmnFw;
     /** SMN region handle for the SRAM1 region. */
     PSPIOMREGIONHANDLE          hSmnSram1;
-    /** The memory the firmware is loaded to residing at SMN address 0x3f00000. */
-    uint8_t                     abFw[192 * _1K];
-    /** An SRAM1 region used for some sort of config residing at SMN address 0x3f50000. */
-    uint8_t                     abSram1[1376];
+    /** The memory the firmware is loaded to residing at SMN address 0x3f00000 (owned by the I/O manager). */
+    uint8_t                     *pbFw;
+    /** An SRAM1 region used for some sort of config residing at SMN address 0x3f50000 (owned by the I/O manager). */
+    uint8_t                     *pbSram1;
 } PSPDEVMP2;
 /** Pointer to the device instance data. */
 typedef PSPDEVMP2 *PPSPDEVMP2;
 
 
-static void pspDevMp2FwRead(SMNADDR offSmn, size_t cbRead, void *pvDst, void *pvUser)
-{
-    PPSPDEVMP2 pThis = (PPSPDEVMP2)pvUser;
-
-    memcpy(pvDst, &pThis->abFw[offSmn], cbRead);
-}
-
-
-static void pspDevMp2FwWrite(SMNADDR offSmn, size_t cbWrite, const void *pvVal, void *pvUser)
-{
-    PPSPDEVMP2 pThis = (PPSPDEVMP2)pvUser;
-
-    memcpy(&pThis->abFw[offSmn], pvVal, cbWrite);
-}
-
-
-static void pspDevMp2Sram1Read(SMNADDR offSmn, size_t cbRead, void *pvDst, void *pvUser)
-{
-    PPSPDEVMP2 pThis = (PPSPDEVMP2)pvUser;
-
-    memcpy(pvDst, &pThis->abSram1[offSmn], cbRead);
-}
-
-
-static void pspDevMp2Sram1Write(SMNADDR offSmn, size_t cbWrite, const void *pvVal, void *pvUser)
-{
-    PPSPDEVMP2 pThis = (PPSPDEVMP2)pvUser;
-
-    memcpy(&pThis->abSram1[offSmn], pvVal, cbWrite);
-}
-
-
 static int pspDevMp2Init(PPSPDEV pDev)
 {
     PPSPDEVMP2 pThis = (PPSPDEVMP2)&pDev->abInstance[0];
 
-    int rc = PSPEmuIoMgrSmnRegister(pDev->hIoMgr, 0x03f00000, sizeof(pThis->abFw),
-                                    pspDevMp2FwRead, pspDevMp2FwWrite, pThis,
-                                    "MP2 SRAM0", &pThis->hSmnFw);
+    int rc = PSPEmuIoMgrSmnRamRegister(pDev->hIoMgr, 0x03f00000, 192 * _1K,
+                                       PSPEMU_CORE_MEM_REGION_PROT_F_READ | PSPEMU_CORE_MEM_REGION_PROT_F_WRITE,
+                                       "MP2 SRAM0", (void **)&pThis->pbFw, &pThis->hSmnFw);
     if (!rc)
-        rc = PSPEmuIoMgrSmnRegister(pDev->hIoMgr, 0x03f50000, sizeof(pThis->abSram1),
-                                    pspDevMp2Sram1Read, pspDevMp2Sram1Write, pThis,
-                                    "MP2 SRAM1", &pThis->hSmnSram1);
+        rc = PSPEmuIoMgrSmnRamRegister(pDev->hIoMgr, 0x03f50000, 1376,
+                                       PSPEMU_CORE_MEM_REGION_PROT_F_READ | PSPEMU_CORE_MEM_REGION_PROT_F_WRITE,
+                                       "MP2 SRAM1", (void **)&pThis->pbSram1, &pThis->hSmnSram1);
 
     return rc;
 }
@@ -47,8 +47,8 @@ typedef struct PSPDEVSMU
     uint32_t                    u32RegMsgArgRet;
     /** Message ID register. */
     uint32_t                    u32RegMsgId;
-    /** The memory the firmware is loaded to residing at SMN address 0x3c00000. */
-    uint8_t                     abFw[_256K];
+    /** The memory the firmware is loaded to residing at SMN address 0x3c00000 (owned by the I/O manager). */
+    uint8_t                     *pbFw;
 } PSPDEVSMU;
 /** Pointer to the device instance data. */
 typedef PSPDEVSMU *PPSPDEVSMU;
@@ -145,22 +145,6 @@ static void pspDevSmuMsgWrite(SMNADDR offSmn, size_t cbWrite, const void *pvVal,
 }
 
 
-static void pspDevSmuFwRead(SMNADDR offSmn, size_t cbRead, void *pvDst, void *pvUser)
-{
-    PPSPDEVSMU pThis = (PPSPDEVSMU)pvUser;
-
-    memcpy(pvDst, &pThis->abFw[offSmn], cbRead);
-}
-
-
-static void pspDevSmuFwWrite(SMNADDR offSmn, size_t cbWrite, const void *pvVal, void *pvUser)
-{
-    PPSPDEVSMU pThis = (PPSPDEVSMU)pvUser;
-
-    memcpy(&pThis->abFw[offSmn], pvVal, cbWrite);
-}
-
-
 static int pspDevSmuInit(PPSPDEV pDev)
 {
     PPSPDEVSMU pThis = (PPSPDEVSMU)&pDev->abInstance[0];
@@ -180,9 +164,9 @@ static int pspDevSmuInit(PPSPDEV pDev)
                                     pspDevSmuMsgRead, pspDevSmuMsgWrite, pThis,
                                     "SmuMsg", &pThis->hSmnMsg);
     if (!rc)
-        rc = PSPEmuIoMgrSmnRegister(pDev->hIoMgr, 0x03c00000, sizeof(pThis->abFw),
-                                    pspDevSmuFwRead, pspDevSmuFwWrite, pThis,
-                                    "SmuFw", &pThis->hSmnFw);
+        rc = PSPEmuIoMgrSmnRamRegister(pDev->hIoMgr, 0x03c00000, _256K,
+                                       PSPEMU_CORE_MEM_REGION_PROT_F_READ | PSPEMU_CORE_MEM_REGION_PROT_F_WRITE,
+                                       "SmuFw", (void **)&pThis->pbFw, &pThis->hSmnFw);
     return rc;
 }
 
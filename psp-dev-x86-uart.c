@@ -40,6 +40,16 @@
 #include <psp-trace.h>
 
 
+/** Size of the socket mode transmit buffer. */
+#define PSP_DEV_X86_UART_TX_BUF_SIZE        512
+/** Size of the socket mode receive FIFO, must be a power of two. */
+#define PSP_DEV_X86_UART_RX_FIFO_SIZE       256
+/** Number of register accesses without a THR write after which pending transmit data is flushed. */
+#define PSP_DEV_X86_UART_TX_FLUSH_TICKS     4
+/** Number of LSR/RBR reads with an empty receive FIFO after which the socket is polled for new data. */
+#define PSP_DEV_X86_UART_RX_POLL_TICKS      64
+
+
 /**
  * Unknown device instance data.
  */
@@ -73,18 +83,129 @@ typedef struct PSPDEVUART
         {
             /** Flag whether this is server mode. */
             bool            fSrv;
-            /** Flag whether there is data to read on the socket. */
-            bool            fDataRdy;
             /** The listening socket. */
             int             iFdListening;
-            /** The socket for the current connection. */
+            /** The socket for the current connection, -1 if the connection was closed. */
             int             iFdCon;
+            /** Number of register accesses since the last THR write, the tick driving the transmit flush. */
+            uint32_t        cTicksIdle;
+            /** Number of bytes pending in the transmit buffer. */
+            uint32_t        cbTx;
+            /** The transmit buffer. */
+            uint8_t         abTx[PSP_DEV_X86_UART_TX_BUF_SIZE];
+            /** Number of receive FIFO checks since the socket was polled the last time. */
+            uint32_t        cTicksRxPoll;
+            /** Receive FIFO read index (free running). */
+            uint32_t        idxRxRead;
+            /** Receive FIFO write index (free running). */
+            uint32_t        idxRxWrite;
+            /** The receive FIFO. */
+            uint8_t         abRxFifo[PSP_DEV_X86_UART_RX_FIFO_SIZE];
         } Sock;
     } u;
 } PSPDEVUART;
 /** Pointer to the device instance data. */
 typedef PSPDEVUART *PPSPDEVUART;
 
+
+/**
+ * Sends all pending data in the transmit buffer over the socket.
+ *
+ * @returns nothing.
+ * @param   pThis                   The UART device instance.
+ */
+static void pspDevX86UartTxFlush(PPSPDEVUART pThis)
+{
+    uint32_t offTx = 0;
+
+    while (   offTx < pThis->u.Sock.cbTx
+           && pThis->u.Sock.iFdCon != -1)
+    {
+        ssize_t cbSent = send(pThis->u.Sock.iFdCon, &pThis->u.Sock.abTx[offTx], pThis->u.Sock.cbTx - offTx, MSG_NOSIGNAL);
+        if (cbSent > 0)
+            offTx += (uint32_t)cbSent;
+        else if (cbSent == -1 && errno == EINTR)
+            continue;
+        else
+        {
+            PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_X86_UART,
+                                    "Failed to send data over socket: %zd (errno=%d)", cbSent, errno);
+            break;
+        }
+    }
+
+    pThis->u.Sock.cbTx       = 0;
+    pThis->u.Sock.cTicksIdle = 0;
+}
+
+
+/**
+ * Advances the transmit flush tick, flushing any pending data if the guest stopped writing to THR.
+ *
+ * @returns nothing.
+ * @param   pThis                   The UART device instance.
+ */
+static void pspDevX86UartTxTick(PPSPDEVUART pThis)
+{
+    if (   pThis->u.Sock.cbTx
+        && ++pThis->u.Sock.cTicksIdle >= PSP_DEV_X86_UART_TX_FLUSH_TICKS)
+        pspDevX86UartTxFlush(pThis);
+}
+
+
+/**
+ * Fills the receive FIFO with whatever data is available on the socket without blocking.
+ *
+ * @returns Flag whether the receive FIFO contains data.
+ * @param   pThis                   The UART device instance.
+ *
+ * @note The socket is only polled once the FIFO ran empty and only every PSP_DEV_X86_UART_RX_POLL_TICKS
+ *       calls to keep the poll() system call out of the guests LSR polling loops.
+ */
+static bool pspDevX86UartRxFill(PPSPDEVUART pThis)
+{
+    uint32_t cbUsed = pThis->u.Sock.idxRxWrite - pThis->u.Sock.idxRxRead;
+
+    if (   !cbUsed
+        && pThis->u.Sock.iFdCon != -1
+        && ++pThis->u.Sock.cTicksRxPoll >= PSP_DEV_X86_UART_RX_POLL_TICKS)
+    {
+        pThis->u.Sock.cTicksRxPoll = 0;
+
+        struct pollfd PollFd;
+
+        PollFd.fd      = pThis->u.Sock.iFdCon;
+        PollFd.events  = POLLIN;
+        PollFd.revents = 0;
+
+        int rcPsx = poll(&PollFd, 1, 0);
+        if (   rcPsx == 1
+            && (PollFd.revents & (POLLIN | POLLHUP | POLLERR)))
+        {
+            /* Read as much as fits into the contiguous free part of the ring buffer. */
+            uint32_t offWrite = pThis->u.Sock.idxRxWrite & (PSP_DEV_X86_UART_RX_FIFO_SIZE - 1);
+            uint32_t cbFree = MIN(PSP_DEV_X86_UART_RX_FIFO_SIZE - cbUsed, PSP_DEV_X86_UART_RX_FIFO_SIZE - offWrite);
+            ssize_t cbRet = recv(pThis->u.Sock.iFdCon, &pThis->u.Sock.abRxFifo[offWrite], cbFree, MSG_DONTWAIT);
+            if (cbRet > 0)
+            {
+                pThis->u.Sock.idxRxWrite += (uint32_t)cbRet;
+                cbUsed                   += (uint32_t)cbRet;
+            }
+            else if (   cbRet == 0
+                     || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+            {
+                PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_X86_UART,
+                                        "Connection closed or error reading data from socket: %zd", cbRet);
+                close(pThis->u.Sock.iFdCon);
+                pThis->u.Sock.iFdCon = -1;
+            }
+        }
+    }
+
+    return cbUsed != 0;
+}
+
+
 static void pspDevX86UartRead(X86PADDR offMmio, size_t cbRead, void *pvVal, void *pvUser)
 {
     PPSPDEVUART pThis = (PPSPDEVUART)pvUser;
@@ -96,13 +217,19 @@ static void pspDevX86UartRead(X86PADDR offMmio, size_t cbRead, void *pvVal, void
         return;
     }
 
+    if (pThis->fSocket)
+        pspDevX86UartTxTick(pThis);
+
     uint8_t *pbVal = (uint8_t *)pvVal;
     switch (offMmio)
     {
         case X86_UART_REG_RBR_OFF:
         {
-            if (pThis->u.Sock.fDataRdy)
-                pThis->u.Sock.fDataRdy = false;
+            if (pThis->fSocket)
+            {
+                if (pspDevX86UartRxFill(pThis))
+                    pThis->u8RegRbr = pThis->u.Sock.abRxFifo[pThis->u.Sock.idxRxRead++ & (PSP_DEV_X86_UART_RX_FIFO_SIZE - 1)];
+            }
             *pbVal = pThis->u8RegRbr;
             break;
         }
@@ -111,31 +238,9 @@ static void pspDevX86UartRead(X86PADDR offMmio, size_t cbRead, void *pvVal, void
             uint8_t uRegLsr = X86_UART_REG_LSR_THRE | X86_UART_REG_LSR_TEMT; /* We can always take data. */
 
             /* Check whether there is data available in socket mode. */
-            if (pThis->fSocket)
-            {
-                if (!pThis->u.Sock.fDataRdy)
-                {
-                    struct pollfd PollFd;
-
-                    PollFd.fd      = pThis->u.Sock.iFdCon;
-                    PollFd.events  = POLLIN | POLLHUP | POLLERR;
-                    PollFd.revents = 0;
-
-                    int rcPsx = poll(&PollFd, 1, 0);
-                    if (rcPsx == 1)
-                    {
-                        uRegLsr |= X86_UART_REG_LSR_DR;
-                        ssize_t cbRet = recv(pThis->u.Sock.iFdCon, &pThis->u8RegRbr, 1, MSG_DONTWAIT);
-                        if (cbRet != 1)
-                            PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_X86_UART,
-                                                    "Error reading data from socket: %zd", cbRet);
-                        else
-                            pThis->u.Sock.fDataRdy = true;
-                    }
-                }
-                else
-                    uRegLsr |= X86_UART_REG_LSR_DR;
-            }
+            if (   pThis->fSocket
+                && pspDevX86UartRxFill(pThis))
+                uRegLsr |= X86_UART_REG_LSR_DR;
 
             *pbVal = uRegLsr;
             break;
@@ -167,6 +272,10 @@ static void pspDevX86UartWrite(X86PADDR offMmio, size_t cbWrite, const void *pvV
         return;
     }
 
+    if (   pThis->fSocket
+        && offMmio != X86_UART_REG_THR_OFF)
+        pspDevX86UartTxTick(pThis);
+
     uint8_t bVal = *(const uint8_t *)pvVal;
     switch (offMmio)
     {
@@ -187,32 +296,32 @@ static void pspDevX86UartWrite(X86PADDR offMmio, size_t cbWrite, const void *pvV
             }
             else if (pThis->fSocket)
             {
-                /* Socket mode, send data as is. */
-                ssize_t cbSent = send(pThis->u.Sock.iFdCon, &bVal, 1, 0);
-                if (cbSent != 1)
-                    PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_X86_UART,
-                                            "Failed to send data over socket: %zd", cbSent);
+                /* Socket mode, buffer the data and send it on a newline, a full buffer or when the guest stops writing. */
+                pThis->u.Sock.abTx[pThis->u.Sock.cbTx++] = bVal;
+                pThis->u.Sock.cTicksIdle = 0;
+                if (   bVal == '\n'
+                    || pThis->u.Sock.cbTx == sizeof(pThis->u.Sock.abTx))
+                    pspDevX86UartTxFlush(pThis);
             }
             else if (bVal != '\r') /* Ignore carriage return. */
             {
-                /* Store character. */
-                if (pThis->u.Log.offWrite < sizeof(pThis->u.Log.achBuf))
+                /* Store character, a line exceeding the buffer gets dumped in pieces instead of being dropped. */
+                pThis->u.Log.achBuf[pThis->u.Log.offWrite] = bVal;
+                if (   bVal == '\n'
+                    || pThis->u.Log.offWrite == sizeof(pThis->u.Log.achBuf) - 1)
                 {
-                    pThis->u.Log.achBuf[pThis->u.Log.offWrite] = bVal;
-                    if (bVal == '\n')
-                    {
-                        pThis->u.Log.achBuf[pThis->u.Log.offWrite] = '\0';
-                        /* Dump to the trace log and reset the buffer. */
-                        PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_X86_UART,
-                                                "%s", &pThis->u.Log.achBuf[0]);
-                        pThis->u.Log.offWrite = 0;
-                    }
-                    else
-                        pThis->u.Log.offWrite++;
+                    pThis->u.Log.achBuf[pThis->u.Log.offWrite] = '\0';
+                    /* Dump to the trace log and reset the buffer. */
+                    PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_X86_UART,
+                                            "%s%s", &pThis->u.Log.achBuf[0], bVal == '\n' ? "" : "...");
+                    pThis->u.Log.offWrite = 0;
+
+                    /* The character overwritten by the terminator starts the next piece. */
+                    if (bVal != '\n')
+                        pThis->u.Log.achBuf[pThis->u.Log.offWrite++] = bVal;
                 }
                 else
-                    PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_ERROR, PSPTRACEEVTORIGIN_X86_UART,
-                                            "Buffer too small");
+                    pThis->u.Log.offWrite++;
             }
             break;
         }
@@ -273,8 +382,13 @@ static int pspDevX86UartInit(PPSPDEV pDev)
     if (   !rc
         && pDev->pCfg->pszUartRemoteAddr)
     {
-        pThis->fSocket         = true;
-        pThis->u.Sock.fDataRdy = false;
+        pThis->fSocket              = true;
+        pThis->u.Sock.iFdCon        = -1;
+        pThis->u.Sock.cTicksIdle    = 0;
+        pThis->u.Sock.cbTx          = 0;
+        pThis->u.Sock.cTicksRxPoll  = 0;
+        pThis->u.Sock.idxRxRead     = 0;
+        pThis->u.Sock.idxRxWrite    = 0;
 
         /* Check for server mode. */
         char *pszSep = strchr(pDev->pCfg->pszUartRemoteAddr, ':');
@@ -300,6 +414,7 @@ static int pspDevX86UartInit(PPSPDEV pDev)
                     {
                         printf("UART: Failed to connect to %s:%s\n", pDev->pCfg->pszUartRemoteAddr, pszSep);
                         close(pThis->u.Sock.iFdCon);
+                        pThis->u.Sock.iFdCon = -1;
                         rc = -1;
                     }
                 }
@@ -336,7 +451,7 @@ static int pspDevX86UartInit(PPSPDEV pDev)
                         pThis->u.Sock.iFdCon = accept(pThis->u.Sock.iFdListening, (struct sockaddr *)NULL, NULL);
                         if (pThis->u.Sock.iFdCon == -1)
                         {
-                            pThis->u.Sock.iFdCon = 0;
+                            pThis->u.Sock.iFdCon = -1;
                             rc = -1;
                         }
                     }
@@ -357,9 +472,28 @@ static int pspDevX86UartInit(PPSPDEV pDev)
 }
 
 
+static void pspDevX86UartHalt(PPSPDEV pDev)
+{
+    PPSPDEVUART pThis = (PPSPDEVUART)&pDev->abInstance[0];
+
+    /* The guest might wait for input after printing a prompt without a trailing newline, so send everything now. */
+    if (   pThis->fSocket
+        && pThis->u.Sock.cbTx)
+        pspDevX86UartTxFlush(pThis);
+}
+
+
 static void pspDevX86UartDestruct(PPSPDEV pDev)
 {
-    /* Nothing to do so far. */
+    PPSPDEVUART pThis = (PPSPDEVUART)&pDev->abInstance[0];
+
+    if (pThis->fSocket)
+    {
+        pspDevX86UartTxFlush(pThis);
+        if (pThis->u.Sock.iFdCon != -1)
+            close(pThis->u.Sock.iFdCon);
+        pThis->u.Sock.iFdCon = -1;
+    }
 }
 
 
@@ -379,6 +513,8 @@ const PSPDEVREG g_DevRegX86Uart =
     /** pfnDestruct */
     pspDevX86UartDestruct,
     /** pfnReset */
-    NULL
+    NULL,
+    /** pfnHalt */
+    pspDevX86UartHalt
 };
 
@@ -21,54 +21,214 @@
  */
 #include <capstone/capstone.h>
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include <common/types.h>
 #include <common/cdefs.h>
 
 #include <psp-disasm.h>
 
-int PSPEmuDisasm(char *pchDst, size_t cch, uint32_t cInsnsDisasm, uint8_t *pbCode, size_t cbCode, PSPADDR uAddrStart, bool fThumb)
+
+/** Number of entries in the decode cache (power of two). */
+#define PSP_DISASM_CACHE_ENTRIES        1024
+/** Maximum size of a cached instruction line. */
+#define PSP_DISASM_CACHE_LINE_MAX       96
+
+
+/**
+ * A decoded instruction cache entry.
+ */
+typedef struct PSPDISASMCACHEENTRY
+{
+    /** Address of the instruction. */
+    PSPADDR                     uAddr;
+    /** Flag whether the instruction was decoded in THUMB mode. */
+    bool                        fThumb;
+    /** Size of the instruction in bytes, 0 if the entry is unused. */
+    uint8_t                     cbInsn;
+    /** The instruction bytes the entry was decoded from, a mismatch means the code was modified. */
+    uint8_t                     abInsn[4];
+    /** The formatted instruction line. */
+    char                        szLine[PSP_DISASM_CACHE_LINE_MAX];
+} PSPDISASMCACHEENTRY;
+/** Pointer to a decoded instruction cache entry. */
+typedef PSPDISASMCACHEENTRY *PPSPDISASMCACHEENTRY;
+
+
+/**
+ * Per mode disassembler state.
+ */
+typedef struct PSPDISASMMODE
 {
-    int rc = 0;
-    csh hCapStone;
-    cs_insn *paInsn;
+    /** The capstone handle, kept open for the lifetime of the thread. */
+    csh                         hCapStone;
+    /** Instruction buffer for cs_disasm_iter(). */
+    cs_insn                     *pInsn;
+    /** Flag whether the handle was opened. */
+    bool                        fInit;
+} PSPDISASMMODE;
+/** Pointer to a per mode disassembler state. */
+typedef PSPDISASMMODE *PPSPDISASMMODE;
+
+
+/** The ARM (index 0) and THUMB (index 1) disassembler state, per thread as capstone handles are not thread safe. */
+static __thread PSPDISASMMODE g_aDisasmModes[2];
+/** The decoded instruction cache, allocated on first use. */
+static __thread PPSPDISASMCACHEENTRY g_paDisasmCache = NULL;
 
-    /** @todo Thumb */
-    if (cs_open(CS_ARCH_ARM, fThumb ? CS_MODE_THUMB : CS_MODE_ARM, &hCapStone) != CS_ERR_OK)
-        return -1;
 
-    size_t cInsn = cs_disasm(hCapStone, pbCode, cbCode, uAddrStart, 0, &paInsn);
-    if (cInsn)
+/**
+ * Returns the disassembler state for the given mode, opening the capstone handle if required.
+ *
+ * @returns Pointer to the disassembler state or NULL on failure.
+ * @param   fThumb                  Flag whether to return the THUMB or ARM state.
+ */
+static PPSPDISASMMODE pspEmuDisasmModeGet(bool fThumb)
+{
+    PPSPDISASMMODE pMode = &g_aDisasmModes[fThumb ? 1 : 0];
+
+    if (!pMode->fInit)
     {
-        size_t cchLeft = cch;
-        char *pszDst = pchDst;
-        uint32_t i = 0;
+        if (cs_open(CS_ARCH_ARM, fThumb ? CS_MODE_THUMB : CS_MODE_ARM, &pMode->hCapStone) != CS_ERR_OK)
+            return NULL;
+
+        pMode->pInsn = cs_malloc(pMode->hCapStone);
+        if (!pMode->pInsn)
+        {
+            cs_close(&pMode->hCapStone);
+            return NULL;
+        }
+
+        pMode->fInit = true;
+    }
+
+    return pMode;
+}
 
-        if (cInsnsDisasm)
-            cInsn = MIN(cInsn, cInsnsDisasm);
 
-        pchDst[0] = 0;
+/**
+ * Disassembles a single instruction, consulting the decode cache first.
+ *
+ * @returns Pointer to the formatted instruction line or NULL if decoding failed.
+ * @param   pbCode                  The code to disassemble.
+ * @param   cbCode                  Number of code bytes available.
+ * @param   uAddr                   The address of the instruction.
+ * @param   fThumb                  Flag whether to disassemble in THUMB or ARM mode.
+ * @param   pcbInsn                 Where to store the size of the instruction on success.
+ * @param   pszBuf                  Scratch buffer for lines not fitting into the cache.
+ * @param   cchBuf                  Size of the scratch buffer.
+ */
+static const char *pspEmuDisasmInsn(const uint8_t *pbCode, size_t cbCode, PSPADDR uAddr, bool fThumb, size_t *pcbInsn,
+                                    char *pszBuf, size_t cchBuf)
+{
+    PPSPDISASMCACHEENTRY pEntry = NULL;
 
-        while (i < cInsn)
+    if (g_paDisasmCache)
+    {
+        pEntry = &g_paDisasmCache[(uAddr >> 1) & (PSP_DISASM_CACHE_ENTRIES - 1)];
+        if (   pEntry->cbInsn
+            && pEntry->uAddr == uAddr
+            && pEntry->fThumb == fThumb
+            && pEntry->cbInsn <= cbCode
+            && !memcmp(&pEntry->abInsn[0], pbCode, pEntry->cbInsn))
         {
-            size_t cchWritten = snprintf(pszDst, cchLeft, "%#08x:    %s\t\t%s\n",
-                                         paInsn[i].address, paInsn[i].mnemonic,
-                                         paInsn[i].op_str);
-            if (cchWritten >= cchLeft)
-                break;
-
-            cchLeft -= cchWritten;
-            pszDst  += cchWritten;
-            i++;
+            *pcbInsn = pEntry->cbInsn;
+            return &pEntry->szLine[0];
         }
+    }
+
+    PPSPDISASMMODE pMode = pspEmuDisasmModeGet(fThumb);
+    if (!pMode)
+        return NULL;
 
-        cs_free(paInsn, cInsn);
+    const uint8_t *pbInsn = pbCode;
+    size_t cbLeft = cbCode;
+    uint64_t u64Addr = uAddr;
+    if (!cs_disasm_iter(pMode->hCapStone, &pbInsn, &cbLeft, &u64Addr, pMode->pInsn))
+        return NULL;
+
+    cs_insn *pInsn = pMode->pInsn;
+    size_t cchLine = snprintf(pszBuf, cchBuf, "%#08x:    %s\t\t%s\n",
+                              (uint32_t)pInsn->address, pInsn->mnemonic, pInsn->op_str);
+    *pcbInsn = pInsn->size;
+
+    if (!g_paDisasmCache)
+    {
+        g_paDisasmCache = (PPSPDISASMCACHEENTRY)calloc(PSP_DISASM_CACHE_ENTRIES, sizeof(*g_paDisasmCache));
+        if (g_paDisasmCache)
+            pEntry = &g_paDisasmCache[(uAddr >> 1) & (PSP_DISASM_CACHE_ENTRIES - 1)];
     }
-    else
-        rc = -1;
 
-    cs_close(&hCapStone);
+    if (   pEntry
+        && cchLine < sizeof(pEntry->szLine)
+        && pInsn->size <= sizeof(pEntry->abInsn))
+    {
+        pEntry->uAddr  = uAddr;
+        pEntry->fThumb = fThumb;
+        pEntry->cbInsn = (uint8_t)pInsn->size;
+        memcpy(&pEntry->abInsn[0], pbCode, pInsn->size);
+        memcpy(&pEntry->szLine[0], pszBuf, cchLine + 1);
+        return &pEntry->szLine[0];
+    }
+
+    return pszBuf;
+}
+
+
+int PSPEmuDisasm(char *pchDst, size_t cch, uint32_t cInsnsDisasm, uint8_t *pbCode, size_t cbCode, PSPADDR uAddrStart, bool fThumb)
+{
+    size_t cchLeft = cch;
+    char *pszDst = pchDst;
+    size_t offCode = 0;
+    uint32_t cInsn = 0;
+
+    pchDst[0] = 0;
+
+    while (   offCode < cbCode
+           && (   !cInsnsDisasm
+               || cInsn < cInsnsDisasm))
+    {
+        char szBuf[256];
+        size_t cbInsn = 0;
+        const char *pszLine = pspEmuDisasmInsn(pbCode + offCode, cbCode - offCode, uAddrStart + offCode, fThumb,
+                                               &cbInsn, &szBuf[0], sizeof(szBuf));
+        if (!pszLine)
+            break;
+
+        size_t cchLine = strlen(pszLine);
+        if (cchLine >= cchLeft)
+            break;
+
+        memcpy(pszDst, pszLine, cchLine + 1);
+        cchLeft -= cchLine;
+        pszDst  += cchLine;
+        offCode += cbInsn;
+        cInsn++;
+    }
 
-    return rc;
+    return cInsn ? 0 : -1;
 }
 
+
+void PSPEmuDisasmThreadTerm(void)
+{
+    for (uint32_t i = 0; i < ELEMENTS(g_aDisasmModes); i++)
+    {
+        PPSPDISASMMODE pMode = &g_aDisasmModes[i];
+
+        if (pMode->fInit)
+        {
+            cs_free(pMode->pInsn, 1);
+            cs_close(&pMode->hCapStone);
+            pMode->pInsn = NULL;
+            pMode->fInit = false;
+        }
+    }
+
+    if (g_paDisasmCache)
+    {
+        free(g_paDisasmCache);
+        g_paDisasmCache = NULL;
+    }
+}
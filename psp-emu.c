@@ -35,9 +35,16 @@
 #include <psp-ccd.h>
 #include <psp-dbg.h>
 #include <psp-flash.h>
+#include <psp-perf.h>
 #include <psp-proxy.h>
 
 
+/** Maximum number of sockets which can be emulated. */
+#define PSPEMU_SOCKETS_MAX          2
+/** Maximum number of CCDs per socket which can be emulated. */
+#define PSPEMU_CCDS_PER_SOCKET_MAX  4
+
+
 static uint32_t g_idSocketSingle = UINT32_MAX;
 static uint32_t g_idCcdSingle = UINT32_MAX;
 
@@ -49,6 +56,7 @@ static struct option g_aOptions[] =
 {
     {"emulation-mode",               required_argument, 0, 'm'},
     {"flash-rom",                    required_argument, 0, 'f'},
+    {"flash-idx-cache-dont-write",   no_argument,       0, 'k'},
     {"on-chip-bl",                   required_argument, 0, 'o'},
     {"boot-rom-svc-page",            required_argument, 0, 's'},
     {"boot-rom-svc-page-dont-alter", no_argument,       0, 'n'},
@@ -59,6 +67,8 @@ static struct option g_aOptions[] =
     {"psp-dbg-mode",                 no_argument,       0, 'g'},
     {"psp-proxy-addr",               required_argument, 0, 'x'},
     {"trace-log",                    required_argument, 0, 't'},
+    {"trace-full-core-ctx",          no_argument,       0, 'Y'},
+    {"trace-filter",                 required_argument, 0, 'Z'},
     {"micro-arch",                   required_argument, 0, 'a'},
     {"cpu-segment",                  required_argument, 0, 'c'},
     {"intercept-svc-6",              no_argument,       0, '6'},
@@ -76,11 +86,16 @@ static struct option g_aOptions[] =
     {"emulate-single-die-id",        required_argument, 0, 'D'},
     {"emulate-devices",              required_argument, 0, 'E'},
     {"iom-log-all-accesses",         no_argument      , 0, 'I'},
+    {"iom-stats",                    required_argument, 0, 'Q'},
+    {"perf-report",                  required_argument, 0, 'L'},
     {"proxy-buffer-writes",          no_argument      , 0, 'P'},
     {"dbg-step-count",               required_argument, 0, 'G'},
     {"dbg-run-up-to",                required_argument, 0, 'U'},
+    {"dbg-all-ccds",                 no_argument,       0, 'B'},
     {"proxy-trusted-os-handover",    required_argument, 0, 'T'},
     {"proxy-ccp",                    no_argument,       0, 'X'},
+    {"ccp-async",                    no_argument,       0, 'K'},
+    {"ccp-rsa-cache",                required_argument, 0, 'W'},
     {"memory-preload",               required_argument, 0, 'M'},
     {"memory-create",                required_argument, 0, 'R'},
     {"single-step-dump-core-state",  no_argument,       0, 'A'},
@@ -105,11 +120,16 @@ static void pspEmuCfgFree(PPSPEMUCFG pCfg)
         && pCfg->cbOnChipBl)
         PSPEmuFlashFree(pCfg->pvOnChipBl, pCfg->cbOnChipBl);
 
+    if (pCfg->hFlashIdx)
+        PSPEmuFlashIdxDestroy(pCfg->hFlashIdx);
+
     if (   pCfg->pvFlashRom
         && pCfg->cbFlashRom)
         PSPEmuFlashFree(pCfg->pvFlashRom, pCfg->cbFlashRom);
 
-    if (   pCfg->pvBinLoad
+    /* A binary taken from the flash ROM points into it and must not be freed separately. */
+    if (   pCfg->pszPathBinLoad
+        && pCfg->pvBinLoad
         && pCfg->cbBinLoad)
         PSPEmuFlashFree(pCfg->pvBinLoad, pCfg->cbBinLoad);
 
@@ -428,16 +448,24 @@ static int pspEmuCfgParse(int argc, char *argv[], PPSPEMUCFG pCfg)
     pCfg->uDbgPort              = 0;
     pCfg->cDbgInsnStep          = 0;
     pCfg->PspAddrDbgRunUpTo     = UINT32_MAX;
+    pCfg->fDbgAllCcds           = false;
     pCfg->fLoadPspDir           = false;
+    pCfg->fFlashIdxCacheWrite   = true;
     pCfg->fIncptSvc6            = false;
     pCfg->fTraceSvcs            = false;
     pCfg->fTimerRealtime        = false;
     pCfg->fBootRomSvcPageModify = true;
     pCfg->fIomLogAllAccesses    = false;
+    pCfg->pszIomStats           = NULL;
+    pCfg->fPerfReport           = false;
+    pCfg->cSecPerfReport        = 0;
     pCfg->fProxyWrBuffer        = false;
     pCfg->fCcpProxy             = false;
+    pCfg->fCcpAsync             = false;
+    pCfg->pszCcpRsaCache        = NULL;
     pCfg->pvFlashRom            = NULL;
     pCfg->cbFlashRom            = 0;
+    pCfg->hFlashIdx             = NULL;
     pCfg->pvOnChipBl            = NULL;
     pCfg->cbOnChipBl            = 0;
     pCfg->pvBinLoad             = NULL;
@@ -449,6 +477,8 @@ static int pspEmuCfgParse(int argc, char *argv[], PPSPEMUCFG pCfg)
     pCfg->pszPspProxyAddr       = NULL;
     pCfg->PspAddrProxyTrustedOsHandover = 0;
     pCfg->pszTraceLog           = NULL;
+    pCfg->fTraceFullCoreCtx     = false;
+    pCfg->pszTraceFilter        = NULL;
     pCfg->enmMicroArch          = PSPEMUMICROARCH_INVALID;
     pCfg->enmCpuSegment         = PSPEMUAMDCPUSEGMENT_INVALID;
     pCfg->enmAcpiState          = PSPEMUACPISTATE_S5;
@@ -477,17 +507,22 @@ static int pspEmuCfgParse(int argc, char *argv[], PPSPEMUCFG pCfg)
                 printf("%s: AMD Platform Secure Processor emulator\n"
                        "    --emulation-mode [app|sys|on-chip-bl|trusted-os]\n"
                        "    --flash-rom <path/to/flash/rom>\n"
+                       "    --flash-idx-cache-dont-write Do not write the <flash/rom>.idx directory index cache next to the flash image\n"
                        "    --boot-rom-svc-page <path/to/boot/rom/svc/page>\n"
                        "    --boot-rom-svc-page-dont-alter Do not alter the boot ROM service page for the emulated CCD (IDs etc.)\n"
                        "    --bin-contains-hdr The binaries contain the 256 byte header, omit if raw binaries\n"
-                       "    --bin-load <path/to/binary/to/load>\n"
+                       "    --bin-load <path/to/binary/to/load> Taken from the flash image if omitted (except for app mode)\n"
                        "    --on-chip-bl <path/to/on-chip-bl/binary>\n"
                        "    --dbg <listening port>\n"
                        "    --psp-proxy-addr <path/to/proxy/device>\n"
                        "    --proxy-trusted-os-handover <address> If set, this is the address where the off chip BL jumps to the trusted OS and the emulator will do the same\n"
                        "    --load-psp-dir\n"
                        "    --psp-dbg-mode\n"
-                       "    --trace-log <path/to/trace/log>\n"
+                       "    --trace-log <path/to/trace/log> With multiple CCDs each one logs to <path/to/trace/log>.<socket id>.<ccd id>\n"
+                       "    --trace-full-core-ctx Log the changed core registers with every trace event\n"
+                       "    --trace-filter <filter> Only log device accesses matching the filter, clauses separated by ';' with terms\n"
+                       "                            dev=<name>[*] origin=mmio|smn|x86|x86-mmio|x86-mem addr=<first>[-<last>]\n"
+                       "                            pc=<first>[-<last>] rw=r|w|rw val=<val>[/<mask>] rate=<events per second>\n"
                        "    --micro-arch <zen|zen+|zen2>\n"
                        "    --cpu-segment <ryzen|ryzen-pro|threadripper|epyc>\n"
                        "    --acpi-state <s0|s1|s1|s2|s3|s4|s5>\n"
@@ -507,9 +542,14 @@ static int pspEmuCfgParse(int argc, char *argv[], PPSPEMUCFG pCfg)
                        "    --emulate-single-die-id <id> Emulate only a single PSP with the given die ID\n"
                        "    --emulate-devices [<dev1>:<dev2>:...] Enables only the specified devices for emulation\n"
                        "    --iom-log-all-accesses I/O manager logs all device accesses not only the ones to unassigned regions\n"
+                       "    --iom-stats <path/to/stats.json> Dumps the per region access statistics as JSON on exit\n"
+                       "    --perf-report <interval in seconds> Reports the host time spent in each emulator subsystem periodically (0 for exit only) and on exit\n"
                        "    --proxy-buffer-writes If proxy mode is enabled certain writes will be cached and sent in bursts to speed up certain access patterns\n"
                        "    --proxy-ccp When proxy mode is enabled this will pass through certain CCP request to a real CCP (AES with keys from the protected LSB so far)\n"
+                       "    --ccp-async Process CCP requests only accessing the SRAM on a host worker thread while the PSP core keeps executing\n"
+                       "    --ccp-rsa-cache <path/to/cache/dir> Caches the results of CCP RSA operations in the given directory across runs\n"
                        "    --dbg-run-up-to <addr> Runs until the given address is hit and drops then into the debugger instead of right at the start\n"
+                       "    --dbg-all-ccds Emulates all configured CCDs with the debugger attached to them (select one with the \"ccd\" monitor command)\n"
                        "    --single-step-dump-core-state Single step execution, dumping the core state after each instruction\n"
                        "    --dbg-step-count <count> Number of instructions to step through in a single round, use at own RISK\n",
                        argv[0]);
@@ -534,6 +574,9 @@ static int pspEmuCfgParse(int argc, char *argv[], PPSPEMUCFG pCfg)
             case 'f':
                 pCfg->pszPathFlashRom = optarg;
                 break;
+            case 'k':
+                pCfg->fFlashIdxCacheWrite = false;
+                break;
             case 's':
                 pCfg->pszPathBootRomSvcPage = optarg;
                 break;
@@ -564,6 +607,12 @@ static int pspEmuCfgParse(int argc, char *argv[], PPSPEMUCFG pCfg)
             case 't':
                 pCfg->pszTraceLog = optarg;
                 break;
+            case 'Y':
+                pCfg->fTraceFullCoreCtx = true;
+                break;
+            case 'Z':
+                pCfg->pszTraceFilter = optarg;
+                break;
             case 'a':
             {
                 if (!strcasecmp(optarg, "zen"))
@@ -659,6 +708,13 @@ static int pspEmuCfgParse(int argc, char *argv[], PPSPEMUCFG pCfg)
             case 'I':
                 pCfg->fIomLogAllAccesses = true;
                 break;
+            case 'Q':
+                pCfg->pszIomStats = optarg;
+                break;
+            case 'L':
+                pCfg->fPerfReport    = true;
+                pCfg->cSecPerfReport = strtoul(optarg, NULL, 10);
+                break;
             case 'P':
                 pCfg->fProxyWrBuffer = true;
                 break;
@@ -668,12 +724,21 @@ static int pspEmuCfgParse(int argc, char *argv[], PPSPEMUCFG pCfg)
             case 'U':
                 pCfg->PspAddrDbgRunUpTo = strtoul(optarg, NULL, 0);
                 break;
+            case 'B':
+                pCfg->fDbgAllCcds = true;
+                break;
             case 'T':
                 pCfg->PspAddrProxyTrustedOsHandover = strtoul(optarg, NULL, 0);
                 break;
             case 'X':
                 pCfg->fCcpProxy = true;
                 break;
+            case 'K':
+                pCfg->fCcpAsync = true;
+                break;
+            case 'W':
+                pCfg->pszCcpRsaCache = optarg;
+                break;
             case 'M':
             {
                 int rc = pspEmuCfgMemPreloadParse(pCfg, optarg);
@@ -704,16 +769,26 @@ static int pspEmuCfgParse(int argc, char *argv[], PPSPEMUCFG pCfg)
     }
 
     if (   pCfg->cSockets < 1
-        || pCfg->cSockets > 2)
+        || pCfg->cSockets > PSPEMU_SOCKETS_MAX)
     {
-        fprintf(stderr, "--sockets argument must be in range [1..2]\n");
+        fprintf(stderr, "--sockets argument must be in range [1..%u]\n", PSPEMU_SOCKETS_MAX);
         return -1;
     }
 
     if (   pCfg->cCcdsPerSocket < 1
-        || pCfg->cCcdsPerSocket > 4)
+        || pCfg->cCcdsPerSocket > PSPEMU_CCDS_PER_SOCKET_MAX)
+    {
+        fprintf(stderr, "--ccds-per-socket argument must be in range [1..%u]\n", PSPEMU_CCDS_PER_SOCKET_MAX);
+        return -1;
+    }
+
+    if (   pCfg->fDbgAllCcds
+        && (   !pCfg->uDbgPort
+            || pCfg->pszPspProxyAddr
+            || g_idSocketSingle != UINT32_MAX
+            || g_idCcdSingle != UINT32_MAX))
     {
-        fprintf(stderr, "--ccds-per-socket argument must be in range [1..4]\n");
+        fprintf(stderr, "--dbg-all-ccds requires --dbg and can't be combined with the proxy or a single socket/die\n");
         return -1;
     }
 
@@ -731,10 +806,10 @@ static int pspEmuCfgParse(int argc, char *argv[], PPSPEMUCFG pCfg)
         return -1;
     }
 
-    if (   pCfg->enmMode != PSPEMUMODE_SYSTEM_ON_CHIP_BL
+    if (   pCfg->enmMode == PSPEMUMODE_APP
         && !pCfg->pszPathBinLoad)
     {
-        fprintf(stderr, "Loading the designated binary from the flash image is not implemented yet, please load the binary explicitely using --bin-load\n");
+        fprintf(stderr, "Application mode requires the binary to be loaded explicitely using --bin-load\n");
         return -1;
     }
 
@@ -767,6 +842,14 @@ static int pspEmuCfgParse(int argc, char *argv[], PPSPEMUCFG pCfg)
             fprintf(stderr, "Loading the flash ROM failed with %d\n", rc);
     }
 
+    if (!rc)
+    {
+        rc = PSPEmuFlashIdxCreate(&pCfg->hFlashIdx, pCfg->pvFlashRom, pCfg->cbFlashRom, pCfg->pszPathFlashRom,
+                                  pCfg->fFlashIdxCacheWrite);
+        if (rc)
+            fprintf(stderr, "Indexing the flash ROM failed with %d\n", rc);
+    }
+
     if (   !rc
         && pCfg->pszPathBinLoad)
     {
@@ -774,6 +857,36 @@ static int pspEmuCfgParse(int argc, char *argv[], PPSPEMUCFG pCfg)
         if (rc)
             fprintf(stderr, "Loading the binary \"%s\" failed with %d\n", pCfg->pszPathBinLoad, rc);
     }
+    else if (   !rc
+             && (   pCfg->enmMode == PSPEMUMODE_SYSTEM
+                 || pCfg->enmMode == PSPEMUMODE_TRUSTED_OS))
+    {
+        /* Take the designated binary from the flash image, it always contains the header. */
+        uint8_t uType =   pCfg->enmMode == PSPEMUMODE_SYSTEM
+                        ? PSP_FLASH_ENTRY_TYPE_BOOT_LOADER
+                        : PSP_FLASH_ENTRY_TYPE_TRUSTED_OS;
+        size_t offEntry = 0;
+
+        rc = PSPEmuFlashIdxQueryEntry(pCfg->hFlashIdx, PSP_FLASH_ENTRY_ID_PSP_MAKE(uType, 0), &offEntry, &pCfg->cbBinLoad);
+        if (   !rc
+            && (   offEntry >= pCfg->cbFlashRom
+                || pCfg->cbBinLoad > pCfg->cbFlashRom - offEntry))
+        {
+            fprintf(stderr, "The binary at flash offset %#zx (%zu bytes) exceeds the flash image\n", offEntry, pCfg->cbBinLoad);
+            pCfg->cbBinLoad = 0;
+            rc = -1;
+        }
+        else if (!rc)
+        {
+            pCfg->pvBinLoad       = (uint8_t *)pCfg->pvFlashRom + offEntry;
+            pCfg->fBinContainsHdr = true;
+            printf("Loading %s from flash offset %#zx (%zu bytes)\n",
+                   uType == PSP_FLASH_ENTRY_TYPE_BOOT_LOADER ? "off chip bootloader" : "trusted OS",
+                   offEntry, pCfg->cbBinLoad);
+        }
+        else
+            fprintf(stderr, "The flash image doesn't contain the binary for the selected emulation mode, please load it explicitely using --bin-load\n");
+    }
 
     if (   !rc
         && pCfg->pszAppPreload)
@@ -799,35 +912,41 @@ static int pspEmuCfgParse(int argc, char *argv[], PPSPEMUCFG pCfg)
 
 
 /**
- * Executes the given CCD under debugger control.
+ * Executes the given CCDs under debugger control.
  *
  * @returns Status code.
- * @param   hCcd                    The CCD instance to run in a debugger.
+ * @param   pahCcds                 The CCD instances to run in a debugger.
+ * @param   cCcds                   Number of CCDs in the array.
  * @param   pCfg                    The configuration.
  */
-static int pspEmuDbgRun(PSPCCD hCcd, PCPSPEMUCFG pCfg)
+static int pspEmuDbgRun(PPSPCCD pahCcds, uint32_t cCcds, PCPSPEMUCFG pCfg)
 {
-    PSPCORE hPspCore = NULL;
+    int rc = 0;
 
-    int rc = PSPEmuCcdQueryCore(hCcd, &hPspCore);
-    if (!rc)
+    for (uint32_t i = 0; i < cCcds && !rc; i++)
     {
+        PSPCORE hPspCore = NULL;
+
         /*
          * Execute one instruction to initialize the CPU state properly
          * so the debugger has valid values to work with.
          */
-        int rc = PSPEmuCoreExecRun(hPspCore, PSPEMU_CORE_EXEC_F_DEFAULT, 1, PSPEMU_CORE_EXEC_INDEFINITE);
+        rc = PSPEmuCcdQueryCore(pahCcds[i], &hPspCore);
         if (!rc)
-        {
-            PSPDBG hDbg = NULL;
+            rc = PSPEmuCoreExecRun(hPspCore, PSPEMU_CORE_EXEC_F_DEFAULT, 1, PSPEMU_CORE_EXEC_INDEFINITE);
+    }
 
-            rc = PSPEmuDbgCreate(&hDbg, pCfg->uDbgPort, pCfg->cDbgInsnStep, pCfg->PspAddrDbgRunUpTo,
-                                 &hCcd, 1, pCfg->hDbgHlp);
-            if (!rc)
-            {
-                printf("Debugger is listening on port %u...\n", pCfg->uDbgPort);
-                rc = PSPEmuDbgRunloop(hDbg);
-            }
+    if (!rc)
+    {
+        PSPDBG hDbg = NULL;
+
+        rc = PSPEmuDbgCreate(&hDbg, pCfg->uDbgPort, pCfg->cDbgInsnStep, pCfg->PspAddrDbgRunUpTo,
+                             pahCcds, cCcds, pCfg->hDbgHlp);
+        if (!rc)
+        {
+            printf("Debugger is listening on port %u...\n", pCfg->uDbgPort);
+            rc = PSPEmuDbgRunloop(hDbg);
+            PSPEmuDbgDestroy(hDbg);
         }
     }
 
@@ -847,42 +966,70 @@ int main(int argc, char *argv[])
         if (Cfg.uDbgPort)
             rc = PSPEmuDbgHlpCreate(&Cfg.hDbgHlp);
 
+        if (   STS_SUCCESS(rc)
+            && Cfg.fPerfReport)
+            rc = PSPEmuPerfInit(Cfg.cSecPerfReport);
+
         if (STS_SUCCESS(rc))
         {
-            PSPCCD hCcd = NULL;
+            PSPCCD ahCcds[PSPEMU_SOCKETS_MAX * PSPEMU_CCDS_PER_SOCKET_MAX];
+            uint32_t cCcds = 0;
+
             if (   g_idSocketSingle != UINT32_MAX
                 && g_idCcdSingle != UINT32_MAX)
-                rc = PSPEmuCcdCreate(&hCcd, g_idSocketSingle, g_idCcdSingle, &Cfg);
+            {
+                rc = PSPEmuCcdCreate(&ahCcds[0], g_idSocketSingle, g_idCcdSingle, &Cfg);
+                if (!rc)
+                    cCcds = 1;
+            }
+            else if (Cfg.fDbgAllCcds)
+            {
+                for (uint32_t idSocket = 0; idSocket < Cfg.cSockets && !rc; idSocket++)
+                {
+                    for (uint32_t idCcd = 0; idCcd < Cfg.cCcdsPerSocket && !rc; idCcd++)
+                    {
+                        rc = PSPEmuCcdCreate(&ahCcds[cCcds], idSocket, idCcd, &Cfg);
+                        if (!rc)
+                            cCcds++;
+                    }
+                }
+            }
             else
-                rc = PSPEmuCcdCreate(&hCcd, 0, 0, &Cfg);
+            {
+                rc = PSPEmuCcdCreate(&ahCcds[0], 0, 0, &Cfg);
+                if (!rc)
+                    cCcds = 1;
+            }
 
             if (!rc)
             {
                 PSPPROXY hProxy = NULL;
 
-                /* Setup the proxy if configured. */
+                /* Setup the proxy if configured (only possible with a single CCD). */
                 if (Cfg.pszPspProxyAddr)
                 {
                     rc = PSPProxyCreate(&hProxy, &Cfg);
                     if (!rc)
-                        rc = PSPProxyCcdRegister(hProxy, hCcd);
+                        rc = PSPProxyCcdRegister(hProxy, ahCcds[0]);
                 }
 
                 if (!rc)
                 {
                     if (Cfg.uDbgPort)
-                        rc = pspEmuDbgRun(hCcd, &Cfg);
+                        rc = pspEmuDbgRun(&ahCcds[0], cCcds, &Cfg);
                     else
-                        rc = PSPEmuCcdRun(hCcd);
+                        rc = PSPEmuCcdRun(ahCcds[0]);
                 }
 
                 if (hProxy)
-                    PSPProxyCcdDeregister(hProxy, hCcd);
-
-                PSPEmuCcdDestroy(hCcd);
+                    PSPProxyCcdDeregister(hProxy, ahCcds[0]);
             }
+
+            for (uint32_t i = 0; i < cCcds; i++)
+                PSPEmuCcdDestroy(ahCcds[i]);
         }
 
+        PSPEmuPerfTerm();
         pspEmuCfgFree(&Cfg);
     }
     else
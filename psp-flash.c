@@ -22,49 +22,335 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+#include <common/types.h>
+#include <common/cdefs.h>
+#include <common/status.h>
 
 #include <psp-flash.h>
 
+
+/** The embedded firmware structure signature. */
+#define PSP_FLASH_EFS_SIGNATURE                     0x55aa55aa
+/** The PSP 1st level directory cookie ("$PSP"). */
+#define PSP_FLASH_DIR_PSP_L1_COOKIE                 0x50535024
+/** The PSP 2nd level directory cookie ("$PL2"). */
+#define PSP_FLASH_DIR_PSP_L2_COOKIE                 0x324c5024
+/** The PSP combo directory cookie ("2PSP"). */
+#define PSP_FLASH_DIR_PSP_COMBO_COOKIE              0x50535032
+/** The BIOS 1st level directory cookie ("$BHD"). */
+#define PSP_FLASH_DIR_BIOS_L1_COOKIE                0x44484224
+/** The BIOS 2nd level directory cookie ("$BL2"). */
+#define PSP_FLASH_DIR_BIOS_L2_COOKIE                0x324c4224
+/** The BIOS combo directory cookie ("2BHD"). */
+#define PSP_FLASH_DIR_BIOS_COMBO_COOKIE             0x44484232
+/** Maximum directory nesting level we follow (combo -> L1 -> L2). */
+#define PSP_FLASH_DIR_DEPTH_MAX                     3
+
+/** The on disk index cache magic ("PFIC"). */
+#define PSP_FLASH_IDX_CACHE_MAGIC                   0x43494650
+/** The on disk index cache version. */
+#define PSP_FLASH_IDX_CACHE_VERSION                 2
+
+
+/**
+ * Embedded firmware structure, the anchor of the flash layout.
+ */
+typedef struct PSPFLASHEFS
+{
+    /** 0x00: Signature, PSP_FLASH_EFS_SIGNATURE. */
+    uint32_t                u32Signature;
+    /** 0x04: IMC firmware pointer. */
+    uint32_t                u32ImcFw;
+    /** 0x08: GbE firmware pointer. */
+    uint32_t                u32GbeFw;
+    /** 0x0c: xHCI firmware pointer. */
+    uint32_t                u32XhciFw;
+    /** 0x10: Legacy PSP directory pointer. */
+    uint32_t                u32PspDir;
+    /** 0x14: PSP (combo) directory pointer. */
+    uint32_t                u32PspDirNew;
+    /** 0x18: BIOS directory pointers for the various families. */
+    uint32_t                au32BiosDir[3];
+    /** 0x24: Second generation EFS flags. */
+    uint32_t                u32EfsGen;
+    /** 0x28: Another BIOS directory pointer. */
+    uint32_t                u32BiosDir3;
+} PSPFLASHEFS;
+/** Pointer to a const embedded firmware structure. */
+typedef const PSPFLASHEFS *PCPSPFLASHEFS;
+
+
+/**
+ * Directory header common to PSP and BIOS directories.
+ */
+typedef struct PSPFLASHDIRHDR
+{
+    /** 0x00: Cookie identifying the directory type. */
+    uint32_t                u32Cookie;
+    /** 0x04: Fletcher checksum over the rest of the directory. */
+    uint32_t                u32Chksum;
+    /** 0x08: Number of entries following. */
+    uint32_t                cEntries;
+    /** 0x0c: Reserved/additional info. */
+    uint32_t                u32Rsvd;
+} PSPFLASHDIRHDR;
+/** Pointer to a const directory header. */
+typedef const PSPFLASHDIRHDR *PCPSPFLASHDIRHDR;
+
+
+/**
+ * PSP directory entry.
+ */
+typedef struct PSPFLASHPSPDIRENTRY
+{
+    /** 0x00: Entry type. */
+    uint8_t                 u8Type;
+    /** 0x01: Sub program. */
+    uint8_t                 u8SubProg;
+    /** 0x02: Reserved. */
+    uint16_t                u16Rsvd;
+    /** 0x04: Size of the entry in bytes. */
+    uint32_t                cbEntry;
+    /** 0x08: Location of the entry. */
+    uint64_t                u64Addr;
+} PSPFLASHPSPDIRENTRY;
+/** Pointer to a const PSP directory entry. */
+typedef const PSPFLASHPSPDIRENTRY *PCPSPFLASHPSPDIRENTRY;
+
+
+/**
+ * BIOS directory entry.
+ */
+typedef struct PSPFLASHBIOSDIRENTRY
+{
+    /** 0x00: Entry type. */
+    uint8_t                 u8Type;
+    /** 0x01: Memory region type. */
+    uint8_t                 u8RegionType;
+    /** 0x02: Flags. */
+    uint8_t                 fFlags;
+    /** 0x03: Sub program. */
+    uint8_t                 u8SubProg;
+    /** 0x04: Size of the entry in bytes. */
+    uint32_t                cbEntry;
+    /** 0x08: Location of the entry in the flash. */
+    uint64_t                u64Src;
+    /** 0x10: Destination address in memory. */
+    uint64_t                u64Dst;
+} PSPFLASHBIOSDIRENTRY;
+/** Pointer to a const BIOS directory entry. */
+typedef const PSPFLASHBIOSDIRENTRY *PCPSPFLASHBIOSDIRENTRY;
+
+
+/**
+ * Combo directory header.
+ */
+typedef struct PSPFLASHCOMBODIRHDR
+{
+    /** 0x00: Cookie identifying the directory type. */
+    uint32_t                u32Cookie;
+    /** 0x04: Fletcher checksum over the rest of the directory. */
+    uint32_t                u32Chksum;
+    /** 0x08: Number of entries following. */
+    uint32_t                cEntries;
+    /** 0x0c: Lookup mode. */
+    uint32_t                u32LookupMode;
+    /** 0x10: Reserved. */
+    uint8_t                 abRsvd[16];
+} PSPFLASHCOMBODIRHDR;
+/** Pointer to a const combo directory header. */
+typedef const PSPFLASHCOMBODIRHDR *PCPSPFLASHCOMBODIRHDR;
+
+
+/**
+ * Combo directory entry.
+ */
+typedef struct PSPFLASHCOMBODIRENTRY
+{
+    /** 0x00: ID selector. */
+    uint32_t                u32IdSel;
+    /** 0x04: Chip ID the directory applies to. */
+    uint32_t                u32Id;
+    /** 0x08: Location of the directory. */
+    uint64_t                u64Addr;
+} PSPFLASHCOMBODIRENTRY;
+/** Pointer to a const combo directory entry. */
+typedef const PSPFLASHCOMBODIRENTRY *PCPSPFLASHCOMBODIRENTRY;
+
+
+/**
+ * A single index entry, also the on disk format.
+ */
+typedef struct PSPFLASHIDXENTRY
+{
+    /** The entry ID. */
+    uint32_t                idEntry;
+    /** The directory level the entry was found in. */
+    uint32_t                uLvl;
+    /** Offset of the entry from the start of the flash. */
+    uint64_t                offEntry;
+    /** Size of the entry in bytes. */
+    uint64_t                cbEntry;
+} PSPFLASHIDXENTRY;
+/** Pointer to an index entry. */
+typedef PSPFLASHIDXENTRY *PPSPFLASHIDXENTRY;
+/** Pointer to a const index entry. */
+typedef const PSPFLASHIDXENTRY *PCPSPFLASHIDXENTRY;
+
+
+/**
+ * The on disk index cache header, followed by the entries.
+ */
+typedef struct PSPFLASHIDXCACHEHDR
+{
+    /** Magic, PSP_FLASH_IDX_CACHE_MAGIC. */
+    uint32_t                u32Magic;
+    /** Version, PSP_FLASH_IDX_CACHE_VERSION. */
+    uint32_t                u32Version;
+    /** Device ID of the flash image file the index was created from. */
+    uint64_t                u64Dev;
+    /** Inode number of the flash image file the index was created from. */
+    uint64_t                u64Inode;
+    /** Modification time of the flash image file in nanoseconds since the epoch. */
+    int64_t                 i64MtimeNs;
+    /** Size of the flash the index was created from. */
+    uint64_t                cbFlash;
+    /** Offset of the 1st level PSP directory, UINT64_MAX if not found. */
+    uint64_t                offPspDir;
+    /** Number of entries following. */
+    uint32_t                cEntries;
+    /** Reserved. */
+    uint32_t                u32Rsvd;
+} PSPFLASHIDXCACHEHDR;
+
+
+/**
+ * Flash layout index instance.
+ */
+typedef struct PSPFLASHIDXINT
+{
+    /** Start of the flash region being indexed. */
+    const uint8_t           *pbFlash;
+    /** Size of the flash region. */
+    size_t                  cbFlash;
+    /** Offset of the 1st level PSP directory, UINT64_MAX if not found. */
+    uint64_t                offPspDir;
+    /** Number of entries in the index. */
+    uint32_t                cEntries;
+    /** Number of entries allocated. */
+    uint32_t                cEntriesMax;
+    /** The index entries, sorted by ID after the scan. */
+    PPSPFLASHIDXENTRY       paEntries;
+} PSPFLASHIDXINT;
+/** Pointer to a flash layout index instance. */
+typedef PSPFLASHIDXINT *PPSPFLASHIDXINT;
+
+
+/**
+ * Reads the given file into a private anonymous mapping, used as a fallback
+ * for files which can't be mapped directly (pipes, special files, etc.).
+ *
+ * @returns Status code.
+ * @param   iFd                     The file descriptor to read from.
+ * @param   ppv                     Where to store the pointer to the content on success.
+ * @param   pcb                     Where to store the size of the content on success.
+ */
+static int pspEmuFlashLoadFromFd(int iFd, void **ppv, size_t *pcb)
+{
+    size_t cbAlloc = 1024 * 1024;
+    size_t cbRead = 0;
+    uint8_t *pbBuf = (uint8_t *)mmap(NULL, cbAlloc, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pbBuf == MAP_FAILED)
+        return errno;
+
+    for (;;)
+    {
+        if (cbRead == cbAlloc)
+        {
+            uint8_t *pbNew = (uint8_t *)mmap(NULL, 2 * cbAlloc, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (pbNew == MAP_FAILED)
+                break;
+
+            memcpy(pbNew, pbBuf, cbRead);
+            munmap(pbBuf, cbAlloc);
+            pbBuf = pbNew;
+            cbAlloc *= 2;
+        }
+
+        ssize_t rcPsx = read(iFd, pbBuf + cbRead, cbAlloc - cbRead);
+        if (rcPsx > 0)
+            cbRead += rcPsx;
+        else if (rcPsx == 0)
+        {
+            if (cbRead)
+            {
+                /* Trim the unused tail so PSPEmuFlashFree() only needs the returned size. */
+                size_t cbPg = (size_t)sysconf(_SC_PAGESIZE);
+                size_t cbUsed = (cbRead + cbPg - 1) & ~(cbPg - 1);
+                if (cbUsed < cbAlloc)
+                    munmap(pbBuf + cbUsed, cbAlloc - cbUsed);
+
+                *ppv = pbBuf;
+                *pcb = cbRead;
+                return 0;
+            }
+            break;
+        }
+        else if (errno != EINTR)
+            break;
+    }
+
+    munmap(pbBuf, cbAlloc);
+    return -1;
+}
+
+
 int PSPEmuFlashLoadFromFile(const char *pszFilename, void **ppv, size_t *pcb)
 {
     int rc = 0;
-    FILE *pFwFile = fopen(pszFilename, "rb");
-    if (pFwFile)
+    int iFd = open(pszFilename, O_RDONLY);
+    if (iFd != -1)
     {
-        /* Determine file size. */
-        rc = fseek(pFwFile, 0, SEEK_END);
+        struct stat StatBuf;
+
+        rc = fstat(iFd, &StatBuf);
         if (!rc)
         {
-            long cbFw = ftell(pFwFile);
-            if (cbFw != -1)
+            if (S_ISREG(StatBuf.st_mode))
             {
-                rewind(pFwFile);
-
-                void *pvFw = malloc(cbFw);
-                if (pvFw)
+                /*
+                 * Map the file privately, unmodified pages are shared with the page cache (and every other emulator
+                 * instance using the same image) while writes (flash programming, etc.) never reach the file.
+                 */
+                if (StatBuf.st_size > 0)
                 {
-                    size_t cbRead = fread(pvFw, cbFw, 1, pFwFile);
-                    if (cbRead == 1)
+                    void *pvFw = mmap(NULL, StatBuf.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, iFd, 0);
+                    if (pvFw != MAP_FAILED)
                     {
                         *ppv = pvFw;
-                        *pcb = cbFw;
-                        return 0;
+                        *pcb = StatBuf.st_size;
                     }
-
-                    free(pvFw);
-                    rc = -1;
+                    else
+                        rc = errno;
                 }
                 else
                     rc = -1;
             }
             else
-                rc = errno;
+                rc = pspEmuFlashLoadFromFd(iFd, ppv, pcb);
         }
         else
             rc = errno;
 
-        fclose(pFwFile);
+        close(iFd); /* The mapping stays valid. */
     }
     else
         rc = errno;
@@ -72,14 +358,576 @@ int PSPEmuFlashLoadFromFile(const char *pszFilename, void **ppv, size_t *pcb)
     return rc;
 }
 
+
 int PSPEmuFlashFree(void *pv, size_t cb)
 {
-    free(pv);
+    /* Both the file and the fallback path return mappings, munmap() rounds the size up to full pages. */
+    return munmap(pv, cb) == 0 ? 0 : -1;
+}
+
+
+/**
+ * Converts the given directory address to an offset into the flash.
+ *
+ * @returns Flash offset.
+ * @param   pThis                   The flash index instance.
+ * @param   u64Addr                 The address from the directory (either an offset or memory mapped address).
+ */
+static uint64_t pspEmuFlashIdxAddrToOff(PPSPFLASHIDXINT pThis, uint64_t u64Addr)
+{
+    /* The flash is mapped right below 4GiB, the upper bits of newer entries denote the address mode. */
+    uint64_t off = u64Addr & 0x00ffffff;
+    if (off >= pThis->cbFlash)
+    {
+        /*
+         * Smaller flash chips are mirrored in the 16MiB window which only works for power of two sizes,
+         * otherwise the offset is left out of range and rejected by the callers.
+         */
+        if (!(pThis->cbFlash & (pThis->cbFlash - 1)))
+            off &= pThis->cbFlash - 1;
+    }
+
+    return off;
+}
+
+
+/**
+ * Returns whether the given range is completely inside the flash.
+ *
+ * @returns Flag whether the range is valid.
+ * @param   pThis                   The flash index instance.
+ * @param   off                     Start offset of the range.
+ * @param   cb                      Size of the range in bytes.
+ */
+static inline bool pspEmuFlashIdxRangeIsValid(PPSPFLASHIDXINT pThis, uint64_t off, uint64_t cb)
+{
+    return    off < pThis->cbFlash
+           && cb <= pThis->cbFlash - off;
+}
+
+
+/**
+ * Adds the given entry to the index, replacing an existing entry from a lower directory level.
+ *
+ * @returns Status code.
+ * @param   pThis                   The flash index instance.
+ * @param   idEntry                 The entry ID.
+ * @param   uLvl                    The directory level the entry was found in.
+ * @param   offEntry                Offset of the entry from the start of the flash.
+ * @param   cbEntry                 Size of the entry in bytes.
+ */
+static int pspEmuFlashIdxEntryAdd(PPSPFLASHIDXINT pThis, uint32_t idEntry, uint32_t uLvl, uint64_t offEntry, uint64_t cbEntry)
+{
+    for (uint32_t i = 0; i < pThis->cEntries; i++)
+    {
+        PPSPFLASHIDXENTRY pEntry = &pThis->paEntries[i];
+
+        if (pEntry->idEntry == idEntry)
+        {
+            if (pEntry->uLvl < uLvl)
+            {
+                pEntry->uLvl     = uLvl;
+                pEntry->offEntry = offEntry;
+                pEntry->cbEntry  = cbEntry;
+            }
+            return STS_INF_SUCCESS;
+        }
+    }
+
+    if (pThis->cEntries == pThis->cEntriesMax)
+    {
+        uint32_t cEntriesNew = pThis->cEntriesMax ? pThis->cEntriesMax * 2 : 64;
+        PPSPFLASHIDXENTRY paEntriesNew = (PPSPFLASHIDXENTRY)realloc(pThis->paEntries, cEntriesNew * sizeof(*paEntriesNew));
+        if (!paEntriesNew)
+            return STS_ERR_NO_MEMORY;
+
+        pThis->paEntries   = paEntriesNew;
+        pThis->cEntriesMax = cEntriesNew;
+    }
+
+    PPSPFLASHIDXENTRY pEntry = &pThis->paEntries[pThis->cEntries++];
+    pEntry->idEntry  = idEntry;
+    pEntry->uLvl     = uLvl;
+    pEntry->offEntry = offEntry;
+    pEntry->cbEntry  = cbEntry;
+    return STS_INF_SUCCESS;
+}
+
+
+static int pspEmuFlashIdxDirScan(PPSPFLASHIDXINT pThis, uint64_t offDir, uint32_t uLvl);
+
+
+/**
+ * Indexes the given PSP directory.
+ *
+ * @returns Status code.
+ * @param   pThis                   The flash index instance.
+ * @param   offDir                  Offset of the directory header.
+ * @param   cEntries                Number of directory entries.
+ * @param   uLvl                    The directory level.
+ */
+static int pspEmuFlashIdxPspDirScan(PPSPFLASHIDXINT pThis, uint64_t offDir, uint32_t cEntries, uint32_t uLvl)
+{
+    int rc = STS_INF_SUCCESS;
+    PCPSPFLASHPSPDIRENTRY paEntries = (PCPSPFLASHPSPDIRENTRY)(pThis->pbFlash + offDir + sizeof(PSPFLASHDIRHDR));
+
+    for (uint32_t i = 0; i < cEntries && STS_SUCCESS(rc); i++)
+    {
+        PCPSPFLASHPSPDIRENTRY pEntry = &paEntries[i];
+        uint64_t offEntry = pspEmuFlashIdxAddrToOff(pThis, pEntry->u64Addr);
+
+        /* Value entries (soft fuses, etc.) and anything pointing outside of the flash are skipped. */
+        if (!pspEmuFlashIdxRangeIsValid(pThis, offEntry, pEntry->cbEntry))
+            continue;
+
+        if (pEntry->u8Type == PSP_FLASH_ENTRY_TYPE_PSP_L2_DIR)
+            rc = pspEmuFlashIdxDirScan(pThis, offEntry, uLvl + 1);
+        else
+            rc = pspEmuFlashIdxEntryAdd(pThis, PSP_FLASH_ENTRY_ID_PSP_MAKE(pEntry->u8Type, pEntry->u8SubProg),
+                                        uLvl, offEntry, pEntry->cbEntry);
+    }
+
+    return rc;
+}
+
+
+/**
+ * Indexes the given BIOS directory.
+ *
+ * @returns Status code.
+ * @param   pThis                   The flash index instance.
+ * @param   offDir                  Offset of the directory header.
+ * @param   cEntries                Number of directory entries.
+ * @param   uLvl                    The directory level.
+ */
+static int pspEmuFlashIdxBiosDirScan(PPSPFLASHIDXINT pThis, uint64_t offDir, uint32_t cEntries, uint32_t uLvl)
+{
+    int rc = STS_INF_SUCCESS;
+    PCPSPFLASHBIOSDIRENTRY paEntries = (PCPSPFLASHBIOSDIRENTRY)(pThis->pbFlash + offDir + sizeof(PSPFLASHDIRHDR));
+
+    for (uint32_t i = 0; i < cEntries && STS_SUCCESS(rc); i++)
+    {
+        PCPSPFLASHBIOSDIRENTRY pEntry = &paEntries[i];
+        uint64_t offEntry = pspEmuFlashIdxAddrToOff(pThis, pEntry->u64Src);
+
+        if (!pspEmuFlashIdxRangeIsValid(pThis, offEntry, pEntry->cbEntry))
+            continue;
+
+        if (pEntry->u8Type == PSP_FLASH_ENTRY_TYPE_BIOS_L2_DIR)
+            rc = pspEmuFlashIdxDirScan(pThis, offEntry, uLvl + 1);
+        else
+            rc = pspEmuFlashIdxEntryAdd(pThis, PSP_FLASH_ENTRY_ID_BIOS_MAKE(pEntry->u8Type, pEntry->u8SubProg),
+                                        uLvl, offEntry, pEntry->cbEntry);
+    }
+
+    return rc;
+}
+
+
+/**
+ * Indexes the directory at the given offset, dispatching on the directory cookie.
+ *
+ * @returns Status code, STS_ERR_NOT_FOUND if there is no valid directory at the given offset.
+ * @param   pThis                   The flash index instance.
+ * @param   offDir                  Offset of the directory header.
+ * @param   uLvl                    The directory level (0 for combo directories, 1 for 1st level directories, etc.).
+ */
+static int pspEmuFlashIdxDirScan(PPSPFLASHIDXINT pThis, uint64_t offDir, uint32_t uLvl)
+{
+    if (   uLvl > PSP_FLASH_DIR_DEPTH_MAX
+        || !pspEmuFlashIdxRangeIsValid(pThis, offDir, sizeof(PSPFLASHCOMBODIRHDR)))
+        return STS_ERR_NOT_FOUND;
+
+    PCPSPFLASHDIRHDR pHdr = (PCPSPFLASHDIRHDR)(pThis->pbFlash + offDir);
+    switch (pHdr->u32Cookie)
+    {
+        case PSP_FLASH_DIR_PSP_COMBO_COOKIE:
+        case PSP_FLASH_DIR_BIOS_COMBO_COOKIE:
+        {
+            PCPSPFLASHCOMBODIRHDR pComboHdr = (PCPSPFLASHCOMBODIRHDR)pHdr;
+            if (   uLvl != 0
+                || !pComboHdr->cEntries
+                || !pspEmuFlashIdxRangeIsValid(pThis, offDir + sizeof(*pComboHdr), sizeof(PSPFLASHCOMBODIRENTRY)))
+                return STS_ERR_NOT_FOUND;
+
+            /** @todo Select the directory matching the emulated chip ID instead of the first one. */
+            PCPSPFLASHCOMBODIRENTRY pEntry = (PCPSPFLASHCOMBODIRENTRY)(pComboHdr + 1);
+            return pspEmuFlashIdxDirScan(pThis, pspEmuFlashIdxAddrToOff(pThis, pEntry->u64Addr), 1);
+        }
+        case PSP_FLASH_DIR_PSP_L1_COOKIE:
+        case PSP_FLASH_DIR_PSP_L2_COOKIE:
+        {
+            if (!pspEmuFlashIdxRangeIsValid(pThis, offDir + sizeof(*pHdr), (uint64_t)pHdr->cEntries * sizeof(PSPFLASHPSPDIRENTRY)))
+                return STS_ERR_NOT_FOUND;
+
+            if (   pHdr->u32Cookie == PSP_FLASH_DIR_PSP_L1_COOKIE
+                && pThis->offPspDir == UINT64_MAX)
+                pThis->offPspDir = offDir;
+
+            return pspEmuFlashIdxPspDirScan(pThis, offDir, pHdr->cEntries, uLvl ? uLvl : 1);
+        }
+        case PSP_FLASH_DIR_BIOS_L1_COOKIE:
+        case PSP_FLASH_DIR_BIOS_L2_COOKIE:
+        {
+            if (!pspEmuFlashIdxRangeIsValid(pThis, offDir + sizeof(*pHdr), (uint64_t)pHdr->cEntries * sizeof(PSPFLASHBIOSDIRENTRY)))
+                return STS_ERR_NOT_FOUND;
+
+            return pspEmuFlashIdxBiosDirScan(pThis, offDir, pHdr->cEntries, uLvl ? uLvl : 1);
+        }
+        default:
+            break;
+    }
+
+    return STS_ERR_NOT_FOUND;
+}
+
+
+/**
+ * Scans the flash layout starting at the embedded firmware structure.
+ *
+ * @returns Status code.
+ * @param   pThis                   The flash index instance.
+ */
+static int pspEmuFlashIdxScan(PPSPFLASHIDXINT pThis)
+{
+    static const uint32_t s_aoffEfs[] = { 0x020000, 0x820000, 0xc20000, 0xe20000, 0xfa0000, 0xfc0000 };
+    int rc = STS_INF_SUCCESS;
+
+    for (uint32_t i = 0; i < ELEMENTS(s_aoffEfs); i++)
+    {
+        if (!pspEmuFlashIdxRangeIsValid(pThis, s_aoffEfs[i], sizeof(PSPFLASHEFS)))
+            continue;
+
+        PCPSPFLASHEFS pEfs = (PCPSPFLASHEFS)(pThis->pbFlash + s_aoffEfs[i]);
+        if (pEfs->u32Signature != PSP_FLASH_EFS_SIGNATURE)
+            continue;
+
+        const uint32_t au32Dirs[] = { pEfs->u32PspDirNew, pEfs->u32PspDir, pEfs->au32BiosDir[0],
+                                      pEfs->au32BiosDir[1], pEfs->au32BiosDir[2], pEfs->u32BiosDir3 };
+        for (uint32_t idxDir = 0; idxDir < ELEMENTS(au32Dirs) && STS_SUCCESS(rc); idxDir++)
+        {
+            if (   au32Dirs[idxDir]
+                && au32Dirs[idxDir] != 0xffffffff)
+            {
+                rc = pspEmuFlashIdxDirScan(pThis, pspEmuFlashIdxAddrToOff(pThis, au32Dirs[idxDir]), 0);
+                if (rc == STS_ERR_NOT_FOUND)
+                    rc = STS_INF_SUCCESS;
+            }
+        }
+
+        break;
+    }
+
+    /* Images without an EFS (or a broken one) get the PSP directory by looking for the cookie on every page. */
+    for (uint64_t offDir = 0; offDir < pThis->cbFlash && pThis->offPspDir == UINT64_MAX && STS_SUCCESS(rc); offDir += _4K)
+    {
+        rc = pspEmuFlashIdxDirScan(pThis, offDir, 1);
+        if (rc == STS_ERR_NOT_FOUND)
+            rc = STS_INF_SUCCESS;
+    }
+
+    return rc;
+}
+
+
+/**
+ * Index entry comparator for qsort() and bsearch().
+ */
+static int pspEmuFlashIdxEntryCmp(const void *pv1, const void *pv2)
+{
+    PCPSPFLASHIDXENTRY pEntry1 = (PCPSPFLASHIDXENTRY)pv1;
+    PCPSPFLASHIDXENTRY pEntry2 = (PCPSPFLASHIDXENTRY)pv2;
+
+    if (pEntry1->idEntry < pEntry2->idEntry)
+        return -1;
+    if (pEntry1->idEntry > pEntry2->idEntry)
+        return 1;
     return 0;
 }
 
+
+/**
+ * Initializes the cache key header fields from the flash image file.
+ *
+ * @returns Status code, STS_ERR_NOT_FOUND if the file can't be used for caching.
+ * @param   pThis                   The flash index instance.
+ * @param   pszFlashPath            Path of the flash image.
+ * @param   pHdr                    The header to initialize.
+ *
+ * @note The key consists of the file identity and modification time instead of a digest of the content
+ *       so validating the cache doesn't require reading the whole image.
+ */
+static int pspEmuFlashIdxCacheKeyInit(PPSPFLASHIDXINT pThis, const char *pszFlashPath, PSPFLASHIDXCACHEHDR *pHdr)
+{
+    struct stat StatFlash;
+
+    if (   stat(pszFlashPath, &StatFlash)
+        || !S_ISREG(StatFlash.st_mode)
+        || (uint64_t)StatFlash.st_size != pThis->cbFlash)
+        return STS_ERR_NOT_FOUND;
+
+    memset(pHdr, 0, sizeof(*pHdr));
+    pHdr->u32Magic   = PSP_FLASH_IDX_CACHE_MAGIC;
+    pHdr->u32Version = PSP_FLASH_IDX_CACHE_VERSION;
+    pHdr->u64Dev     = (uint64_t)StatFlash.st_dev;
+    pHdr->u64Inode   = (uint64_t)StatFlash.st_ino;
+    pHdr->i64MtimeNs = (int64_t)StatFlash.st_mtim.tv_sec * 1000000000 + StatFlash.st_mtim.tv_nsec;
+    pHdr->cbFlash    = pThis->cbFlash;
+    return STS_INF_SUCCESS;
+}
+
+
+/**
+ * Returns whether the cache file can be written next to the given flash image.
+ *
+ * @returns Flag whether the cache can be written.
+ * @param   pszFlashPath            Path of the flash image.
+ */
+static bool pspEmuFlashIdxCacheIsWritable(const char *pszFlashPath)
+{
+    struct statvfs StatFs;
+
+    if (   !statvfs(pszFlashPath, &StatFs)
+        && (StatFs.f_flag & ST_RDONLY))
+        return false;
+
+    return true;
+}
+
+
+/**
+ * Checks that the entries loaded from a cache are sorted by ID and completely inside the flash.
+ *
+ * @returns Flag whether the loaded index can be used.
+ * @param   pThis                   The flash index instance.
+ * @param   offPspDir               The loaded PSP directory offset.
+ * @param   paEntries               The loaded entries.
+ * @param   cEntries                Number of loaded entries.
+ *
+ * @note Matching the file identity doesn't guarantee that the content is unchanged (an in place rewrite
+ *       preserving the modification time) and the cache might be corrupted, so nothing is trusted.
+ */
+static bool pspEmuFlashIdxCacheIsSane(PPSPFLASHIDXINT pThis, uint64_t offPspDir, PCPSPFLASHIDXENTRY paEntries,
+                                      uint32_t cEntries)
+{
+    if (   offPspDir != UINT64_MAX
+        && offPspDir >= pThis->cbFlash)
+        return false;
+
+    for (uint32_t i = 0; i < cEntries; i++)
+    {
+        if (   !pspEmuFlashIdxRangeIsValid(pThis, paEntries[i].offEntry, paEntries[i].cbEntry)
+            || (   i > 0
+                && paEntries[i - 1].idEntry >= paEntries[i].idEntry))
+            return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Tries to load the index from the given cache file.
+ *
+ * @returns Status code, STS_ERR_NOT_FOUND if there is no matching cache.
+ * @param   pThis                   The flash index instance.
+ * @param   pszCache                The cache file path.
+ * @param   pHdrKey                 The expected cache header.
+ */
+static int pspEmuFlashIdxCacheLoad(PPSPFLASHIDXINT pThis, const char *pszCache, const PSPFLASHIDXCACHEHDR *pHdrKey)
+{
+    int rc = STS_ERR_NOT_FOUND;
+    FILE *pFile = fopen(pszCache, "rb");
+    if (pFile)
+    {
+        PSPFLASHIDXCACHEHDR Hdr;
+
+        if (   fread(&Hdr, sizeof(Hdr), 1, pFile) == 1
+            && Hdr.u32Magic == pHdrKey->u32Magic
+            && Hdr.u32Version == pHdrKey->u32Version
+            && Hdr.u64Dev == pHdrKey->u64Dev
+            && Hdr.u64Inode == pHdrKey->u64Inode
+            && Hdr.i64MtimeNs == pHdrKey->i64MtimeNs
+            && Hdr.cbFlash == pHdrKey->cbFlash)
+        {
+            PPSPFLASHIDXENTRY paEntries = NULL;
+            uint8_t bEof;
+
+            if (Hdr.cEntries)
+                paEntries = (PPSPFLASHIDXENTRY)calloc(Hdr.cEntries, sizeof(*paEntries));
+            if (   (   !Hdr.cEntries
+                    || (   paEntries
+                        && fread(paEntries, sizeof(*paEntries), Hdr.cEntries, pFile) == Hdr.cEntries))
+                && fread(&bEof, 1, 1, pFile) == 0
+                && pspEmuFlashIdxCacheIsSane(pThis, Hdr.offPspDir, paEntries, Hdr.cEntries))
+            {
+                pThis->offPspDir   = Hdr.offPspDir;
+                pThis->cEntries    = Hdr.cEntries;
+                pThis->cEntriesMax = Hdr.cEntries;
+                pThis->paEntries   = paEntries;
+                rc = STS_INF_SUCCESS;
+            }
+            else if (paEntries)
+                free(paEntries);
+        }
+
+        fclose(pFile);
+    }
+
+    return rc;
+}
+
+
+/**
+ * Stores the index in the given cache file.
+ *
+ * @returns nothing.
+ * @param   pThis                   The flash index instance.
+ * @param   pszCache                The cache file path.
+ * @param   pHdrKey                 The cache header with the key fields initialized.
+ *
+ * @note The index is written to a temporary file first and renamed afterwards so concurrent emulator
+ *       instances never see a partially written cache. Failing to store the cache is not fatal.
+ */
+static void pspEmuFlashIdxCacheStore(PPSPFLASHIDXINT pThis, const char *pszCache, const PSPFLASHIDXCACHEHDR *pHdrKey)
+{
+    char szPathTmp[4096];
+    PSPFLASHIDXCACHEHDR Hdr = *pHdrKey;
+
+    Hdr.offPspDir  = pThis->offPspDir;
+    Hdr.cEntries   = pThis->cEntries;
+
+    snprintf(&szPathTmp[0], sizeof(szPathTmp), "%s.%d.tmp", pszCache, (int)getpid());
+    FILE *pFile = fopen(&szPathTmp[0], "wb");
+    if (pFile)
+    {
+        bool fOk =    fwrite(&Hdr, sizeof(Hdr), 1, pFile) == 1
+                   && (   !pThis->cEntries
+                       || fwrite(pThis->paEntries, sizeof(*pThis->paEntries), pThis->cEntries, pFile) == pThis->cEntries);
+        if (fclose(pFile))
+            fOk = false;
+
+        if (   !fOk
+            || rename(&szPathTmp[0], pszCache))
+            remove(&szPathTmp[0]);
+    }
+}
+
+
+int PSPEmuFlashIdxCreate(PPSPFLASHIDX phFlashIdx, const void *pvFlash, size_t cbFlash, const char *pszFlashPath,
+                         bool fCacheWrite)
+{
+    int rc = STS_INF_SUCCESS;
+    PPSPFLASHIDXINT pThis = (PPSPFLASHIDXINT)calloc(1, sizeof(*pThis));
+    if (pThis)
+    {
+        char szCache[4096];
+        PSPFLASHIDXCACHEHDR HdrKey;
+        bool fCache = false;
+
+        pThis->pbFlash   = (const uint8_t *)pvFlash;
+        pThis->cbFlash   = cbFlash;
+        pThis->offPspDir = UINT64_MAX;
+
+        if (   pszFlashPath
+            && STS_SUCCESS(pspEmuFlashIdxCacheKeyInit(pThis, pszFlashPath, &HdrKey)))
+        {
+            snprintf(&szCache[0], sizeof(szCache), "%s.idx", pszFlashPath);
+            fCache = true;
+        }
+
+        if (   !fCache
+            || STS_FAILURE(pspEmuFlashIdxCacheLoad(pThis, &szCache[0], &HdrKey)))
+        {
+            rc = pspEmuFlashIdxScan(pThis);
+            if (STS_SUCCESS(rc))
+            {
+                if (pThis->cEntries)
+                    qsort(pThis->paEntries, pThis->cEntries, sizeof(*pThis->paEntries), pspEmuFlashIdxEntryCmp);
+                if (   fCache
+                    && fCacheWrite
+                    && pspEmuFlashIdxCacheIsWritable(pszFlashPath))
+                    pspEmuFlashIdxCacheStore(pThis, &szCache[0], &HdrKey);
+            }
+        }
+
+        if (STS_SUCCESS(rc))
+        {
+            *phFlashIdx = pThis;
+            return STS_INF_SUCCESS;
+        }
+
+        if (pThis->paEntries)
+            free(pThis->paEntries);
+        free(pThis);
+    }
+    else
+        rc = STS_ERR_NO_MEMORY;
+
+    return rc;
+}
+
+
+void PSPEmuFlashIdxDestroy(PSPFLASHIDX hFlashIdx)
+{
+    PPSPFLASHIDXINT pThis = hFlashIdx;
+
+    if (pThis->paEntries)
+        free(pThis->paEntries);
+    free(pThis);
+}
+
+
+int PSPEmuFlashIdxQueryEntry(PSPFLASHIDX hFlashIdx, uint32_t idEntry, size_t *poffEntry, size_t *pcbEntry)
+{
+    PPSPFLASHIDXINT pThis = hFlashIdx;
+    PSPFLASHIDXENTRY Key;
+
+    Key.idEntry = idEntry;
+    PCPSPFLASHIDXENTRY pEntry = (PCPSPFLASHIDXENTRY)bsearch(&Key, pThis->paEntries, pThis->cEntries,
+                                                            sizeof(*pThis->paEntries), pspEmuFlashIdxEntryCmp);
+    if (!pEntry)
+        return STS_ERR_NOT_FOUND;
+
+    *poffEntry = pEntry->offEntry;
+    *pcbEntry  = pEntry->cbEntry;
+    return STS_INF_SUCCESS;
+}
+
+
+int PSPEmuFlashIdxQueryPspDir(PSPFLASHIDX hFlashIdx, size_t *poffDir)
+{
+    PPSPFLASHIDXINT pThis = hFlashIdx;
+
+    if (pThis->offPspDir == UINT64_MAX)
+        return STS_ERR_NOT_FOUND;
+
+    *poffDir = pThis->offPspDir;
+    return STS_INF_SUCCESS;
+}
+
+
 int PSPEmuFlashReadEntry(uint32_t enmEntryId, void *pvFlash, size_t cbFlash, void *pvDst, size_t cbDst)
 {
-    return -1;
+    PSPFLASHIDX hFlashIdx;
+    int rc = PSPEmuFlashIdxCreate(&hFlashIdx, pvFlash, cbFlash, NULL /*pszFlashPath*/, false /*fCacheWrite*/);
+    if (STS_SUCCESS(rc))
+    {
+        size_t offEntry = 0;
+        size_t cbEntry = 0;
+
+        rc = PSPEmuFlashIdxQueryEntry(hFlashIdx, enmEntryId, &offEntry, &cbEntry);
+        if (STS_SUCCESS(rc))
+        {
+            if (cbEntry <= cbDst)
+                memcpy(pvDst, (uint8_t *)pvFlash + offEntry, cbEntry);
+            else
+                rc = STS_ERR_BUFFER_OVERFLOW;
+        }
+
+        PSPEmuFlashIdxDestroy(hFlashIdx);
+    }
+
+    return rc;
 }
 
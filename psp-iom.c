@@ -23,15 +23,24 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
+#include <sys/mman.h>
 
 #include <common/types.h>
 #include <common/cdefs.h>
 #include <common/status.h>
 
 #include <psp-iom.h>
+#include <psp-perf.h>
 #include <psp-trace.h>
 
 
+/** Page shift used for fetching x86 memory on demand. */
+#define PSP_IOM_X86_MEM_PAGE_SHIFT      12
+/** Page size used for fetching x86 memory on demand. */
+#define PSP_IOM_X86_MEM_PAGE_SIZE       (1 << PSP_IOM_X86_MEM_PAGE_SHIFT)
+
+
 /** Pointer to the internal I/O manager state. */
 typedef struct PSPIOMINT *PPSPIOMINT;
 
@@ -153,6 +162,16 @@ typedef struct PSPIOMREGIONHANDLEINT
     const char                      *pszDesc;
     /** Flags for this region. */
     uint32_t                        fFlags;
+    /** Number of trace points overlapping this region, 0 means tracing is skipped entirely. */
+    uint32_t                        cTps;
+    /** Array of trace points overlapping this region (newest first). */
+    PCPSPIOMTPINT                   *papTps;
+    /** Trace filter generation the clause bitmap below was evaluated for, 0 if never evaluated. */
+    uint32_t                        uTraceFltGen;
+    /** Bitmap of trace filter clauses which can match accesses to this region. */
+    uint64_t                        bmTraceFlt;
+    /** Access statistics. */
+    PSPIOMSTATS                     Stats;
     /** Type dependent data. */
     union
     {
@@ -179,6 +198,12 @@ typedef struct PSPIOMREGIONHANDLEINT
             PFNPSPIOMSMNREAD        pfnRead;
             /** Write callback. */
             PFNPSPIOMSMNWRITE       pfnWrite;
+            /** Host memory backing the region if it can be mapped directly, NULL if not. */
+            void                    *pvBacking;
+            /** Protection flags for the direct mapping (PSPEMU_CORE_MEM_REGION_PROT_F_XXX). */
+            uint32_t                fBackingProt;
+            /** Size of the backing allocation if the I/O manager allocated it (RAM region), 0 otherwise. */
+            size_t                  cbBackingAlloc;
         } Smn;
         /** X86 MMIO/Memory region. */
         struct
@@ -201,16 +226,15 @@ typedef struct PSPIOMREGIONHANDLEINT
                 /** Memory specific data. */
                 struct
                 {
-                    /** Pointer to the next exectuable memory region (only valid if  fCanExec is true). */
-                    struct PSPIOMREGIONHANDLEINT *pExecNext;
                     /** Fetch callback. */
                     PFNPSPIOMX86MEMFETCH         pfnFetch;
-                    /** Pointer to memory backing this region. */
+                    /** Pointer to memory backing this region, the whole region is reserved on first access
+                     * and the host allocates pages only when they get touched. */
                     void                         *pvMapping;
-                    /** Amount of memory currently allocated. */
+                    /** Size of the reservation in bytes (region size rounded up to a page). */
                     size_t                       cbAlloc;
-                    /** Size of the region initialized with valid data so far. */
-                    size_t                       cbValid;
+                    /** Bitmap of pages already fetched (one bit per page). */
+                    uint8_t                      *pbmPagesValid;
                     /** Size of the highest written area so far (exclusive, defines range of memory to sync back). */
                     size_t                       cbWritten;
                     /** Flag whether the memory should be made executable to the core. */
@@ -250,6 +274,25 @@ typedef PSPIOMX86MMIOSPLIT *PPSPIOMX86MMIOSPLIT;
 typedef const PSPIOMX86MMIOSPLIT *PCPSPIOMX86MMIOSPLIT;
 
 
+/** Maximum number of x86 memory regions mapped directly into a single x86 mapping slot. */
+#define PSP_IOM_X86_SLOT_MEM_DIRECT_MAX 8
+
+/**
+ * X86 memory region mapped directly into a x86 mapping slot.
+ */
+typedef struct PSPIOMX86MEMDIRECT
+{
+    /** The x86 memory region. */
+    PPSPIOMREGIONHANDLEINT      pX86Mem;
+    /** PSP address the (page aligned) part of the memory region is mapped to. */
+    PSPADDR                     PspAddrStart;
+    /** Size of the direct mapping. */
+    size_t                      cbMem;
+} PSPIOMX86MEMDIRECT;
+/** Pointer to a directly mapped x86 memory region descriptor. */
+typedef PSPIOMX86MEMDIRECT *PPSPIOMX86MEMDIRECT;
+
+
 /**
  * X86 mapping control slot.
  */
@@ -264,16 +307,14 @@ typedef struct PSPIOMX86MAPCTRLSLOT
     /** The x86 physical base address currently mapped. */
     X86PADDR                        PhysX86Base;
 
-    /** The x86 memory region mapped executable,
-     * We only allow only one for now. */
-    PPSPIOMREGIONHANDLEINT          pX86MemExec;
-    /** PSP address the memory region is mapped to. */
-    PSPADDR                         PspAddrMemExecStart;
-    /** Size of the executable memory region. */
-    size_t                          cbMemExec;
-
-    /* Split MMIO region data if any (before and after executable region). */
-    PSPIOMX86MMIOSPLIT              aSplitMmio[2];
+    /** Number of x86 memory regions mapped directly, 0 if the whole slot goes through the callbacks. */
+    uint32_t                        cMemDirect;
+    /** The directly mapped x86 memory regions, sorted by address. */
+    PSPIOMX86MEMDIRECT              aMemDirect[PSP_IOM_X86_SLOT_MEM_DIRECT_MAX];
+    /** Number of split MMIO regions registered for the gaps between the directly mapped regions. */
+    uint32_t                        cSplitMmio;
+    /** Split MMIO region data if any (before, between and after the directly mapped regions). */
+    PSPIOMX86MMIOSPLIT              aSplitMmio[PSP_IOM_X86_SLOT_MEM_DIRECT_MAX + 1];
 
     /** @name Register interface accessible from MMIO space.
      * @{ */
@@ -287,6 +328,53 @@ typedef struct PSPIOMX86MAPCTRLSLOT
 } PSPIOMX86MAPCTRLSLOT;
 
 
+/** Start of the SMN mapping slots in the PSP address space. */
+#define PSP_IOM_SMN_SLOTS_START         0x01000000
+/** Number of SMN mapping slots. */
+#define PSP_IOM_SMN_SLOTS_COUNT         32
+/** Size of a single SMN mapping slot. */
+#define PSP_IOM_SMN_SLOT_SIZE           _1M
+
+
+/** Forward declaration of a SMN mapping slot pointer. */
+typedef struct PSPIOMSMNSLOT *PPSPIOMSMNSLOT;
+
+/**
+ * SMN slot MMIO descriptor, a slot is split into two of them around a directly mapped region.
+ */
+typedef struct PSPIOMSMNMMIO
+{
+    /** Owning SMN mapping slot. */
+    PPSPIOMSMNSLOT              pSmnSlot;
+    /** Start PSP MMIO address of the MMIO region. */
+    PSPADDR                     PspAddrMmioStart;
+    /** Size of the MMIO region, 0 if not registered. */
+    size_t                      cbMmio;
+} PSPIOMSMNMMIO;
+/** Pointer to a SMN slot MMIO descriptor. */
+typedef PSPIOMSMNMMIO *PPSPIOMSMNMMIO;
+
+
+/**
+ * SMN mapping slot.
+ */
+typedef struct PSPIOMSMNSLOT
+{
+    /** Pointer to the owning I/O manager instance. */
+    PPSPIOMINT                      pIoMgr;
+    /** Base MMIO address this slot starts at. */
+    PSPADDR                         PspAddrMmioStart;
+    /** The SMN region mapped directly, NULL if the whole slot goes through the callbacks. */
+    PPSPIOMREGIONHANDLEINT          pSmnDirect;
+    /** PSP address the region is mapped to. */
+    PSPADDR                         PspAddrDirectStart;
+    /** Size of the direct mapping. */
+    size_t                          cbDirect;
+    /** The MMIO regions registered for the slot (the whole slot or the parts before and after the direct mapping). */
+    PSPIOMSMNMMIO                   aMmio[2];
+} PSPIOMSMNSLOT;
+
+
 /**
  * The internal I/O manager manager state.
  */
@@ -298,8 +386,6 @@ typedef struct PSPIOMINT
     PPSPIOMREGIONHANDLEINT      pSmnHead;
     /** The head of list of X86 regions (@todo AVL tree?). */
     PPSPIOMREGIONHANDLEINT      pX86Head;
-    /** The head of list of X86 memory regions with exec permissions. */
-    PPSPIOMREGIONHANDLEINT      pX86MemExecHead;
     /** Lowest MMIO address assigned to a region (for faster lookup). */
     PSPADDR                     PspAddrMmioLowest;
     /** Highes MMIO address assigned to a region (inclusive). */
@@ -315,7 +401,9 @@ typedef struct PSPIOMINT
     /** The PSP core handle this I/O manager is assigned to. */
     PSPCORE                     hPspCore;
     /** The currently mapped SMN base address for each slot (written by the control interface). */
-    SMNADDR                     aSmnAddrBaseSlots[32];
+    SMNADDR                     aSmnAddrBaseSlots[PSP_IOM_SMN_SLOTS_COUNT];
+    /** The SMN mapping slots. */
+    PSPIOMSMNSLOT               aSmnSlots[PSP_IOM_SMN_SLOTS_COUNT];
     /** The MMIO region handle for the SMN control register interface. */
     PPSPIOMREGIONHANDLEINT      pMmioRegionSmnCtrl;
     /** The MMIO region handle for the X86 mapping control register interface. */
@@ -354,10 +442,18 @@ typedef struct PSPIOMINT
     /** Description used for access tracing. */
     const char                  *pszX86UnassignedDesc;
 
-    /** Registered trace points. */
+    /** Registered trace points (newest first), also attached to the regions they overlap,
+     * the list is only walked for unassigned accesses. */
     PPSPIOMTPINT                pTpHead;
     /** Flag whether to log all accesses or only ones to unassigned regions. */
     bool                        fLogAllAccesses;
+    /** Flag whether the access statistics are gathered. */
+    bool                        fStats;
+    /** Access statistics for unassigned accesses, indexed by PSPIOMADDRSPACE. */
+    PSPIOMSTATS                 aStatsUnassigned[PSPIOMADDRSPACE_X86 + 1];
+    /** Region generation counter, incremented whenever a region gets deregistered
+     * (invalidates regions cached during vectored accesses). */
+    uint32_t                    uRegionGen;
 } PSPIOMINT;
 
 
@@ -446,6 +542,166 @@ static PCPSPIOMTPINT pspEmuIomTpFindNext(PCPSPIOMTPINT pFirst, PSPIOMTRACETYPE e
 }
 
 
+/**
+ * Returns whether the given trace point matches the given access pattern.
+ *
+ * @returns Flag whether the trace point matches.
+ * @param   pTp                     The trace point to check.
+ * @param   cbAccess                Access width, 1, 2 or 4 byte.
+ * @param   fFlagsRw                Read/Write flags matching the trace point.
+ * @param   fFlagsAp                Access point (before/after) flags matching the trace point.
+ */
+static inline bool pspEmuIomTpMatches(PCPSPIOMTPINT pTp, size_t cbAccess, uint32_t fFlagsRw, uint32_t fFlagsAp)
+{
+    return    (   pTp->cbAccess == cbAccess
+               || !pTp->cbAccess) /* 0 matches all access widths. */
+           && (pTp->fFlags & fFlagsRw) != 0
+           && (pTp->fFlags & fFlagsAp) != 0;
+}
+
+
+/**
+ * Returns whether the given trace point covers any part of the given region.
+ *
+ * @returns Flag whether the trace point overlaps the region.
+ * @param   pRegion                 The region to check.
+ * @param   pTp                     The trace point to check.
+ */
+static bool pspEmuIomRegionTpOverlaps(PPSPIOMREGIONHANDLEINT pRegion, PCPSPIOMTPINT pTp)
+{
+    switch (pRegion->enmType)
+    {
+        case PSPIOMREGIONTYPE_PSP_MMIO:
+            return    pTp->enmType == PSPIOMTRACETYPE_MMIO
+                   && pTp->u.Mmio.PspAddrMmioStart <= pRegion->u.Mmio.PspAddrMmioStart + pRegion->u.Mmio.cbMmio - 1
+                   && pTp->u.Mmio.PspAddrMmioEnd >= pRegion->u.Mmio.PspAddrMmioStart;
+        case PSPIOMREGIONTYPE_SMN:
+            return    pTp->enmType == PSPIOMTRACETYPE_SMN
+                   && pTp->u.Smn.SmnAddrStart <= pRegion->u.Smn.SmnAddrStart + pRegion->u.Smn.cbSmn - 1
+                   && pTp->u.Smn.SmnAddrEnd >= pRegion->u.Smn.SmnAddrStart;
+        case PSPIOMREGIONTYPE_X86_MMIO:
+        case PSPIOMREGIONTYPE_X86_MEM:
+            return    pTp->enmType == PSPIOMTRACETYPE_X86
+                   && pTp->u.X86.PhysX86AddrStart <= pRegion->u.X86.PhysX86AddrStart + pRegion->u.X86.cbX86 - 1
+                   && pTp->u.X86.PhysX86AddrEnd >= pRegion->u.X86.PhysX86AddrStart;
+        default:
+            break;
+    }
+
+    return false;
+}
+
+
+/**
+ * Attaches the given trace point to the given region.
+ *
+ * @returns Status code.
+ * @param   pRegion                 The region to attach the trace point to.
+ * @param   pTp                     The trace point to attach.
+ * @param   fFront                  Flag whether to put the trace point in front of the existing ones.
+ */
+static int pspEmuIomRegionTpAttach(PPSPIOMREGIONHANDLEINT pRegion, PCPSPIOMTPINT pTp, bool fFront)
+{
+    PCPSPIOMTPINT *papTpsNew = (PCPSPIOMTPINT *)realloc(pRegion->papTps, (pRegion->cTps + 1) * sizeof(*papTpsNew));
+    if (!papTpsNew)
+        return -1;
+
+    if (fFront)
+    {
+        memmove(&papTpsNew[1], &papTpsNew[0], pRegion->cTps * sizeof(*papTpsNew));
+        papTpsNew[0] = pTp;
+    }
+    else
+        papTpsNew[pRegion->cTps] = pTp;
+
+    pRegion->papTps = papTpsNew;
+    pRegion->cTps++;
+    return 0;
+}
+
+
+/**
+ * Detaches the given trace point from the given region if attached.
+ *
+ * @returns nothing.
+ * @param   pRegion                 The region to detach the trace point from.
+ * @param   pTp                     The trace point to detach.
+ */
+static void pspEmuIomRegionTpDetach(PPSPIOMREGIONHANDLEINT pRegion, PCPSPIOMTPINT pTp)
+{
+    for (uint32_t i = 0; i < pRegion->cTps; i++)
+    {
+        if (pRegion->papTps[i] == pTp)
+        {
+            memmove(&pRegion->papTps[i], &pRegion->papTps[i + 1], (pRegion->cTps - i - 1) * sizeof(pRegion->papTps[0]));
+            pRegion->cTps--;
+            if (!pRegion->cTps)
+            {
+                free(pRegion->papTps);
+                pRegion->papTps = NULL;
+            }
+            break;
+        }
+    }
+}
+
+
+/**
+ * Attaches all existing trace points overlapping the given newly registered region.
+ *
+ * @returns Status code.
+ * @param   pThis                   The I/O manager.
+ * @param   pRegion                 The region to attach the trace points to.
+ */
+static int pspEmuIomRegionTpsAttachAll(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRegion)
+{
+    int rc = 0;
+    PCPSPIOMTPINT pTp = pThis->pTpHead;
+
+    while (   pTp
+           && !rc)
+    {
+        if (pspEmuIomRegionTpOverlaps(pRegion, pTp))
+            rc = pspEmuIomRegionTpAttach(pRegion, pTp, false /*fFront*/);
+        pTp = pTp->pNext;
+    }
+
+    if (rc)
+    {
+        free(pRegion->papTps);
+        pRegion->papTps = NULL;
+        pRegion->cTps   = 0;
+    }
+
+    return rc;
+}
+
+
+/**
+ * Returns the head of the region list trace points of the given type can hit.
+ *
+ * @returns Region list head.
+ * @param   pThis                   The I/O manager.
+ * @param   enmType                 The trace point type.
+ */
+static PPSPIOMREGIONHANDLEINT pspEmuIomTpRegionListGet(PPSPIOMINT pThis, PSPIOMTRACETYPE enmType)
+{
+    switch (enmType)
+    {
+        case PSPIOMTRACETYPE_MMIO:
+            return pThis->pMmioHead;
+        case PSPIOMTRACETYPE_SMN:
+            return pThis->pSmnHead;
+        case PSPIOMTRACETYPE_X86:
+            return pThis->pX86Head;
+        default:
+            break;
+    }
+
+    return NULL;
+}
+
+
 static SMNADDR pspEmuIomGetSmnAddrFromSlotAndOffset(PPSPIOMINT pThis, PSPADDR offMmio)
 {
     /* Each slot is 1MB big, so get the slot number by shifting the appropriate bits to the right. */
@@ -461,6 +717,135 @@ static SMNADDR pspEmuIomGetSmnAddrFromSlotAndOffset(PPSPIOMINT pThis, PSPADDR of
 }
 
 
+/**
+ * Returns the current host timestamp used for the handler statistics.
+ *
+ * @returns Nanosecond timestamp.
+ */
+static inline uint64_t pspEmuIomStatsTsNs(void)
+{
+    struct timespec Tp;
+    clock_gettime(CLOCK_MONOTONIC, &Tp);
+    return (uint64_t)Tp.tv_sec * 1000000000ULL + Tp.tv_nsec;
+}
+
+
+/**
+ * Accounts a read to the statistics of the given region.
+ *
+ * @returns nothing.
+ * @param   pThis                   I/O manager instance.
+ * @param   pRegion                 The region or NULL if unassigned.
+ * @param   enmAddrSpace            The address space being accessed (for unassigned accesses).
+ * @param   cbRead                  Number of bytes read.
+ * @param   tsStartNs               Host timestamp taken before calling the handler.
+ */
+static inline void pspEmuIomStatsRead(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRegion, PSPIOMADDRSPACE enmAddrSpace,
+                                      size_t cbRead, uint64_t tsStartNs)
+{
+    PPSPIOMSTATS pStats = pRegion ? &pRegion->Stats : &pThis->aStatsUnassigned[enmAddrSpace];
+
+    pStats->cReads++;
+    pStats->cbRead  += cbRead;
+    pStats->cNsRead += pspEmuIomStatsTsNs() - tsStartNs;
+}
+
+
+/**
+ * Accounts a write to the statistics of the given region.
+ *
+ * @returns nothing.
+ * @param   pThis                   I/O manager instance.
+ * @param   pRegion                 The region or NULL if unassigned.
+ * @param   enmAddrSpace            The address space being accessed (for unassigned accesses).
+ * @param   cbWrite                 Number of bytes written.
+ * @param   tsStartNs               Host timestamp taken before calling the handler.
+ */
+static inline void pspEmuIomStatsWrite(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRegion, PSPIOMADDRSPACE enmAddrSpace,
+                                       size_t cbWrite, uint64_t tsStartNs)
+{
+    PPSPIOMSTATS pStats = pRegion ? &pRegion->Stats : &pThis->aStatsUnassigned[enmAddrSpace];
+
+    pStats->cWrites++;
+    pStats->cbWritten += cbWrite;
+    pStats->cNsWrite  += pspEmuIomStatsTsNs() - tsStartNs;
+}
+
+
+/**
+ * Returns the identifier to use for unassigned accesses of the given origin.
+ *
+ * @returns Pointer to the identifier.
+ * @param   pThis                   I/O manager instance.
+ * @param   enmOrigin               The trace event origin.
+ */
+static const char *pspEmuIomTraceUnassignedIdGet(PPSPIOMINT pThis, PSPTRACEEVTORIGIN enmEvtOrigin)
+{
+    const char *pszRegId = NULL;
+
+    switch (enmEvtOrigin)
+    {
+        case PSPTRACEEVTORIGIN_MMIO:
+            pszRegId = pThis->pszMmioUnassignedDesc;
+            break;
+        case PSPTRACEEVTORIGIN_SMN:
+            pszRegId = pThis->pszSmnUnassignedDesc;
+            break;
+        case PSPTRACEEVTORIGIN_X86:
+            pszRegId = pThis->pszX86UnassignedDesc;
+            break;
+        default:
+            break;
+    }
+
+    return pszRegId ? pszRegId : "<UNASSIGNED>";
+}
+
+
+/**
+ * Decides whether the given access should be logged to the tracer.
+ *
+ * @returns Flag whether to create a trace event for the access.
+ * @param   pThis                   I/O manager instance.
+ * @param   pRegion                 The region or NULL if unassigned.
+ * @param   fUnassigned             Flag whether the access is treated as unassigned.
+ * @param   enmOrigin               The trace event origin.
+ * @param   pszRegId                The region identifier being logged.
+ * @param   u64Addr                 The address being accessed.
+ * @param   fWrite                  Flag whether this is a write.
+ * @param   pvVal                   The data being accessed.
+ * @param   cbVal                   Number of bytes accessed.
+ *
+ * @note Without a trace filter only unassigned accesses are logged unless logging all accesses is enabled.
+ *       With a filter every access matching it is logged and nothing else, the device dependent part
+ *       of the filter is cached in the region until the filter changes.
+ */
+static bool pspEmuIomTraceShouldLog(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRegion, bool fUnassigned,
+                                    PSPTRACEEVTORIGIN enmEvtOrigin, const char *pszRegId, uint64_t u64Addr,
+                                    bool fWrite, const void *pvVal, size_t cbVal)
+{
+    uint32_t uFltGen = PSPEmuTraceFilterGetGen(NULL);
+    if (!uFltGen)
+        return fUnassigned || pThis->fLogAllAccesses;
+
+    uint64_t bmFlt = 0;
+    if (!fUnassigned)
+    {
+        if (pRegion->uTraceFltGen != uFltGen)
+        {
+            pRegion->bmTraceFlt   = PSPEmuTraceFilterQueryDev(NULL, enmEvtOrigin, pszRegId);
+            pRegion->uTraceFltGen = uFltGen;
+        }
+        bmFlt = pRegion->bmTraceFlt;
+    }
+    else
+        bmFlt = PSPEmuTraceFilterQueryDev(NULL, enmEvtOrigin, pszRegId);
+
+    return    bmFlt
+           && PSPEmuTraceFilterCheck(NULL, bmFlt, u64Addr, fWrite, pvVal, cbVal);
+}
+
+
 /**
  * Logs a read from the given region to the tracer.
  *
@@ -475,43 +860,22 @@ static SMNADDR pspEmuIomGetSmnAddrFromSlotAndOffset(PPSPIOMINT pThis, PSPADDR of
 static void pspEmuIomTraceRegionRead(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRegion, PSPTRACEEVTORIGIN enmEvtOrigin,
                                      uint64_t u64Addr, const void *pvDst, size_t cbRead)
 {
-    PSPTRACEEVTSEVERITY enmSeverity = PSPTRACEEVTSEVERITY_INFO;
-    const char *pszRegId = NULL;
-
-    if (   !pRegion
-        || !(pRegion->fFlags & PSP_IOM_REGION_F_READ)) /* Writeonly regions get treated as unassigned for now. */
-    {
-        pszRegId = "<UNASSIGNED>";
-        switch (enmEvtOrigin)
-        {
-            case PSPTRACEEVTORIGIN_MMIO:
-                if (pThis->pszMmioUnassignedDesc)
-                    pszRegId = pThis->pszMmioUnassignedDesc;
-                break;
-            case PSPTRACEEVTORIGIN_SMN:
-                if (pThis->pszSmnUnassignedDesc)
-                    pszRegId = pThis->pszSmnUnassignedDesc;
-                break;
-            case PSPTRACEEVTORIGIN_X86:
-                if (pThis->pszX86UnassignedDesc)
-                    pszRegId = pThis->pszX86UnassignedDesc;
-                break;
-            default:
-                break;
-        }
+    /* Writeonly regions get treated as unassigned for now. */
+    bool fUnassigned = !pRegion || !(pRegion->fFlags & PSP_IOM_REGION_F_READ);
 
-        enmSeverity = PSPTRACEEVTSEVERITY_WARNING;
-    }
-    else if (pThis->fLogAllAccesses)
-    {
-        if (!pRegion->pszDesc)
-            pszRegId = "<UNKNOWN>";
-        else
-            pszRegId = pRegion->pszDesc;
-    }
+    /* Fast path for the common case of an assigned access without anything to log. */
+    if (   !fUnassigned
+        && !pThis->fLogAllAccesses
+        && !PSPEmuTraceFilterGetGen(NULL))
+        return;
 
-    if (pszRegId)
-        PSPEmuTraceEvtAddDevRead(NULL, enmSeverity, enmEvtOrigin, pszRegId, u64Addr, pvDst, cbRead);
+    const char *pszRegId =   fUnassigned
+                           ? pspEmuIomTraceUnassignedIdGet(pThis, enmEvtOrigin)
+                           : pRegion->pszDesc ? pRegion->pszDesc : "<UNKNOWN>";
+    if (pspEmuIomTraceShouldLog(pThis, pRegion, fUnassigned, enmEvtOrigin, pszRegId, u64Addr,
+                                false /*fWrite*/, pvDst, cbRead))
+        PSPEmuTraceEvtAddDevRead(NULL, fUnassigned ? PSPTRACEEVTSEVERITY_WARNING : PSPTRACEEVTSEVERITY_INFO,
+                                 enmEvtOrigin, pszRegId, u64Addr, pvDst, cbRead);
 }
 
 
@@ -529,43 +893,22 @@ static void pspEmuIomTraceRegionRead(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pR
 static void pspEmuIomTraceRegionWrite(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRegion, PSPTRACEEVTORIGIN enmEvtOrigin,
                                       uint64_t u64Addr, const void *pvData, size_t cbWrite)
 {
-    PSPTRACEEVTSEVERITY enmSeverity = PSPTRACEEVTSEVERITY_INFO;
-    const char *pszRegId = NULL;
+    /* Readonly regions get treated as unassigned for now. */
+    bool fUnassigned = !pRegion || !(pRegion->fFlags & PSP_IOM_REGION_F_WRITE);
 
-    if (   !pRegion
-        || !(pRegion->fFlags & PSP_IOM_REGION_F_WRITE)) /* Readonly regions get treated as unassigned for now. */
-    {
-        pszRegId = "<UNASSIGNED>";
-        switch (enmEvtOrigin)
-        {
-            case PSPTRACEEVTORIGIN_MMIO:
-                if (pThis->pszMmioUnassignedDesc)
-                    pszRegId = pThis->pszMmioUnassignedDesc;
-                break;
-            case PSPTRACEEVTORIGIN_SMN:
-                if (pThis->pszSmnUnassignedDesc)
-                    pszRegId = pThis->pszSmnUnassignedDesc;
-                break;
-            case PSPTRACEEVTORIGIN_X86:
-                if (pThis->pszX86UnassignedDesc)
-                    pszRegId = pThis->pszX86UnassignedDesc;
-                break;
-            default:
-                break;
-        }
+    /* Fast path for the common case of an assigned access without anything to log. */
+    if (   !fUnassigned
+        && !pThis->fLogAllAccesses
+        && !PSPEmuTraceFilterGetGen(NULL))
+        return;
 
-        enmSeverity = PSPTRACEEVTSEVERITY_WARNING;
-    }
-    else if (pThis->fLogAllAccesses)
-    {
-        if (!pRegion->pszDesc)
-            pszRegId = "<UNKNOWN>";
-        else
-            pszRegId = pRegion->pszDesc;
-    }
-
-    if (pszRegId)
-        PSPEmuTraceEvtAddDevWrite(NULL, enmSeverity, enmEvtOrigin, pszRegId, u64Addr, pvData, cbWrite);
+    const char *pszRegId =   fUnassigned
+                           ? pspEmuIomTraceUnassignedIdGet(pThis, enmEvtOrigin)
+                           : pRegion->pszDesc ? pRegion->pszDesc : "<UNKNOWN>";
+    if (pspEmuIomTraceShouldLog(pThis, pRegion, fUnassigned, enmEvtOrigin, pszRegId, u64Addr,
+                                true /*fWrite*/, pvData, cbWrite))
+        PSPEmuTraceEvtAddDevWrite(NULL, fUnassigned ? PSPTRACEEVTSEVERITY_WARNING : PSPTRACEEVTSEVERITY_INFO,
+                                  enmEvtOrigin, pszRegId, u64Addr, pvData, cbWrite);
 }
 
 
@@ -584,6 +927,26 @@ static void pspEmuIomTraceRegionWrite(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT p
 static void pspEmuIomSmnTpCall(PPSPIOMINT pThis, SMNADDR SmnAddr, PPSPIOMREGIONHANDLEINT pRegion, size_t cbAccess, const void *pvVal,
                                uint32_t fFlagsRw, uint32_t fFlagsAp)
 {
+    if (pRegion)
+    {
+        /* Only the trace points overlapping the region are attached to it. */
+        for (uint32_t i = 0; i < pRegion->cTps; i++)
+        {
+            PCPSPIOMTPINT pTp = pRegion->papTps[i];
+            if (   pspEmuIomTpMatches(pTp, cbAccess, fFlagsRw, fFlagsAp)
+                && SmnAddr >= pTp->u.Smn.SmnAddrStart
+                && SmnAddr <= pTp->u.Smn.SmnAddrEnd)
+                pTp->u.Smn.pfnTrace(SmnAddr,
+                                    NULL, /** @todo Description */
+                                    SmnAddr - pRegion->u.Smn.SmnAddrStart,
+                                    cbAccess,
+                                    pvVal,
+                                    fFlagsRw | fFlagsAp,
+                                    pTp->pvUser);
+        }
+        return;
+    }
+
     PCPSPIOMTPINT pTp = pThis->pTpHead;
     for (;;)
     {
@@ -620,6 +983,26 @@ static void pspEmuIomSmnTpCall(PPSPIOMINT pThis, SMNADDR SmnAddr, PPSPIOMREGIONH
 static void pspEmuIomMmioTpCall(PPSPIOMINT pThis, PSPADDR PspAddrMmio, PPSPIOMREGIONHANDLEINT pRegion, size_t cbAccess, const void *pvVal,
                                 uint32_t fFlagsRw, uint32_t fFlagsAp)
 {
+    if (pRegion)
+    {
+        /* Only the trace points overlapping the region are attached to it. */
+        for (uint32_t i = 0; i < pRegion->cTps; i++)
+        {
+            PCPSPIOMTPINT pTp = pRegion->papTps[i];
+            if (   pspEmuIomTpMatches(pTp, cbAccess, fFlagsRw, fFlagsAp)
+                && PspAddrMmio >= pTp->u.Mmio.PspAddrMmioStart
+                && PspAddrMmio <= pTp->u.Mmio.PspAddrMmioEnd)
+                pTp->u.Mmio.pfnTrace(PspAddrMmio,
+                                     NULL, /** @todo Description */
+                                     PspAddrMmio - pRegion->u.Mmio.PspAddrMmioStart,
+                                     cbAccess,
+                                     pvVal,
+                                     fFlagsRw | fFlagsAp,
+                                     pTp->pvUser);
+        }
+        return;
+    }
+
     PCPSPIOMTPINT pTp = pThis->pTpHead;
     for (;;)
     {
@@ -656,6 +1039,26 @@ static void pspEmuIomMmioTpCall(PPSPIOMINT pThis, PSPADDR PspAddrMmio, PPSPIOMRE
 static void pspEmuIomX86TpCall(PPSPIOMINT pThis, X86PADDR PhysX86Addr, PPSPIOMREGIONHANDLEINT pRegion, size_t cbAccess, const void *pvVal,
                                uint32_t fFlagsRw, uint32_t fFlagsAp)
 {
+    if (pRegion)
+    {
+        /* Only the trace points overlapping the region are attached to it. */
+        for (uint32_t i = 0; i < pRegion->cTps; i++)
+        {
+            PCPSPIOMTPINT pTp = pRegion->papTps[i];
+            if (   pspEmuIomTpMatches(pTp, cbAccess, fFlagsRw, fFlagsAp)
+                && PhysX86Addr >= pTp->u.X86.PhysX86AddrStart
+                && PhysX86Addr <= pTp->u.X86.PhysX86AddrEnd)
+                pTp->u.X86.pfnTrace(PhysX86Addr,
+                                    NULL, /** @todo Description */
+                                    PhysX86Addr - pRegion->u.X86.PhysX86AddrStart,
+                                    cbAccess,
+                                    pvVal,
+                                    fFlagsRw | fFlagsAp,
+                                    pTp->pvUser);
+        }
+        return;
+    }
+
     PCPSPIOMTPINT pTp = pThis->pTpHead;
     for (;;)
     {
@@ -684,42 +1087,114 @@ static void pspEmuIomX86TpCall(PPSPIOMINT pThis, X86PADDR PhysX86Addr, PPSPIOMRE
  * @param   pX86Region              The region being acccessed.
  * @param   offX86Mem               Offset where the access starts.
  * @param   cbAccess                Number of bytes being accessed.
+ *
+ * @note Only the pages covered by the access are fetched, consecutive pages missing are fetched with a single call.
  */
 static int pspEmuIoMgrX86MemEnsureMapping(PPSPIOMREGIONHANDLEINT pX86Region, X86PADDR offX86Mem, size_t cbAccess)
 {
-    int rc = 0;
+    if (!cbAccess)
+        return 0;
 
-    /* Check whether the data at that address is already in memory and fetch it if required. */
-    if (offX86Mem + cbAccess > pX86Region->u.X86.u.Mem.cbValid)
+    if (!pX86Region->u.X86.u.Mem.pvMapping)
     {
-        /* We cache always at 1K aligned segments. */
-        size_t cbFetch = offX86Mem + cbAccess - pX86Region->u.X86.u.Mem.cbValid;
-        cbFetch = MIN((cbFetch + _1K) & ~(_1K - 1), pX86Region->u.X86.cbX86 - pX86Region->u.X86.u.Mem.cbValid);
+        /* Reserve the address space for the complete region, anonymous memory reads as zero until written. */
+        size_t cbAlloc = (pX86Region->u.X86.cbX86 + PSP_IOM_X86_MEM_PAGE_SIZE - 1) & ~(size_t)(PSP_IOM_X86_MEM_PAGE_SIZE - 1);
+        size_t cPages = cbAlloc >> PSP_IOM_X86_MEM_PAGE_SHIFT;
+        void *pvMapping = mmap(NULL, cbAlloc, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (pvMapping == MAP_FAILED)
+            return -1;
 
-        /* Increase the mapping memory. */
-        void *pvNew = realloc(pX86Region->u.X86.u.Mem.pvMapping, pX86Region->u.X86.u.Mem.cbAlloc + cbFetch);
-        if (pvNew)
+        pX86Region->u.X86.u.Mem.pbmPagesValid = (uint8_t *)calloc((cPages + 7) / 8, sizeof(uint8_t));
+        if (!pX86Region->u.X86.u.Mem.pbmPagesValid)
         {
-            void *pvInit = (uint8_t *)pvNew + pX86Region->u.X86.u.Mem.cbValid;
+            munmap(pvMapping, cbAlloc);
+            return -1;
+        }
 
-            pX86Region->u.X86.u.Mem.pvMapping = pvNew;
-            pX86Region->u.X86.u.Mem.cbAlloc   += cbFetch;
+        pX86Region->u.X86.u.Mem.pvMapping = pvMapping;
+        pX86Region->u.X86.u.Mem.cbAlloc   = cbAlloc;
+    }
 
-            /* Fetch initial memory content or just zero the memory if no callback is provided. */
-            if (pX86Region->u.X86.u.Mem.pfnFetch)
-                pX86Region->u.X86.u.Mem.pfnFetch(pX86Region->u.X86.u.Mem.cbValid, cbFetch, pvInit,
-                                                 pX86Region->pvUser);
-            else
-                memset(pvInit, 0, cbFetch);
+    /* Without a fetch callback there is nothing to do as the memory is already zeroed. */
+    if (!pX86Region->u.X86.u.Mem.pfnFetch)
+        return 0;
+
+    uint8_t *pbmPagesValid = pX86Region->u.X86.u.Mem.pbmPagesValid;
+    size_t idxPage = offX86Mem >> PSP_IOM_X86_MEM_PAGE_SHIFT;
+    size_t idxPageLast = (offX86Mem + cbAccess - 1) >> PSP_IOM_X86_MEM_PAGE_SHIFT;
+
+    while (idxPage <= idxPageLast)
+    {
+        if (!(pbmPagesValid[idxPage / 8] & BIT(idxPage % 8)))
+        {
+            /* Collect the run of missing pages. */
+            size_t idxPageStart = idxPage;
+            while (   idxPage <= idxPageLast
+                   && !(pbmPagesValid[idxPage / 8] & BIT(idxPage % 8)))
+            {
+                pbmPagesValid[idxPage / 8] |= BIT(idxPage % 8);
+                idxPage++;
+            }
 
-            pX86Region->u.X86.u.Mem.cbValid += cbFetch;
-            return rc;
+            X86PADDR offFetch = (X86PADDR)idxPageStart << PSP_IOM_X86_MEM_PAGE_SHIFT;
+            size_t cbFetch = MIN((idxPage - idxPageStart) << PSP_IOM_X86_MEM_PAGE_SHIFT,
+                                 pX86Region->u.X86.cbX86 - offFetch);
+
+            pX86Region->u.X86.u.Mem.pfnFetch(offFetch, cbFetch, (uint8_t *)pX86Region->u.X86.u.Mem.pvMapping + offFetch,
+                                             pX86Region->pvUser);
         }
         else
-            rc = -1;
+            idxPage++;
     }
 
-    return rc;
+    return 0;
+}
+
+
+/**
+ * Frees the backing memory of the given x86 memory region.
+ *
+ * @returns nothing.
+ * @param   pX86Region              The x86 memory region.
+ */
+static void pspEmuIoMgrX86MemFree(PPSPIOMREGIONHANDLEINT pX86Region)
+{
+    if (pX86Region->u.X86.u.Mem.pvMapping)
+        munmap(pX86Region->u.X86.u.Mem.pvMapping, pX86Region->u.X86.u.Mem.cbAlloc);
+    if (pX86Region->u.X86.u.Mem.pbmPagesValid)
+        free(pX86Region->u.X86.u.Mem.pbmPagesValid);
+
+    pX86Region->u.X86.u.Mem.pvMapping     = NULL;
+    pX86Region->u.X86.u.Mem.cbAlloc       = 0;
+    pX86Region->u.X86.u.Mem.pbmPagesValid = NULL;
+}
+
+
+/**
+ * Frees the backing memory of the given SMN RAM region if the I/O manager allocated it.
+ *
+ * @returns nothing.
+ * @param   pSmnRegion              The SMN region.
+ */
+static void pspEmuIoMgrSmnRamFree(PPSPIOMREGIONHANDLEINT pSmnRegion)
+{
+    if (pSmnRegion->u.Smn.cbBackingAlloc)
+        munmap(pSmnRegion->u.Smn.pvBacking, pSmnRegion->u.Smn.cbBackingAlloc);
+
+    pSmnRegion->u.Smn.pvBacking      = NULL;
+    pSmnRegion->u.Smn.cbBackingAlloc = 0;
+}
+
+
+static void pspEmuIoMgrSmnRamRead(SMNADDR offSmn, size_t cbRead, void *pvDst, void *pvUser)
+{
+    memcpy(pvDst, (uint8_t *)pvUser + offSmn, cbRead);
+}
+
+
+static void pspEmuIoMgrSmnRamWrite(SMNADDR offSmn, size_t cbWrite, const void *pvVal, void *pvUser)
+{
+    memcpy((uint8_t *)pvUser + offSmn, pvVal, cbWrite);
 }
 
 
@@ -780,6 +1255,9 @@ static int pspEmuIoMgrX86MemWriteWorker(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT
 static void pspEmuIomSmnRegionRead(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRegion, SMNADDR SmnAddr, size_t cbRead, void *pvDst)
 {
     pspEmuIomSmnTpCall(pThis, SmnAddr, pRegion, cbRead, pvDst, PSPEMU_IOM_TRACE_F_READ, PSPEMU_IOM_TRACE_F_BEFORE);
+    PSPEmuPerfEnter(PSPPERFSUBSYS_DEV);
+    bool fStats = pThis->fStats;
+    uint64_t tsStartNs = fStats ? pspEmuIomStatsTsNs() : 0;
     if (pRegion)
     {
         if (pRegion->u.Smn.pfnRead)
@@ -791,6 +1269,9 @@ static void pspEmuIomSmnRegionRead(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pReg
         pThis->pfnSmnUnassignedRead(SmnAddr, cbRead, pvDst, pThis->pvUserSmnUnassigned);
     else
         memset(pvDst, 0, cbRead);
+    if (fStats)
+        pspEmuIomStatsRead(pThis, pRegion, PSPIOMADDRSPACE_SMN, cbRead, tsStartNs);
+    PSPEmuPerfLeave();
 
     pspEmuIomTraceRegionRead(pThis, pRegion, PSPTRACEEVTORIGIN_SMN, SmnAddr, pvDst, cbRead);
     pspEmuIomSmnTpCall(pThis, SmnAddr, pRegion, cbRead, pvDst, PSPEMU_IOM_TRACE_F_READ, PSPEMU_IOM_TRACE_F_AFTER);
@@ -811,6 +1292,9 @@ static void pspEmuIomSmnRegionWrite(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRe
 {
     pspEmuIomTraceRegionWrite(pThis, pRegion, PSPTRACEEVTORIGIN_SMN, SmnAddr, pvSrc, cbWrite);
     pspEmuIomSmnTpCall(pThis, SmnAddr, pRegion, cbWrite, pvSrc, PSPEMU_IOM_TRACE_F_WRITE, PSPEMU_IOM_TRACE_F_BEFORE);
+    PSPEmuPerfEnter(PSPPERFSUBSYS_DEV);
+    bool fStats = pThis->fStats;
+    uint64_t tsStartNs = fStats ? pspEmuIomStatsTsNs() : 0;
     if (pRegion)
     {
         if (pRegion->u.Smn.pfnWrite)
@@ -818,6 +1302,9 @@ static void pspEmuIomSmnRegionWrite(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRe
     }
     else if (pThis->pfnSmnUnassignedWrite)
         pThis->pfnSmnUnassignedWrite(SmnAddr, cbWrite, pvSrc, pThis->pvUserSmnUnassigned);
+    if (fStats)
+        pspEmuIomStatsWrite(pThis, pRegion, PSPIOMADDRSPACE_SMN, cbWrite, tsStartNs);
+    PSPEmuPerfLeave();
 
     pspEmuIomSmnTpCall(pThis, SmnAddr, pRegion, cbWrite, pvSrc, PSPEMU_IOM_TRACE_F_WRITE, PSPEMU_IOM_TRACE_F_AFTER);
 }
@@ -836,6 +1323,9 @@ static void pspEmuIomSmnRegionWrite(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRe
 static void pspEmuIomMmioRegionRead(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRegion, PSPADDR PspAddrMmio, size_t cbRead, void *pvDst)
 {
     pspEmuIomMmioTpCall(pThis, PspAddrMmio, pRegion, cbRead, pvDst, PSPEMU_IOM_TRACE_F_READ, PSPEMU_IOM_TRACE_F_BEFORE);
+    PSPEmuPerfEnter(PSPPERFSUBSYS_DEV);
+    bool fStats = pThis->fStats;
+    uint64_t tsStartNs = fStats ? pspEmuIomStatsTsNs() : 0;
     if (pRegion)
     {
         if (pRegion->u.Mmio.pfnRead)
@@ -847,6 +1337,9 @@ static void pspEmuIomMmioRegionRead(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRe
         pThis->pfnMmioUnassignedRead(PspAddrMmio, cbRead, pvDst, pThis->pvUserMmioUnassigned);
     else
         memset(pvDst, 0, cbRead);
+    if (fStats)
+        pspEmuIomStatsRead(pThis, pRegion, PSPIOMADDRSPACE_PSP, cbRead, tsStartNs);
+    PSPEmuPerfLeave();
 
     pspEmuIomTraceRegionRead(pThis, pRegion, PSPTRACEEVTORIGIN_MMIO, PspAddrMmio, pvDst, cbRead);
     pspEmuIomMmioTpCall(pThis, PspAddrMmio, pRegion, cbRead, pvDst, PSPEMU_IOM_TRACE_F_READ, PSPEMU_IOM_TRACE_F_AFTER);
@@ -867,6 +1360,9 @@ static void pspEmuIomMmioRegionWrite(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pR
 {
     pspEmuIomTraceRegionWrite(pThis, pRegion, PSPTRACEEVTORIGIN_MMIO, PspAddrMmio, pvSrc, cbWrite);
     pspEmuIomMmioTpCall(pThis, PspAddrMmio, pRegion, cbWrite, pvSrc, PSPEMU_IOM_TRACE_F_WRITE, PSPEMU_IOM_TRACE_F_BEFORE);
+    PSPEmuPerfEnter(PSPPERFSUBSYS_DEV);
+    bool fStats = pThis->fStats;
+    uint64_t tsStartNs = fStats ? pspEmuIomStatsTsNs() : 0;
     if (pRegion)
     {
         if (pRegion->u.Mmio.pfnWrite)
@@ -874,6 +1370,9 @@ static void pspEmuIomMmioRegionWrite(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pR
     }
     else if (pThis->pfnMmioUnassignedWrite)
         pThis->pfnMmioUnassignedWrite(PspAddrMmio, cbWrite, pvSrc, pThis->pvUserMmioUnassigned);
+    if (fStats)
+        pspEmuIomStatsWrite(pThis, pRegion, PSPIOMADDRSPACE_PSP, cbWrite, tsStartNs);
+    PSPEmuPerfLeave();
 
     pspEmuIomMmioTpCall(pThis, PspAddrMmio, pRegion, cbWrite, pvSrc, PSPEMU_IOM_TRACE_F_WRITE, PSPEMU_IOM_TRACE_F_AFTER);
 }
@@ -896,6 +1395,9 @@ static void pspEmuIomX86RegionRead(PPSPIOMINT pThis, PPSPIOMX86MAPCTRLSLOT pX86M
     PSPTRACEEVTORIGIN enmEvtOrigin = PSPTRACEEVTORIGIN_X86;
 
     pspEmuIomX86TpCall(pThis, PhysX86Addr, pRegion, cbRead, pvDst, PSPEMU_IOM_TRACE_F_READ, PSPEMU_IOM_TRACE_F_BEFORE);
+    PSPEmuPerfEnter(PSPPERFSUBSYS_DEV);
+    bool fStats = pThis->fStats;
+    uint64_t tsStartNs = fStats ? pspEmuIomStatsTsNs() : 0;
     if (pRegion)
     {
         if (pRegion->enmType == PSPIOMREGIONTYPE_X86_MMIO)
@@ -918,6 +1420,9 @@ static void pspEmuIomX86RegionRead(PPSPIOMINT pThis, PPSPIOMX86MAPCTRLSLOT pX86M
                                     pX86MapSlot->u32RegUnk5, pThis->pvUserX86Unassigned);
     else
         memset(pvDst, 0, cbRead);
+    if (fStats)
+        pspEmuIomStatsRead(pThis, pRegion, PSPIOMADDRSPACE_X86, cbRead, tsStartNs);
+    PSPEmuPerfLeave();
 
     pspEmuIomTraceRegionRead(pThis, pRegion, enmEvtOrigin, PhysX86Addr, pvDst, cbRead);
     pspEmuIomX86TpCall(pThis, PhysX86Addr, pRegion, cbRead, pvDst, PSPEMU_IOM_TRACE_F_READ, PSPEMU_IOM_TRACE_F_AFTER);
@@ -949,6 +1454,9 @@ static void pspEmuIomX86RegionWrite(PPSPIOMINT pThis, PPSPIOMX86MAPCTRLSLOT pX86
     pspEmuIomTraceRegionWrite(pThis, pRegion, enmEvtOrigin, PhysX86Addr, pvSrc, cbWrite);
 
     pspEmuIomX86TpCall(pThis, PhysX86Addr, pRegion, cbWrite, pvSrc, PSPEMU_IOM_TRACE_F_WRITE, PSPEMU_IOM_TRACE_F_BEFORE);
+    PSPEmuPerfEnter(PSPPERFSUBSYS_DEV);
+    bool fStats = pThis->fStats;
+    uint64_t tsStartNs = fStats ? pspEmuIomStatsTsNs() : 0;
     if (pRegion)
     {
         if (pRegion->enmType == PSPIOMREGIONTYPE_X86_MMIO)
@@ -962,6 +1470,9 @@ static void pspEmuIomX86RegionWrite(PPSPIOMINT pThis, PPSPIOMX86MAPCTRLSLOT pX86
     else if (pThis->pfnX86UnassignedWrite)
         pThis->pfnX86UnassignedWrite(PhysX86Addr, cbWrite, pvSrc,  pX86MapSlot->u32RegUnk2 == 6 ? true : false /*fMmio*/,
                                      pX86MapSlot->u32RegUnk5, pThis->pvUserX86Unassigned);
+    if (fStats)
+        pspEmuIomStatsWrite(pThis, pRegion, PSPIOMADDRSPACE_X86, cbWrite, tsStartNs);
+    PSPEmuPerfLeave();
 
     pspEmuIomX86TpCall(pThis, PhysX86Addr, pRegion, cbWrite, pvSrc, PSPEMU_IOM_TRACE_F_WRITE, PSPEMU_IOM_TRACE_F_AFTER);
 }
@@ -969,8 +1480,10 @@ static void pspEmuIomX86RegionWrite(PPSPIOMINT pThis, PPSPIOMX86MAPCTRLSLOT pX86
 
 static void pspEmuIomSmnSlotsRead(PSPCORE hCore, PSPADDR uPspAddr, size_t cbRead, void *pvDst, void *pvUser)
 {
-    PPSPIOMINT pThis = (PPSPIOMINT)pvUser;
+    PPSPIOMSMNMMIO pSmnMmio = (PPSPIOMSMNMMIO)pvUser;
+    PPSPIOMINT pThis = pSmnMmio->pSmnSlot->pIoMgr;
 
+    uPspAddr += pSmnMmio->PspAddrMmioStart - PSP_IOM_SMN_SLOTS_START;
     SMNADDR SmnAddr = pspEmuIomGetSmnAddrFromSlotAndOffset(pThis, uPspAddr);
     PPSPIOMREGIONHANDLEINT pRegion = pspEmuIomSmnFindRegion(pThis, SmnAddr);
 
@@ -980,8 +1493,10 @@ static void pspEmuIomSmnSlotsRead(PSPCORE hCore, PSPADDR uPspAddr, size_t cbRead
 
 static void pspEmuIomSmnSlotsWrite(PSPCORE hCore, PSPADDR uPspAddr, size_t cbWrite, const void *pvSrc, void *pvUser)
 {
-    PPSPIOMINT pThis = (PPSPIOMINT)pvUser;
+    PPSPIOMSMNMMIO pSmnMmio = (PPSPIOMSMNMMIO)pvUser;
+    PPSPIOMINT pThis = pSmnMmio->pSmnSlot->pIoMgr;
 
+    uPspAddr += pSmnMmio->PspAddrMmioStart - PSP_IOM_SMN_SLOTS_START;
     SMNADDR SmnAddr = pspEmuIomGetSmnAddrFromSlotAndOffset(pThis, uPspAddr);
     PPSPIOMREGIONHANDLEINT pRegion = pspEmuIomSmnFindRegion(pThis, SmnAddr);
 
@@ -1039,33 +1554,6 @@ static PPSPIOMREGIONHANDLEINT pspEmuIomX86MapFindRegion(PPSPIOMINT pThis, X86PAD
 }
 
 
-/**
- * Finds an executable memory region within the given range.
- *
- * @returns Pointer to the executable memory region or NULL if none was found.
- * @param   pThis                   The I/O manager.
- * @param   PhysX86Addr             The absolute X86 physical address marking the start of the region.
- * @param   cbX86                   Size of the region.
- */
-static PPSPIOMREGIONHANDLEINT pspEmuIomX86MapMemExecFindRegion(PPSPIOMINT pThis, X86PADDR PhysX86Addr, size_t cbX86)
-{
-    X86PADDR PhysX86AddrEnd = PhysX86Addr + cbX86;
-    PPSPIOMREGIONHANDLEINT pCur = pThis->pX86MemExecHead;
-
-    while (pCur)
-    {
-        X86PADDR PhysX86AddrEndCur = pCur->u.X86.PhysX86AddrStart + pCur->u.X86.cbX86;
-        if (   PhysX86Addr < PhysX86AddrEndCur
-            && pCur->u.X86.PhysX86AddrStart < PhysX86AddrEnd)
-            return pCur;
-
-        pCur = pCur->u.X86.u.Mem.pExecNext;
-    }
-
-    return NULL;
-}
-
-
 static void pspEmuIomX86MapRead(PSPCORE hCore, PSPADDR uPspAddr, size_t cbRead, void *pvDst, void *pvUser)
 {
     PPSPIOMX86MAPCTRLSLOT pX86MapSlot = (PPSPIOMX86MAPCTRLSLOT)pvUser;
@@ -1117,117 +1605,491 @@ static void pspEmuIomX86MapWriteSplit(PSPCORE hCore, PSPADDR uPspAddr, size_t cb
 
 
 /**
- * Unmaps any directly mapped x86 memory regions.
+ * Registers a split MMIO handler for the given part of a x86 mapping slot.
+ *
+ * @returns Status code.
+ * @param   pThis                   The I/O manager instance.
+ * @param   pX86MapSlot             The x86 mapping slot.
+ * @param   PspAddrMmioStart        Start address of the MMIO region.
+ * @param   cbMmio                  Size of the MMIO region.
+ */
+static int pspEmuIoMgrX86MapSplitMmioRegister(PPSPIOMINT pThis, PPSPIOMX86MAPCTRLSLOT pX86MapSlot,
+                                              PSPADDR PspAddrMmioStart, size_t cbMmio)
+{
+    PPSPIOMX86MMIOSPLIT pX86MmioSplit = &pX86MapSlot->aSplitMmio[pX86MapSlot->cSplitMmio];
+
+    int rc = PSPEmuCoreMmioRegister(pThis->hPspCore, PspAddrMmioStart, cbMmio,
+                                    pspEmuIomX86MapReadSplit, pspEmuIomX86MapWriteSplit,
+                                    pX86MmioSplit);
+    if (!rc)
+    {
+        pX86MmioSplit->pX86MapSlot      = pX86MapSlot;
+        pX86MmioSplit->PspAddrMmioStart = PspAddrMmioStart;
+        pX86MmioSplit->cbMmio           = cbMmio;
+        pX86MapSlot->cSplitMmio++;
+    }
+
+    return rc;
+}
+
+
+/**
+ * Removes all direct mappings and split MMIO handlers of the given x86 mapping slot
+ * and registers the plain MMIO handler for the whole slot again.
  *
  * @returns nothing.
  * @param   pThis                   The I/O manager instance.
  * @param   pX86MapSlot             The x86 mapping slot being restored.
+ *
+ * @note The plain MMIO handler for the whole slot must not be registered when calling this.
  */
-static void pspEmuIoMgrX86MapExecMemoryRegionsUnmap(PPSPIOMINT pThis, PPSPIOMX86MAPCTRLSLOT pX86MapSlot)
+static void pspEmuIoMgrX86MapDirectRelease(PPSPIOMINT pThis, PPSPIOMX86MAPCTRLSLOT pX86MapSlot)
 {
-    if (pX86MapSlot->pX86MemExec)
+    int rc = 0;
+
+    for (uint32_t i = 0; i < pX86MapSlot->cMemDirect; i++)
     {
-        int rc = PSPEmuCoreMemRegionRemove(pThis->hPspCore, pX86MapSlot->PspAddrMemExecStart, pX86MapSlot->cbMemExec);
-        /** @todo Assert rc */
+        PPSPIOMX86MEMDIRECT pMemDirect = &pX86MapSlot->aMemDirect[i];
 
-        /* Deregister the possibly split MMIO region. */
-        if (pX86MapSlot->aSplitMmio[0].cbMmio)
-            rc = PSPEmuCoreMmioDeregister(pThis->hPspCore, pX86MapSlot->aSplitMmio[0].PspAddrMmioStart,
-                                          pX86MapSlot->aSplitMmio[0].cbMmio);
-        if (pX86MapSlot->aSplitMmio[1].cbMmio)
-            rc = PSPEmuCoreMmioDeregister(pThis->hPspCore, pX86MapSlot->aSplitMmio[1].PspAddrMmioStart,
-                                          pX86MapSlot->aSplitMmio[1].cbMmio);
-
-        /* Restore the old MMIO region. */
-        rc = PSPEmuCoreMmioRegister(pThis->hPspCore, pX86MapSlot->PspAddrMmioStart, pX86MapSlot->cbMmio,
-                                    pspEmuIomX86MapRead, pspEmuIomX86MapWrite,
-                                    pX86MapSlot);
+        rc = PSPEmuCoreMemRegionRemove(pThis->hPspCore, pMemDirect->PspAddrStart, pMemDirect->cbMem);
         /** @todo Assert rc */
+        pMemDirect->pX86Mem      = NULL;
+        pMemDirect->PspAddrStart = 0;
+        pMemDirect->cbMem        = 0;
+    }
+
+    for (uint32_t i = 0; i < pX86MapSlot->cSplitMmio; i++)
+    {
+        PPSPIOMX86MMIOSPLIT pX86MmioSplit = &pX86MapSlot->aSplitMmio[i];
 
-        /* Clear important members. */
-        pX86MapSlot->pX86MemExec                    = NULL;
-        pX86MapSlot->PspAddrMemExecStart            = 0;
-        pX86MapSlot->cbMemExec                      = 0;
-        pX86MapSlot->aSplitMmio[0].pX86MapSlot      = NULL;
-        pX86MapSlot->aSplitMmio[0].cbMmio           = 0;
-        pX86MapSlot->aSplitMmio[0].PspAddrMmioStart = 0;
-        pX86MapSlot->aSplitMmio[1].pX86MapSlot      = NULL;
-        pX86MapSlot->aSplitMmio[1].cbMmio           = 0;
-        pX86MapSlot->aSplitMmio[1].PspAddrMmioStart = 0;
+        rc = PSPEmuCoreMmioDeregister(pThis->hPspCore, pX86MmioSplit->PspAddrMmioStart, pX86MmioSplit->cbMmio);
+        /** @todo Assert rc */
+        pX86MmioSplit->pX86MapSlot      = NULL;
+        pX86MmioSplit->PspAddrMmioStart = 0;
+        pX86MmioSplit->cbMmio           = 0;
     }
+
+    pX86MapSlot->cMemDirect = 0;
+    pX86MapSlot->cSplitMmio = 0;
+
+    /* Restore the old MMIO region. */
+    rc = PSPEmuCoreMmioRegister(pThis->hPspCore, pX86MapSlot->PspAddrMmioStart, pX86MapSlot->cbMmio,
+                                pspEmuIomX86MapRead, pspEmuIomX86MapWrite,
+                                pX86MapSlot);
+    /** @todo Assert rc */
+}
+
+
+/**
+ * Unmaps any directly mapped x86 memory regions.
+ *
+ * @returns nothing.
+ * @param   pThis                   The I/O manager instance.
+ * @param   pX86MapSlot             The x86 mapping slot being restored.
+ */
+static void pspEmuIoMgrX86MapDirectUnmap(PPSPIOMINT pThis, PPSPIOMX86MAPCTRLSLOT pX86MapSlot)
+{
+    if (pX86MapSlot->cMemDirect)
+        pspEmuIoMgrX86MapDirectRelease(pThis, pX86MapSlot);
+}
+
+
+/**
+ * Checks whether the given x86 region can be mapped directly into the core.
+ *
+ * @returns Flag whether the region can be mapped directly.
+ * @param   pThis                   The I/O manager instance.
+ * @param   pRegion                 The x86 region to check.
+ *
+ * @note Any kind of tracing requires the accesses to go through the callbacks. The backing memory
+ *       is only page aligned relative to the region start, so the region must start on a page boundary.
+ */
+static bool pspEmuIomX86RegionCanMapDirect(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRegion)
+{
+    return    pRegion->enmType == PSPIOMREGIONTYPE_X86_MEM
+           && !(pRegion->u.X86.PhysX86AddrStart & (PSP_IOM_X86_MEM_PAGE_SIZE - 1))
+           && !pRegion->cTps
+           && !pThis->fLogAllAccesses
+           && !PSPEmuTraceFilterGetGen(NULL);
 }
 
 
 /**
- * Maps any directly mapped x86 memory regions.
+ * Maps all x86 memory regions covered by the given slot directly into the core,
+ * leaving only the gaps between them to the MMIO callbacks.
  *
  * @returns nothing.
  * @param   pThis                   The I/O manager instance.
- * @param   pX86MapSlot             The x86 mapping slot being changed.
+ * @param   pX86MapSlot             The x86 mapping slot being changed (must not have any direct mapping).
  */
-static void pspEmuIoMgrX86MapExecMemoryRegionsMapMaybe(PPSPIOMINT pThis, PPSPIOMX86MAPCTRLSLOT pX86MapSlot)
+static void pspEmuIoMgrX86MapDirectMapMaybe(PPSPIOMINT pThis, PPSPIOMX86MAPCTRLSLOT pX86MapSlot)
 {
-    /* Check whether the mapping covers an exectuable memory region, otherwise we can skip the shenanigans... */
-    PPSPIOMREGIONHANDLEINT pX86MemExec = pspEmuIomX86MapMemExecFindRegion(pThis, pX86MapSlot->PhysX86Base, pX86MapSlot->cbMmio);
-    if (pX86MemExec)
+    PSPIOMX86MEMDIRECT aMemDirect[PSP_IOM_X86_SLOT_MEM_DIRECT_MAX];
+    uint32_t cMemDirect = 0;
+    X86PADDR PhysX86SlotEnd = pX86MapSlot->PhysX86Base + pX86MapSlot->cbMmio;
+
+    /* The region list is sorted by start address, so stop at the first region starting after the slot. */
+    PPSPIOMREGIONHANDLEINT pRegion = pThis->pX86Head;
+    while (   pRegion
+           && pRegion->u.X86.PhysX86AddrStart < PhysX86SlotEnd
+           && cMemDirect < ELEMENTS(aMemDirect))
+    {
+        X86PADDR PhysX86RegionEnd = pRegion->u.X86.PhysX86AddrStart + pRegion->u.X86.cbX86;
+
+        if (   PhysX86RegionEnd > pX86MapSlot->PhysX86Base
+            && pspEmuIomX86RegionCanMapDirect(pThis, pRegion))
+        {
+            /*
+             * Map only the part of the region visible through the slot, the core maps in page granularity
+             * so a partial page at the end keeps going through the callbacks.
+             */
+            X86PADDR PhysX86Start =   pRegion->u.X86.PhysX86AddrStart > pX86MapSlot->PhysX86Base
+                                    ? pRegion->u.X86.PhysX86AddrStart
+                                    : pX86MapSlot->PhysX86Base;
+            X86PADDR PhysX86End = MIN(PhysX86RegionEnd, PhysX86SlotEnd) & ~(X86PADDR)(PSP_IOM_X86_MEM_PAGE_SIZE - 1);
+
+            if (PhysX86End > PhysX86Start)
+            {
+                X86PADDR offX86Mem = PhysX86Start - pRegion->u.X86.PhysX86AddrStart;
+                size_t cbMem = (size_t)(PhysX86End - PhysX86Start);
+
+                /* Fetch everything now as the core accesses the memory without asking us from now on. */
+                int rc = pspEmuIoMgrX86MemEnsureMapping(pRegion, offX86Mem, cbMem);
+                if (!rc)
+                {
+                    /* Writes are not seen anymore, so treat the mapped part as written. */
+                    if (offX86Mem + cbMem > pRegion->u.X86.u.Mem.cbWritten)
+                        pRegion->u.X86.u.Mem.cbWritten = offX86Mem + cbMem;
+
+                    aMemDirect[cMemDirect].pX86Mem      = pRegion;
+                    aMemDirect[cMemDirect].PspAddrStart = pX86MapSlot->PspAddrMmioStart + (PSPADDR)(PhysX86Start - pX86MapSlot->PhysX86Base);
+                    aMemDirect[cMemDirect].cbMem        = cbMem;
+                    cMemDirect++;
+                }
+                /** @todo else add fatal trace event. */
+            }
+        }
+
+        pRegion = pRegion->pNext;
+    }
+
+    if (!cMemDirect)
+        return;
+
+    /* Unmap the default handler for this region first. */
+    int rc = PSPEmuCoreMmioDeregister(pThis->hPspCore, pX86MapSlot->PspAddrMmioStart, pX86MapSlot->cbMmio);
+    if (rc)
+        return; /** @todo Assert */
+
+    /* Insert the memory regions with split MMIO handlers for the gaps before, between and after them. */
+    PSPADDR PspAddrCur = pX86MapSlot->PspAddrMmioStart;
+    for (uint32_t i = 0; i < cMemDirect && !rc; i++)
     {
-        /* Oh boy, here it goes... */
+        PPSPIOMX86MEMDIRECT pMemDirect = &aMemDirect[i];
+        PPSPIOMREGIONHANDLEINT pX86Mem = pMemDirect->pX86Mem;
+        X86PADDR offX86Mem = pX86MapSlot->PhysX86Base + (pMemDirect->PspAddrStart - pX86MapSlot->PspAddrMmioStart)
+                           - pX86Mem->u.X86.PhysX86AddrStart;
+        uint32_t fProt = PSPEMU_CORE_MEM_REGION_PROT_F_READ | PSPEMU_CORE_MEM_REGION_PROT_F_WRITE;
 
-        /* Ensure that the whole memory region is valid. */
-        int rc = pspEmuIoMgrX86MemEnsureMapping(pX86MemExec, 0, pX86MemExec->u.X86.cbX86);
+        if (pX86Mem->u.X86.u.Mem.fCanExec)
+            fProt |= PSPEMU_CORE_MEM_REGION_PROT_F_EXEC;
+
+        if (pMemDirect->PspAddrStart > PspAddrCur)
+            rc = pspEmuIoMgrX86MapSplitMmioRegister(pThis, pX86MapSlot, PspAddrCur, pMemDirect->PspAddrStart - PspAddrCur);
+        if (!rc)
+            rc = PSPEmuCoreMemRegionAdd(pThis->hPspCore, pMemDirect->PspAddrStart, pMemDirect->cbMem, fProt,
+                                        (uint8_t *)pX86Mem->u.X86.u.Mem.pvMapping + offX86Mem);
         if (!rc)
         {
-            /* Unmap the default handler for this region first. */
-            rc = PSPEmuCoreMmioDeregister(pThis->hPspCore, pX86MapSlot->PspAddrMmioStart, pX86MapSlot->cbMmio);
-            /** @todo Assert */
+            pX86MapSlot->aMemDirect[pX86MapSlot->cMemDirect++] = *pMemDirect;
+            PspAddrCur = pMemDirect->PspAddrStart + pMemDirect->cbMem;
+        }
+    }
 
-            /* Check whether we have to insert a split MMIO handler before the memory region. */
-            X86PADDR offMemExec = pX86MemExec->u.X86.PhysX86AddrStart - pX86MapSlot->PhysX86Base;
-            size_t cbMemExec = pX86MemExec->u.X86.cbX86; /** @todo Handle cut off regions don't fitting into the complete slot. */
+    if (   !rc
+        && PspAddrCur < pX86MapSlot->PspAddrMmioStart + pX86MapSlot->cbMmio)
+        rc = pspEmuIoMgrX86MapSplitMmioRegister(pThis, pX86MapSlot, PspAddrCur,
+                                                pX86MapSlot->PspAddrMmioStart + pX86MapSlot->cbMmio - PspAddrCur);
 
-            if (offMemExec)
-            {
-                rc = PSPEmuCoreMmioRegister(pThis->hPspCore, pX86MapSlot->PspAddrMmioStart, offMemExec,
-                                            pspEmuIomX86MapReadSplit, pspEmuIomX86MapWriteSplit,
-                                            &pX86MapSlot->aSplitMmio[0]);
-                /** @todo Assert */
-
-                pX86MapSlot->aSplitMmio[0].pX86MapSlot      = pX86MapSlot;
-                pX86MapSlot->aSplitMmio[0].cbMmio           = offMemExec;
-                pX86MapSlot->aSplitMmio[0].PspAddrMmioStart = pX86MapSlot->PspAddrMmioStart;
-            }
+    /* Go back to the callbacks for the whole slot if anything failed. */
+    if (rc)
+        pspEmuIoMgrX86MapDirectRelease(pThis, pX86MapSlot);
+}
+
+
+/**
+ * Updates the direct mappings of the given x86 mapping slot after its base or the regions changed.
+ *
+ * @returns nothing.
+ * @param   pThis                   The I/O manager instance.
+ * @param   pX86MapSlot             The x86 mapping slot.
+ */
+static void pspEmuIoMgrX86MapSlotRemap(PPSPIOMINT pThis, PPSPIOMX86MAPCTRLSLOT pX86MapSlot)
+{
+    pspEmuIoMgrX86MapDirectUnmap(pThis, pX86MapSlot);
+    pspEmuIoMgrX86MapDirectMapMaybe(pThis, pX86MapSlot);
+}
+
+
+/**
+ * Updates the direct mappings of all x86 mapping slots which were programmed so far.
+ *
+ * @returns nothing.
+ * @param   pThis                   The I/O manager instance.
+ *
+ * @note Slots still at their reset base address are left alone like in the control register write path.
+ */
+static void pspEmuIoMgrX86MapSlotsRemapAll(PPSPIOMINT pThis)
+{
+    for (uint32_t i = 0; i < ELEMENTS(pThis->aX86MapCtrlSlots); i++)
+    {
+        PPSPIOMX86MAPCTRLSLOT pX86MapSlot = &pThis->aX86MapCtrlSlots[i];
+
+        if (   pX86MapSlot->u32RegX86BaseAddr
+            || pX86MapSlot->cMemDirect)
+            pspEmuIoMgrX86MapSlotRemap(pThis, pX86MapSlot);
+    }
+}
+
+
+/**
+ * Registers the MMIO handler for the given part of a SMN mapping slot.
+ *
+ * @returns Status code.
+ * @param   pThis                   The I/O manager instance.
+ * @param   pSmnSlot                The SMN mapping slot.
+ * @param   idxMmio                 The MMIO descriptor index to use.
+ * @param   PspAddrMmioStart        Start address of the MMIO region.
+ * @param   cbMmio                  Size of the MMIO region.
+ */
+static int pspEmuIomSmnSlotMmioRegister(PPSPIOMINT pThis, PPSPIOMSMNSLOT pSmnSlot, uint32_t idxMmio,
+                                        PSPADDR PspAddrMmioStart, size_t cbMmio)
+{
+    PPSPIOMSMNMMIO pSmnMmio = &pSmnSlot->aMmio[idxMmio];
+
+    int rc = PSPEmuCoreMmioRegister(pThis->hPspCore, PspAddrMmioStart, cbMmio,
+                                    pspEmuIomSmnSlotsRead, pspEmuIomSmnSlotsWrite,
+                                    pSmnMmio);
+    if (!rc)
+    {
+        pSmnMmio->pSmnSlot         = pSmnSlot;
+        pSmnMmio->PspAddrMmioStart = PspAddrMmioStart;
+        pSmnMmio->cbMmio           = cbMmio;
+    }
+
+    return rc;
+}
 
-            /* Now insert the executable memory region. */
-            rc = PSPEmuCoreMemRegionAdd(pThis->hPspCore, pX86MapSlot->PspAddrMmioStart + offMemExec, cbMemExec,
-                                        PSPEMU_CORE_MEM_REGION_PROT_F_EXEC | PSPEMU_CORE_MEM_REGION_PROT_F_READ | PSPEMU_CORE_MEM_REGION_PROT_F_WRITE,
-                                        pX86MemExec->u.X86.u.Mem.pvMapping);
-            /** @todo Assert */
 
-            /* Insert split MMIO region coming after the executable memory region. */
-            if (offMemExec + cbMemExec < pX86MapSlot->cbMmio)
+/**
+ * Deregisters all MMIO handlers of the given SMN mapping slot.
+ *
+ * @returns nothing.
+ * @param   pThis                   The I/O manager instance.
+ * @param   pSmnSlot                The SMN mapping slot.
+ */
+static void pspEmuIomSmnSlotMmioDeregisterAll(PPSPIOMINT pThis, PPSPIOMSMNSLOT pSmnSlot)
+{
+    for (uint32_t i = 0; i < ELEMENTS(pSmnSlot->aMmio); i++)
+    {
+        PPSPIOMSMNMMIO pSmnMmio = &pSmnSlot->aMmio[i];
+
+        if (pSmnMmio->cbMmio)
+        {
+            int rc = PSPEmuCoreMmioDeregister(pThis->hPspCore, pSmnMmio->PspAddrMmioStart, pSmnMmio->cbMmio);
+            /** @todo Assert rc */
+            pSmnMmio->PspAddrMmioStart = 0;
+            pSmnMmio->cbMmio           = 0;
+        }
+    }
+}
+
+
+/**
+ * Checks whether the given SMN region can be mapped directly into the core.
+ *
+ * @returns Flag whether the region can be mapped directly.
+ * @param   pThis                   The I/O manager instance.
+ * @param   pRegion                 The SMN region to check.
+ *
+ * @note Any kind of tracing requires the accesses to go through the callbacks.
+ */
+static bool pspEmuIomSmnRegionCanMapDirect(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRegion)
+{
+    return    pRegion->u.Smn.pvBacking
+           && !pRegion->cTps
+           && !pThis->fLogAllAccesses
+           && !PSPEmuTraceFilterGetGen(NULL);
+}
+
+
+/**
+ * Restores the plain MMIO handler for the given SMN mapping slot if a region is mapped directly.
+ *
+ * @returns nothing.
+ * @param   pThis                   The I/O manager instance.
+ * @param   pSmnSlot                The SMN mapping slot.
+ */
+static void pspEmuIomSmnSlotDirectUnmap(PPSPIOMINT pThis, PPSPIOMSMNSLOT pSmnSlot)
+{
+    if (pSmnSlot->pSmnDirect)
+    {
+        int rc = PSPEmuCoreMemRegionRemove(pThis->hPspCore, pSmnSlot->PspAddrDirectStart, pSmnSlot->cbDirect);
+        /** @todo Assert rc */
+
+        pspEmuIomSmnSlotMmioDeregisterAll(pThis, pSmnSlot);
+        rc = pspEmuIomSmnSlotMmioRegister(pThis, pSmnSlot, 0 /*idxMmio*/, pSmnSlot->PspAddrMmioStart, PSP_IOM_SMN_SLOT_SIZE);
+        /** @todo Assert rc */
+
+        pSmnSlot->pSmnDirect         = NULL;
+        pSmnSlot->PspAddrDirectStart = 0;
+        pSmnSlot->cbDirect           = 0;
+    }
+}
+
+
+/**
+ * Maps the first SMN region covered by the given slot directly into the core if possible.
+ *
+ * @returns nothing.
+ * @param   pThis                   The I/O manager instance.
+ * @param   pSmnSlot                The SMN mapping slot (must not have a direct mapping).
+ * @param   SmnAddrBase             The SMN base address the slot is mapping.
+ */
+static void pspEmuIomSmnSlotDirectMapMaybe(PPSPIOMINT pThis, PPSPIOMSMNSLOT pSmnSlot, SMNADDR SmnAddrBase)
+{
+    uint64_t SmnAddrSlotEnd = (uint64_t)SmnAddrBase + PSP_IOM_SMN_SLOT_SIZE;
+
+    /* The region list is sorted by start address, so stop at the first region starting after the slot. */
+    PPSPIOMREGIONHANDLEINT pRegion = pThis->pSmnHead;
+    while (   pRegion
+           && pRegion->u.Smn.SmnAddrStart < SmnAddrSlotEnd)
+    {
+        uint64_t SmnAddrRegionEnd = (uint64_t)pRegion->u.Smn.SmnAddrStart + pRegion->u.Smn.cbSmn;
+
+        if (   SmnAddrRegionEnd > SmnAddrBase
+            && pspEmuIomSmnRegionCanMapDirect(pThis, pRegion))
+        {
+            /*
+             * Map only the part of the region visible through the slot, the core maps in page granularity
+             * so partial pages at either end keep going through the callbacks.
+             */
+            uint64_t SmnAddrStart =   pRegion->u.Smn.SmnAddrStart > SmnAddrBase
+                                    ? pRegion->u.Smn.SmnAddrStart
+                                    : SmnAddrBase;
+            uint64_t SmnAddrEnd = MIN(SmnAddrRegionEnd, SmnAddrSlotEnd);
+
+            SmnAddrStart = (SmnAddrStart + _4K - 1) & ~(uint64_t)(_4K - 1);
+            SmnAddrEnd  &= ~(uint64_t)(_4K - 1);
+            if (SmnAddrEnd > SmnAddrStart)
             {
-                PSPADDR PspAddrMmioAfter = pX86MapSlot->PspAddrMmioStart + offMemExec + cbMemExec;
-                size_t cbMmioAfter = pX86MapSlot->cbMmio - (PspAddrMmioAfter - pX86MapSlot->PspAddrMmioStart);
+                PSPADDR PspAddrDirectStart = pSmnSlot->PspAddrMmioStart + (PSPADDR)(SmnAddrStart - SmnAddrBase);
+                size_t cbDirect = (size_t)(SmnAddrEnd - SmnAddrStart);
+                size_t cbBefore = PspAddrDirectStart - pSmnSlot->PspAddrMmioStart;
+                size_t cbAfter = PSP_IOM_SMN_SLOT_SIZE - cbBefore - cbDirect;
 
-                rc = PSPEmuCoreMmioRegister(pThis->hPspCore, PspAddrMmioAfter, cbMmioAfter,
-                                            pspEmuIomX86MapReadSplit, pspEmuIomX86MapWriteSplit,
-                                            &pX86MapSlot->aSplitMmio[1]);
-                /** @todo Assert */
+                pspEmuIomSmnSlotMmioDeregisterAll(pThis, pSmnSlot);
 
-                pX86MapSlot->aSplitMmio[1].pX86MapSlot      = pX86MapSlot;
-                pX86MapSlot->aSplitMmio[1].cbMmio           = cbMmioAfter;
-                pX86MapSlot->aSplitMmio[1].PspAddrMmioStart = PspAddrMmioAfter;
-            }
+                int rc = 0;
+                if (cbBefore)
+                    rc = pspEmuIomSmnSlotMmioRegister(pThis, pSmnSlot, 0 /*idxMmio*/, pSmnSlot->PspAddrMmioStart, cbBefore);
+                if (!rc)
+                    rc = PSPEmuCoreMemRegionAdd(pThis->hPspCore, PspAddrDirectStart, cbDirect, pRegion->u.Smn.fBackingProt,
+                                                (uint8_t *)pRegion->u.Smn.pvBacking + (SmnAddrStart - pRegion->u.Smn.SmnAddrStart));
+                if (!rc)
+                {
+                    if (cbAfter)
+                        rc = pspEmuIomSmnSlotMmioRegister(pThis, pSmnSlot, 1 /*idxMmio*/, PspAddrDirectStart + cbDirect, cbAfter);
+                    if (!rc)
+                    {
+                        pSmnSlot->pSmnDirect         = pRegion;
+                        pSmnSlot->PspAddrDirectStart = PspAddrDirectStart;
+                        pSmnSlot->cbDirect           = cbDirect;
+                        return;
+                    }
+
+                    PSPEmuCoreMemRegionRemove(pThis->hPspCore, PspAddrDirectStart, cbDirect);
+                }
 
-            pX86MapSlot->pX86MemExec                    = pX86MemExec;
-            pX86MapSlot->PspAddrMemExecStart            = pX86MapSlot->PspAddrMmioStart + offMemExec;
-            pX86MapSlot->cbMemExec                      = cbMemExec;
+                /* Go back to the callbacks for the whole slot. */
+                pspEmuIomSmnSlotMmioDeregisterAll(pThis, pSmnSlot);
+                rc = pspEmuIomSmnSlotMmioRegister(pThis, pSmnSlot, 0 /*idxMmio*/, pSmnSlot->PspAddrMmioStart, PSP_IOM_SMN_SLOT_SIZE);
+                /** @todo Assert rc */
+                return;
+            }
         }
-        /** @todo else add fatal trace event. */
+
+        pRegion = pRegion->pNext;
+    }
+}
+
+
+/**
+ * Updates the direct mapping of the given SMN mapping slot after its base or the regions changed.
+ *
+ * @returns nothing.
+ * @param   pThis                   The I/O manager instance.
+ * @param   idxSlot                 The SMN mapping slot index.
+ */
+static void pspEmuIomSmnSlotRemap(PPSPIOMINT pThis, uint32_t idxSlot)
+{
+    PPSPIOMSMNSLOT pSmnSlot = &pThis->aSmnSlots[idxSlot];
+
+    pspEmuIomSmnSlotDirectUnmap(pThis, pSmnSlot);
+    pspEmuIomSmnSlotDirectMapMaybe(pThis, pSmnSlot, pThis->aSmnAddrBaseSlots[idxSlot]);
+}
+
+
+/**
+ * Sets a new SMN base address for the given slot, updating the direct mapping if it changed.
+ *
+ * @returns nothing.
+ * @param   pThis                   The I/O manager instance.
+ * @param   idxSlot                 The SMN mapping slot index.
+ * @param   SmnAddrBase             The new SMN base address.
+ */
+static void pspEmuIomSmnSlotBaseSet(PPSPIOMINT pThis, uint32_t idxSlot, SMNADDR SmnAddrBase)
+{
+    if (pThis->aSmnAddrBaseSlots[idxSlot] != SmnAddrBase)
+    {
+        pThis->aSmnAddrBaseSlots[idxSlot] = SmnAddrBase;
+        pspEmuIomSmnSlotRemap(pThis, idxSlot);
     }
 }
 
 
+/**
+ * Updates the direct mappings of all SMN mapping slots.
+ *
+ * @returns nothing.
+ * @param   pThis                   The I/O manager instance.
+ */
+static void pspEmuIomSmnSlotsRemapAll(PPSPIOMINT pThis)
+{
+    for (uint32_t i = 0; i < ELEMENTS(pThis->aSmnSlots); i++)
+        pspEmuIomSmnSlotRemap(pThis, i);
+}
+
+
+/**
+ * Sets the host memory backing the given SMN region and updates the direct mappings.
+ *
+ * @returns nothing.
+ * @param   pRegion                 The SMN region.
+ * @param   pvBacking               The host memory backing the complete region, NULL to remove the backing.
+ * @param   cbBackingAlloc          Size of the allocation if the I/O manager owns the backing, 0 otherwise.
+ * @param   fProt                   Protection flags of the direct mapping, see PSPEMU_CORE_MEM_REGION_PROT_F_XXX.
+ */
+static void pspEmuIomSmnRegionBackingSet(PPSPIOMREGIONHANDLEINT pRegion, void *pvBacking, size_t cbBackingAlloc,
+                                         uint32_t fProt)
+{
+    pRegion->u.Smn.pvBacking      = pvBacking;
+    pRegion->u.Smn.cbBackingAlloc = cbBackingAlloc;
+    pRegion->u.Smn.fBackingProt   = fProt;
+    pspEmuIomSmnSlotsRemapAll(pRegion->pIoMgr);
+}
+
+
 static void pspEmuIoMgrMmioSmnCtrlRead(PSPADDR offMmio, size_t cbRead, void *pvDst, void *pvUser)
 {
     PPSPIOMINT pThis = (PPSPIOMINT)pvUser;
@@ -1260,8 +2122,8 @@ static void pspEmuIoMgrMmioSmnCtrlWrite(PSPADDR offMmio, size_t cbWrite, const v
             uint32_t uSmnBaseVal = *(uint32_t *)pvVal;
             PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_DEBUG, PSPTRACEEVTORIGIN_SMN,
                                     "MMIO/SMN: Mapping slot %u and %u to 0x%08x", idxSlotBase, idxSlotBase + 1, uSmnBaseVal);
-            pThis->aSmnAddrBaseSlots[idxSlotBase]     = (uSmnBaseVal & 0xffff) << 20;
-            pThis->aSmnAddrBaseSlots[idxSlotBase + 1] = (uSmnBaseVal >> 16) << 20;
+            pspEmuIomSmnSlotBaseSet(pThis, idxSlotBase,     (uSmnBaseVal & 0xffff) << 20);
+            pspEmuIomSmnSlotBaseSet(pThis, idxSlotBase + 1, (uSmnBaseVal >> 16) << 20);
             break;
         }
         case 2:
@@ -1271,7 +2133,7 @@ static void pspEmuIoMgrMmioSmnCtrlWrite(PSPADDR offMmio, size_t cbWrite, const v
             uint16_t uSmnBaseVal = *(uint16_t *)pvVal;
             PSPEmuTraceEvtAddString(NULL, PSPTRACEEVTSEVERITY_DEBUG, PSPTRACEEVTORIGIN_SMN,
                                     "MMIO/SMN: Mapping slot %u to 0x%08x", idxSlotBase, uSmnBaseVal);
-            pThis->aSmnAddrBaseSlots[idxSlotBase] = uSmnBaseVal << 20;
+            pspEmuIomSmnSlotBaseSet(pThis, idxSlotBase, uSmnBaseVal << 20);
             break;
         }
         default:
@@ -1359,17 +2221,17 @@ static void pspEmuIoMgrX86MapCtrlWrite(PSPADDR offMmio, size_t cbWrite, const vo
 
                 if (u32RegX86BaseAddrNew != pX86Slot->u32RegX86BaseAddr)
                 {
-                    /* Restore the original mapping in case there is an executable memory region mapped right now. */
-                    pspEmuIoMgrX86MapExecMemoryRegionsUnmap(pThis, pX86Slot);
+                    /* Restore the original mapping in case there are memory regions mapped directly right now. */
+                    pspEmuIoMgrX86MapDirectUnmap(pThis, pX86Slot);
 
                     pX86Slot->u32RegX86BaseAddr = u32RegX86BaseAddrNew;
                     pX86Slot->PhysX86Base = (X86PADDR)(pX86Slot->u32RegX86BaseAddr & 0x3f) << 26 | ((X86PADDR)(pX86Slot->u32RegX86BaseAddr >> 6)) << 32;
 
                     /*
-                     * In case of executable memory regions in the covered range we have to re-arrange the mapping and
-                     * map the executable memory directly.
+                     * In case of memory regions in the covered range we have to re-arrange the mapping and
+                     * map the memory directly, leaving only the rest to the MMIO callbacks.
                      */
-                    pspEmuIoMgrX86MapExecMemoryRegionsMapMaybe(pThis, pX86Slot);
+                    pspEmuIoMgrX86MapDirectMapMaybe(pThis, pX86Slot);
                 }
                 break;
             }
@@ -1465,7 +2327,7 @@ static void pspEmuIoMgrX86MapCtrl3Write(PSPADDR offMmio, size_t cbWrite, const v
 
 
 /**
- * Creates and links a new trace point with the given config.
+ * Creates a new trace point with the given config, pspEmuIomTpLink() makes it active once the range is set.
  *
  * @returns Status code.
  * @param   pThis                   I/O manager instance.
@@ -1496,8 +2358,6 @@ static int pspEmuIomTpCreate(PPSPIOMINT pThis, PSPIOMTRACETYPE enmType, size_t c
         pTp->fFlags   = fFlags;
         pTp->pvUser   = pvUser;
         pTp->enmType  = enmType;
-        pTp->pNext = pThis->pTpHead;
-        pThis->pTpHead = pTp;
         *ppTp = pTp;
     }
     else
@@ -1507,6 +2367,54 @@ static int pspEmuIomTpCreate(PPSPIOMINT pThis, PSPIOMTRACETYPE enmType, size_t c
 }
 
 
+/**
+ * Links the given trace point into the global list and attaches it to all regions it overlaps.
+ *
+ * @returns Status code.
+ * @param   pThis                   I/O manager instance.
+ * @param   pTp                     The trace point to link, the address range must be set.
+ *
+ * @note The trace point is freed on failure.
+ */
+static int pspEmuIomTpLink(PPSPIOMINT pThis, PPSPIOMTPINT pTp)
+{
+    int rc = 0;
+    PPSPIOMREGIONHANDLEINT pRegion = pspEmuIomTpRegionListGet(pThis, pTp->enmType);
+
+    while (   pRegion
+           && !rc)
+    {
+        if (pspEmuIomRegionTpOverlaps(pRegion, pTp))
+            rc = pspEmuIomRegionTpAttach(pRegion, pTp, true /*fFront*/);
+        pRegion = pRegion->pNext;
+    }
+
+    if (!rc)
+    {
+        pTp->pNext = pThis->pTpHead;
+        pThis->pTpHead = pTp;
+
+        /* Traced regions can't be mapped directly anymore. */
+        if (pTp->enmType == PSPIOMTRACETYPE_SMN)
+            pspEmuIomSmnSlotsRemapAll(pThis);
+        else if (pTp->enmType == PSPIOMTRACETYPE_X86)
+            pspEmuIoMgrX86MapSlotsRemapAll(pThis);
+    }
+    else
+    {
+        pRegion = pspEmuIomTpRegionListGet(pThis, pTp->enmType);
+        while (pRegion)
+        {
+            pspEmuIomRegionTpDetach(pRegion, pTp);
+            pRegion = pRegion->pNext;
+        }
+        free(pTp);
+    }
+
+    return rc;
+}
+
+
 static int pspEmuIomMmioRegionRegister(PPSPIOMINT pThis, PSPADDR PspAddrMmioStart, size_t cbMmio,
                                        PFNPSPIOMMMIOREAD pfnRead, PFNPSPIOMMMIOWRITE pfnWrite, void *pvUser,
                                        const char *pszDesc, PPSPIOMREGIONHANDLEINT *ppMmio)
@@ -1545,7 +2453,8 @@ static int pspEmuIomMmioRegionRegister(PPSPIOMINT pThis, PSPADDR PspAddrMmioStar
         if (   (   !pPrev
                 || pPrev->u.Mmio.PspAddrMmioStart + cbMmio <= PspAddrMmioStart)
             && (   !pCur
-                || PspAddrMmioStart + cbMmio <= pCur->u.Mmio.PspAddrMmioStart))
+                || PspAddrMmioStart + cbMmio <= pCur->u.Mmio.PspAddrMmioStart)
+            && !pspEmuIomRegionTpsAttachAll(pThis, pRegion))
         {
             pRegion->pNext = pCur;
             if (pPrev)
@@ -1603,7 +2512,8 @@ static int pspEmuIomX86RegionInsert(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRe
     if (   (   !pPrev
             || pPrev->u.X86.PhysX86AddrStart + cbX86 <= PhysX86AddrStart)
         && (   !pCur
-            || PhysX86AddrStart + cbX86 <= pCur->u.X86.PhysX86AddrStart))
+            || PhysX86AddrStart + cbX86 <= pCur->u.X86.PhysX86AddrStart)
+        && !pspEmuIomRegionTpsAttachAll(pThis, pRegion))
     {
         pRegion->pNext = pCur;
         if (pPrev)
@@ -1624,40 +2534,6 @@ static int pspEmuIomX86RegionInsert(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRe
 }
 
 
-/**
- * Inserts the given X86 memory region with exec permissions into the list of executable memory regions.
- *
- * @returns Status code.
- * @param   pThis                   The I/O manager.
- * @param   pRegion                 The X86 region to insert.
- */
-static void pspEmuIomX86MemExecInsert(PPSPIOMINT pThis, PPSPIOMREGIONHANDLEINT pRegion)
-{
-    X86PADDR PhysX86AddrStart = pRegion->u.X86.PhysX86AddrStart;
-    size_t cbX86 = pRegion->u.X86.cbX86;
-    int rc = 0;
-
-    PPSPIOMREGIONHANDLEINT pPrev = NULL;
-    PPSPIOMREGIONHANDLEINT pCur = pThis->pX86MemExecHead;
-
-    /* Search where to insert the new device, sorted by starting X86 address. */
-    while (pCur)
-    {
-        if (pCur->u.X86.PhysX86AddrStart > PhysX86AddrStart)
-            break;
-        pPrev = pCur;
-        pCur = pCur->u.X86.u.Mem.pExecNext;
-    }
-
-    /* No sanity checks needed here as it was already done in the general X86 region list insertion step. */
-    pRegion->u.X86.u.Mem.pExecNext = pCur;
-    if (pPrev)
-        pPrev->u.X86.u.Mem.pExecNext = pRegion;
-    else
-        pThis->pX86MemExecHead = pRegion;
-}
-
-
 /**
  * Frees the given region list.
  *
@@ -1670,11 +2546,55 @@ static void pspEmuIoMgrDestroyRegionList(PPSPIOMREGIONHANDLEINT pHead)
     {
         PPSPIOMREGIONHANDLEINT pFree = pHead;
         pHead = pHead->pNext;
+        if (pFree->enmType == PSPIOMREGIONTYPE_X86_MEM)
+            pspEmuIoMgrX86MemFree(pFree);
+        else if (pFree->enmType == PSPIOMREGIONTYPE_SMN)
+            pspEmuIoMgrSmnRamFree(pFree);
+        if (pFree->papTps)
+            free(pFree->papTps);
         free(pFree);
     }
 }
 
 
+/**
+ * Checks whether the given region of the given address space contains the complete access.
+ *
+ * @returns Flag whether the access is completely contained in the region.
+ * @param   pRegion                 The region to check, can be NULL.
+ * @param   enmAddrSpace            The address space the access happens in.
+ * @param   u64Addr                 The address being accessed.
+ * @param   cbAccess                Access width in bytes.
+ */
+static bool pspEmuIomRegionContainsAccess(PPSPIOMREGIONHANDLEINT pRegion, PSPIOMADDRSPACE enmAddrSpace,
+                                          uint64_t u64Addr, size_t cbAccess)
+{
+    if (!pRegion)
+        return false;
+
+    switch (enmAddrSpace)
+    {
+        case PSPIOMADDRSPACE_PSP:
+            return    pRegion->enmType == PSPIOMREGIONTYPE_PSP_MMIO
+                   && u64Addr >= pRegion->u.Mmio.PspAddrMmioStart
+                   && u64Addr + cbAccess <= (uint64_t)pRegion->u.Mmio.PspAddrMmioStart + pRegion->u.Mmio.cbMmio;
+        case PSPIOMADDRSPACE_SMN:
+            return    pRegion->enmType == PSPIOMREGIONTYPE_SMN
+                   && u64Addr >= pRegion->u.Smn.SmnAddrStart
+                   && u64Addr + cbAccess <= (uint64_t)pRegion->u.Smn.SmnAddrStart + pRegion->u.Smn.cbSmn;
+        case PSPIOMADDRSPACE_X86:
+            return    (   pRegion->enmType == PSPIOMREGIONTYPE_X86_MMIO
+                       || pRegion->enmType == PSPIOMREGIONTYPE_X86_MEM)
+                   && u64Addr >= pRegion->u.X86.PhysX86AddrStart
+                   && u64Addr + cbAccess <= pRegion->u.X86.PhysX86AddrStart + pRegion->u.X86.cbX86;
+        default:
+            break;
+    }
+
+    return false;
+}
+
+
 /**
  * Checks whether the given PSP address is inside the SMN region and returns the proper region handle
  * if asked for and the absolute SMN address being accessed.
@@ -1688,12 +2608,13 @@ static void pspEmuIoMgrDestroyRegionList(PPSPIOMREGIONHANDLEINT pHead)
 static bool pspEmuIoMgrAddrIsSmn(PPSPIOMINT pThis, PSPADDR PspAddr, PPSPIOMREGIONHANDLEINT *ppRegion,
                                  SMNADDR *pSmnAddr)
 {
-    if (PspAddr >= 0x01000000 && PspAddr < 0x01000000 + 32 * _1M)
+    if (   PspAddr >= PSP_IOM_SMN_SLOTS_START
+        && PspAddr < PSP_IOM_SMN_SLOTS_START + PSP_IOM_SMN_SLOTS_COUNT * PSP_IOM_SMN_SLOT_SIZE)
     {
         /* SMN device region. */
         if (ppRegion)
         {
-            PspAddr -= 0x01000000;
+            PspAddr -= PSP_IOM_SMN_SLOTS_START;
 
             SMNADDR SmnAddr = pspEmuIomGetSmnAddrFromSlotAndOffset(pThis, PspAddr);
             PPSPIOMREGIONHANDLEINT pRegion = pspEmuIomSmnFindRegion(pThis, SmnAddr);
@@ -1778,7 +2699,6 @@ int PSPEmuIoMgrCreate(PPSPIOM phIoMgr, PSPCORE hPspCore)
         pThis->pMmioHead              = NULL;
         pThis->pSmnHead               = NULL;
         pThis->pX86Head               = NULL;
-        pThis->pX86MemExecHead        = NULL;
         pThis->PspAddrMmioLowest      = 0xffffffff;
         pThis->PspAddrMmioHighest     = 0x00000000;
         pThis->SmnAddrLowest          = 0xffffffff;
@@ -1798,11 +2718,19 @@ int PSPEmuIoMgrCreate(PPSPIOM phIoMgr, PSPCORE hPspCore)
         pThis->pvUserX86Unassigned    = NULL;
         pThis->pTpHead                = NULL;
         pThis->fLogAllAccesses        = false;
+        pThis->fStats                 = false;
+        pThis->uRegionGen             = 0;
 
-        /* Register the MMIO region, where the SMN devices get mapped to (32 slots each 1MiB wide). */
-        rc = PSPEmuCoreMmioRegister(hPspCore, 0x01000000, 32 * _1M,
-                                    pspEmuIomSmnSlotsRead, pspEmuIomSmnSlotsWrite,
-                                    pThis);
+        /* Register the MMIO regions, where the SMN devices get mapped to (32 slots each 1MiB wide). */
+        for (uint32_t i = 0; i < ELEMENTS(pThis->aSmnSlots) && !rc; i++)
+        {
+            PPSPIOMSMNSLOT pSmnSlot = &pThis->aSmnSlots[i];
+
+            pSmnSlot->pIoMgr           = pThis;
+            pSmnSlot->PspAddrMmioStart = PSP_IOM_SMN_SLOTS_START + i * PSP_IOM_SMN_SLOT_SIZE;
+            pSmnSlot->pSmnDirect       = NULL;
+            rc = pspEmuIomSmnSlotMmioRegister(pThis, pSmnSlot, 0 /*idxMmio*/, pSmnSlot->PspAddrMmioStart, PSP_IOM_SMN_SLOT_SIZE);
+        }
         if (!rc)
         {
             /* Register the remaining standard MMIO region. */
@@ -1820,7 +2748,8 @@ int PSPEmuIoMgrCreate(PPSPIOM phIoMgr, PSPCORE hPspCore)
                     pX86MapSlot->PspAddrMmioStart  = 0x04000000 + i * 64 * _1M;
                     pX86MapSlot->cbMmio            = 64 * _1M;
                     pX86MapSlot->PhysX86Base       = 0;
-                    pX86MapSlot->pX86MemExec       = NULL;
+                    pX86MapSlot->cMemDirect        = 0;
+                    pX86MapSlot->cSplitMmio        = 0;
                     pX86MapSlot->u32RegX86BaseAddr = 0;
                     pX86MapSlot->u32RegUnk1        = 0;
                     pX86MapSlot->u32RegUnk2        = 0;
@@ -1884,9 +2813,11 @@ int PSPEmuIoMgrCreate(PPSPIOM phIoMgr, PSPCORE hPspCore)
                 PSPEmuCoreMmioDeregister(pThis->hPspCore, 0x03000000, 0x04000000 - 0x03000000);
             }
 
-            PSPEmuCoreMmioDeregister(pThis->hPspCore, 0x01000000, 32 * _1M);
         }
 
+        for (uint32_t i = 0; i < ELEMENTS(pThis->aSmnSlots); i++)
+            pspEmuIomSmnSlotMmioDeregisterAll(pThis, &pThis->aSmnSlots[i]);
+
         free(pThis);
     }
     else
@@ -1909,14 +2840,24 @@ int PSPEmuIoMgrDestroy(PSPIOM hIoMgr)
         free(pFree);
     }
 
+    for (uint32_t i = 0; i < ELEMENTS(pThis->aSmnSlots); i++)
+    {
+        PPSPIOMSMNSLOT pSmnSlot = &pThis->aSmnSlots[i];
+
+        if (pSmnSlot->pSmnDirect)
+            PSPEmuCoreMemRegionRemove(pThis->hPspCore, pSmnSlot->PspAddrDirectStart, pSmnSlot->cbDirect);
+        pspEmuIomSmnSlotMmioDeregisterAll(pThis, pSmnSlot);
+    }
+
+    /* The direct mappings reference the x86 memory, so drop them before the regions get freed. */
+    for (uint32_t i = 0; i < ELEMENTS(pThis->aX86MapCtrlSlots); i++)
+        pspEmuIoMgrX86MapDirectUnmap(pThis, &pThis->aX86MapCtrlSlots[i]);
+
     pspEmuIoMgrDestroyRegionList(pThis->pMmioHead);
     pspEmuIoMgrDestroyRegionList(pThis->pSmnHead);
     pspEmuIoMgrDestroyRegionList(pThis->pX86Head);
-    /* pX86MemExecHead is already part of pX86Head, so freed already. */
 
-    int rc = PSPEmuCoreMmioDeregister(pThis->hPspCore, 0x01000000, 0x01000000 + 32 * _1M);
-    if (!rc)
-        rc = PSPEmuCoreMmioDeregister(pThis->hPspCore, 0x01000000 + 32 * _1M, 0x44000000);
+    int rc = PSPEmuCoreMmioDeregister(pThis->hPspCore, 0x03000000, 0x04000000 - 0x03000000);
     /** @todo Free devices. */
     free(pThis);
     return rc;
@@ -1928,10 +2869,30 @@ int PSPEmuIoMgrTraceAllAccessesSet(PSPIOM hIoMgr, bool fEnable)
     PPSPIOMINT pThis = hIoMgr;
 
     pThis->fLogAllAccesses = fEnable;
+    pspEmuIomSmnSlotsRemapAll(pThis);
+    pspEmuIoMgrX86MapSlotsRemapAll(pThis);
     return 0;
 }
 
 
+int PSPEmuIoMgrTraceFilterChanged(PSPIOM hIoMgr)
+{
+    PPSPIOMINT pThis = hIoMgr;
+
+    pspEmuIomSmnSlotsRemapAll(pThis);
+    pspEmuIoMgrX86MapSlotsRemapAll(pThis);
+    return 0;
+}
+
+
+int PSPEmuIoMgrCoreWakeup(PSPIOM hIoMgr)
+{
+    PPSPIOMINT pThis = hIoMgr;
+
+    return PSPEmuCoreHaltWakeup(pThis->hPspCore);
+}
+
+
 int PSPEmuIoMgrMmioUnassignedSet(PSPIOM hIoMgr, PFNPSPIOMMMIOREAD pfnRead, PFNPSPIOMMMIOWRITE pfnWrite, const char *pszDesc,
                                  void *pvUser)
 {
@@ -2010,7 +2971,9 @@ int PSPEmuIoMgrMmioTraceRegister(PSPIOM hIoMgr, PSPADDR PspAddrMmioStart, PSPADD
         pTp->u.Mmio.PspAddrMmioStart = PspAddrMmioStart;
         pTp->u.Mmio.PspAddrMmioEnd   = PspAddrMmioEnd;
         pTp->u.Mmio.pfnTrace         = pfnTrace;
-        *phIoTp = pTp;
+        rc = pspEmuIomTpLink(pThis, pTp);
+        if (!rc)
+            *phIoTp = pTp;
     }
 
     return rc;
@@ -2056,7 +3019,8 @@ int PSPEmuIoMgrSmnRegister(PSPIOM hIoMgr, SMNADDR SmnAddrStart, size_t cbSmn,
         if (   (   !pPrev
                 || pPrev->u.Smn.SmnAddrStart + cbSmn <= SmnAddrStart)
             && (   !pCur
-                || SmnAddrStart + cbSmn <= pCur->u.Smn.SmnAddrStart))
+                || SmnAddrStart + cbSmn <= pCur->u.Smn.SmnAddrStart)
+            && !pspEmuIomRegionTpsAttachAll(pThis, pRegion))
         {
             pRegion->pNext = pCur;
             if (pPrev)
@@ -2085,6 +3049,48 @@ int PSPEmuIoMgrSmnRegister(PSPIOM hIoMgr, SMNADDR SmnAddrStart, size_t cbSmn,
 }
 
 
+int PSPEmuIoMgrSmnRamRegister(PSPIOM hIoMgr, SMNADDR SmnAddrStart, size_t cbSmn, uint32_t fProt,
+                              const char *pszDesc, void **ppvRam, PPSPIOMREGIONHANDLE phSmn)
+{
+    /* Page aligned so the core can map it, anonymous memory reads as zero. */
+    size_t cbAlloc = (cbSmn + _4K - 1) & ~(size_t)(_4K - 1);
+    void *pvRam = mmap(NULL, cbAlloc, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pvRam == MAP_FAILED)
+        return -1;
+
+    PSPIOMREGIONHANDLE hSmn = NULL;
+    int rc = PSPEmuIoMgrSmnRegister(hIoMgr, SmnAddrStart, cbSmn,
+                                    pspEmuIoMgrSmnRamRead,
+                                    (fProt & PSPEMU_CORE_MEM_REGION_PROT_F_WRITE) ? pspEmuIoMgrSmnRamWrite : NULL,
+                                    pvRam, pszDesc, &hSmn);
+    if (!rc)
+    {
+        /* The region owns the memory from now on, it gets freed when the region is deregistered. */
+        pspEmuIomSmnRegionBackingSet(hSmn, pvRam, cbAlloc, fProt);
+        *ppvRam = pvRam;
+        *phSmn  = hSmn;
+        return 0;
+    }
+
+    munmap(pvRam, cbAlloc);
+    return rc;
+}
+
+
+int PSPEmuIoMgrSmnRegionBackingSet(PSPIOMREGIONHANDLE hSmn, void *pvBacking, uint32_t fProt)
+{
+    PPSPIOMREGIONHANDLEINT pRegion = hSmn;
+
+    /* The backing of RAM regions is owned by the I/O manager and can't be replaced. */
+    if (   pRegion->enmType != PSPIOMREGIONTYPE_SMN
+        || pRegion->u.Smn.cbBackingAlloc)
+        return -1;
+
+    pspEmuIomSmnRegionBackingSet(pRegion, pvBacking, 0 /*cbBackingAlloc*/, fProt);
+    return 0;
+}
+
+
 int PSPEmuIoMgrSmnTraceRegister(PSPIOM hIoMgr, SMNADDR SmnAddrStart, SMNADDR SmnAddrEnd,
                                 size_t cbAccess, uint32_t fFlags, PFNPSPIOMSMNTRACE pfnTrace, void *pvUser,
                                 PPSPIOMTP phIoTp)
@@ -2101,7 +3107,9 @@ int PSPEmuIoMgrSmnTraceRegister(PSPIOM hIoMgr, SMNADDR SmnAddrStart, SMNADDR Smn
         pTp->u.Smn.SmnAddrStart = SmnAddrStart;
         pTp->u.Smn.SmnAddrEnd   = SmnAddrEnd;
         pTp->u.Smn.pfnTrace     = pfnTrace;
-        *phIoTp = pTp;
+        rc = pspEmuIomTpLink(pThis, pTp);
+        if (!rc)
+            *phIoTp = pTp;
     }
 
     return rc;
@@ -2165,19 +3173,27 @@ int PSPEmuIoMgrX86MemRegister(PSPIOM hIoMgr, X86PADDR PhysX86AddrMemStart, size_
         pRegion->fFlags                 = PSP_IOM_REGION_F_READ | PSP_IOM_REGION_F_WRITE;
         pRegion->u.X86.PhysX86AddrStart = PhysX86AddrMemStart;
         pRegion->u.X86.cbX86            = cbX86Mem;
-        pRegion->u.X86.u.Mem.pExecNext  = NULL;
         pRegion->u.X86.u.Mem.pfnFetch   = pfnFetch;
         pRegion->u.X86.u.Mem.pvMapping  = NULL;
         pRegion->u.X86.u.Mem.cbAlloc    = 0;
-        pRegion->u.X86.u.Mem.cbValid    = 0;
+        pRegion->u.X86.u.Mem.pbmPagesValid = NULL;
         pRegion->u.X86.u.Mem.cbWritten  = 0;
         pRegion->u.X86.u.Mem.fCanExec   = fCanExec;
 
         rc = pspEmuIomX86RegionInsert(pThis, pRegion);
         if (!rc)
         {
-            if (fCanExec)
-                pspEmuIomX86MemExecInsert(pThis, pRegion);
+            /* Map the new memory into any slot already covering it. */
+            for (uint32_t i = 0; i < ELEMENTS(pThis->aX86MapCtrlSlots); i++)
+            {
+                PPSPIOMX86MAPCTRLSLOT pX86MapSlot = &pThis->aX86MapCtrlSlots[i];
+
+                if (   pX86MapSlot->u32RegX86BaseAddr
+                    && PhysX86AddrMemStart < pX86MapSlot->PhysX86Base + pX86MapSlot->cbMmio
+                    && pX86MapSlot->PhysX86Base < PhysX86AddrMemStart + cbX86Mem)
+                    pspEmuIoMgrX86MapSlotRemap(pThis, pX86MapSlot);
+            }
+
             *phX86Mem = pRegion;
             return 0;
         }
@@ -2237,7 +3253,9 @@ int PSPEmuIoMgrX86TraceRegister(PSPIOM hIoMgr, X86PADDR PhysX86AddrStart, X86PAD
         pTp->u.X86.PhysX86AddrStart = PhysX86AddrStart;
         pTp->u.X86.PhysX86AddrEnd   = PhysX86AddrEnd;
         pTp->u.X86.pfnTrace         = pfnTrace;
-        *phIoTp = pTp;
+        rc = pspEmuIomTpLink(pThis, pTp);
+        if (!rc)
+            *phIoTp = pTp;
     }
 
     return rc;
@@ -2286,37 +3304,43 @@ int PSPEmuIoMgrDeregister(PSPIOMREGIONHANDLE hRegion)
         else
             *ppList = pCur->pNext;
 
-        /* For X86 memory regions we have to destroy the backing memory. */
+        pThis->uRegionGen++;
+
+        /* Drop any direct mapping of a SMN region before it goes away. */
+        if (pRegion->enmType == PSPIOMREGIONTYPE_SMN)
+        {
+            for (uint32_t i = 0; i < ELEMENTS(pThis->aSmnSlots); i++)
+            {
+                if (pThis->aSmnSlots[i].pSmnDirect == pRegion)
+                    pspEmuIomSmnSlotRemap(pThis, i);
+            }
+
+            pspEmuIoMgrSmnRamFree(pRegion);
+        }
+
+        /* For X86 memory regions we have to drop the direct mappings and destroy the backing memory. */
         /** @todo Sync mapping? */
         if (pRegion->enmType == PSPIOMREGIONTYPE_X86_MEM)
         {
-            if (pRegion->u.X86.u.Mem.pvMapping)
-                free(pRegion->u.X86.u.Mem.pvMapping);
-
-            /* Remove from executable list if required. */
-            if (pRegion->u.X86.u.Mem.fCanExec)
+            for (uint32_t i = 0; i < ELEMENTS(pThis->aX86MapCtrlSlots); i++)
             {
-                pPrev = NULL;
-                pCur = pThis->pX86MemExecHead;
+                PPSPIOMX86MAPCTRLSLOT pX86MapSlot = &pThis->aX86MapCtrlSlots[i];
 
-                while (   pCur
-                       && pCur != pRegion)
+                for (uint32_t idxMem = 0; idxMem < pX86MapSlot->cMemDirect; idxMem++)
                 {
-                    pPrev = pCur;
-                    pCur = pCur->u.X86.u.Mem.pExecNext;
-                }
-
-                if (pCur)
-                {
-                    /* Found */
-                    if (pPrev)
-                        pPrev->u.X86.u.Mem.pExecNext = pCur->u.X86.u.Mem.pExecNext;
-                    else
-                        pThis->pX86MemExecHead = pCur->u.X86.u.Mem.pExecNext;
+                    if (pX86MapSlot->aMemDirect[idxMem].pX86Mem == pRegion)
+                    {
+                        pspEmuIoMgrX86MapSlotRemap(pThis, pX86MapSlot);
+                        break;
+                    }
                 }
-                /** @todo else Assert() as it should never happen. */
             }
+
+            pspEmuIoMgrX86MemFree(pRegion);
         }
+
+        if (pRegion->papTps)
+            free(pRegion->papTps);
         free(pRegion);
     }
     else /* Not found? */
@@ -2350,6 +3374,18 @@ int PSPEmuIoMgrTpDeregister(PSPIOMTP hIoTp)
         else
             pThis->pTpHead = pCur->pNext;
 
+        PPSPIOMREGIONHANDLEINT pRegion = pspEmuIomTpRegionListGet(pThis, pTp->enmType);
+        while (pRegion)
+        {
+            pspEmuIomRegionTpDetach(pRegion, pTp);
+            pRegion = pRegion->pNext;
+        }
+
+        if (pTp->enmType == PSPIOMTRACETYPE_SMN)
+            pspEmuIomSmnSlotsRemapAll(pThis);
+        else if (pTp->enmType == PSPIOMTRACETYPE_X86)
+            pspEmuIoMgrX86MapSlotsRemapAll(pThis);
+
         free(pTp);
     }
     else /* Not found? */
@@ -2415,6 +3451,19 @@ int PSPEmuIoMgrPspAddrWrite(PSPIOM hIoMgr, PSPADDR PspAddr, const void *pvSrc, s
 }
 
 
+int PSPEmuIoMgrPspAddrQueryBacking(PSPIOM hIoMgr, PSPADDR PspAddr, void **ppv, size_t *pcbAvail)
+{
+    PPSPIOMINT pThis = hIoMgr;
+
+    if (   pspEmuIoMgrAddrIsMmio(pThis, PspAddr, NULL /*ppRegion*/)
+        || pspEmuIoMgrAddrIsSmn(pThis, PspAddr, NULL /*ppRegion*/, NULL /*pSmnAddr*/)
+        || pspEmuIoMgrAddrIsX86(pThis, PspAddr, NULL /*ppX86MapSlot*/, NULL /*ppRegion*/, NULL /*pPhysX86Addr*/))
+        return STS_ERR_NOT_FOUND;
+
+    return PSPEmuCoreMemQueryBacking(pThis->hPspCore, PspAddr, ppv, pcbAvail);
+}
+
+
 int PSPEmuIoMgrX86AddrRead(PSPIOM hIoMgr, X86PADDR PhysX86Addr, void *pvDst, size_t cbRead)
 {
     PPSPIOMINT pThis = hIoMgr;
@@ -2479,6 +3528,104 @@ int PSPEmuIoMgrX86AddrWrite(PSPIOM hIoMgr, X86PADDR PhysX86Addr, const void *pvS
 }
 
 
+int PSPEmuIoMgrAccessV(PSPIOM hIoMgr, PPSPIOMACCESSOP paOps, uint32_t cOps)
+{
+    PPSPIOMINT pThis = hIoMgr;
+    int rc = STS_INF_SUCCESS;
+    /* The region resolved for the previous operation, reused as long as the following accesses stay inside of it. */
+    PPSPIOMREGIONHANDLEINT pRegionLast = NULL;
+    uint32_t uRegionGenLast = pThis->uRegionGen;
+
+    for (uint32_t i = 0; i < cOps && STS_SUCCESS(rc); i++)
+    {
+        PPSPIOMACCESSOP pOp = &paOps[i];
+        PPSPIOMREGIONHANDLEINT pRegion = NULL;
+        bool fWrite = (pOp->fFlags & PSP_IOM_ACCESS_OP_F_WRITE) ? true : false;
+
+        if (   !pOp->cbAccess
+            || pOp->cbAccess > sizeof(pOp->u64Val))
+        {
+            rc = STS_ERR_INVALID_PARAMETER;
+            break;
+        }
+
+        if (!fWrite)
+            pOp->u64Val = 0;
+
+        /* A device handler called during the previous operation might have deregistered the cached region. */
+        if (uRegionGenLast != pThis->uRegionGen)
+        {
+            pRegionLast    = NULL;
+            uRegionGenLast = pThis->uRegionGen;
+        }
+
+        if (pspEmuIomRegionContainsAccess(pRegionLast, pOp->enmAddrSpace, pOp->u64Addr, pOp->cbAccess))
+            pRegion = pRegionLast;
+
+        switch (pOp->enmAddrSpace)
+        {
+            case PSPIOMADDRSPACE_PSP:
+            {
+                PSPADDR PspAddr = (PSPADDR)pOp->u64Addr;
+
+                /*
+                 * Only MMIO regions are cached, the SMN and x86 windows depend on the mapping slots
+                 * which might get reprogrammed by the operations in the batch.
+                 */
+                if (   pRegion
+                    || pspEmuIoMgrAddrIsMmio(pThis, PspAddr, &pRegion))
+                {
+                    if (fWrite)
+                        pspEmuIomMmioRegionWrite(pThis, pRegion, PspAddr, pOp->cbAccess, &pOp->u64Val);
+                    else
+                        pspEmuIomMmioRegionRead(pThis, pRegion, PspAddr, pOp->cbAccess, &pOp->u64Val);
+                }
+                else if (fWrite)
+                    rc = PSPEmuIoMgrPspAddrWrite(hIoMgr, PspAddr, &pOp->u64Val, pOp->cbAccess);
+                else
+                    rc = PSPEmuIoMgrPspAddrRead(hIoMgr, PspAddr, &pOp->u64Val, pOp->cbAccess);
+                break;
+            }
+            case PSPIOMADDRSPACE_SMN:
+            {
+                SMNADDR SmnAddr = (SMNADDR)pOp->u64Addr;
+
+                if (!pRegion)
+                    pRegion = pspEmuIomSmnFindRegion(pThis, SmnAddr);
+
+                if (fWrite)
+                    pspEmuIomSmnRegionWrite(pThis, pRegion, SmnAddr, pOp->cbAccess, &pOp->u64Val);
+                else
+                    pspEmuIomSmnRegionRead(pThis, pRegion, SmnAddr, pOp->cbAccess, &pOp->u64Val);
+                break;
+            }
+            case PSPIOMADDRSPACE_X86:
+            {
+                X86PADDR PhysX86Addr = pOp->u64Addr;
+
+                if (!pRegion)
+                    pRegion = pspEmuIomX86MapFindRegion(pThis, PhysX86Addr);
+
+                /* There is no mapping slot involved so unassigned accesses can't be forwarded. */
+                if (!pRegion)
+                    rc = STS_ERR_NOT_FOUND;
+                else if (fWrite)
+                    pspEmuIomX86RegionWrite(pThis, NULL /*pX86MapSlot*/, pRegion, PhysX86Addr, pOp->cbAccess, &pOp->u64Val);
+                else
+                    pspEmuIomX86RegionRead(pThis, NULL /*pX86MapSlot*/, pRegion, PhysX86Addr, pOp->cbAccess, &pOp->u64Val);
+                break;
+            }
+            default:
+                rc = STS_ERR_INVALID_PARAMETER;
+        }
+
+        pRegionLast = pRegion;
+    }
+
+    return rc;
+}
+
+
 int PSPEmuIoMgrX86MapSlotDump(PSPIOM hIoMgr, uint32_t idxSlotStart, uint32_t idxSlotEnd)
 {
     PPSPIOMINT pThis = hIoMgr;
@@ -2512,3 +3659,173 @@ int PSPEmuIoMgrSmnMapSlotDump(PSPIOM hIoMgr, uint32_t idxSlotStart, uint32_t idx
     return STS_INF_SUCCESS;
 }
 
+
+/**
+ * Calls the given statistics enumeration callback for all regions in the given list.
+ *
+ * @returns Status code.
+ * @param   pHead                   Head of the region list.
+ * @param   enmAddrSpace            The address space the regions are in.
+ * @param   pfnEnum                 The callback to call for each region.
+ * @param   pvUser                  Opaque user data to pass to the callback.
+ */
+static int pspEmuIoMgrStatsEnumList(PPSPIOMREGIONHANDLEINT pHead, PSPIOMADDRSPACE enmAddrSpace,
+                                    PFNPSPIOMSTATSENUM pfnEnum, void *pvUser)
+{
+    int rc = STS_INF_SUCCESS;
+
+    for (PPSPIOMREGIONHANDLEINT pCur = pHead; pCur && STS_SUCCESS(rc); pCur = pCur->pNext)
+    {
+        uint64_t u64AddrStart = 0;
+        size_t cbRegion = 0;
+
+        switch (pCur->enmType)
+        {
+            case PSPIOMREGIONTYPE_PSP_MMIO:
+                u64AddrStart = pCur->u.Mmio.PspAddrMmioStart;
+                cbRegion     = pCur->u.Mmio.cbMmio;
+                break;
+            case PSPIOMREGIONTYPE_SMN:
+                u64AddrStart = pCur->u.Smn.SmnAddrStart;
+                cbRegion     = pCur->u.Smn.cbSmn;
+                break;
+            case PSPIOMREGIONTYPE_X86_MMIO:
+            case PSPIOMREGIONTYPE_X86_MEM:
+                u64AddrStart = pCur->u.X86.PhysX86AddrStart;
+                cbRegion     = pCur->u.X86.cbX86;
+                break;
+            default:
+                break;
+        }
+
+        rc = pfnEnum(enmAddrSpace, u64AddrStart, cbRegion, pCur->pszDesc ? pCur->pszDesc : "<UNKNOWN>",
+                     &pCur->Stats, pvUser);
+    }
+
+    return rc;
+}
+
+
+/**
+ * JSON statistics dumper state.
+ */
+typedef struct PSPIOMSTATSJSON
+{
+    /** The file to write to. */
+    FILE                        *pFile;
+    /** Number of regions written so far. */
+    uint32_t                    cRegions;
+} PSPIOMSTATSJSON;
+/** Pointer to the JSON statistics dumper state. */
+typedef PSPIOMSTATSJSON *PPSPIOMSTATSJSON;
+
+
+/**
+ * @copydoc{FNPSPIOMSTATSENUM}
+ *
+ * Writes a JSON object for every accessed region.
+ */
+static int pspEmuIoMgrStatsDumpJsonEnum(PSPIOMADDRSPACE enmAddrSpace, uint64_t u64AddrStart, size_t cbRegion, const char *pszDesc,
+                                        PCPSPIOMSTATS pStats, void *pvUser)
+{
+    PPSPIOMSTATSJSON pJson = (PPSPIOMSTATSJSON)pvUser;
+    FILE *pFile = pJson->pFile;
+
+    if (   !pStats->cReads
+        && !pStats->cWrites)
+        return STS_INF_SUCCESS;
+
+    fprintf(pFile, "%s    {\"space\": \"%s\", \"addr\": %llu, \"size\": %zu, \"desc\": \"",
+            pJson->cRegions++ ? ",\n" : "",
+              enmAddrSpace == PSPIOMADDRSPACE_PSP
+            ? "mmio"
+            : enmAddrSpace == PSPIOMADDRSPACE_SMN
+            ? "smn"
+            : "x86",
+            (unsigned long long)u64AddrStart, cbRegion);
+    for (const char *pch = pszDesc; *pch; pch++)
+    {
+        if (*pch == '"' || *pch == '\\')
+            fputc('\\', pFile);
+        if ((unsigned char)*pch >= 0x20)
+            fputc(*pch, pFile);
+    }
+    fprintf(pFile, "\", \"reads\": %llu, \"writes\": %llu, \"bytes_read\": %llu, \"bytes_written\": %llu, "
+                   "\"ns_read\": %llu, \"ns_write\": %llu}",
+            (unsigned long long)pStats->cReads, (unsigned long long)pStats->cWrites,
+            (unsigned long long)pStats->cbRead, (unsigned long long)pStats->cbWritten,
+            (unsigned long long)pStats->cNsRead, (unsigned long long)pStats->cNsWrite);
+
+    return ferror(pFile) ? STS_ERR_GENERAL_ERROR : STS_INF_SUCCESS;
+}
+
+
+int PSPEmuIoMgrStatsEnable(PSPIOM hIoMgr, bool fEnable)
+{
+    PPSPIOMINT pThis = hIoMgr;
+
+    pThis->fStats = fEnable;
+    return STS_INF_SUCCESS;
+}
+
+
+int PSPEmuIoMgrStatsEnum(PSPIOM hIoMgr, PFNPSPIOMSTATSENUM pfnEnum, void *pvUser)
+{
+    PPSPIOMINT pThis = hIoMgr;
+
+    int rc = pspEmuIoMgrStatsEnumList(pThis->pMmioHead, PSPIOMADDRSPACE_PSP, pfnEnum, pvUser);
+    if (STS_SUCCESS(rc))
+        rc = pspEmuIoMgrStatsEnumList(pThis->pSmnHead, PSPIOMADDRSPACE_SMN, pfnEnum, pvUser);
+    if (STS_SUCCESS(rc))
+        rc = pspEmuIoMgrStatsEnumList(pThis->pX86Head, PSPIOMADDRSPACE_X86, pfnEnum, pvUser);
+    if (STS_SUCCESS(rc))
+        rc = pfnEnum(PSPIOMADDRSPACE_PSP, 0, 0, pThis->pszMmioUnassignedDesc ? pThis->pszMmioUnassignedDesc : "<UNASSIGNED>",
+                     &pThis->aStatsUnassigned[PSPIOMADDRSPACE_PSP], pvUser);
+    if (STS_SUCCESS(rc))
+        rc = pfnEnum(PSPIOMADDRSPACE_SMN, 0, 0, pThis->pszSmnUnassignedDesc ? pThis->pszSmnUnassignedDesc : "<UNASSIGNED>",
+                     &pThis->aStatsUnassigned[PSPIOMADDRSPACE_SMN], pvUser);
+    if (STS_SUCCESS(rc))
+        rc = pfnEnum(PSPIOMADDRSPACE_X86, 0, 0, pThis->pszX86UnassignedDesc ? pThis->pszX86UnassignedDesc : "<UNASSIGNED>",
+                     &pThis->aStatsUnassigned[PSPIOMADDRSPACE_X86], pvUser);
+
+    return rc;
+}
+
+
+int PSPEmuIoMgrStatsReset(PSPIOM hIoMgr)
+{
+    PPSPIOMINT pThis = hIoMgr;
+    PPSPIOMREGIONHANDLEINT apHeads[] = { pThis->pMmioHead, pThis->pSmnHead, pThis->pX86Head };
+
+    for (uint32_t i = 0; i < ELEMENTS(apHeads); i++)
+    {
+        for (PPSPIOMREGIONHANDLEINT pCur = apHeads[i]; pCur; pCur = pCur->pNext)
+            memset(&pCur->Stats, 0, sizeof(pCur->Stats));
+    }
+    memset(&pThis->aStatsUnassigned[0], 0, sizeof(pThis->aStatsUnassigned));
+
+    return STS_INF_SUCCESS;
+}
+
+
+int PSPEmuIoMgrStatsDumpToFile(PSPIOM hIoMgr, const char *pszFilename)
+{
+    PSPIOMSTATSJSON Json;
+
+    FILE *pFile = fopen(pszFilename, "w");
+    if (!pFile)
+        return STS_ERR_GENERAL_ERROR;
+
+    Json.pFile    = pFile;
+    Json.cRegions = 0;
+
+    fprintf(pFile, "[\n");
+    int rc = PSPEmuIoMgrStatsEnum(hIoMgr, pspEmuIoMgrStatsDumpJsonEnum, &Json);
+    fprintf(pFile, "\n]\n");
+
+    if (   fclose(pFile)
+        && STS_SUCCESS(rc))
+        rc = STS_ERR_GENERAL_ERROR;
+
+    return rc;
+}
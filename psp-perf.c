@@ -0,0 +1,219 @@
+/** @file
+ * PSP Emulator - Host time accounting of the emulator subsystems.
+ */
+
+/*
+ * Copyright (C) 2020 Alexander Eichner <alexander.eichner@campus.tu-berlin.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <common/types.h>
+#include <common/cdefs.h>
+#include <common/status.h>
+
+#include <psp-perf.h>
+
+
+/** Maximum nesting depth of subsystems, deeper nesting is accounted to the innermost tracked subsystem. */
+#define PSP_PERF_NESTING_MAX            16
+
+
+/**
+ * Per thread host time accounting state.
+ */
+typedef struct PSPPERFINT
+{
+    /** Flag whether accounting is enabled. */
+    bool                            fEnabled;
+    /** Current nesting depth, index of the active subsystem in the stack below. */
+    uint32_t                        idxStack;
+    /** Number of currently active enter calls which didn't fit onto the stack anymore. */
+    uint32_t                        cOverflowActive;
+    /** Total number of enter calls which didn't fit onto the stack. */
+    uint32_t                        cOverflow;
+    /** Stack of active subsystems, the bottom is always PSPPERFSUBSYS_OTHER. */
+    PSPPERFSUBSYS                   aenmStack[PSP_PERF_NESTING_MAX];
+    /** Timestamp of the last subsystem switch. */
+    uint64_t                        tsLastNs;
+    /** Timestamp accounting was enabled. */
+    uint64_t                        tsStartNs;
+    /** Report interval in nanoseconds, 0 if disabled. */
+    uint64_t                        cNsReportInterval;
+    /** Timestamp of the last periodic report. */
+    uint64_t                        tsReportLastNs;
+    /** Accumulated nanoseconds for each subsystem. */
+    uint64_t                        acNsSubsys[PSPPERFSUBSYS_LAST + 1];
+    /** Accumulated nanoseconds for each subsystem at the time of the last periodic report. */
+    uint64_t                        acNsSubsysReportLast[PSPPERFSUBSYS_LAST + 1];
+    /** Number of times each subsystem was entered. */
+    uint64_t                        acEnterSubsys[PSPPERFSUBSYS_LAST + 1];
+    /** Number of times each subsystem was entered at the time of the last periodic report. */
+    uint64_t                        acEnterSubsysReportLast[PSPPERFSUBSYS_LAST + 1];
+} PSPPERFINT;
+/** Pointer to the host time accounting state. */
+typedef PSPPERFINT *PPSPPERFINT;
+
+
+/** The accounting state, devices running worker threads don't get accounted. */
+static __thread PSPPERFINT g_Perf;
+
+/** Subsystem names for the report, indexed by PSPPERFSUBSYS. */
+static const char *g_apszPerfSubsys[PSPPERFSUBSYS_LAST + 1] =
+{
+    NULL,
+    "other",
+    "core-exec",
+    "mmu",
+    "iom",
+    "devices",
+    "svc/smc",
+    "trace",
+    "proxy"
+};
+
+
+/**
+ * Returns the current host timestamp.
+ *
+ * @returns Nanosecond timestamp.
+ */
+static inline uint64_t pspEmuPerfTsNs(void)
+{
+    struct timespec Tp;
+    clock_gettime(CLOCK_MONOTONIC, &Tp);
+    return (uint64_t)Tp.tv_sec * 1000000000ULL + Tp.tv_nsec;
+}
+
+
+/**
+ * Prints a report of the time accounted since the given snapshot.
+ *
+ * @returns nothing.
+ * @param   pThis                   The accounting state.
+ * @param   pszTitle                The report title.
+ * @param   cNsWall                 Wall clock time of the reported interval.
+ * @param   pacNsBase               The accumulated times to report the difference to, NULL for everything.
+ * @param   pacEnterBase            The enter counts to report the difference to, NULL for everything.
+ */
+static void pspEmuPerfReport(PPSPPERFINT pThis, const char *pszTitle, uint64_t cNsWall,
+                             const uint64_t *pacNsBase, const uint64_t *pacEnterBase)
+{
+    printf("Host time report (%s, %llu.%03llus wall):\n", pszTitle,
+           (unsigned long long)(cNsWall / 1000000000ULL), (unsigned long long)((cNsWall / 1000000ULL) % 1000));
+    for (uint32_t i = PSPPERFSUBSYS_OTHER; i <= PSPPERFSUBSYS_LAST; i++)
+    {
+        uint64_t cNs    = pThis->acNsSubsys[i]    - (pacNsBase ? pacNsBase[i] : 0);
+        uint64_t cEnter = pThis->acEnterSubsys[i] - (pacEnterBase ? pacEnterBase[i] : 0);
+        uint64_t uPermille = cNsWall ? cNs * 1000 / cNsWall : 0;
+
+        printf("    %-10s %12llu us %3llu.%llu%% %12llu calls\n", g_apszPerfSubsys[i], (unsigned long long)(cNs / 1000),
+               (unsigned long long)(uPermille / 10), (unsigned long long)(uPermille % 10), (unsigned long long)cEnter);
+    }
+    if (pThis->cOverflow)
+        printf("    Nesting was too deep %u times, time got accounted to the innermost tracked subsystem\n", pThis->cOverflow);
+}
+
+
+/**
+ * Accounts the time since the last switch to the active subsystem and prints the periodic report if due.
+ *
+ * @returns nothing.
+ * @param   pThis                   The accounting state.
+ */
+static inline void pspEmuPerfAccount(PPSPPERFINT pThis)
+{
+    uint64_t tsNs = pspEmuPerfTsNs();
+
+    pThis->acNsSubsys[pThis->aenmStack[pThis->idxStack]] += tsNs - pThis->tsLastNs;
+    pThis->tsLastNs = tsNs;
+
+    if (   pThis->cNsReportInterval
+        && tsNs - pThis->tsReportLastNs >= pThis->cNsReportInterval)
+    {
+        pspEmuPerfReport(pThis, "interval", tsNs - pThis->tsReportLastNs,
+                         &pThis->acNsSubsysReportLast[0], &pThis->acEnterSubsysReportLast[0]);
+        memcpy(&pThis->acNsSubsysReportLast[0], &pThis->acNsSubsys[0], sizeof(pThis->acNsSubsys));
+        memcpy(&pThis->acEnterSubsysReportLast[0], &pThis->acEnterSubsys[0], sizeof(pThis->acEnterSubsys));
+        pThis->tsReportLastNs = tsNs;
+    }
+}
+
+
+int PSPEmuPerfInit(uint32_t cSecReportInterval)
+{
+    PPSPPERFINT pThis = &g_Perf;
+
+    memset(pThis, 0, sizeof(*pThis));
+    pThis->aenmStack[0]      = PSPPERFSUBSYS_OTHER;
+    pThis->tsStartNs         = pspEmuPerfTsNs();
+    pThis->tsLastNs          = pThis->tsStartNs;
+    pThis->tsReportLastNs    = pThis->tsStartNs;
+    pThis->cNsReportInterval = (uint64_t)cSecReportInterval * 1000000000ULL;
+    pThis->fEnabled          = true;
+    return STS_INF_SUCCESS;
+}
+
+
+void PSPEmuPerfTerm(void)
+{
+    PPSPPERFINT pThis = &g_Perf;
+
+    if (!pThis->fEnabled)
+        return;
+
+    pThis->cNsReportInterval = 0;
+    pspEmuPerfAccount(pThis);
+    pspEmuPerfReport(pThis, "total", pThis->tsLastNs - pThis->tsStartNs, NULL /*pacNsBase*/, NULL /*pacEnterBase*/);
+    pThis->fEnabled = false;
+}
+
+
+void PSPEmuPerfEnter(PSPPERFSUBSYS enmSubsys)
+{
+    PPSPPERFINT pThis = &g_Perf;
+
+    if (!pThis->fEnabled)
+        return;
+
+    pspEmuPerfAccount(pThis);
+    pThis->acEnterSubsys[enmSubsys]++;
+    if (pThis->idxStack + 1 < ELEMENTS(pThis->aenmStack))
+        pThis->aenmStack[++pThis->idxStack] = enmSubsys;
+    else
+    {
+        pThis->cOverflowActive++;
+        pThis->cOverflow++;
+    }
+}
+
+
+void PSPEmuPerfLeave(void)
+{
+    PPSPPERFINT pThis = &g_Perf;
+
+    if (!pThis->fEnabled)
+        return;
+
+    pspEmuPerfAccount(pThis);
+    if (pThis->cOverflowActive)
+        pThis->cOverflowActive--;
+    else if (pThis->idxStack)
+        pThis->idxStack--;
+}
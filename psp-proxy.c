@@ -30,6 +30,7 @@
 
 #include <libpspproxy.h>
 
+#include <psp-perf.h>
 #include <psp-proxy.h>
 #include <psp-trace.h>
 #include <psp-iom.h>
@@ -592,6 +593,8 @@ static void pspEmuProxyCcdPspMmioUnassignedRead(PSPADDR offMmio, size_t cbRead,
     PPSPPROXYCCD pCcdRec = (PPSPPROXYCCD)pvUser;
     PPSPPROXYINT pThis = pCcdRec->pThis;
 
+    PSPEmuPerfEnter(PSPPERFSUBSYS_PROXY);
+
     /* Reads will flush any buffered writes immediately and reset the write buffering. */
     pspEmuProxyCcdWrBufFlush(pThis, pCcdRec);
 
@@ -612,6 +615,8 @@ static void pspEmuProxyCcdPspMmioUnassignedRead(PSPADDR offMmio, size_t cbRead,
     else
         PSPEmuTraceEvtAddDevRead(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_MMIO,
                                  "<PROXY/DENIED>", offMmio, pvVal, cbRead);
+
+    PSPEmuPerfLeave();
 }
 
 
@@ -620,6 +625,8 @@ static void pspEmuProxyCcdPspMmioUnassignedWrite(PSPADDR offMmio, size_t cbWrite
     PPSPPROXYCCD pCcdRec = (PPSPPROXYCCD)pvUser;
     PPSPPROXYINT pThis = pCcdRec->pThis;
 
+    PSPEmuPerfEnter(PSPPERFSUBSYS_PROXY);
+
     /** @todo Implement buffering for MMIO accesses. */
     pspEmuProxyCcdWrBufFlush(pThis, pCcdRec);
 
@@ -640,6 +647,8 @@ static void pspEmuProxyCcdPspMmioUnassignedWrite(PSPADDR offMmio, size_t cbWrite
     else
         PSPEmuTraceEvtAddDevWrite(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_MMIO,
                                   "<PROXY/DENIED>", offMmio, pvVal, cbWrite);
+
+    PSPEmuPerfLeave();
 }
 
 
@@ -648,6 +657,8 @@ static void pspEmuProxyCcdPspSmnUnassignedRead(SMNADDR offSmn, size_t cbRead, vo
     PPSPPROXYCCD pCcdRec = (PPSPPROXYCCD)pvUser;
     PPSPPROXYINT pThis = pCcdRec->pThis;
 
+    PSPEmuPerfEnter(PSPPERFSUBSYS_PROXY);
+
     /* Reads will flush any buffered writes immediately and reset the write buffering. */
     pspEmuProxyCcdWrBufFlush(pThis, pCcdRec);
 
@@ -664,6 +675,8 @@ static void pspEmuProxyCcdPspSmnUnassignedRead(SMNADDR offSmn, size_t cbRead, vo
     else
         PSPEmuTraceEvtAddDevRead(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_SMN,
                                  "<PROXY/DENIED>", offSmn, pvVal, cbRead);
+
+    PSPEmuPerfLeave();
 }
 
 
@@ -672,6 +685,8 @@ static void pspEmuProxyCcdPspSmnUnassignedWrite(SMNADDR offSmn, size_t cbWrite,
     PPSPPROXYCCD pCcdRec = (PPSPPROXYCCD)pvUser;
     PPSPPROXYINT pThis = pCcdRec->pThis;
 
+    PSPEmuPerfEnter(PSPPERFSUBSYS_PROXY);
+
     bool fAllowed = PSPProxyIsSmnAccessAllowed(offSmn, cbWrite, true /*fWrite*/,
                                                pspEmuCcdDetermineBlStage(pCcdRec->hCcd),
                                                pThis->pCfg, NULL /*pvReadVal*/);
@@ -698,6 +713,8 @@ static void pspEmuProxyCcdPspSmnUnassignedWrite(SMNADDR offSmn, size_t cbWrite,
     else
         PSPEmuTraceEvtAddDevWrite(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_SMN,
                                   "<PROXY/DENIED>", offSmn, pvVal, cbWrite);
+
+    PSPEmuPerfLeave();
 }
 
 
@@ -707,6 +724,8 @@ static void pspEmuProxyCcdX86UnassignedRead(X86PADDR offX86Phys, size_t cbRead,
     PPSPPROXYCCD pCcdRec = (PPSPPROXYCCD)pvUser;
     PPSPPROXYINT pThis = pCcdRec->pThis;
 
+    PSPEmuPerfEnter(PSPPERFSUBSYS_PROXY);
+
     /* Reads will flush any buffered writes immediately and reset the write buffering. */
     pspEmuProxyCcdWrBufFlush(pThis, pCcdRec);
 
@@ -728,6 +747,8 @@ static void pspEmuProxyCcdX86UnassignedRead(X86PADDR offX86Phys, size_t cbRead,
     else
         PSPEmuTraceEvtAddDevRead(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_X86,
                                  "<PROXY/DENIED>", offX86Phys, pvVal, cbRead);
+
+    PSPEmuPerfLeave();
 }
 
 
@@ -737,6 +758,8 @@ static void pspEmuProxyCcdX86UnassignedWrite(X86PADDR offX86Phys, size_t cbWrite
     PPSPPROXYCCD pCcdRec = (PPSPPROXYCCD)pvUser;
     PPSPPROXYINT pThis = pCcdRec->pThis;
 
+    PSPEmuPerfEnter(PSPPERFSUBSYS_PROXY);
+
     bool fAllowed = PSPProxyIsX86AccessAllowed(offX86Phys, cbWrite, true /*fWrite*/,
                                                pspEmuCcdDetermineBlStage(pCcdRec->hCcd),
                                                pThis->pCfg, NULL /*pvReadVal*/);
@@ -769,6 +792,8 @@ static void pspEmuProxyCcdX86UnassignedWrite(X86PADDR offX86Phys, size_t cbWrite
     else
         PSPEmuTraceEvtAddDevWrite(NULL, PSPTRACEEVTSEVERITY_INFO, PSPTRACEEVTORIGIN_X86,
                                   "<PROXY/DENIED>", offX86Phys, pvVal, cbWrite);
+
+    PSPEmuPerfLeave();
 }
 
 
@@ -435,26 +435,22 @@ static int pspEmuSvcX86MemMapWorker(PPSPSVCINT pThis, uint32_t u32PhysX86AddrLow
                  * of the emulated x86 mapping engine to point to our created x86 memory mapping.
                  */
                 PSPADDR PspAddrSlotBase = 0x03230000 + idxSlot * 4 * sizeof(uint32_t);
-                uint32_t uTmp = 0;
-
-                /* Program base address. */
-                uTmp = ((PhysX86AddrBase >> 32) << 6) | ((PhysX86AddrBase >> 26) & 0x3f);
-                rc = PSPEmuIoMgrPspAddrWrite(pThis->hIoMgr, PspAddrSlotBase + 0, &uTmp, sizeof(uTmp));
-                /* Unknown but fixed value. */
-                uTmp = 0x12;
-                if (!rc)
-                    rc = PSPEmuIoMgrPspAddrWrite(pThis->hIoMgr, PspAddrSlotBase + 4, &uTmp, sizeof(uTmp));
-                if (!rc)
-                    rc = PSPEmuIoMgrPspAddrWrite(pThis->hIoMgr, PspAddrSlotBase + 8, &uMemType, sizeof(uMemType));
-                if (!rc)
-                    rc = PSPEmuIoMgrPspAddrWrite(pThis->hIoMgr, PspAddrSlotBase + 12, &uMemType, sizeof(uMemType));
-
-                uTmp = 0xffffffff;
-                if (!rc)
-                    rc = PSPEmuIoMgrPspAddrWrite(pThis->hIoMgr, 0x032303e0 + idxSlot * sizeof(uint32_t), &uTmp, sizeof(uTmp));
-                uTmp = 0xc0000000;
-                if (!rc)
-                    rc = PSPEmuIoMgrPspAddrWrite(pThis->hIoMgr, 0x032304d8 + idxSlot * sizeof(uint32_t), &uTmp, sizeof(uTmp));
+                PSPIOMACCESSOP aOps[] =
+                {
+                    /* Program base address. */
+                    { PSPIOMADDRSPACE_PSP, PSP_IOM_ACCESS_OP_F_WRITE, PspAddrSlotBase + 0,  sizeof(uint32_t),
+                      ((PhysX86AddrBase >> 32) << 6) | ((PhysX86AddrBase >> 26) & 0x3f) },
+                    /* Unknown but fixed value. */
+                    { PSPIOMADDRSPACE_PSP, PSP_IOM_ACCESS_OP_F_WRITE, PspAddrSlotBase + 4,  sizeof(uint32_t), 0x12       },
+                    { PSPIOMADDRSPACE_PSP, PSP_IOM_ACCESS_OP_F_WRITE, PspAddrSlotBase + 8,  sizeof(uint32_t), uMemType   },
+                    { PSPIOMADDRSPACE_PSP, PSP_IOM_ACCESS_OP_F_WRITE, PspAddrSlotBase + 12, sizeof(uint32_t), uMemType   },
+                    { PSPIOMADDRSPACE_PSP, PSP_IOM_ACCESS_OP_F_WRITE, 0x032303e0 + idxSlot * sizeof(uint32_t),
+                      sizeof(uint32_t), 0xffffffff },
+                    { PSPIOMADDRSPACE_PSP, PSP_IOM_ACCESS_OP_F_WRITE, 0x032304d8 + idxSlot * sizeof(uint32_t),
+                      sizeof(uint32_t), 0xc0000000 }
+                };
+
+                rc = PSPEmuIoMgrAccessV(pThis->hIoMgr, &aOps[0], ELEMENTS(aOps));
                 if (!rc)
                     *pPspAddrMapped = 0x04000000 + idxSlot * _64M + offStart;
                 else
@@ -22,9 +22,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
 
 #include <common/status.h>
 
+#include <psp-disasm.h>
+#include <psp-perf.h>
 #include <psp-trace.h>
 
 
@@ -143,10 +147,13 @@ typedef struct PSPTRACEEVT
     PSPTRACEEVTORIGIN               enmOrigin;
     /** The content type. */
     PSPTRACEEVTCONTENTTYPE          enmContent;
-    /** PSP core state. */
+    /** PSP core state, only the PC is valid with PSPEMU_TRACE_F_FULL_CORE_CTX. */
     PSPCORESTATE                    CoreState;
-    /** The PSP core context when this event happened. */
-    uint32_t                        au32CoreRegs[PSPCOREREG_SPSR + 1];
+    /** Bitmap of core registers (indexed by PSPCOREREG) which changed since the previous event,
+     * only valid with PSPEMU_TRACE_F_FULL_CORE_CTX. */
+    uint32_t                        bmCoreRegs;
+    /** Offset of the changed register values in the content array (ordered by PSPCOREREG). */
+    uint32_t                        offCoreRegs;
     /** Number of bytes allocated for this event in the array below. */
     size_t                          cbAlloc;
     /** Array holding the content depending on the content type - variable in size. */
@@ -158,6 +165,65 @@ typedef PSPTRACEEVT *PPSPTRACEEVT;
 typedef const PSPTRACEEVT *PCPSPTRACEEVT;
 
 
+/** Maximum number of clauses a trace filter can consist of (one bit per clause in the decision bitmaps). */
+#define PSP_TRACE_FLT_CLAUSES_MAX           64
+/** Maximum length of a device name pattern in a filter clause. */
+#define PSP_TRACE_FLT_DEV_NAME_MAX          64
+
+/** The clause matches read accesses. */
+#define PSP_TRACE_FLT_CLAUSE_F_READ         BIT(0)
+/** The clause matches write accesses. */
+#define PSP_TRACE_FLT_CLAUSE_F_WRITE        BIT(1)
+/** The clause has a device name predicate. */
+#define PSP_TRACE_FLT_CLAUSE_F_DEV          BIT(2)
+/** The device name is a prefix (pattern ended with '*'). */
+#define PSP_TRACE_FLT_CLAUSE_F_DEV_PREFIX   BIT(3)
+/** The clause has an address range predicate. */
+#define PSP_TRACE_FLT_CLAUSE_F_ADDR         BIT(4)
+/** The clause has a PC range predicate. */
+#define PSP_TRACE_FLT_CLAUSE_F_PC           BIT(5)
+/** The clause has a value predicate. */
+#define PSP_TRACE_FLT_CLAUSE_F_VAL          BIT(6)
+/** The clause has a rate limit. */
+#define PSP_TRACE_FLT_CLAUSE_F_RATE         BIT(7)
+
+
+/**
+ * A single trace filter clause, all predicates must match (AND).
+ */
+typedef struct PSPTRACEFLTCLAUSE
+{
+    /** Flags indicating which predicates are set, PSP_TRACE_FLT_CLAUSE_F_XXX. */
+    uint32_t                        fFlags;
+    /** Bitmap of event origins the clause matches (indexed by PSPTRACEEVTORIGIN), 0 for any. */
+    uint32_t                        bmOrigins;
+    /** Device name (or prefix) to match. */
+    char                            szDev[PSP_TRACE_FLT_DEV_NAME_MAX];
+    /** First address of the address range to match. */
+    uint64_t                        u64AddrFirst;
+    /** Last address of the address range to match (inclusive). */
+    uint64_t                        u64AddrLast;
+    /** First PC of the PC range to match. */
+    uint32_t                        PspAddrPcFirst;
+    /** Last PC of the PC range to match (inclusive). */
+    uint32_t                        PspAddrPcLast;
+    /** Value to match after applying the mask. */
+    uint64_t                        u64Val;
+    /** Mask applied to the accessed value before comparing. */
+    uint64_t                        u64ValMask;
+    /** Maximum number of events per second. */
+    uint32_t                        cRateMax;
+    /** Number of events logged in the current rate window. */
+    uint32_t                        cRateWnd;
+    /** Start of the current rate window in nanoseconds. */
+    uint64_t                        tsRateWndNs;
+} PSPTRACEFLTCLAUSE;
+/** Pointer to a trace filter clause. */
+typedef PSPTRACEFLTCLAUSE *PPSPTRACEFLTCLAUSE;
+/** Pointer to a const trace filter clause. */
+typedef const PSPTRACEFLTCLAUSE *PCPSPTRACEFLTCLAUSE;
+
+
 /**
  * The tracer instance data.
  */
@@ -187,6 +253,18 @@ typedef struct PSPTRACEINT
     uint64_t                        cTraceEvts;
     /** Pointer to the array holding the pointers to the individual trace events. */
     PCPSPTRACEEVT                   *papTraceEvts;
+    /** Mutex serializing event creation, devices might add events from worker threads. */
+    pthread_mutex_t                 Mtx;
+    /** Flag whether the register file below is valid (false until the first full context event). */
+    bool                            fCoreRegsValid;
+    /** The core register file of the previous full context event the next one is delta encoded against. */
+    uint32_t                        au32CoreRegsLast[PSPCOREREG_LAST + 1];
+    /** Generation of the active filter, 0 if no filter is set (everything gets logged). */
+    uint32_t                        uFltGen;
+    /** Number of clauses in the active filter (ORed). */
+    uint32_t                        cFltClauses;
+    /** The clauses of the active filter. */
+    PPSPTRACEFLTCLAUSE              paFltClauses;
 } PSPTRACEINT;
 /** Pointer to the tracer instance data. */
 typedef PSPTRACEINT *PPSPTRACEINT;
@@ -194,8 +272,41 @@ typedef PSPTRACEINT *PPSPTRACEINT;
 typedef const PSPTRACEINT *PCPSPTRACEINT;
 
 
-/** Global default tracer instance used. */
-static PPSPTRACEINT g_pTraceDef = NULL;
+/** Default tracer instance used, per thread as every CCD traces to its own tracer from the thread executing it. */
+static __thread PPSPTRACEINT g_pTraceDef = NULL;
+/** Last filter generation handed out, shared by all tracers so cached decisions never alias. */
+static uint32_t g_uTraceFltGenLast = 0;
+
+/** The registers captured for full core context events, in PSPCOREREG order. */
+static const PSPCOREREG g_aenmCoreRegsFull[] =
+{
+    PSPCOREREG_R0,
+    PSPCOREREG_R1,
+    PSPCOREREG_R2,
+    PSPCOREREG_R3,
+    PSPCOREREG_R4,
+    PSPCOREREG_R5,
+    PSPCOREREG_R6,
+    PSPCOREREG_R7,
+    PSPCOREREG_R8,
+    PSPCOREREG_R9,
+    PSPCOREREG_R10,
+    PSPCOREREG_R11,
+    PSPCOREREG_R12,
+    PSPCOREREG_SP,
+    PSPCOREREG_LR,
+    PSPCOREREG_PC,
+    PSPCOREREG_CPSR,
+    PSPCOREREG_SPSR
+};
+
+/** Register names for the full core context dump, indexed by PSPCOREREG. */
+static const char *g_apszCoreRegNames[PSPCOREREG_LAST + 1] =
+{
+    NULL,
+    "R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7", "R8", "R9", "R10", "R11", "R12",
+    "SP", "LR", "PC", "CPSR", "SPSR"
+};
 
 
 /**
@@ -337,6 +448,37 @@ static int pspEmuTraceEvtCreateAndLink(PPSPTRACEINT pThis, PSPTRACEEVTSEVERITY e
                                        PSPTRACEEVTCONTENTTYPE enmContent, size_t cbAlloc, PPSPTRACEEVT *ppEvt)
 {
     int rc = 0;
+    uint32_t au32CoreRegs[ELEMENTS(g_aenmCoreRegsFull)];
+    uint32_t bmCoreRegs = 0;
+    uint32_t offCoreRegs = 0;
+    uint32_t cCoreRegs = 0;
+
+    /*
+     * Gather the full core context with a single batch query first, only the registers
+     * which changed since the previous event get stored.
+     */
+    if (pThis->fFlags & PSPEMU_TRACE_F_FULL_CORE_CTX)
+    {
+        rc = PSPEmuCoreQueryRegBatch(pThis->hPspCore, &g_aenmCoreRegsFull[0], ELEMENTS(g_aenmCoreRegsFull), &au32CoreRegs[0]);
+        if (rc)
+            return rc;
+
+        for (uint32_t i = 0; i < ELEMENTS(g_aenmCoreRegsFull); i++)
+        {
+            PSPCOREREG enmReg = g_aenmCoreRegsFull[i];
+
+            if (   !pThis->fCoreRegsValid
+                || pThis->au32CoreRegsLast[enmReg] != au32CoreRegs[i])
+            {
+                bmCoreRegs |= BIT(enmReg);
+                cCoreRegs++;
+            }
+        }
+
+        offCoreRegs = (cbAlloc + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+        cbAlloc     = offCoreRegs + cCoreRegs * sizeof(uint32_t);
+    }
+
     PPSPTRACEEVT pEvt = (PPSPTRACEEVT)calloc(1, sizeof(*pEvt) + cbAlloc);
     if (pEvt)
     {
@@ -346,11 +488,27 @@ static int pspEmuTraceEvtCreateAndLink(PPSPTRACEINT pThis, PSPTRACEEVTSEVERITY e
         pEvt->enmOrigin      = enmOrigin;
         pEvt->enmContent     = enmContent;
         pEvt->cbAlloc        = cbAlloc;
+        pEvt->bmCoreRegs     = bmCoreRegs;
+        pEvt->offCoreRegs    = offCoreRegs;
 
         /* Gather the PSP core context. */
         if (pThis->fFlags & PSPEMU_TRACE_F_FULL_CORE_CTX)
         {
-            /** @todo Need a batch query for the core API. */
+            uint32_t *pau32CoreRegs = (uint32_t *)&pEvt->abContent[offCoreRegs];
+            uint32_t idxReg = 0;
+
+            for (uint32_t i = 0; i < ELEMENTS(g_aenmCoreRegsFull); i++)
+            {
+                PSPCOREREG enmReg = g_aenmCoreRegsFull[i];
+
+                if (bmCoreRegs & BIT(enmReg))
+                    pau32CoreRegs[idxReg++] = au32CoreRegs[i];
+                if (enmReg == PSPCOREREG_PC)
+                    pEvt->CoreState.PspAddrPc = au32CoreRegs[i];
+                pThis->au32CoreRegsLast[enmReg] = au32CoreRegs[i];
+            }
+
+            pThis->fCoreRegsValid = true;
         }
         else
             rc = PSPEmuCoreQueryState(pThis->hPspCore, &pEvt->CoreState);
@@ -432,9 +590,11 @@ static const char *pspEmuTraceEvtDumpPrefixCreate(PPSPTRACEINT pThis, char *pszB
     pszCur  += rcStr;
     cchLeft -= rcStr;
 
-    /* The PC if we don't have a full CPU context. */
+    /*
+     * The PC is always available, the remaining core state only without a full CPU context
+     * as the changed registers get dumped separately then.
+     */
     if (!(fFlags & PSPEMU_TRACE_F_FULL_CORE_CTX))
-    {
         rcStr = snprintf(pszCur, cchLeft, "0x%08x[%5s,%s,%s,%s,%s,0x%08x] ",
                          pEvt->CoreState.PspAddrPc,
                          PSPEmuCoreModeToStr(pEvt->CoreState.enmCoreMode),
@@ -443,13 +603,14 @@ static const char *pspEmuTraceEvtDumpPrefixCreate(PPSPTRACEINT pThis, char *pszB
                          pEvt->CoreState.fIrqMasked   ? "NI" : " I",
                          pEvt->CoreState.fFiqMasked   ? "NF" : " F",
                          pEvt->CoreState.PspPAddrPgTblRoot);
-        if (   rcStr < 0
-            || rcStr >= cchLeft)
-            return NULL;
+    else
+        rcStr = snprintf(pszCur, cchLeft, "0x%08x ", pEvt->CoreState.PspAddrPc);
+    if (   rcStr < 0
+        || rcStr >= cchLeft)
+        return NULL;
 
-        pszCur  += rcStr;
-        cchLeft -= rcStr;
-    }
+    pszCur  += rcStr;
+    cchLeft -= rcStr;
 
     return pszBuf;
 }
@@ -631,10 +792,46 @@ static int pspEmuTraceEvtDump(PPSPTRACEINT pThis, uint32_t fFlags, PCPSPTRACEEVT
     pszCur++;
     cchLeft--;
 
-    /* Now the full CPU context if available. */
-    if (fFlags & PSPEMU_TRACE_F_FULL_CORE_CTX)
+    /* Now the full CPU context if available, only the registers which changed since the previous event are dumped. */
+    if (   (fFlags & PSPEMU_TRACE_F_FULL_CORE_CTX)
+        && pEvt->bmCoreRegs)
     {
-        /** @todo */
+        const uint32_t *pau32CoreRegs = (const uint32_t *)&pEvt->abContent[pEvt->offCoreRegs];
+        uint32_t idxReg = 0;
+
+        rcStr = snprintf(pszCur, cchLeft, "%s{", &achPrefixSpace[0]);
+        if (   rcStr < 0
+            || rcStr >= cchLeft)
+            return -1;
+
+        pszCur  += rcStr;
+        cchLeft -= rcStr;
+
+        for (uint32_t i = 0; i < ELEMENTS(g_aenmCoreRegsFull); i++)
+        {
+            PSPCOREREG enmReg = g_aenmCoreRegsFull[i];
+
+            if (pEvt->bmCoreRegs & BIT(enmReg))
+            {
+                rcStr = snprintf(pszCur, cchLeft, "%s%s=0x%08x", idxReg ? " " : "",
+                                 g_apszCoreRegNames[enmReg], pau32CoreRegs[idxReg]);
+                if (   rcStr < 0
+                    || rcStr >= cchLeft)
+                    return -1;
+
+                pszCur  += rcStr;
+                cchLeft -= rcStr;
+                idxReg++;
+            }
+        }
+
+        rcStr = snprintf(pszCur, cchLeft, "}\n");
+        if (   rcStr < 0
+            || rcStr >= cchLeft)
+            return -1;
+
+        pszCur  += rcStr;
+        cchLeft -= rcStr;
     }
 
     /* Flush */
@@ -705,6 +902,9 @@ static int pspEmuTraceEvtAddDevReadWriteWorker(PSPTRACE hTrace, PSPTRACEEVTSEVER
         PPSPTRACEEVT pEvt;
         size_t cchDevId = strlen(pszDevId) + 1; /* Include terminator */
         size_t cbAlloc = sizeof(PSPTRACEEVTDEVXFER) + cbXfer + cchDevId;
+
+        pthread_mutex_lock(&pThis->Mtx);
+        PSPEmuPerfEnter(PSPPERFSUBSYS_TRACE);
         rc = pspEmuTraceEvtCreateAndLink(pThis, enmSeverity, enmOrigin, PSPTRACEEVTCONTENTTYPE_DEV_XFER, cbAlloc, &pEvt);
         if (!rc)
         {
@@ -718,6 +918,8 @@ static int pspEmuTraceEvtAddDevReadWriteWorker(PSPTRACE hTrace, PSPTRACEEVTSEVER
             memcpy(&pDevXfer->abXfer[cbXfer], pszDevId, cchDevId);
             rc = pspEmuTraceFlushMaybe(pThis);
         }
+        PSPEmuPerfLeave();
+        pthread_mutex_unlock(&pThis->Mtx);
     }
     return rc;
 }
@@ -757,6 +959,9 @@ static int pspEmuTraceEvtAddSvmc(PSPTRACE hTrace, PSPTRACEEVTCONTENTTYPE enmCont
         PPSPTRACEEVT pEvt;
         size_t cchMsg = pszMsg ? strlen(pszMsg) + 1 : 0;
         size_t cbAlloc = sizeof(PSPTRACEEVTSVMC) + cchMsg;
+
+        pthread_mutex_lock(&pThis->Mtx);
+        PSPEmuPerfEnter(PSPPERFSUBSYS_TRACE);
         rc = pspEmuTraceEvtCreateAndLink(pThis, enmSeverity, enmEvtOrigin, enmContentType, cbAlloc, &pEvt);
         if (!rc)
         {
@@ -780,11 +985,360 @@ static int pspEmuTraceEvtAddSvmc(PSPTRACE hTrace, PSPTRACEEVTCONTENTTYPE enmCont
                 pSvmc->szMsg[0] = '\0'; /* Make sure it is terminated. */
             rc = pspEmuTraceFlushMaybe(pThis);
         }
+        PSPEmuPerfLeave();
+        pthread_mutex_unlock(&pThis->Mtx);
+    }
+
+    return rc;
+}
+
+/**
+ * Parses a "<first>[-<last>]" range from the given string.
+ *
+ * @returns Status code.
+ * @param   pszVal                  The string to parse.
+ * @param   pu64First               Where to store the first value of the range.
+ * @param   pu64Last                Where to store the last value of the range (inclusive),
+ *                                  same as the first value if no range is given.
+ */
+static int pspEmuTraceFltParseRange(const char *pszVal, uint64_t *pu64First, uint64_t *pu64Last)
+{
+    char *pszEnd = NULL;
+
+    errno = 0;
+    *pu64First = strtoull(pszVal, &pszEnd, 0);
+    if (errno || pszEnd == pszVal)
+        return STS_ERR_INVALID_PARAMETER;
+
+    if (*pszEnd == '-')
+    {
+        const char *pszLast = pszEnd + 1;
+        *pu64Last = strtoull(pszLast, &pszEnd, 0);
+        if (errno || pszEnd == pszLast || *pu64Last < *pu64First)
+            return STS_ERR_INVALID_PARAMETER;
+    }
+    else
+        *pu64Last = *pu64First;
+
+    return *pszEnd == '\0' ? STS_INF_SUCCESS : STS_ERR_INVALID_PARAMETER;
+}
+
+
+/**
+ * Parses a comma separated list of event origins.
+ *
+ * @returns Status code.
+ * @param   pszVal                  The string to parse, gets modified.
+ * @param   pbmOrigins              Where to store the bitmap of origins on success.
+ */
+static int pspEmuTraceFltParseOrigins(char *pszVal, uint32_t *pbmOrigins)
+{
+    static const struct
+    {
+        const char          *pszName;
+        PSPTRACEEVTORIGIN   enmOrigin;
+    } s_aOrigins[] =
+    {
+        { "mmio",     PSPTRACEEVTORIGIN_MMIO     },
+        { "smn",      PSPTRACEEVTORIGIN_SMN      },
+        { "x86",      PSPTRACEEVTORIGIN_X86      },
+        { "x86-mmio", PSPTRACEEVTORIGIN_X86_MMIO },
+        { "x86-mem",  PSPTRACEEVTORIGIN_X86_MEM  }
+    };
+    char *pszSave = NULL;
+    uint32_t bmOrigins = 0;
+
+    for (char *pszOrigin = strtok_r(pszVal, ",", &pszSave); pszOrigin; pszOrigin = strtok_r(NULL, ",", &pszSave))
+    {
+        uint32_t i;
+        for (i = 0; i < ELEMENTS(s_aOrigins); i++)
+        {
+            if (!strcmp(pszOrigin, s_aOrigins[i].pszName))
+            {
+                bmOrigins |= BIT(s_aOrigins[i].enmOrigin);
+                break;
+            }
+        }
+
+        if (i == ELEMENTS(s_aOrigins))
+            return STS_ERR_INVALID_PARAMETER;
+    }
+
+    if (!bmOrigins)
+        return STS_ERR_INVALID_PARAMETER;
+
+    *pbmOrigins = bmOrigins;
+    return STS_INF_SUCCESS;
+}
+
+
+/**
+ * Parses a single "<key>=<value>" term into the given clause.
+ *
+ * @returns Status code.
+ * @param   pClause                 The clause to add the predicate to.
+ * @param   pszTerm                 The term to parse, gets modified.
+ */
+static int pspEmuTraceFltParseTerm(PPSPTRACEFLTCLAUSE pClause, char *pszTerm)
+{
+    int rc = STS_INF_SUCCESS;
+    char *pszVal = strchr(pszTerm, '=');
+    if (!pszVal || pszVal[1] == '\0')
+        return STS_ERR_INVALID_PARAMETER;
+    *pszVal++ = '\0';
+
+    if (!strcmp(pszTerm, "dev"))
+    {
+        size_t cchDev = strlen(pszVal);
+        if (pszVal[cchDev - 1] == '*')
+        {
+            pClause->fFlags |= PSP_TRACE_FLT_CLAUSE_F_DEV_PREFIX;
+            cchDev--;
+        }
+        if (cchDev >= sizeof(pClause->szDev))
+            return STS_ERR_BUFFER_OVERFLOW;
+
+        memcpy(&pClause->szDev[0], pszVal, cchDev);
+        pClause->szDev[cchDev] = '\0';
+        pClause->fFlags |= PSP_TRACE_FLT_CLAUSE_F_DEV;
+    }
+    else if (!strcmp(pszTerm, "origin"))
+        rc = pspEmuTraceFltParseOrigins(pszVal, &pClause->bmOrigins);
+    else if (!strcmp(pszTerm, "addr"))
+    {
+        rc = pspEmuTraceFltParseRange(pszVal, &pClause->u64AddrFirst, &pClause->u64AddrLast);
+        pClause->fFlags |= PSP_TRACE_FLT_CLAUSE_F_ADDR;
+    }
+    else if (!strcmp(pszTerm, "pc"))
+    {
+        uint64_t u64First = 0;
+        uint64_t u64Last = 0;
+        rc = pspEmuTraceFltParseRange(pszVal, &u64First, &u64Last);
+        if (STS_SUCCESS(rc) && u64Last > UINT32_MAX)
+            rc = STS_ERR_INVALID_PARAMETER;
+        pClause->PspAddrPcFirst = (uint32_t)u64First;
+        pClause->PspAddrPcLast  = (uint32_t)u64Last;
+        pClause->fFlags |= PSP_TRACE_FLT_CLAUSE_F_PC;
+    }
+    else if (!strcmp(pszTerm, "rw"))
+    {
+        pClause->fFlags &= ~(PSP_TRACE_FLT_CLAUSE_F_READ | PSP_TRACE_FLT_CLAUSE_F_WRITE);
+        if (!strcmp(pszVal, "r"))
+            pClause->fFlags |= PSP_TRACE_FLT_CLAUSE_F_READ;
+        else if (!strcmp(pszVal, "w"))
+            pClause->fFlags |= PSP_TRACE_FLT_CLAUSE_F_WRITE;
+        else if (!strcmp(pszVal, "rw"))
+            pClause->fFlags |= PSP_TRACE_FLT_CLAUSE_F_READ | PSP_TRACE_FLT_CLAUSE_F_WRITE;
+        else
+            rc = STS_ERR_INVALID_PARAMETER;
+    }
+    else if (!strcmp(pszTerm, "val"))
+    {
+        char *pszEnd = NULL;
+
+        errno = 0;
+        pClause->u64Val     = strtoull(pszVal, &pszEnd, 0);
+        pClause->u64ValMask = UINT64_MAX;
+        if (!errno && pszEnd != pszVal && *pszEnd == '/')
+        {
+            const char *pszMask = pszEnd + 1;
+            pClause->u64ValMask = strtoull(pszMask, &pszEnd, 0);
+            if (pszEnd == pszMask)
+                rc = STS_ERR_INVALID_PARAMETER;
+        }
+        if (errno || pszEnd == pszVal || *pszEnd != '\0')
+            rc = STS_ERR_INVALID_PARAMETER;
+        pClause->u64Val &= pClause->u64ValMask;
+        pClause->fFlags |= PSP_TRACE_FLT_CLAUSE_F_VAL;
     }
+    else if (!strcmp(pszTerm, "rate"))
+    {
+        char *pszEnd = NULL;
+
+        errno = 0;
+        unsigned long cRateMax = strtoul(pszVal, &pszEnd, 0);
+        if (errno || pszEnd == pszVal || *pszEnd != '\0' || !cRateMax || cRateMax > UINT32_MAX)
+            rc = STS_ERR_INVALID_PARAMETER;
+        pClause->cRateMax = (uint32_t)cRateMax;
+        pClause->fFlags |= PSP_TRACE_FLT_CLAUSE_F_RATE;
+    }
+    else
+        rc = STS_ERR_INVALID_PARAMETER;
 
     return rc;
 }
 
+
+/**
+ * Compiles the given filter expression into an array of clauses.
+ *
+ * @returns Status code.
+ * @param   pszFilter               The filter expression.
+ * @param   ppaClauses              Where to store the pointer to the clause array on success.
+ * @param   pcClauses               Where to store the number of clauses on success.
+ */
+static int pspEmuTraceFltCompile(const char *pszFilter, PPSPTRACEFLTCLAUSE *ppaClauses, uint32_t *pcClauses)
+{
+    int rc = STS_INF_SUCCESS;
+    char *pszDup = strdup(pszFilter);
+    PPSPTRACEFLTCLAUSE paClauses = (PPSPTRACEFLTCLAUSE)calloc(PSP_TRACE_FLT_CLAUSES_MAX, sizeof(*paClauses));
+    uint32_t cClauses = 0;
+
+    if (   pszDup
+        && paClauses)
+    {
+        char *pszSaveClause = NULL;
+
+        for (char *pszClause = strtok_r(pszDup, ";", &pszSaveClause);
+                pszClause && STS_SUCCESS(rc);
+                pszClause = strtok_r(NULL, ";", &pszSaveClause))
+        {
+            PPSPTRACEFLTCLAUSE pClause = &paClauses[cClauses];
+            char *pszSaveTerm = NULL;
+            uint32_t cTerms = 0;
+
+            if (cClauses == PSP_TRACE_FLT_CLAUSES_MAX)
+            {
+                rc = STS_ERR_BUFFER_OVERFLOW;
+                break;
+            }
+
+            pClause->fFlags = PSP_TRACE_FLT_CLAUSE_F_READ | PSP_TRACE_FLT_CLAUSE_F_WRITE;
+            for (char *pszTerm = strtok_r(pszClause, " \t", &pszSaveTerm);
+                    pszTerm && STS_SUCCESS(rc);
+                    pszTerm = strtok_r(NULL, " \t", &pszSaveTerm))
+            {
+                rc = pspEmuTraceFltParseTerm(pClause, pszTerm);
+                cTerms++;
+            }
+
+            /* Skip empty clauses (like a trailing ';'). */
+            if (cTerms)
+                cClauses++;
+        }
+
+        if (   STS_SUCCESS(rc)
+            && !cClauses)
+            rc = STS_ERR_INVALID_PARAMETER;
+    }
+    else
+        rc = STS_ERR_NO_MEMORY;
+
+    if (pszDup)
+        free(pszDup);
+
+    if (STS_SUCCESS(rc))
+    {
+        *ppaClauses = paClauses;
+        *pcClauses  = cClauses;
+    }
+    else if (paClauses)
+        free(paClauses);
+
+    return rc;
+}
+
+
+/**
+ * Checks whether the given clause matches the given device.
+ *
+ * @returns Flag whether the device matches.
+ * @param   pClause                 The clause to check.
+ * @param   enmOrigin               The origin of the access.
+ * @param   pszDevId                The device identifier.
+ */
+static bool pspEmuTraceFltClauseMatchesDev(PCPSPTRACEFLTCLAUSE pClause, PSPTRACEEVTORIGIN enmOrigin, const char *pszDevId)
+{
+    if (   pClause->bmOrigins
+        && !(pClause->bmOrigins & BIT(enmOrigin)))
+        return false;
+
+    if (pClause->fFlags & PSP_TRACE_FLT_CLAUSE_F_DEV)
+    {
+        if (!pszDevId)
+            return false;
+
+        if (pClause->fFlags & PSP_TRACE_FLT_CLAUSE_F_DEV_PREFIX)
+            return !strncmp(pszDevId, &pClause->szDev[0], strlen(&pClause->szDev[0]));
+
+        return !strcmp(pszDevId, &pClause->szDev[0]);
+    }
+
+    return true;
+}
+
+
+/**
+ * Checks the access dependent predicates of the given clause, accounting the event
+ * against the rate limit if everything else matches.
+ *
+ * @returns Flag whether the access matches.
+ * @param   pThis                   The tracer instance.
+ * @param   pClause                 The clause to check.
+ * @param   u64Addr                 The accessed address.
+ * @param   fWrite                  Flag whether this is a write access.
+ * @param   pvVal                   The value being accessed.
+ * @param   cbVal                   Size of the access in bytes.
+ * @param   pfPcQueried             Flag whether the PC was queried already, updated.
+ * @param   pPspAddrPc              Where the PC is stored, updated on first use.
+ */
+static bool pspEmuTraceFltClauseMatchesAccess(PPSPTRACEINT pThis, PPSPTRACEFLTCLAUSE pClause, uint64_t u64Addr,
+                                              bool fWrite, const void *pvVal, size_t cbVal,
+                                              bool *pfPcQueried, uint32_t *pPspAddrPc)
+{
+    if (!(pClause->fFlags & (fWrite ? PSP_TRACE_FLT_CLAUSE_F_WRITE : PSP_TRACE_FLT_CLAUSE_F_READ)))
+        return false;
+
+    if (   (pClause->fFlags & PSP_TRACE_FLT_CLAUSE_F_ADDR)
+        && (   u64Addr > pClause->u64AddrLast
+            || u64Addr + (cbVal ? cbVal - 1 : 0) < pClause->u64AddrFirst))
+        return false;
+
+    if (pClause->fFlags & PSP_TRACE_FLT_CLAUSE_F_VAL)
+    {
+        uint64_t u64Val = 0;
+        memcpy(&u64Val, pvVal, MIN(cbVal, sizeof(u64Val)));
+        if ((u64Val & pClause->u64ValMask) != pClause->u64Val)
+            return false;
+    }
+
+    if (pClause->fFlags & PSP_TRACE_FLT_CLAUSE_F_PC)
+    {
+        /* Only query the PC once per access and only if actually required. */
+        if (!*pfPcQueried)
+        {
+            if (   !pThis->hPspCore
+                || STS_FAILURE(PSPEmuCoreQueryReg(pThis->hPspCore, PSPCOREREG_PC, pPspAddrPc)))
+                return false;
+            *pfPcQueried = true;
+        }
+
+        if (   *pPspAddrPc < pClause->PspAddrPcFirst
+            || *pPspAddrPc > pClause->PspAddrPcLast)
+            return false;
+    }
+
+    if (pClause->fFlags & PSP_TRACE_FLT_CLAUSE_F_RATE)
+    {
+        struct timespec Tp;
+        clock_gettime(CLOCK_MONOTONIC, &Tp);
+        uint64_t tsNs = (uint64_t)Tp.tv_sec * 1000000000ULL + Tp.tv_nsec;
+
+        if (tsNs - pClause->tsRateWndNs >= 1000000000ULL)
+        {
+            pClause->tsRateWndNs = tsNs;
+            pClause->cRateWnd    = 0;
+        }
+
+        if (pClause->cRateWnd == pClause->cRateMax)
+            return false;
+        pClause->cRateWnd++;
+    }
+
+    return true;
+}
+
+
 int PSPEmuTraceCreate(PPSPTRACE phTrace, uint32_t fFlags, PSPCORE hPspCore,
                       uint32_t cEvtsBuffer, PFNPSPTRACEFLUSH pfnFlush, void *pvUser)
 {
@@ -803,6 +1357,7 @@ int PSPEmuTraceCreate(PPSPTRACE phTrace, uint32_t fFlags, PSPCORE hPspCore,
         pThis->cTraceEvtsMax    = 0;
         pThis->cTraceEvts       = 0;
         pThis->papTraceEvts     = NULL;
+        pthread_mutex_init(&pThis->Mtx, NULL);
 
         if (fFlags & PSPEMU_TRACE_F_ALL_EVENTS)
         {
@@ -839,7 +1394,7 @@ void PSPEmuTraceDestroy(PSPTRACE hTrace)
 {
     PPSPTRACEINT pThis = hTrace;
 
-    /* Unset as default. */
+    /* Unset as default (only possible for the calling thread). */
     if (g_pTraceDef == pThis)
         g_pTraceDef = NULL;
 
@@ -850,7 +1405,13 @@ void PSPEmuTraceDestroy(PSPTRACE hTrace)
             free((void *)pThis->papTraceEvts[i]);
         free(pThis->papTraceEvts);
     }
+    if (pThis->paFltClauses)
+        free(pThis->paFltClauses);
+    pthread_mutex_destroy(&pThis->Mtx);
     free(pThis);
+
+    /* Release the disassembler state of the destroying thread used by the core state dumps logged from it. */
+    PSPEmuDisasmThreadTerm();
 }
 
 
@@ -882,6 +1443,97 @@ int PSPEmuTraceEvtEnable(PSPTRACE hTrace, PSPTRACEEVTORIGIN *paEvtOrigins, PSPTR
 }
 
 
+int PSPEmuTraceFilterSet(PSPTRACE hTrace, const char *pszFilter)
+{
+    int rc = STS_INF_SUCCESS;
+    PPSPTRACEINT pThis = pspEmuTraceGetInstance(hTrace);
+    PPSPTRACEFLTCLAUSE paClauses = NULL;
+    uint32_t cClauses = 0;
+
+    if (!pThis)
+        return STS_ERR_INVALID_PARAMETER;
+
+    if (   pszFilter
+        && *pszFilter != '\0')
+        rc = pspEmuTraceFltCompile(pszFilter, &paClauses, &cClauses);
+
+    if (STS_SUCCESS(rc))
+    {
+        pthread_mutex_lock(&pThis->Mtx);
+        PPSPTRACEFLTCLAUSE paClausesOld = pThis->paFltClauses;
+        pThis->paFltClauses = paClauses;
+        pThis->cFltClauses  = cClauses;
+        pThis->uFltGen      = 0;
+        if (cClauses)
+        {
+            /* Skip 0 on wraparound as it means no filter is set. */
+            if (!++g_uTraceFltGenLast)
+                g_uTraceFltGenLast++;
+            pThis->uFltGen = g_uTraceFltGenLast;
+        }
+        pthread_mutex_unlock(&pThis->Mtx);
+
+        if (paClausesOld)
+            free(paClausesOld);
+    }
+
+    return rc;
+}
+
+
+uint32_t PSPEmuTraceFilterGetGen(PSPTRACE hTrace)
+{
+    PPSPTRACEINT pThis = pspEmuTraceGetInstance(hTrace);
+    return pThis ? pThis->uFltGen : 0;
+}
+
+
+uint64_t PSPEmuTraceFilterQueryDev(PSPTRACE hTrace, PSPTRACEEVTORIGIN enmOrigin, const char *pszDevId)
+{
+    PPSPTRACEINT pThis = pspEmuTraceGetInstance(hTrace);
+    uint64_t bmClauses = 0;
+
+    if (pThis)
+    {
+        pthread_mutex_lock(&pThis->Mtx);
+        for (uint32_t i = 0; i < pThis->cFltClauses; i++)
+        {
+            if (pspEmuTraceFltClauseMatchesDev(&pThis->paFltClauses[i], enmOrigin, pszDevId))
+                bmClauses |= 1ULL << i;
+        }
+        pthread_mutex_unlock(&pThis->Mtx);
+    }
+
+    return bmClauses;
+}
+
+
+bool PSPEmuTraceFilterCheck(PSPTRACE hTrace, uint64_t bmClauses, uint64_t u64Addr, bool fWrite,
+                            const void *pvVal, size_t cbVal)
+{
+    PPSPTRACEINT pThis = pspEmuTraceGetInstance(hTrace);
+    bool fMatch = false;
+
+    if (   pThis
+        && bmClauses)
+    {
+        bool fPcQueried = false;
+        uint32_t PspAddrPc = 0;
+
+        pthread_mutex_lock(&pThis->Mtx);
+        for (uint32_t i = 0; i < pThis->cFltClauses && !fMatch; i++)
+        {
+            if (bmClauses & (1ULL << i))
+                fMatch = pspEmuTraceFltClauseMatchesAccess(pThis, &pThis->paFltClauses[i], u64Addr, fWrite,
+                                                           pvVal, cbVal, &fPcQueried, &PspAddrPc);
+        }
+        pthread_mutex_unlock(&pThis->Mtx);
+    }
+
+    return fMatch;
+}
+
+
 int PSPEmuTraceEvtAddStringV(PSPTRACE hTrace, PSPTRACEEVTSEVERITY enmSeverity, PSPTRACEEVTORIGIN enmEvtOrigin,
                              const char *pszFmt, va_list hArgs)
 {
@@ -921,6 +1573,8 @@ int PSPEmuTraceEvtAddStringV(PSPTRACE hTrace, PSPTRACEEVTSEVERITY enmSeverity, P
                 size_t cbStr = rcStr + 1; /* Include terminator. */
                 size_t cbAlloc = cbStr + sizeof(PSPTRACEEVTSTR);
 
+                pthread_mutex_lock(&pThis->Mtx);
+                PSPEmuPerfEnter(PSPPERFSUBSYS_TRACE);
                 rc = pspEmuTraceEvtCreateAndLink(pThis, enmSeverity, enmEvtOrigin, PSPTRACEEVTCONTENTTYPE_STRING, cbAlloc, &pEvt);
                 if (!rc)
                 {
@@ -941,6 +1595,8 @@ int PSPEmuTraceEvtAddStringV(PSPTRACE hTrace, PSPTRACEEVTSEVERITY enmSeverity, P
                     memcpy(&pStr->achStr[0], pszStart, cbStr);
                     rc = pspEmuTraceFlushMaybe(pThis);
                 }
+                PSPEmuPerfLeave();
+                pthread_mutex_unlock(&pThis->Mtx);
             }
         }
         else
@@ -972,6 +1628,9 @@ int PSPEmuTraceEvtAddXfer(PSPTRACE hTrace, PSPTRACEEVTSEVERITY enmSeverity, PSPT
     {
         PPSPTRACEEVT pEvt;
         size_t cbAlloc = sizeof(PSPTRACEEVTXFER) + cbXfer;
+
+        pthread_mutex_lock(&pThis->Mtx);
+        PSPEmuPerfEnter(PSPPERFSUBSYS_TRACE);
         rc = pspEmuTraceEvtCreateAndLink(pThis, enmSeverity, enmEvtOrigin, PSPTRACEEVTCONTENTTYPE_XFER, cbAlloc, &pEvt);
         if (!rc)
         {
@@ -982,6 +1641,8 @@ int PSPEmuTraceEvtAddXfer(PSPTRACE hTrace, PSPTRACEEVTSEVERITY enmSeverity, PSPT
             memcpy(&pXfer->abXfer[0], pvBuf, cbXfer);
             rc = pspEmuTraceFlushMaybe(pThis);
         }
+        PSPEmuPerfLeave();
+        pthread_mutex_unlock(&pThis->Mtx);
     }
 
     return rc;